@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "cluon-complete.hpp"
+#include "codec.hpp"
+#include "rec-file-view.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Compress all Envelopes of a .rec file with each codec and report the
+// compression ratio versus compression and decompression speed per dataType.
+int32_t main(int32_t argc, char **argv) {
+  int32_t retCode{0};
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if (0 == commandlineArguments.count("rec")) {
+    std::cerr << argv[0] << " compares the codecs for values on the Envelopes from a .rec file." << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --rec=MyFile.rec [--codec=lz4,lz4hc:9,zstd:3]" << std::endl;
+    std::cerr << "         --rec:   name of the recording file" << std::endl;
+    std::cerr << "         --codec: comma-separated list of codecs to compare (default: all available with typical levels)" << std::endl;
+    std::cerr << "Example: " << argv[0] << " --rec=myFile.rec" << std::endl;
+    retCode = 1;
+  } else {
+    const std::string REC{commandlineArguments["rec"]};
+    std::string CODECS{commandlineArguments["codec"]};
+    if (CODECS.empty()) {
+      CODECS = "none,lz4,lz4:8,lz4hc:3,lz4hc:9,lz4hc:12,lz4dict,lz4hcdict:9";
+      if (codec::isAvailable(codec::ZSTD)) {
+        CODECS += ",zstd:1,zstd:3,zstd:19";
+      }
+    }
+
+    std::vector<codec::Config> configs;
+    {
+      std::stringstream sstr{CODECS};
+      for (std::string entry; std::getline(sstr, entry, ',');) {
+        codec::Config c;
+        if (!codec::parse(entry, c)) {
+          std::cerr << "[" << argv[0] << "]: Invalid or unavailable codec '" << entry << "'." << std::endl;
+          return 1;
+        }
+        configs.push_back(c);
+      }
+    }
+
+    cluon::RecFileView recFile(REC);
+    if (!recFile.good()) {
+      std::cerr << "[" << argv[0] << "]: " << REC << " could not be opened." << std::endl;
+      return 1;
+    }
+    std::map<int32_t, std::vector<std::pair<const char*, std::size_t>>> envelopesPerDataType;
+    {
+      cluon::EnvelopeView e;
+      while (recFile.next(e)) {
+        envelopesPerDataType[e.dataType()].push_back(std::make_pair(e.data(), e.size()));
+      }
+    }
+    // Summary over all dataTypes.
+    envelopesPerDataType[-1] = {};
+    for (auto &entry : envelopesPerDataType) {
+      if (-1 != entry.first) {
+        envelopesPerDataType[-1].insert(envelopesPerDataType[-1].end(), entry.second.begin(), entry.second.end());
+      }
+    }
+
+    auto MBperSecond = [](const uint64_t &bytes, const int64_t &duration) {
+      return (duration > 0) ? (static_cast<double>(bytes) / (1024.0 * 1024.0)) / (static_cast<double>(duration) / (1000.0 * 1000.0)) : 0.0;
+    };
+
+    std::cout << std::setw(10) << "dataType" << std::setw(10) << "count" << std::setw(12) << "codec"
+              << std::setw(14) << "raw bytes" << std::setw(14) << "stored bytes" << std::setw(8) << "ratio"
+              << std::setw(14) << "comp. MB/s" << std::setw(14) << "decomp. MB/s" << std::endl;
+    for (auto &entry : envelopesPerDataType) {
+      for (auto &c : configs) {
+        uint64_t rawBytes{0};
+        uint64_t storedBytes{0};
+        std::vector<std::vector<char>> compressedValues(entry.second.size());
+        std::vector<cabinet::Key> keys(entry.second.size());
+
+        // Train the dictionary upfront from the first values of this dataType.
+        codec::Dictionaries dictionaries;
+        std::shared_ptr<const codec::Dictionary> dictionary;
+        if (codec::usesDictionary(c.codec)) {
+          codec::DictionaryTrainer trainer(dictionaries);
+          for (std::size_t i{0}; (i < entry.second.size()) && (nullptr == dictionary); i++) {
+            dictionary = trainer.sample(entry.first, 0, entry.second[i].first, entry.second[i].second);
+          }
+        }
+
+        const cluon::data::TimeStamp BEFORE_COMPRESSION{cluon::time::now()};
+        for (std::size_t i{0}; i < entry.second.size(); i++) {
+          const uint8_t applied{codec::encode(c, entry.second[i].first, entry.second[i].second, compressedValues[i], dictionary.get())};
+          keys[i].length(entry.second[i].second).version(codec::version(0, applied));
+          rawBytes += entry.second[i].second;
+          storedBytes += (codec::NONE != applied) ? compressedValues[i].size() : entry.second[i].second;
+        }
+        const int64_t compressionDuration{cluon::time::deltaInMicroseconds(cluon::time::now(), BEFORE_COMPRESSION)};
+
+        std::vector<char> buffer;
+        uint64_t failures{0};
+        const cluon::data::TimeStamp BEFORE_DECOMPRESSION{cluon::time::now()};
+        for (std::size_t i{0}; i < entry.second.size(); i++) {
+          const bool COMPRESSED{codec::NONE != codec::codecOf(keys[i])};
+          auto value = codec::decode(keys[i], COMPRESSED ? compressedValues[i].data() : entry.second[i].first,
+                                              COMPRESSED ? compressedValues[i].size() : entry.second[i].second, buffer, &dictionaries);
+          failures += ((nullptr == value.first) || (value.second != entry.second[i].second)) ? 1 : 0;
+        }
+        const int64_t decompressionDuration{cluon::time::deltaInMicroseconds(cluon::time::now(), BEFORE_DECOMPRESSION)};
+
+        std::cout << std::setw(10) << ((-1 == entry.first) ? std::string("all") : std::to_string(entry.first))
+                  << std::setw(10) << entry.second.size() << std::setw(12) << codec::toString(c)
+                  << std::setw(14) << rawBytes << std::setw(14) << storedBytes
+                  << std::fixed << std::setprecision(3) << std::setw(8) << ((storedBytes > 0) ? static_cast<double>(rawBytes) / static_cast<double>(storedBytes) : 0.0)
+                  << std::setprecision(1) << std::setw(14) << MBperSecond(rawBytes, compressionDuration)
+                  << std::setw(14) << MBperSecond(rawBytes, decompressionDuration) << std::defaultfloat
+                  << ((failures > 0) ? " (" + std::to_string(failures) + " failures)" : "") << std::endl;
+      }
+    }
+  }
+  return retCode;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "cluon-complete.hpp"
+#include "hilbert.hpp"
+#include "key.hpp"
+#include "morton.hpp"
+#include "../test/gps-traces.hpp"
+
+#include "lmdb.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Replay the lap around AstaZero from tests-morton.cpp with some jitter per lap,
+// index the positions along the Z-order and the Hilbert curve, and report per
+// geobox the seeks, the distinct pages holding the results, and the latency.
+int32_t main(int32_t argc, char **argv) {
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if (0 != commandlineArguments.count("help")) {
+    std::cerr << argv[0] << " compares geobox queries on the tables '19/0-morton' and '19/0-hilbert' for replayed GPS traces." << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " [--laps=100] [--queries=1000] [--size=200] [--cells=256] [--cab=/tmp/bench-curves.cab]" << std::endl;
+    std::cerr << "         --laps:    number of replayed laps at 10Hz (default: 100)" << std::endl;
+    std::cerr << "         --queries: number of random geoboxes along the trace (default: 1000)" << std::endl;
+    std::cerr << "         --size:    edge length of the geoboxes in meters (default: 200)" << std::endl;
+    std::cerr << "         --cells:   upper limit of cells to cover a geobox along the Hilbert curve (default: 256)" << std::endl;
+    std::cerr << "         --cab:     name of the temporary database file (default: /tmp/bench-curves.cab)" << std::endl;
+    return 1;
+  }
+  const uint32_t LAPS{(commandlineArguments["laps"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["laps"])) : 100};
+  const uint32_t QUERIES{(commandlineArguments["queries"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["queries"])) : 1000};
+  const double SIZE{(commandlineArguments["size"].size() != 0) ? std::stod(commandlineArguments["size"]) : 200.0};
+  const std::size_t CELLS{(commandlineArguments["cells"].size() != 0) ? static_cast<std::size_t>(std::stoul(commandlineArguments["cells"])) : 256};
+  const std::string CABINET{(commandlineArguments["cab"].size() != 0) ? commandlineArguments["cab"] : "/tmp/bench-curves.cab"};
+
+  std::vector<std::pair<double, double>> trace;
+  {
+    std::stringstream sstr{std::string(GPS_TRACE_AZ)};
+    double lat{0};
+    double lon{0};
+    while (sstr >> lat >> lon) {
+      trace.emplace_back(lat, lon);
+    }
+  }
+
+  // One degree of latitude is about 111,195m; the longitudes are scaled by the cosine of the latitude.
+  const double SCALE{std::cos(trace.front().first * M_PI / 180.0)};
+  const double METER{1.0 / 111195.0};
+  std::mt19937_64 rng(42);
+  std::normal_distribution<double> jitter(0.0, 1.5 * METER);
+  std::vector<std::pair<float, float>> positions;
+  for (uint32_t lap{0}; lap < LAPS; lap++) {
+    const double OFFSET_LAT{jitter(rng)};
+    const double OFFSET_LON{jitter(rng) / SCALE};
+    for (std::size_t i{0}; i < trace.size(); i++) {
+      const auto &a = trace[i];
+      const auto &b = trace[(i + 1) % trace.size()];
+      // The points of the trace are about 50m apart; at 18km/h, they are interpolated at 10Hz.
+      for (uint32_t step{0}; step < 100; step++) {
+        const double T{static_cast<double>(step) / 100.0};
+        positions.emplace_back(static_cast<float>(a.first + (b.first - a.first) * T + OFFSET_LAT),
+                               static_cast<float>(a.second + (b.second - a.second) * T + OFFSET_LON));
+      }
+    }
+  }
+
+  std::remove(CABINET.c_str());
+  std::remove((CABINET + "-lock").c_str());
+  MDB_env *env{nullptr};
+  mdb_env_create(&env);
+  mdb_env_set_mapsize(env, 16UL * 1024UL * 1024UL * 1024UL);
+  mdb_env_set_maxdbs(env, 10);
+  if (MDB_SUCCESS != mdb_env_open(env, CABINET.c_str(), MDB_NOSUBDIR|MDB_NOSYNC, 0600)) {
+    std::cerr << "[" << argv[0] << "]: " << CABINET << " could not be opened." << std::endl;
+    mdb_env_close(env);
+    return 1;
+  }
+  MDB_stat envStat;
+  mdb_env_stat(env, &envStat);
+  const uintptr_t PAGE_SIZE{envStat.ms_psize};
+
+  const std::vector<Curve> CURVES{CURVE_MORTON, CURVE_HILBERT};
+  for (const Curve &curve : CURVES) {
+    MDB_txn *txn{nullptr};
+    MDB_dbi dbi{0};
+    mdb_txn_begin(env, nullptr, 0, &txn);
+    mdb_dbi_open(txn, ("19/0" + curveSuffixOf(curve)).c_str(), MDB_CREATE|MDB_DUPSORT|MDB_DUPFIXED, &dbi);
+    mdb_set_compare(txn, dbi, &compareMortonKeys);
+    mdb_set_dupsort(txn, dbi, &compareKeys);
+    int64_t timeStamp{1650000000000000000LL};
+    for (const auto &p : positions) {
+      uint64_t k{htobe64(convertLatLonToCurve(curve, p))};
+      int64_t v{static_cast<int64_t>(htobe64(static_cast<uint64_t>(timeStamp)))};
+      MDB_val key{sizeof(k), &k};
+      MDB_val value{sizeof(v), &v};
+      mdb_put(txn, dbi, &key, &value, 0);
+      timeStamp += 100000000LL;
+    }
+    mdb_txn_commit(txn);
+  }
+
+  // Geoboxes around random positions of the trace.
+  std::vector<std::pair<uint64_t, uint64_t>> boxes;
+  std::uniform_real_distribution<double> shift(-0.5 * SIZE * METER, 0.5 * SIZE * METER);
+  for (uint32_t i{0}; i < QUERIES; i++) {
+    const auto &p = trace[rng() % trace.size()];
+    const double LAT{p.first + shift(rng)};
+    const double LON{p.second + shift(rng) / SCALE};
+    const double HALF{0.5 * SIZE * METER};
+    boxes.push_back(convertLatLonBoxToMorton(std::make_pair(static_cast<float>(LAT - HALF), static_cast<float>(LON - HALF / SCALE)),
+                                             std::make_pair(static_cast<float>(LAT + HALF), static_cast<float>(LON + HALF / SCALE))));
+  }
+
+  std::cout << positions.size() << " positions, " << QUERIES << " geoboxes of " << SIZE << "m" << std::endl;
+  std::cout << std::setw(10) << "curve" << std::setw(14) << "entries/box" << std::setw(14) << "seeks/box" << std::setw(14) << "pages/box" << std::setw(14) << "us/box" << std::endl;
+  for (const Curve &curve : CURVES) {
+    MDB_txn *txn{nullptr};
+    MDB_dbi dbi{0};
+    mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn);
+    mdb_dbi_open(txn, ("19/0" + curveSuffixOf(curve)).c_str(), 0, &dbi);
+    mdb_set_compare(txn, dbi, &compareMortonKeys);
+    mdb_set_dupsort(txn, dbi, &compareKeys);
+    MDB_cursor *cursor{nullptr};
+    mdb_cursor_open(txn, dbi, &cursor);
+
+    // The values point into the memory map; their pages are the pages read for the results.
+    uint64_t entries{0};
+    uint64_t seeks{0};
+    uint64_t pages{0};
+    std::unordered_set<uintptr_t> pagesOfBox;
+    auto delegate = [&](const uint64_t &, const MDB_val &values) {
+      entries += values.mv_size / sizeof(int64_t);
+      pagesOfBox.insert(reinterpret_cast<uintptr_t>(values.mv_data) / PAGE_SIZE);
+    };
+    for (const auto &box : boxes) {
+      pagesOfBox.clear();
+      seeks += (CURVE_HILBERT == curve) ? hilbertForEachInBox(cursor, box.first, box.second, delegate, nullptr, CELLS) : mortonForEachInBox(cursor, box.first, box.second, delegate);
+      pages += pagesOfBox.size();
+    }
+
+    // The latency is measured on a second run with the pages in memory.
+    auto noop = [](const uint64_t &, const MDB_val &) {};
+    cluon::data::TimeStamp before{cluon::time::now()};
+    for (const auto &box : boxes) {
+      if (CURVE_HILBERT == curve) {
+        hilbertForEachInBox(cursor, box.first, box.second, noop, nullptr, CELLS);
+      }
+      else {
+        mortonForEachInBox(cursor, box.first, box.second, noop);
+      }
+    }
+    const double MICROSECONDS{static_cast<double>(cluon::time::deltaInMicroseconds(cluon::time::now(), before))};
+    mdb_cursor_close(cursor);
+    mdb_txn_abort(txn);
+
+    const double N{static_cast<double>(std::max(QUERIES, 1u))};
+    std::cout << std::setw(10) << curveSuffixOf(curve).substr(1) << std::fixed << std::setprecision(1)
+              << std::setw(14) << static_cast<double>(entries) / N << std::setw(14) << static_cast<double>(seeks) / N
+              << std::setw(14) << static_cast<double>(pages) / N << std::setw(14) << MICROSECONDS / N << std::defaultfloat << std::endl;
+  }
+  mdb_env_close(env);
+  std::remove(CABINET.c_str());
+  std::remove((CABINET + "-lock").c_str());
+  return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "cluon-complete.hpp"
+#include "key.hpp"
+
+#include "lmdb.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Previous implementation of getKey that visited the fields of cabinet::Key.
+static cabinet::Key getKeyByVisitor(const char *src, const size_t &len) noexcept {
+  cabinet::Key k;
+  if ( (nullptr != src) && (KEY_SIZE <= len) ) {
+    uint16_t offset{0};
+    k.accept([](uint32_t, const std::string &, const std::string &) {},
+             [src, &offset](uint32_t field, std::string &&, std::string &&, auto &v) {
+              if (8 >= field) {
+                decltype(v) ntoh{v};
+                std::memcpy(reinterpret_cast<char*>(&ntoh), src + offset, sizeof(ntoh));
+                offset += sizeof(ntoh);
+                if (2 == sizeof(v)) { ntoh = be16toh(v); }
+                else if (4 == sizeof(v)) { ntoh = be32toh(v); }
+                else if (8 == sizeof(v)) { ntoh = be64toh(v); }
+                v = ntoh;
+              }
+             },
+             [](){}
+            );
+    if (KEY_LAYOUT_MEMCMP == (k.version() & 0x0F)) {
+      k.timeStamp(flipSignBit(k.timeStamp())).dataType(flipSignBit(k.dataType()));
+    }
+  }
+  return k;
+}
+
+// Previous implementation of setKey that visited the fields of cabinet::Key.
+static size_t setKeyByVisitor(cabinet::Key k, char *dest, const size_t &len) noexcept {
+  if (KEY_LAYOUT_MEMCMP == (k.version() & 0x0F)) {
+    k.timeStamp(flipSignBit(k.timeStamp())).dataType(flipSignBit(k.dataType()));
+  }
+  if ( (nullptr != dest) && (KEY_SIZE <= len) ) {
+    uint16_t offset{0};
+    k.accept([](uint32_t, const std::string &, const std::string &) {},
+             [dest, &offset](uint32_t field, std::string &&, std::string &&, auto v) {
+              if (8 >= field) {
+                decltype(v) hton{v};
+                if (2 == sizeof(v)) { hton = htobe16(v); }
+                else if (4 == sizeof(v)) { hton = htobe32(v); }
+                else if (8 == sizeof(v)) { hton = htobe64(v); }
+                std::memcpy(dest + offset, reinterpret_cast<const char*>(&hton), sizeof(hton));
+                offset += sizeof(hton);
+              }
+             },
+             [](){}
+            );
+    return offset;
+  }
+  return 0;
+}
+
+// Serialize and deserialize synthetic keys and report ns/key for the previous
+// visitor-based codec, the fixed-offset codec, single-field reads, and the
+// batch decoder.
+int32_t main(int32_t argc, char **argv) {
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if (0 != commandlineArguments.count("help")) {
+    std::cerr << argv[0] << " measures the cost to serialize and deserialize cabinet::Keys." << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " [--entries=1000000] [--runs=5] [--batch=256]" << std::endl;
+    std::cerr << "         --entries: number of keys (default: 1000000)" << std::endl;
+    std::cerr << "         --runs:    number of runs per variant; the fastest is reported (default: 5)" << std::endl;
+    std::cerr << "         --batch:   number of keys per call to the batch decoder (default: 256)" << std::endl;
+    return 1;
+  }
+  const uint32_t ENTRIES{(commandlineArguments["entries"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["entries"])) : 1000000};
+  const uint32_t RUNS{(commandlineArguments["runs"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["runs"])) : 5};
+  const uint32_t BATCH{(commandlineArguments["batch"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["batch"])) : 256};
+
+  std::mt19937_64 rng(42);
+  std::vector<cabinet::Key> keys(ENTRIES);
+  for (uint32_t i{0}; i < ENTRIES; i++) {
+    keys[i].timeStamp(1650000000000000000LL + static_cast<int64_t>(i) * 1000000LL)
+           .dataType(static_cast<int32_t>(19 + (i % 10)))
+           .senderStamp(i % 3)
+           .hash(rng())
+           .hashOfRecFile(0x1234)
+           .length(static_cast<uint16_t>(rng() % 1000))
+           .userData(0)
+           .version(static_cast<uint8_t>(i % 2));
+  }
+  std::vector<char> serialized(static_cast<size_t>(ENTRIES) * KEY_SIZE);
+  std::vector<MDB_val> vals(ENTRIES);
+  for (uint32_t i{0}; i < ENTRIES; i++) {
+    vals[i].mv_data = serialized.data() + static_cast<size_t>(i) * KEY_SIZE;
+    vals[i].mv_size = setKey(keys[i], static_cast<char*>(vals[i].mv_data), KEY_SIZE);
+  }
+
+  // Run f RUNS times and return the fastest run in ns/key; the checksum keeps the compiler from dropping the work.
+  uint64_t checksum{0};
+  auto measure = [ENTRIES, RUNS, &checksum](auto &&f) {
+    double best{0};
+    for (uint32_t run{0}; run < RUNS; run++) {
+      const cluon::data::TimeStamp BEFORE{cluon::time::now()};
+      checksum += f();
+      const double NS{static_cast<double>(cluon::time::deltaInMicroseconds(cluon::time::now(), BEFORE)) * 1000.0 / static_cast<double>(ENTRIES)};
+      best = ((0 == run) || (NS < best)) ? NS : best;
+    }
+    return best;
+  };
+
+  std::vector<char> out(KEY_SIZE);
+  std::vector<std::pair<std::string, double>> results;
+  results.emplace_back("setKey (visitor)", measure([&]() {
+    uint64_t sum{0};
+    for (auto &k : keys) {
+      sum += setKeyByVisitor(k, out.data(), out.size()) + static_cast<uint8_t>(out[7]);
+    }
+    return sum;
+  }));
+  results.emplace_back("setKey", measure([&]() {
+    uint64_t sum{0};
+    for (auto &k : keys) {
+      sum += setKey(k, out.data(), out.size()) + static_cast<uint8_t>(out[7]);
+    }
+    return sum;
+  }));
+  results.emplace_back("getKey (visitor)", measure([&]() {
+    uint64_t sum{0};
+    for (auto &v : vals) {
+      cabinet::Key k = getKeyByVisitor(static_cast<char*>(v.mv_data), v.mv_size);
+      sum += static_cast<uint64_t>(k.timeStamp()) + k.hash();
+    }
+    return sum;
+  }));
+  results.emplace_back("getKey", measure([&]() {
+    uint64_t sum{0};
+    for (auto &v : vals) {
+      cabinet::Key k = getKey(static_cast<char*>(v.mv_data), v.mv_size);
+      sum += static_cast<uint64_t>(k.timeStamp()) + k.hash();
+    }
+    return sum;
+  }));
+  results.emplace_back("keyTimeStamp", measure([&]() {
+    uint64_t sum{0};
+    for (auto &v : vals) {
+      sum += static_cast<uint64_t>(keyTimeStamp(static_cast<char*>(v.mv_data)));
+    }
+    return sum;
+  }));
+  results.emplace_back("keyDataType", measure([&]() {
+    uint64_t sum{0};
+    for (auto &v : vals) {
+      sum += static_cast<uint64_t>(keyDataType(static_cast<char*>(v.mv_data)));
+    }
+    return sum;
+  }));
+  std::vector<int64_t> timeStamps(BATCH);
+  std::vector<int32_t> dataTypes(BATCH);
+  std::vector<uint32_t> senderStamps(BATCH);
+  results.emplace_back("getKeyColumns", measure([&]() {
+    uint64_t sum{0};
+    for (size_t i{0}; i < vals.size(); i += BATCH) {
+      const size_t N{std::min(static_cast<size_t>(BATCH), vals.size() - i)};
+      getKeyColumns(vals.data() + i, N, timeStamps.data(), dataTypes.data(), senderStamps.data());
+      for (size_t j{0}; j < N; j++) {
+        sum += static_cast<uint64_t>(timeStamps[j]) + static_cast<uint64_t>(dataTypes[j]) + senderStamps[j];
+      }
+    }
+    return sum;
+  }));
+
+  for (auto r : results) {
+    std::cout << std::setw(18) << r.first << ": " << std::fixed << std::setprecision(2) << r.second << " ns/key" << std::endl;
+  }
+  std::cout << "(checksum 0x" << std::hex << checksum << std::dec << ")" << std::endl;
+  return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "cluon-complete.hpp"
+#include "key.hpp"
+
+#include "lmdb.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+
+// Comparator of earlier versions that considered only the timeStamp; keys
+// with the same timeStamp were moved to the next free nanosecond.
+static int compareTimeStamps(const MDB_val *a, const MDB_val *b) {
+  int64_t lhs{0};
+  int64_t rhs{0};
+  std::memcpy(&lhs, a->mv_data, sizeof(int64_t));
+  std::memcpy(&rhs, b->mv_data, sizeof(int64_t));
+  lhs = be64toh(lhs);
+  rhs = be64toh(rhs);
+  return (lhs < rhs ? -1 : (lhs > rhs ? 1 : 0));
+}
+
+// Insert synthetic keys into a table per key layout and report the cost of
+// inserting, scanning, and looking up keys with compareKeys versus memcmp,
+// and versus probing for a free nanosecond on keys with the same timeStamp.
+int32_t main(int32_t argc, char **argv) {
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if (0 != commandlineArguments.count("help")) {
+    std::cerr << argv[0] << " compares the B-tree costs for the key layouts on synthetic keys." << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " [--entries=1000000] [--burst=8] [--lookups=1000000] [--cab=/tmp/bench-keys.cab]" << std::endl;
+    std::cerr << "         --entries: number of keys to insert (default: 1000000)" << std::endl;
+    std::cerr << "         --burst:   number of keys sharing the same timeStamp like frames from several cameras (default: 1)" << std::endl;
+    std::cerr << "         --lookups: number of random lookups (default: 1000000)" << std::endl;
+    std::cerr << "         --cab:     name of the temporary database file (default: /tmp/bench-keys.cab)" << std::endl;
+    return 1;
+  }
+  const uint32_t ENTRIES{(commandlineArguments["entries"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["entries"])) : 1000000};
+  const uint32_t BURST{(commandlineArguments["burst"].size() != 0) ? std::max(1U, static_cast<uint32_t>(std::stoul(commandlineArguments["burst"]))) : 1};
+  const uint32_t LOOKUPS{(commandlineArguments["lookups"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["lookups"])) : 1000000};
+  const std::string CABINET{(commandlineArguments["cab"].size() != 0) ? commandlineArguments["cab"] : "/tmp/bench-keys.cab"};
+
+  // Envelopes from 10 streams with some jitter; bursts share their timeStamp.
+  std::mt19937_64 rng(42);
+  std::vector<cabinet::Key> keys(ENTRIES);
+  for (uint32_t i{0}; i < ENTRIES; i++) {
+    const int64_t JITTER{(1 < BURST) ? 0 : static_cast<int64_t>(rng() % 1000) * 1000LL};
+    keys[i].timeStamp(1650000000000000000LL + static_cast<int64_t>(i / BURST) * 1000000LL + JITTER)
+           .dataType(static_cast<int32_t>(19 + (i % 10)))
+           .senderStamp(i % 3)
+           .hash(rng())
+           .hashOfRecFile(0x1234)
+           .length(100);
+  }
+  std::vector<uint32_t> lookups(LOOKUPS);
+  for (auto &l : lookups) {
+    l = static_cast<uint32_t>(rng() % ENTRIES);
+  }
+
+  auto nsPer = [](const cluon::data::TimeStamp &before, const uint64_t &n) {
+    return (0 < n) ? static_cast<double>(cluon::time::deltaInMicroseconds(cluon::time::now(), before)) * 1000.0 / static_cast<double>(n) : 0.0;
+  };
+
+  enum Mode { PROBE, COMPARE_KEYS, MEMCMP };
+  std::cout << std::setw(14) << "layout" << std::setw(14) << "insert ns/key" << std::setw(14) << "probes/key" << std::setw(14) << "scan ns/key" << std::setw(16) << "lookup ns/key" << std::endl;
+  for (Mode mode : {PROBE, COMPARE_KEYS, MEMCMP}) {
+    const uint8_t layout{(MEMCMP == mode) ? KEY_LAYOUT_MEMCMP : KEY_LAYOUT_COMPARE_KEYS};
+    std::remove(CABINET.c_str());
+    std::remove((CABINET + "-lock").c_str());
+
+    MDB_env *env{nullptr};
+    mdb_env_create(&env);
+    mdb_env_set_mapsize(env, 16UL * 1024UL * 1024UL * 1024UL);
+    mdb_env_set_maxdbs(env, 1);
+    if (MDB_SUCCESS != mdb_env_open(env, CABINET.c_str(), MDB_NOSUBDIR|MDB_NOSYNC|MDB_WRITEMAP, 0600)) {
+      std::cerr << "[" << argv[0] << "]: " << CABINET << " could not be opened." << std::endl;
+      mdb_env_close(env);
+      return 1;
+    }
+
+    // Serialize the keys up front to measure only the B-tree.
+    std::vector<std::vector<char>> serializedKeys(ENTRIES, std::vector<char>(64));
+    for (uint32_t i{0}; i < ENTRIES; i++) {
+      keys[i].version(layout);
+      serializedKeys[i].resize(setKey(keys[i], serializedKeys[i].data(), serializedKeys[i].size()));
+    }
+
+    MDB_txn *txn{nullptr};
+    MDB_dbi dbi{0};
+    mdb_txn_begin(env, nullptr, 0, &txn);
+    mdb_dbi_open(txn, "all", MDB_CREATE, &dbi);
+    if (PROBE == mode) {
+      mdb_set_compare(txn, dbi, &compareTimeStamps);
+    }
+    else {
+      setKeyCompare(txn, dbi, layout);
+    }
+
+    const char VALUE[100]{};
+    uint64_t probes{0};
+    cluon::data::TimeStamp before{cluon::time::now()};
+    for (uint32_t i{0}; i < ENTRIES; i++) {
+      std::vector<char> &k = serializedKeys[i];
+      MDB_val key{k.size(), k.data()};
+      MDB_val value{sizeof(VALUE), const_cast<char*>(VALUE)};
+      if (PROBE == mode) {
+        cabinet::Key probe{keys[i]};
+        int32_t rc{MDB_SUCCESS};
+        do {
+          probes++;
+          value = MDB_val{sizeof(VALUE), const_cast<char*>(VALUE)};
+          rc = mdb_put(txn, dbi, &key, &value, MDB_NOOVERWRITE);
+          probe.timeStamp(probe.timeStamp() + 1);
+          setKey(probe, k.data(), k.size());
+        } while (MDB_KEYEXIST == rc);
+      }
+      else {
+        probes++;
+        mdb_put(txn, dbi, &key, &value, MDB_NOOVERWRITE);
+      }
+    }
+    mdb_txn_commit(txn);
+    const double INSERT{nsPer(before, ENTRIES)};
+
+    mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn);
+    MDB_cursor *cursor{nullptr};
+    mdb_cursor_open(txn, dbi, &cursor);
+    MDB_val key;
+    MDB_val value;
+    uint64_t scanned{0};
+    before = cluon::time::now();
+    while (MDB_SUCCESS == mdb_cursor_get(cursor, &key, &value, MDB_NEXT)) {
+      scanned++;
+    }
+    const double SCAN{nsPer(before, scanned)};
+
+    uint64_t found{0};
+    before = cluon::time::now();
+    for (auto i : lookups) {
+      key.mv_size = serializedKeys[i].size();
+      key.mv_data = serializedKeys[i].data();
+      found += (MDB_SUCCESS == mdb_cursor_get(cursor, &key, &value, MDB_SET_RANGE)) ? 1 : 0;
+    }
+    const double LOOKUP{nsPer(before, LOOKUPS)};
+    mdb_cursor_close(cursor);
+    mdb_txn_abort(txn);
+    mdb_env_close(env);
+
+    std::cout << std::setw(14) << ((PROBE == mode) ? "+1ns probing" : ((MEMCMP == mode) ? "memcmp" : "compareKeys"))
+              << std::fixed << std::setprecision(1)
+              << std::setw(14) << INSERT << std::setw(14) << static_cast<double>(probes) / static_cast<double>(ENTRIES) << std::setw(14) << SCAN << std::setw(16) << LOOKUP
+              << "  (" << scanned << " keys, " << found << " found)" << std::endl;
+  }
+  std::remove(CABINET.c_str());
+  std::remove((CABINET + "-lock").c_str());
+  return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "cluon-complete.hpp"
+#include "rec-file-view.hpp"
+
+#include "xxhash.h"
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+// Compare the ingestion front-end of rec2cabinet: Extracting, re-serializing,
+// and hashing Envelopes from an std::fstream vs. hashing the original bytes
+// from a memory-mapped .rec file while decoding only the fields for the key.
+int32_t main(int32_t argc, char **argv) {
+  int32_t retCode{0};
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if (0 == commandlineArguments.count("rec")) {
+    std::cerr << argv[0] << " measures the throughput to read, decode, and hash the Envelopes from a .rec file." << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --rec=MyFile.rec [--runs=3]" << std::endl;
+    std::cerr << "         --rec:  name of the recording file" << std::endl;
+    std::cerr << "         --runs: number of runs per variant (default: 3)" << std::endl;
+    std::cerr << "Example: " << argv[0] << " --rec=myFile.rec" << std::endl;
+    retCode = 1;
+  } else {
+    const std::string REC{commandlineArguments["rec"]};
+    const uint32_t RUNS{(commandlineArguments["runs"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["runs"])) : 3};
+
+    auto report = [](const std::string &name, const uint64_t &entries, const uint64_t &bytes, const uint64_t &checksum, const int64_t &duration) {
+      const double seconds{static_cast<double>(duration) / (1000.0 * 1000.0)};
+      std::cout << std::setw(12) << name << ": " << entries << " envelopes, " << bytes << " bytes in " << std::fixed << std::setprecision(3) << seconds << "s, "
+                << std::setprecision(2) << ((seconds > 0) ? (static_cast<double>(bytes) / (1024.0 * 1024.0)) / seconds : 0.0) << " MB/s, "
+                << std::setprecision(0) << ((seconds > 0) ? static_cast<double>(entries) / seconds : 0.0) << " envelopes/s"
+                << std::defaultfloat << " (checksum 0x" << std::hex << checksum << std::dec << ")" << std::endl;
+    };
+
+    for (uint32_t run{0}; run < RUNS; run++) {
+      {
+        uint64_t entries{0};
+        uint64_t bytes{0};
+        uint64_t checksum{0};
+        const cluon::data::TimeStamp BEFORE{cluon::time::now()};
+        std::fstream recFile(REC.c_str(), std::ios_base::in | std::ios_base::binary);
+        while (recFile.good()) {
+          auto retVal = cluon::extractEnvelope(recFile);
+          if (!recFile.eof() && retVal.first) {
+            cluon::data::Envelope e{std::move(retVal.second)};
+            checksum += static_cast<uint64_t>(e.dataType()) + e.senderStamp() + static_cast<uint64_t>(cluon::time::toMicroseconds(e.sampleTimeStamp()));
+            const std::string sVal{cluon::serializeEnvelope(std::move(e))};
+            checksum ^= XXH64(sVal.data(), sVal.size(), 0);
+            bytes += sVal.size();
+            entries++;
+          }
+        }
+        report("fstream", entries, bytes, checksum, cluon::time::deltaInMicroseconds(cluon::time::now(), BEFORE));
+      }
+      {
+        uint64_t entries{0};
+        uint64_t bytes{0};
+        uint64_t checksum{0};
+        const cluon::data::TimeStamp BEFORE{cluon::time::now()};
+        cluon::RecFileView recFile(REC);
+        cluon::EnvelopeView e;
+        while (recFile.next(e)) {
+          checksum += static_cast<uint64_t>(e.dataType()) + e.senderStamp() + static_cast<uint64_t>(e.sampleTimeStamp());
+          checksum ^= XXH64(e.data(), e.size(), 0);
+          bytes += e.size();
+          entries++;
+        }
+        report("RecFileView", entries, bytes, checksum, cluon::time::deltaInMicroseconds(cluon::time::now(), BEFORE));
+      }
+    }
+  }
+  return retCode;
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef BLOBS_HPP
+#define BLOBS_HPP
+
+#include "key.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Large values, such as ImageReadings or PointCloudReadings, can be stored
+ * in an append-only blob file next to the cabinet ("myStore.cab-blobs")
+ * instead of in overflow pages of the cabinet. The cabinet then stores a
+ * reference in format (all in big endian):
+ *
+ *    codec (uint8_t) file (uint32_t) offset (uint64_t) length (uint64_t)
+ *
+ * where codec is the codec that was applied to the bytes in the blob file;
+ * the key of such a value has the codec BLOB (cf. codec.hpp). file is 0 for
+ * "myStore.cab-blobs" and reserved for further blob files.
+ *
+ * The blob file is written before the transaction referring to it is
+ * committed; bytes that are not referenced after a crash are never read.
+ * Values are only appended within a write transaction of the cabinet so that
+ * LMDB's write lock serializes the writers of several processes.
+ */
+namespace blobs {
+
+constexpr std::size_t REFERENCE_SIZE{1 + 4 + 8 + 8};
+
+struct Reference {
+  uint8_t codec{0};
+  uint32_t file{0};
+  uint64_t offset{0};
+  uint64_t length{0};
+};
+
+/**
+ * @param cabinet name of the cabinet file
+ * @return name of the blob file of the cabinet
+ */
+inline std::string fileOf(const std::string &cabinet) {
+  return cabinet + "-blobs";
+}
+
+/**
+ * @param r reference
+ * @param dst buffer to store the REFERENCE_SIZE bytes of the reference in
+ */
+inline void putReference(const Reference &r, std::vector<char> &dst) {
+  dst.resize(REFERENCE_SIZE);
+  writeBigEndian(r.codec, dst.data());
+  writeBigEndian(r.file, dst.data() + 1);
+  writeBigEndian(r.offset, dst.data() + 5);
+  writeBigEndian(r.length, dst.data() + 13);
+}
+
+/**
+ * @param src stored value
+ * @param len length of the stored value
+ * @param r reference to fill
+ * @return true if src holds a reference
+ */
+inline bool getReference(const char *src, const std::size_t &len, Reference &r) {
+  if ((nullptr == src) || (REFERENCE_SIZE != len)) {
+    return false;
+  }
+  r.codec = readBigEndian<uint8_t>(src);
+  r.file = readBigEndian<uint32_t>(src + 1);
+  r.offset = readBigEndian<uint64_t>(src + 5);
+  r.length = readBigEndian<uint64_t>(src + 13);
+  return true;
+}
+
+/**
+ * This class appends the values that are larger than a threshold to the blob
+ * file, which is only created with the first such value.
+ */
+class Writer {
+ private:
+  Writer(const Writer &) = delete;
+  Writer(Writer &&)      = delete;
+  Writer &operator=(const Writer &) = delete;
+  Writer &operator=(Writer &&) = delete;
+
+ public:
+  /**
+   * @param filename blob file to append to
+   * @param MIN_SIZE values of at least this many bytes are accepted (0 = none)
+   */
+  Writer(const std::string &filename, const std::size_t &MIN_SIZE) :
+    m_filename(filename),
+    m_minSize(MIN_SIZE) {}
+
+  ~Writer() {
+    if (0 <= m_fd) {
+      sync();
+      ::close(m_fd);
+    }
+  }
+
+  /**
+   * @param len length of a value after compression
+   * @return true if the value is to be stored in the blob file
+   */
+  bool accepts(const std::size_t &len) const noexcept {
+    return (0 < m_minSize) && (m_minSize <= len);
+  }
+
+  /**
+   * This method continues at the end of the blob file; it must be called
+   * after beginning a write transaction as other processes might have
+   * appended values since the previous one.
+   */
+  void begin() {
+    if (0 <= m_fd) {
+      struct stat s;
+      if (0 != ::fstat(m_fd, &s)) {
+        throw std::runtime_error("Could not stat " + m_filename);
+      }
+      m_size = static_cast<uint64_t>(s.st_size);
+    }
+  }
+
+  /**
+   * This method appends a value to the blob file.
+   *
+   * @param c codec that was applied to the value
+   * @param src value
+   * @param len length of the value
+   * @param reference the REFERENCE_SIZE bytes to store in the cabinet instead of the value
+   * @return reference to the value; throws std::runtime_error on failures
+   */
+  Reference append(const uint8_t &c, const char *src, const std::size_t &len, std::vector<char> &reference) {
+    if (0 > m_fd) {
+      m_fd = ::open(m_filename.c_str(), O_RDWR|O_CREAT, 0600);
+      struct stat s;
+      if ((0 > m_fd) || (0 != ::fstat(m_fd, &s))) {
+        throw std::runtime_error("Could not open " + m_filename);
+      }
+      m_size = static_cast<uint64_t>(s.st_size);
+    }
+    Reference r;
+    r.codec = c;
+    r.offset = m_size;
+    r.length = len;
+    for (std::size_t written{0}; written < len;) {
+      const ssize_t n{::pwrite(m_fd, src + written, len - written, static_cast<off_t>(m_size + written))};
+      if (0 >= n) {
+        throw std::runtime_error("Could not write to " + m_filename);
+      }
+      written += static_cast<std::size_t>(n);
+    }
+    m_size += len;
+    m_unsynced = true;
+    putReference(r, reference);
+    return r;
+  }
+
+  /**
+   * This method discards the last appended value, e.g., for a duplicate; its
+   * bytes are overwritten by the next value.
+   *
+   * @param r reference returned by the last call to append
+   */
+  void discard(const Reference &r) noexcept {
+    if (r.offset + r.length == m_size) {
+      m_size = r.offset;
+    }
+  }
+
+  /**
+   * This method flushes the appended values to disk; it must be called
+   * before committing the transaction that refers to them.
+   *
+   * @return true on success
+   */
+  bool sync() noexcept {
+    bool retVal{true};
+    if ((0 <= m_fd) && m_unsynced) {
+      retVal = (0 == ::fdatasync(m_fd));
+      m_unsynced = !retVal;
+    }
+    return retVal;
+  }
+
+  /**
+   * @return number of bytes in the blob file
+   */
+  uint64_t size() const noexcept { return m_size; }
+
+ private:
+  std::string m_filename;
+  std::size_t m_minSize{0};
+  int m_fd{-1};
+  uint64_t m_size{0};
+  bool m_unsynced{false};
+};
+
+/**
+ * This class maps the blob file of a cabinet read-only into memory. As the
+ * blob file grows while recording, it is mapped anew when a reference is
+ * beyond the current mapping; previous mappings stay valid until this
+ * Reader is destroyed so that returned pointers remain usable.
+ */
+class Reader {
+ private:
+  Reader(const Reader &) = delete;
+  Reader(Reader &&)      = delete;
+  Reader &operator=(const Reader &) = delete;
+  Reader &operator=(Reader &&) = delete;
+
+ public:
+  /**
+   * @param filename blob file to read from
+   */
+  explicit Reader(const std::string &filename) :
+    m_fd(::open(filename.c_str(), O_RDONLY)) {}
+
+  ~Reader() {
+    for (auto &m : m_mappings) {
+      ::munmap(m.first, m.second);
+    }
+    if (0 <= m_fd) {
+      ::close(m_fd);
+    }
+  }
+
+  bool good() const noexcept { return 0 <= m_fd; }
+
+  /**
+   * @param r reference to a value
+   * @return pointer to the value within the mapped blob file; nullptr if the
+   *         reference is not within the blob file
+   */
+  const char *get(const Reference &r) {
+    if ((0 != r.file) || (0 > m_fd)) {
+      return nullptr;
+    }
+    if ( (r.offset > m_size) || (r.length > m_size - r.offset) ) {
+      struct stat s;
+      if ((0 != ::fstat(m_fd, &s)) || (static_cast<uint64_t>(s.st_size) <= m_size)) {
+        return nullptr;
+      }
+      const std::size_t SIZE{static_cast<std::size_t>(s.st_size)};
+      void *ptr{::mmap(nullptr, SIZE, PROT_READ, MAP_SHARED, m_fd, 0)};
+      if (MAP_FAILED == ptr) {
+        return nullptr;
+      }
+      m_mappings.emplace_back(ptr, SIZE);
+      m_data = static_cast<const char*>(ptr);
+      m_size = SIZE;
+      if ( (r.offset > m_size) || (r.length > m_size - r.offset) ) {
+        return nullptr;
+      }
+    }
+    return m_data + r.offset;
+  }
+
+ private:
+  int m_fd{-1};
+  const char *m_data{nullptr};
+  uint64_t m_size{0};
+  std::vector<std::pair<void*, std::size_t>> m_mappings{};
+};
+
+} // blobs
+#endif
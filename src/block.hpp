@@ -0,0 +1,461 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef BLOCK_HPP
+#define BLOCK_HPP
+
+#include "blobs.hpp"
+#include "cluon-complete.hpp"
+#include "clustered.hpp"
+#include "codec.hpp"
+#include "key.hpp"
+#include "rec-file-view.hpp"
+
+#include "lmdb.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * In a block-packed cabinet, consecutive Envelopes of one stream are
+ * concatenated like in a .rec file and stored as one entry with a key marked
+ * KEY_BLOCK (cf. key.hpp). Compressing the Envelopes together works much
+ * better for small messages and reduces the number of keys; readers unpack
+ * the blocks and merge the Envelopes of overlapping blocks by their
+ * sampleTimeStamps.
+ */
+namespace block {
+
+/**
+ * Envelopes of one stream to be stored as one entry.
+ */
+struct Block {
+  int32_t dataType{0};
+  uint32_t senderStamp{0};
+  uint64_t userData{0};
+  int64_t first{0};
+  int64_t last{0};
+  uint32_t count{0};
+  std::vector<char> envelopes{};
+};
+
+/**
+ * @param b block
+ * @param version layout and codec for the key, cf. codec::version
+ * @return key for the block
+ */
+inline cabinet::Key keyOf(const Block &b, const uint8_t &version) noexcept {
+  cabinet::Key k;
+  k.timeStamp(b.first)
+   .dataType(b.dataType)
+   .senderStamp(b.senderStamp)
+   .hash(static_cast<uint64_t>(b.last))
+   .hashOfRecFile(b.count)
+   .length(static_cast<uint16_t>(b.envelopes.size()))
+   .userData(b.userData)
+   .version(static_cast<uint8_t>(version | KEY_BLOCK));
+  return k;
+}
+
+/**
+ * This class collects the Envelopes per stream into blocks of at most
+ * maxEntries Envelopes that span at most maxDuration nanoseconds.
+ */
+class Packer {
+ public:
+  /**
+   * @param maxEntries maximum number of Envelopes per block
+   * @param maxDuration maximum time between the first and the last Envelope of a block in nanoseconds
+   */
+  Packer(const uint32_t &maxEntries, const int64_t &maxDuration) :
+    m_maxEntries(std::max<uint32_t>(1, maxEntries)),
+    m_maxDuration(maxDuration) {}
+
+  /**
+   * @param dataType dataType of the Envelope
+   * @param senderStamp senderStamp of the Envelope
+   * @param userData userData for the key
+   * @param timeStamp sampleTimeStamp in nanoseconds; not before the previous one of the same stream
+   * @param envelope serialized Envelope
+   * @param length length of the serialized Envelope
+   * @param full completed blocks are appended here
+   */
+  void add(const int32_t &dataType, const uint32_t &senderStamp, const uint64_t &userData, const int64_t &timeStamp, const char *envelope, const std::size_t &length, std::vector<Block> &full) {
+    Block &b = m_pending[std::make_pair(dataType, senderStamp)];
+    if ( (0 < b.count) && ((timeStamp - b.first > m_maxDuration) || (userData != b.userData)) ) {
+      full.push_back(std::move(b));
+      b = Block();
+    }
+    if (0 == b.count) {
+      b.dataType = dataType;
+      b.senderStamp = senderStamp;
+      b.userData = userData;
+      b.first = timeStamp;
+    }
+    b.last = timeStamp;
+    b.count++;
+    b.envelopes.insert(b.envelopes.end(), envelope, envelope + length);
+    if (m_maxEntries <= b.count) {
+      full.push_back(std::move(b));
+      b = Block();
+    }
+  }
+
+  /**
+   * @param full all pending blocks are appended here ordered by their first timeStamp
+   */
+  void flush(std::vector<Block> &full) {
+    const std::size_t FIRST{full.size()};
+    for (auto &p : m_pending) {
+      if (0 < p.second.count) {
+        full.push_back(std::move(p.second));
+      }
+    }
+    m_pending.clear();
+    std::sort(full.begin() + static_cast<std::ptrdiff_t>(FIRST), full.end(), [](const Block &a, const Block &b) { return a.first < b.first; });
+  }
+
+ private:
+  uint32_t m_maxEntries{1};
+  int64_t m_maxDuration{0};
+  std::map<std::pair<int32_t, uint32_t>, Block> m_pending{};
+};
+
+/**
+ * This function detects from the first entry in "all" whether the cabinet
+ * stores blocks; packing rewrites all entries of a cabinet.
+ *
+ * @param txn transaction to read from
+ * @param dbAll table "all"
+ * @return true if the first entry is a block
+ */
+inline bool isPacked(MDB_txn *txn, const MDB_dbi &dbAll) noexcept {
+  bool packed{false};
+  MDB_cursor *cursor{nullptr};
+  if (MDB_SUCCESS == mdb_cursor_open(txn, dbAll, &cursor)) {
+    // MDB_FIRST does not compare keys and works before setting a comparator.
+    MDB_val key;
+    MDB_val value;
+    if (MDB_SUCCESS == mdb_cursor_get(cursor, &key, &value, MDB_FIRST)) {
+      packed = (KEY_SIZE <= key.mv_size) && keyIsBlock(static_cast<const char*>(key.mv_data));
+    }
+    mdb_cursor_close(cursor);
+  }
+  return packed;
+}
+
+/**
+ * This function finds where to start reading in "all" to get all Envelopes
+ * from the given timeStamp on: A block that starts before timeStamp might
+ * still hold later Envelopes. As the blocks of a stream do not overlap, only
+ * the last block before timeStamp in each table "dataType/senderStamp" is
+ * a candidate.
+ *
+ * @param txn transaction to read from
+ * @param tables names of the tables per stream to consider
+ * @param timeStamp timeStamp in nanoseconds
+ * @param layout layout of the keys in the cabinet
+ * @return first timeStamp of the earliest block that holds Envelopes from timeStamp on, or timeStamp
+ */
+inline int64_t firstTimeStampOf(MDB_txn *txn, const std::vector<std::string> &tables, const int64_t &timeStamp, const uint8_t &layout) noexcept {
+  int64_t first{timeStamp};
+  for (auto table : tables) {
+    MDB_dbi dbi{0};
+    MDB_cursor *cursor{nullptr};
+    if ( (MDB_SUCCESS != mdb_dbi_open(txn, table.c_str(), 0, &dbi))
+      || (MDB_SUCCESS != setKeyCompare(txn, dbi, layout))
+      || (MDB_SUCCESS != mdb_cursor_open(txn, dbi, &cursor)) ) {
+      continue;
+    }
+    char prefix[sizeof(int64_t)];
+    MDB_val key{setKeyPrefix(timeStamp, layout, prefix, sizeof(prefix)), prefix};
+    MDB_val value;
+    const int32_t rc{(MDB_SUCCESS == mdb_cursor_get(cursor, &key, &value, MDB_SET_RANGE)) ?
+      mdb_cursor_get(cursor, &key, &value, MDB_PREV) : mdb_cursor_get(cursor, &key, &value, MDB_LAST)};
+    if ( (MDB_SUCCESS == rc) && (KEY_SIZE <= key.mv_size) ) {
+      const char *ptr{static_cast<const char*>(key.mv_data)};
+      if (keyIsBlock(ptr) && (keyBlockLastTimeStamp(ptr) >= timeStamp)) {
+        first = std::min(first, keyTimeStamp(ptr));
+      }
+    }
+    mdb_cursor_close(cursor);
+  }
+  return first;
+}
+
+/**
+ * This class reads the entries of a cabinet as stored in the order of their
+ * keys from where all Envelopes from a start time point on are found, which
+ * is the earliest block that still holds such Envelopes (cf.
+ * firstTimeStampOf) or else the first entry at the start time point; the
+ * start time point itself is included. Entries are read either from "all"
+ * or merged from the tables per stream (cf. clustered::Merge). The unpacked
+ * Envelopes before the start time point are to be skipped by the reader.
+ */
+class Cursor {
+ private:
+  Cursor(const Cursor &) = delete;
+  Cursor(Cursor &&)      = delete;
+  Cursor &operator=(const Cursor &) = delete;
+  Cursor &operator=(Cursor &&) = delete;
+
+ public:
+  /**
+   * @param txn transaction to read from
+   * @param dbAll table "all"
+   * @param tables names of the tables per stream to consider for blocks
+   * @param merge true to merge the entries from tables instead of reading "all"
+   * @param start start time point in nanoseconds; from the first entry if not positive
+   * @param layout layout of the keys in the cabinet
+   */
+  Cursor(MDB_txn *txn, const MDB_dbi &dbAll, const std::vector<std::string> &tables, const bool &merge, const int64_t &start, const uint8_t &layout) {
+    const int64_t first{(start > 0) ? firstTimeStampOf(txn, tables, start, layout) : 0};
+    if (merge) {
+      m_merge.reset(new clustered::Merge(txn, tables, layout, std::max<int64_t>(first, 0)));
+    }
+    else if (MDB_SUCCESS != mdb_cursor_open(txn, dbAll, &m_cursor)) {
+      m_cursor = nullptr;
+      m_end = true;
+    }
+    else if (start > 0) {
+      char prefix[sizeof(int64_t)];
+      m_key = MDB_val{setKeyPrefix(first, layout, prefix, sizeof(prefix)), prefix};
+      m_pending = (MDB_SUCCESS == mdb_cursor_get(m_cursor, &m_key, &m_value, MDB_SET_RANGE));
+      m_positioned = m_pending;
+      m_end = !m_pending;
+    }
+  }
+
+  ~Cursor() {
+    if (nullptr != m_cursor) {
+      mdb_cursor_close(m_cursor);
+    }
+  }
+
+  /**
+   * @param key next key in the order of the keys
+   * @param value its value as stored
+   * @return false at the end
+   */
+  bool next(MDB_val &key, MDB_val &value) noexcept {
+    if (m_pending) {
+      m_pending = false;
+    }
+    else if (m_end) {
+      return false;
+    }
+    else if (m_merge) {
+      m_end = !m_merge->next(m_key, m_value);
+    }
+    else {
+      m_end = (MDB_SUCCESS != mdb_cursor_get(m_cursor, &m_key, &m_value, MDB_NEXT_NODUP));
+    }
+    key = m_key;
+    value = m_value;
+    return !m_end;
+  }
+
+  /**
+   * @return true if the cursor in "all" was positioned at the start time point
+   */
+  bool isPositioned() const noexcept {
+    return m_positioned;
+  }
+
+ private:
+  std::unique_ptr<clustered::Merge> m_merge{};
+  MDB_cursor *m_cursor{nullptr};
+  MDB_val m_key{0, nullptr};
+  MDB_val m_value{0, nullptr};
+  bool m_pending{false};
+  bool m_positioned{false};
+  bool m_end{false};
+};
+
+/**
+ * This class unpacks the entries read in the order of their keys into single
+ * Envelopes in the order of their sampleTimeStamps: Blocks of several streams
+ * overlap in time and hence, their Envelopes are merged. Entries that are no
+ * blocks are returned as they are.
+ */
+class Envelopes {
+ private:
+  Envelopes(const Envelopes &) = delete;
+  Envelopes(Envelopes &&)      = delete;
+  Envelopes &operator=(const Envelopes &) = delete;
+  Envelopes &operator=(Envelopes &&) = delete;
+
+ public:
+  /**
+   * @param next function to read the next entry as stored (cf. clustered::Entries) in the order of the keys; false at the end
+   * @param dictionaries dictionaries of the cabinet
+   * @param blobReader blob file of the cabinet
+   */
+  Envelopes(std::function<bool(MDB_val&, MDB_val&)> next, const codec::Dictionaries *dictionaries, blobs::Reader *blobReader = nullptr) :
+    m_next(next),
+    m_dictionaries(dictionaries),
+    m_blobReader(blobReader) {}
+
+  /**
+   * @param timeStamp sampleTimeStamp of the Envelope in nanoseconds
+   * @param envelope view on the serialized Envelope; valid until the next call
+   * @return false at the end
+   */
+  bool next(int64_t &timeStamp, cluon::EnvelopeView &envelope) {
+    // Release the block of the Envelope returned before.
+    m_returned.reset();
+    while (true) {
+      if (m_heap.empty()) {
+        if (!peek()) {
+          return false;
+        }
+        const char *ptr{static_cast<const char*>(m_key.mv_data)};
+        if (!keyIsBlock(ptr)) {
+          // Fast path: No block is open and all later entries are not before this one.
+          timeStamp = keyTimeStamp(ptr);
+          m_userData = keyUserData(ptr);
+          auto value = decodePeeked(m_buffer);
+          if (nullptr != value.first) {
+            envelope = cluon::EnvelopeView(value.first, value.second, 0);
+            return true;
+          }
+          continue;
+        }
+        open();
+        continue;
+      }
+      // Open all entries that start before the earliest Envelope of the open blocks.
+      if (peek() && (keyTimeStamp(static_cast<const char*>(m_key.mv_data)) <= m_heap.front()->timeStamp)) {
+        open();
+        continue;
+      }
+      std::pop_heap(m_heap.begin(), m_heap.end(), &Envelopes::later);
+      std::shared_ptr<Open> o{m_heap.back()};
+      m_heap.pop_back();
+      timeStamp = o->timeStamp;
+      envelope = o->current;
+      m_userData = o->userData;
+      if (advance(*o)) {
+        m_heap.push_back(o);
+        std::push_heap(m_heap.begin(), m_heap.end(), &Envelopes::later);
+      }
+      else {
+        m_returned = o;
+      }
+      return true;
+    }
+  }
+
+  /**
+   * @return userData from the key of the entry with the Envelope returned last
+   */
+  uint64_t userData() const noexcept {
+    return m_userData;
+  }
+
+  /**
+   * @return number of entries that could not be decoded
+   */
+  uint64_t failed() const noexcept {
+    return m_failed;
+  }
+
+ private:
+  struct Open {
+    bool block{false};
+    std::vector<char> buffer{};
+    std::unique_ptr<cluon::RecFileView> view{};
+    cluon::EnvelopeView current{};
+    int64_t timeStamp{0};
+    uint64_t userData{0};
+    uint64_t order{0};
+  };
+
+  // Orders the heap by timeStamp and, for the same timeStamp, by the order of the entries.
+  static bool later(const std::shared_ptr<Open> &a, const std::shared_ptr<Open> &b) noexcept {
+    return (a->timeStamp > b->timeStamp) || ((a->timeStamp == b->timeStamp) && (a->order > b->order));
+  }
+
+  bool peek() {
+    while (!m_peeked && !m_end) {
+      m_end = !m_next(m_key, m_value);
+      m_peeked = !m_end && (KEY_SIZE <= m_key.mv_size);
+    }
+    return m_peeked;
+  }
+
+  std::pair<const char*, std::size_t> decodePeeked(std::vector<char> &buffer) {
+    m_peeked = false;
+    const MDB_val storedValue{storedValueOf(m_key, m_value)};
+    auto value = codec::decode(getKey(static_cast<const char*>(m_key.mv_data), m_key.mv_size), static_cast<char*>(storedValue.mv_data), storedValue.mv_size, buffer, m_dictionaries, m_blobReader);
+    m_failed += (nullptr == value.first) ? 1 : 0;
+    return value;
+  }
+
+  void open() {
+    const char *ptr{static_cast<const char*>(m_key.mv_data)};
+    std::shared_ptr<Open> o{std::make_shared<Open>()};
+    o->block = keyIsBlock(ptr);
+    o->timeStamp = keyTimeStamp(ptr);
+    o->userData = keyUserData(ptr);
+    o->order = m_order++;
+    auto value = decodePeeked(o->buffer);
+    if (nullptr == value.first) {
+      return;
+    }
+    if (value.first != o->buffer.data()) {
+      o->buffer.assign(value.first, value.first + value.second);
+    }
+    o->buffer.resize(value.second);
+    if (o->block) {
+      o->view.reset(new cluon::RecFileView(o->buffer.data(), o->buffer.size()));
+      if (!advance(*o)) {
+        return;
+      }
+    }
+    else {
+      o->current = cluon::EnvelopeView(o->buffer.data(), o->buffer.size(), 0);
+    }
+    m_heap.push_back(o);
+    std::push_heap(m_heap.begin(), m_heap.end(), &Envelopes::later);
+  }
+
+  static bool advance(Open &o) {
+    if (!o.block || !o.view->next(o.current)) {
+      return false;
+    }
+    o.timeStamp = o.current.sampleTimeStamp() * 1000;
+    return true;
+  }
+
+ private:
+  std::function<bool(MDB_val&, MDB_val&)> m_next;
+  const codec::Dictionaries *m_dictionaries{nullptr};
+  blobs::Reader *m_blobReader{nullptr};
+  MDB_val m_key{0, nullptr};
+  MDB_val m_value{0, nullptr};
+  bool m_peeked{false};
+  bool m_end{false};
+  uint64_t m_userData{0};
+  uint64_t m_order{0};
+  uint64_t m_failed{0};
+  std::vector<char> m_buffer{};
+  std::vector<std::shared_ptr<Open>> m_heap{};
+  std::shared_ptr<Open> m_returned{};
+};
+
+} // block
+#endif
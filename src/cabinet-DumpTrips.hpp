@@ -29,7 +29,7 @@ inline bool cabinet_DumpTrips(const uint64_t &MEM, const std::string &CABINET) {
     // Fetch key/value pairs in a read-only transaction.
     auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
     auto dbi = lmdb::dbi::open(rotxn, "trips");
-    dbi.set_compare(rotxn, &compareKeys);
+    useKeyLayoutOf(rotxn.handle(), dbi.handle());
     const uint64_t totalEntries = dbi.size(rotxn);
     std::cerr << "Found " << totalEntries << " entries in db 'trips'" << std::endl;
     auto cursor = lmdb::cursor::open(rotxn, dbi);
@@ -40,12 +40,10 @@ inline bool cabinet_DumpTrips(const uint64_t &MEM, const std::string &CABINET) {
     while (cursor.get(&key, &value, MDB_NEXT)) {
       entries++;
       const char *ptrKey = static_cast<char*>(key.mv_data);
-      cabinet::Key storedKey = getKey(ptrKey, key.mv_size);
-
       const char *ptrValue = static_cast<char*>(value.mv_data);
-      cabinet::Key storedValue = getKey(ptrValue, value.mv_size);
-
-      std::cout << storedKey.timeStamp() << ";" << storedValue.timeStamp() << std::endl;
+      if ((KEY_SIZE <= key.mv_size) && (KEY_SIZE <= value.mv_size)) {
+        std::cout << keyTimeStamp(ptrKey) << ";" << keyTimeStamp(ptrValue) << std::endl;
+      }
 
       const int32_t percentage = static_cast<int32_t>((static_cast<float>(entries) * 100.0f) / static_cast<float>(totalEntries));
       if ((percentage % 5 == 0) && (percentage != oldPercentage)) {
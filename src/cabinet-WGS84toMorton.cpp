@@ -17,11 +17,12 @@ int32_t main(int32_t argc, char **argv) {
   int32_t retCode{0};
   auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
   if (0 == commandlineArguments.count("cab")) {
-    std::cerr << argv[0] << " traverse table 'all' of a cabinet (an lmdb-based key/value-database) to convert WGS84 messages (19/?) to Morton index." << std::endl;
-    std::cerr << "Usage:   " << argv[0] << " --cab=myStore.cab [--out=myStore.cab-WGS84-Morton] [--mem=32024] [--verbose]" << std::endl;
+    std::cerr << argv[0] << " traverse table 'all' of a cabinet (an lmdb-based key/value-database) to convert WGS84 messages (19/?) to Morton (or Hilbert) index, also per hour of their timeStamps." << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --cab=myStore.cab [--out=myStore.cab-WGS84-Morton] [--mem=32024] [--curve=morton|hilbert] [--verbose]" << std::endl;
     std::cerr << "         --cab:     name of the database file" << std::endl;
     std::cerr << "         --out:     name of the database file to be created from the converted Morton codes" << std::endl;
     std::cerr << "         --mem:     upper memory size for database in memory in GB, default: 64,000 (representing 64TB)" << std::endl;
+    std::cerr << "         --curve:   space-filling curve for the tables '19/?-morton' or '19/?-hilbert', default: morton" << std::endl;
     std::cerr << "         --verbose: display information on stderr" << std::endl;
     std::cerr << "Example: " << argv[0] << " --cab=myStore.cab" << std::endl;
     retCode = 1;
@@ -30,8 +31,13 @@ int32_t main(int32_t argc, char **argv) {
     const std::string MORTONCABINET{(commandlineArguments["out"].size() != 0) ? commandlineArguments["out"] : CABINET + "-WGS84-Morton"};
     const uint64_t MEM{(commandlineArguments["mem"].size() != 0) ? static_cast<uint64_t>(std::stoi(commandlineArguments["mem"])) : 64UL*1024UL};
     const bool VERBOSE{(commandlineArguments["verbose"].size() != 0)};
+    const Curve CURVE{(commandlineArguments["curve"].size() != 0) ? curveOfName(commandlineArguments["curve"]) : CURVE_MORTON};
+    if (CURVE_NONE == CURVE) {
+      std::cerr << "[" << argv[0] << "]: Unknown curve '" << commandlineArguments["curve"] << "'; use morton or hilbert." << std::endl;
+      return 1;
+    }
 
-    retCode = cabinet_WGS84toMorton(MEM, CABINET, MORTONCABINET, VERBOSE);
+    retCode = cabinet_WGS84toMorton(MEM, CABINET, MORTONCABINET, VERBOSE, CURVE);
   }
   return retCode;
 }
@@ -10,17 +10,20 @@
 #define CABINETWGS84TOMORTON_HPP
 
 #include "cluon-complete.hpp"
+#include "blobs.hpp"
 #include "opendlv-standard-message-set.hpp"
+#include "clustered.hpp"
+#include "codec.hpp"
 #include "key.hpp"
+#include "hilbert.hpp"
 #include "morton.hpp"
 #include "lmdb++.h"
-#include "lz4.h"
 
 #include <iostream>
 #include <sstream>
 #include <string>
 
-inline bool cabinet_WGS84toMorton(const uint64_t &MEM, const std::string &CABINET, const std::string &MORTONCABINET, const bool &VERBOSE) {
+inline bool cabinet_WGS84toMorton(const uint64_t &MEM, const std::string &CABINET, const std::string &MORTONCABINET, const bool &VERBOSE, const Curve &CURVE = CURVE_MORTON) {
   bool failed{false};
   try {
     auto env = lmdb::env::create();
@@ -36,10 +39,13 @@ inline bool cabinet_WGS84toMorton(const uint64_t &MEM, const std::string &CABINE
     // Fetch key/value pairs in a read-only transaction.
     auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
     auto dbi = lmdb::dbi::open(rotxn, "all");
-    dbi.set_compare(rotxn, &compareKeys);
+    clustered::Entries storedEntries(rotxn.handle(), useKeyLayoutOf(rotxn.handle(), dbi.handle()));
     const uint64_t totalEntries = dbi.size(rotxn);
     std::cerr << "Found " << totalEntries << " entries." << std::endl;
     auto cursor = lmdb::cursor::open(rotxn, dbi);
+    codec::Dictionaries dictionaries;
+    dictionaries.load(rotxn.handle());
+    blobs::Reader blobReader(blobs::fileOf(CABINET));
     MDB_val key;
     MDB_val value;
     int32_t oldPercentage{-1};
@@ -47,29 +53,23 @@ inline bool cabinet_WGS84toMorton(const uint64_t &MEM, const std::string &CABINE
     while (cursor.get(&key, &value, MDB_NEXT)) {
       entries++;
       const char *ptr = static_cast<char*>(key.mv_data);
-      cabinet::Key storedKey = getKey(ptr, key.mv_size);
-      if (storedKey.dataType() == opendlv::proxy::GeodeticWgs84Reading::ID()) {
-        std::vector<char> val;
-        val.reserve(storedKey.length());
-        if (storedKey.length() > value.mv_size) {
-          LZ4_decompress_safe(static_cast<char*>(value.mv_data), val.data(), value.mv_size, val.capacity());
-        }
-        else {
-          // Stored value is uncompressed.
-          // recFile.write(static_cast<char*>(val.mv_data), val.mv_size);
-          memcpy(val.data(), static_cast<char*>(value.mv_data), value.mv_size);
-        }
-        std::stringstream sstr{std::string(val.data(), storedKey.length())};
+      if ((KEY_SIZE <= key.mv_size) && (keyDataType(ptr) == opendlv::proxy::GeodeticWgs84Reading::ID())) {
+        cabinet::Key storedKey = getKey(ptr, key.mv_size);
+        std::vector<char> buffer;
+        const auto entry = storedEntries.entryOf(key, value);
+        const MDB_val storedValue{storedValueOf(entry.first, entry.second)};
+        auto val = codec::decode(storedKey, static_cast<char*>(storedValue.mv_data), storedValue.mv_size, buffer, &dictionaries, &blobReader);
+        std::stringstream sstr{std::string(val.first, (nullptr != val.first) ? val.second : 0)};
         auto e = cluon::extractEnvelope(sstr);
         if (e.first) {
           // Compose name for database.
           std::stringstream _dataType_senderStamp;
-          _dataType_senderStamp << opendlv::proxy::GeodeticWgs84Reading::ID() << '/'<< e.second.senderStamp() << "-morton";
+          _dataType_senderStamp << opendlv::proxy::GeodeticWgs84Reading::ID() << '/'<< e.second.senderStamp() << curveSuffixOf(CURVE);
           const std::string _shortKey{_dataType_senderStamp.str()};
 
-          // Extract value from Envelope and compute Morton code.
+          // Extract value from Envelope and compute Morton or Hilbert code.
           const auto tmp = cluon::extractMessage<opendlv::proxy::GeodeticWgs84Reading>(std::move(e.second));
-          auto morton = convertLatLonToMorton(std::make_pair(tmp.latitude(), tmp.longitude()));
+          auto morton = convertLatLonToCurve(CURVE, std::make_pair(tmp.latitude(), tmp.longitude()));
           if (VERBOSE) {
             std::cerr << tmp.latitude() << ", " << tmp.longitude() << " = " << morton << ", " << storedKey.timeStamp() << std::endl;
           }
@@ -94,6 +94,14 @@ inline bool cabinet_WGS84toMorton(const uint64_t &MEM, const std::string &CABINE
             __value.mv_data = &_timeStamp;
 
             lmdb::dbi_put(txn, dbGeodeticWgs84SenderStamp.handle(), &__key, &__value, 0); 
+
+            // key is the time bucket followed by the morton code for queries within a time range (cf. mortonKeyOf)
+            auto dbGeodeticWgs84SenderStampTime = lmdb::dbi::open(txn, (_shortKey + "-time").c_str(), MDB_CREATE|MDB_DUPSORT|MDB_DUPFIXED);
+            lmdb::dbi_set_dupsort(txn, dbGeodeticWgs84SenderStampTime.handle(), &compareKeys);
+            const int64_t bucket{mortonBucketOf(storedKey.timeStamp())};
+            uint64_t timeKey[2];
+            MDB_val __timeKey{mortonKeyOf(&bucket, be64toh(morton), timeKey)};
+            lmdb::dbi_put(txn, dbGeodeticWgs84SenderStampTime.handle(), &__timeKey, &__value, 0);
           }
 
           txn.commit();
@@ -10,11 +10,13 @@
 #define CABINETWGS84TOTRIPS_HPP
 
 #include "cluon-complete.hpp"
+#include "blobs.hpp"
 #include "opendlv-standard-message-set.hpp"
+#include "clustered.hpp"
+#include "codec.hpp"
 #include "key.hpp"
 #include "morton.hpp"
 #include "lmdb++.h"
-#include "lz4.h"
 #include "geofence.hpp"
 #include "WGS84toCartesian.hpp"
 
@@ -26,6 +28,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <tuple>
 
 inline bool cabinet_WGS84toTrips(const uint64_t &MEM, const std::string &CABINET, const uint32_t &senderStamp, std::vector<std::array<double,2>> polygon, const std::string &TRIPSCABINET, const bool &GPX, const uint32_t &MIN_LEN, const uint32_t &MAX_LEN, const bool &VERBOSE) {
   bool failed{false};
@@ -43,10 +46,26 @@ inline bool cabinet_WGS84toTrips(const uint64_t &MEM, const std::string &CABINET
     // Fetch key/value pairs in a read-only transaction.
     auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
     auto dbi = lmdb::dbi::open(rotxn, "all");
-    dbi.set_compare(rotxn, &compareKeys);
+    // The keys are copied as they are; hence, the trips cabinet uses the same layout.
+    const uint8_t LAYOUT{useKeyLayoutOf(rotxn.handle(), dbi.handle())};
     const uint64_t totalEntries = dbi.size(rotxn);
     std::cerr << "Found " << totalEntries << " entries." << std::endl;
     auto cursor = lmdb::cursor::open(rotxn, dbi);
+
+    // The copied values might refer to dictionaries, which are copied as well.
+    codec::Dictionaries dictionaries;
+    dictionaries.load(rotxn.handle());
+    blobs::Reader blobReader(blobs::fileOf(CABINET));
+    if (0 < dictionaries.size()) {
+      auto txn = lmdb::txn::begin(envout);
+      for (auto id : dictionaries.ids()) {
+        const int32_t rc{codec::Dictionaries::store(txn.handle(), *dictionaries.byId(id))};
+        if (MDB_SUCCESS != rc) {
+          lmdb::error::raise("codec::Dictionaries::store", rc);
+        }
+      }
+      txn.commit();
+    }
     MDB_val key;
     MDB_val value;
 
@@ -82,23 +101,21 @@ inline bool cabinet_WGS84toTrips(const uint64_t &MEM, const std::string &CABINET
 
     std::vector<std::pair<std::vector<char>, std::vector<char> > > bufferedKeyValues;
     std::vector<std::pair<std::vector<char>, std::vector<char> > > bufferOfKeyValuePairsToStore;
+    clustered::Entries storedEntries(rotxn.handle(), LAYOUT);
     while (cursor.get(&key, &value, MDB_NEXT)) {
       entries++;
+      // The entries of a clustered cabinet are buffered with their values from their stream table.
+      std::tie(key, value) = storedEntries.entryOf(key, value);
       const char *ptr = static_cast<char*>(key.mv_data);
-      cabinet::Key storedKey = getKey(ptr, key.mv_size);
-      std::vector<char> val;
-      val.reserve(storedKey.length());
-      if (storedKey.length() > value.mv_size) {
-        LZ4_decompress_safe(static_cast<char*>(value.mv_data), val.data(), value.mv_size, val.capacity());
-      }
-      else {
-        // Stored value is uncompressed.
-        memcpy(val.data(), static_cast<char*>(value.mv_data), value.mv_size);
-      }
-
-      if (  (storedKey.dataType() == opendlv::proxy::GeodeticWgs84Reading::ID())
-         && (storedKey.senderStamp() == senderStamp) ) {
-        std::stringstream sstr{std::string(val.data(), storedKey.length())};
+      if (  (KEY_SIZE <= key.mv_size)
+         && (keyDataType(ptr) == opendlv::proxy::GeodeticWgs84Reading::ID())
+         && (keySenderStamp(ptr) == senderStamp) ) {
+        // Only GPS positions from the selected sender are decompressed.
+        cabinet::Key storedKey = getKey(ptr, key.mv_size);
+        std::vector<char> buffer;
+        const MDB_val storedValue{storedValueOf(key, value)};
+        auto val = codec::decode(storedKey, static_cast<char*>(storedValue.mv_data), storedValue.mv_size, buffer, &dictionaries, &blobReader);
+        std::stringstream sstr{std::string(val.first, (nullptr != val.first) ? val.second : 0)};
         auto e = cluon::extractEnvelope(sstr);
         if (e.first) {
           // Extract value from Envelope and check whether location is within polygon.
@@ -238,7 +255,7 @@ inline bool cabinet_WGS84toTrips(const uint64_t &MEM, const std::string &CABINET
                       // Store key/value in db "all".
                       auto txn = lmdb::txn::begin(envout);
                       auto dbAll = lmdb::dbi::open(txn, "all", MDB_CREATE);
-                      dbAll.set_compare(txn, &compareKeys);
+                      setKeyCompare(txn.handle(), dbAll.handle(), LAYOUT);
                       lmdb::dbi_put(txn, dbAll.handle(), &_key, &_value, 0); 
                       txn.commit();
                     }
@@ -246,20 +263,13 @@ inline bool cabinet_WGS84toTrips(const uint64_t &MEM, const std::string &CABINET
                     // 2.2 Compute the Morton codes if the current key contains a GPS location.
                     {
                       const char *_ptr = static_cast<char*>(_key.mv_data);
-                      cabinet::Key _storedKey = getKey(_ptr, _key.mv_size);
-
-                      if (_storedKey.dataType() == opendlv::proxy::GeodeticWgs84Reading::ID()) {
-                        std::vector<char> _val;
-                        _val.reserve(_storedKey.length());
-                        if (_storedKey.length() > _value.mv_size) {
-                          LZ4_decompress_safe(static_cast<char*>(_value.mv_data), _val.data(), _value.mv_size, _val.capacity());
-                        }
-                        else {
-                          // Stored value is uncompressed.
-                          memcpy(_val.data(), static_cast<char*>(_value.mv_data), _value.mv_size);
-                        }
+                      if ((KEY_SIZE <= _key.mv_size) && (keyDataType(_ptr) == opendlv::proxy::GeodeticWgs84Reading::ID())) {
+                        cabinet::Key _storedKey = getKey(_ptr, _key.mv_size);
+                        std::vector<char> _buffer;
+                        const MDB_val _storedValue{storedValueOf(_key, _value)};
+                        auto _val = codec::decode(_storedKey, static_cast<char*>(_storedValue.mv_data), _storedValue.mv_size, _buffer, &dictionaries, &blobReader);
 
-                        std::stringstream _sstr{std::string(_val.data(), _storedKey.length())};
+                        std::stringstream _sstr{std::string(_val.first, (nullptr != _val.first) ? _val.second : 0)};
                         auto _e = cluon::extractEnvelope(_sstr);
                         if (_e.first) {
                           // Extract value from Envelope and check whether location is within polygon.
@@ -309,21 +319,21 @@ inline bool cabinet_WGS84toTrips(const uint64_t &MEM, const std::string &CABINET
                     MDB_val __key;
                     __key.mv_size = f.first.size();
                     __key.mv_data = f.first.data();
+                    __key = fixedFieldsOf(__key);
 
                     MDB_val __value;
                     __value.mv_size = 0;
                     __value.mv_data = nullptr;
 
                     const char *__ptr = static_cast<char*>(__key.mv_data);
-                    cabinet::Key __storedKey = getKey(__ptr, __key.mv_size);
 
                      std::stringstream _dataType_senderStamp;
-                    _dataType_senderStamp << __storedKey.dataType() << '/' << __storedKey.senderStamp();
+                    _dataType_senderStamp << keyDataType(__ptr) << '/' << keySenderStamp(__ptr);
                     const std::string _shortKey{_dataType_senderStamp.str()};
 
                     auto txn = lmdb::txn::begin(envout);
                     auto dbDataTypeSenderStamp = lmdb::dbi::open(txn, _shortKey.c_str(), MDB_CREATE);
-                    dbDataTypeSenderStamp.set_compare(txn, &compareKeys);
+                    setKeyCompare(txn.handle(), dbDataTypeSenderStamp.handle(), LAYOUT);
                     lmdb::dbi_put(txn, dbDataTypeSenderStamp.handle(), &__key, &__value, 0); 
                     txn.commit();
                   }
@@ -339,7 +349,7 @@ inline bool cabinet_WGS84toTrips(const uint64_t &MEM, const std::string &CABINET
 
                     auto txn = lmdb::txn::begin(envout);
                     auto dbTrips = lmdb::dbi::open(txn, _shortKey.c_str(), MDB_CREATE);
-                    dbTrips.set_compare(txn, &compareKeys);
+                    setKeyCompare(txn.handle(), dbTrips.handle(), LAYOUT);
                     {
                       // key is the cabinet::Key from the trip start.
                       MDB_val __key;
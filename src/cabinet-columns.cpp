@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "cluon-complete.hpp"
+#include "cabinet-columns.hpp"
+#include "columns.hpp"
+
+#include "lmdb++.h"
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+int32_t main(int32_t argc, char **argv) {
+  int32_t retCode{0};
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if (0 == commandlineArguments.count("cab")) {
+    std::cerr << argv[0] << " decodes numeric fields of Envelopes from a cabinet (an lmdb-based key/value-database) into compressed columns per field, or reads such a column." << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --cab=myStore.cab [--out=myStore.cab-columns] [--fields=1046,1030,19] [--block=1024] [--mem=32024] [--verbose]" << std::endl;
+    std::cerr << "         " << argv[0] << " --cab=myStore.cab [--out=myStore.cab-columns] --read=1046/0.groundSpeed [--start=startTime] [--end=endTime] [--summary]" << std::endl;
+    std::cerr << "         --cab:     name of the database file" << std::endl;
+    std::cerr << "         --out:     name of the database file with the columns (default: myStore.cab-columns)" << std::endl;
+    std::cerr << "         --fields:  comma-separated dataType[/senderStamp][.field] to decode; all numeric fields of a message without .field (default: 1046,1030,19)" << std::endl;
+    std::cerr << "         --block:   number of values per compressed block (default: 1024)" << std::endl;
+    std::cerr << "         --mem:     upper memory size for database in memory in GB, default: 64,000 (representing 64TB)" << std::endl;
+    std::cerr << "         --read:    column to print as timeStamp;value, or 'list' for the names of all columns" << std::endl;
+    std::cerr << "         --start:   start time in Unix epoch seconds; default: 0" << std::endl;
+    std::cerr << "         --end:     end time in Unix epoch seconds; default: inf" << std::endl;
+    std::cerr << "         --summary: print count, minimum, and maximum instead of the values" << std::endl;
+    std::cerr << "         --verbose: display information" << std::endl;
+    std::cerr << "Example: " << argv[0] << " --cab=myStore.cab --fields=1046/0.groundSpeed" << std::endl;
+    retCode = 1;
+  } else {
+    const std::string CABINET{commandlineArguments["cab"]};
+    const std::string COLUMNCABINET{(commandlineArguments["out"].size() != 0) ? commandlineArguments["out"] : CABINET + "-columns"};
+    const uint64_t MEM{(commandlineArguments["mem"].size() != 0) ? static_cast<uint64_t>(std::stoi(commandlineArguments["mem"])) : 64UL*1024UL};
+    const uint32_t BLOCK_SIZE{(commandlineArguments["block"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["block"])) : columns::BLOCK_SIZE};
+    const std::string READ{commandlineArguments["read"]};
+    const int64_t START{(commandlineArguments["start"].size() != 0) ? static_cast<int64_t>(std::stoll(commandlineArguments["start"])) * 1000LL * 1000LL * 1000LL : 0};
+    const int64_t END{(commandlineArguments["end"].size() != 0) ? static_cast<int64_t>(std::stoll(commandlineArguments["end"])) * 1000LL * 1000LL * 1000LL : std::numeric_limits<int64_t>::max()};
+    const bool SUMMARY{(commandlineArguments["summary"].size() != 0)};
+    const bool VERBOSE{(commandlineArguments["verbose"].size() != 0)};
+
+    const std::string ARGV0{argv[0]};
+    if (READ.empty()) {
+      std::vector<columns::Field> fields;
+      if (!columns::parse((commandlineArguments["fields"].size() != 0) ? commandlineArguments["fields"] : "1046,1030,19", fields)) {
+        std::cerr << "[" << ARGV0 << "]: Invalid fields in '" << commandlineArguments["fields"] << "'." << std::endl;
+        return 1;
+      }
+      if (0 == BLOCK_SIZE) {
+        std::cerr << "[" << ARGV0 << "]: --block must be at least 1." << std::endl;
+        return 1;
+      }
+      retCode = cabinet_columns(ARGV0, MEM, CABINET, COLUMNCABINET, fields, BLOCK_SIZE, VERBOSE);
+    }
+    else {
+      try {
+        auto env = lmdb::env::create();
+        env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+        env.set_max_dbs(1000);
+        env.open(COLUMNCABINET.c_str(), MDB_NOSUBDIR|MDB_RDONLY, 0600);
+        auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+        if ("list" == READ) {
+          for (auto c : columns::columnsOf(rotxn.handle())) {
+            std::cout << c << std::endl;
+          }
+        }
+        else if (SUMMARY) {
+          columns::Summary s;
+          retCode = columns::summarize(rotxn.handle(), READ, START, END, s) ? 0 : 1;
+          std::cout << READ << ": count = " << s.count << ", min = " << std::setprecision(17) << s.min << ", max = " << s.max << std::endl;
+        }
+        else {
+          columns::Series s;
+          const cluon::data::TimeStamp before{cluon::time::now()};
+          retCode = columns::read(rotxn.handle(), READ, START, END, s) ? 0 : 1;
+          const int64_t duration{cluon::time::deltaInMicroseconds(cluon::time::now(), before)};
+          std::cout << std::setprecision(17);
+          for (std::size_t i{0}; i < s.timeStamps.size(); i++) {
+            std::cout << s.timeStamps[i] << ";" << s.values[i] << '\n';
+          }
+          std::cout.flush();
+          if (VERBOSE) {
+            std::clog << "[" << ARGV0 << "]: Read " << s.values.size() << " values from " << READ << " in " << duration << "us." << std::endl;
+          }
+        }
+        if (0 != retCode) {
+          std::cerr << "[" << ARGV0 << "]: Could not read column '" << READ << "' from " << COLUMNCABINET << "." << std::endl;
+        }
+        rotxn.abort();
+      }
+      catch(const lmdb::error &e) {
+        std::cerr << "[" << ARGV0 << "]: " << e.what() << std::endl;
+        retCode = 1;
+      }
+    }
+  }
+  return retCode;
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CABINET_COLUMNS_HPP
+#define CABINET_COLUMNS_HPP
+
+#include "cluon-complete.hpp"
+#include "blobs.hpp"
+#include "block.hpp"
+#include "clustered.hpp"
+#include "codec.hpp"
+#include "columns.hpp"
+#include "key.hpp"
+
+#include "lmdb++.h"
+
+#include <cstdint>
+
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/**
+ * This function decodes the selected numeric fields of the Envelopes in a
+ * cabinet into a column cabinet (cf. columns.hpp). An existing column cabinet
+ * is extended by the values after the last timeStamp of each column; a last
+ * block with less than BLOCK_SIZE values is rewritten.
+ *
+ * @param ARGV0 Our name.
+ * @param MEM upper memory size for the databases in GB
+ * @param CABINET cabinet file to read from
+ * @param COLUMNCABINET column cabinet file to write to
+ * @param FIELDS fields to materialize
+ * @param BLOCK_SIZE number of values per block
+ * @param VERBOSE
+ * @return 0 on success, 1 otherwise
+ */
+inline int cabinet_columns(const std::string &ARGV0, const uint64_t &MEM, const std::string &CABINET, const std::string &COLUMNCABINET, const std::vector<columns::Field> &FIELDS, const uint32_t &BLOCK_SIZE, const bool &VERBOSE) {
+  int32_t retCode{0};
+  try {
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM/2 * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINET.c_str(), MDB_NOSUBDIR|MDB_RDONLY, 0600);
+
+    auto envout = lmdb::env::create();
+    envout.set_mapsize(MEM/2 * 1024UL * 1024UL * 1024UL);
+    envout.set_max_dbs(1000);
+    envout.open(COLUMNCABINET.c_str(), MDB_NOSUBDIR, 0600);
+
+    // Values per column that are not yet stored in a block.
+    struct Column {
+      MDB_dbi dbi{0};
+      int64_t stored{std::numeric_limits<int64_t>::min()};
+      std::vector<int64_t> timeStamps{};
+      std::vector<double> values{};
+    };
+    std::map<std::string, Column> pending;
+
+    auto txn = lmdb::txn::begin(envout);
+    uint32_t blocksInTxn{0};
+    auto columnOf = [&](const std::string &name) -> Column& {
+      auto it = pending.find(name);
+      if (pending.end() == it) {
+        Column c;
+        c.dbi = lmdb::dbi::open(txn, name.c_str(), MDB_CREATE).handle();
+        // Continue after the last block and reopen it unless it is full.
+        auto cursor = lmdb::cursor::open(txn, c.dbi);
+        MDB_val key;
+        MDB_val value;
+        if (cursor.get(&key, &value, MDB_LAST)) {
+          columns::Header h;
+          if (columns::headerOf(static_cast<const char*>(value.mv_data), value.mv_size, h)) {
+            c.stored = h.last;
+            if ( (h.count < BLOCK_SIZE)
+              && columns::decode(static_cast<const char*>(value.mv_data), value.mv_size, c.timeStamps, c.values) ) {
+              mdb_cursor_del(cursor.handle(), 0);
+            }
+          }
+        }
+        cursor.close();
+        it = pending.emplace(name, std::move(c)).first;
+      }
+      return it->second;
+    };
+    auto store = [&](Column &c) {
+      if (c.timeStamps.empty()) {
+        return;
+      }
+      std::vector<char> block;
+      columns::encode(c.timeStamps.data(), c.values.data(), static_cast<uint32_t>(c.timeStamps.size()), block);
+      std::vector<char> _key;
+      appendBigEndian(c.timeStamps.front(), _key);
+      MDB_val key{_key.size(), _key.data()};
+      MDB_val value{block.size(), block.data()};
+      lmdb::dbi_put(txn, c.dbi, &key, &value, 0);
+      c.timeStamps.clear();
+      c.values.clear();
+      if (1000 <= ++blocksInTxn) {
+        txn.commit();
+        txn = lmdb::txn::begin(envout);
+        blocksInTxn = 0;
+      }
+    };
+
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    codec::Dictionaries dictionaries;
+    dictionaries.load(rotxn.handle());
+    blobs::Reader blobReader(blobs::fileOf(CABINET));
+    auto dbAll = lmdb::dbi::open(rotxn, "all");
+    clustered::Entries storedEntries(rotxn.handle(), useKeyLayoutOf(rotxn.handle(), dbAll.handle()));
+    const uint64_t totalEntries = dbAll.size(rotxn);
+    std::clog << "[" << ARGV0 << "]: Found " << totalEntries << " entries in " << CABINET << "." << std::endl;
+
+    // Only the entries of the selected streams are decoded.
+    auto cursor = lmdb::cursor::open(rotxn, dbAll);
+    MDB_val key;
+    MDB_val value;
+    int32_t oldPercentage{-1};
+    uint64_t entriesRead{0};
+    block::Envelopes envelopes([&](MDB_val &k, MDB_val &v) {
+      while (cursor.get(&key, &value, MDB_NEXT)) {
+        entriesRead++;
+        const int32_t percentage = static_cast<int32_t>((static_cast<float>(entriesRead) * 100.0f) / static_cast<float>(totalEntries));
+        if ((percentage % 5 == 0) && (percentage != oldPercentage)) {
+          std::clog << "[" << ARGV0 << "]: Processed " << percentage << "% (" << entriesRead << " entries) from " << CABINET << std::endl;
+          oldPercentage = percentage;
+        }
+        const char *ptr{static_cast<const char*>(key.mv_data)};
+        if ( (KEY_SIZE <= key.mv_size) && columns::selects(FIELDS, keyDataType(ptr), keySenderStamp(ptr)) ) {
+          std::tie(k, v) = storedEntries.entryOf(key, value);
+          return true;
+        }
+      }
+      return false;
+    }, &dictionaries, &blobReader);
+
+    uint64_t values{0};
+    uint64_t undecodable{0};
+    int64_t timeStamp{0};
+    cluon::EnvelopeView e;
+    std::vector<std::pair<std::string, double>> fields;
+    while (envelopes.next(timeStamp, e)) {
+      const int32_t DATATYPE{e.dataType()};
+      const uint32_t SENDERSTAMP{e.senderStamp()};
+      std::stringstream sstr{std::string(e.data(), e.size())};
+      auto envelope = cluon::extractEnvelope(sstr);
+      fields.clear();
+      if (!envelope.first || !columns::fieldsOf(std::move(envelope.second), fields)) {
+        undecodable++;
+        continue;
+      }
+      for (const auto &f : fields) {
+        if (!columns::selects(FIELDS, DATATYPE, SENDERSTAMP, f.first)) {
+          continue;
+        }
+        Column &c = columnOf(clustered::tableOf(DATATYPE, SENDERSTAMP) + "." + f.first);
+        if (timeStamp <= c.stored) {
+          continue;
+        }
+        if (VERBOSE) {
+          std::cerr << timeStamp << ": " << DATATYPE << "/" << SENDERSTAMP << "." << f.first << " = " << f.second << std::endl;
+        }
+        c.timeStamps.push_back(timeStamp);
+        c.values.push_back(f.second);
+        values++;
+        if (BLOCK_SIZE <= c.timeStamps.size()) {
+          store(c);
+        }
+      }
+    }
+    cursor.close();
+    rotxn.abort();
+
+    for (auto &c : pending) {
+      store(c.second);
+    }
+    txn.commit();
+
+    if (0 < envelopes.failed() + undecodable) {
+      std::cerr << "[" << ARGV0 << "]: Could not decode " << (envelopes.failed() + undecodable) << " values." << std::endl;
+    }
+    std::clog << "[" << ARGV0 << "]: Stored " << values << " values in " << pending.size() << " columns in " << COLUMNCABINET << "." << std::endl;
+  }
+  catch(const lmdb::error &e) {
+    std::cerr << "[" << ARGV0 << "]: " << e.what() << std::endl;
+    retCode = 1;
+  }
+  return retCode;
+}
+
+#endif
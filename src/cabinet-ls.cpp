@@ -7,10 +7,13 @@
  */
 
 #include "cluon-complete.hpp"
+#include "catalog.hpp"
 #include "key.hpp"
 #include "db.hpp"
 #include "lmdb.h"
+#include "hilbert.hpp"
 #include "morton.hpp"
+#include "timeline.hpp"
 
 #include <cstdio>
 #include <cstring>
@@ -18,7 +21,10 @@
 
 #include <iostream>
 #include <iomanip>
+#include <limits>
+#include <sstream>
 #include <string>
+#include <vector>
 
 int32_t main(int32_t argc, char **argv) {
   int32_t retCode{0};
@@ -28,7 +34,7 @@ int32_t main(int32_t argc, char **argv) {
     std::cerr << "Usage:   " << argv[0] << " --cab=myStore.cab [--mem=32024]" << std::endl;
     std::cerr << "         --cab: name of the database file" << std::endl;
     std::cerr << "         --mem: upper memory size for database in memory in GB, default: 64,000 (representing 64TB)" << std::endl;
-    std::cerr << "         --db:  database to list, default: all" << std::endl;
+    std::cerr << "         --db:  database to list, default: all; 'catalog' lists the summary per stream, 'timeline' the Envelopes per stream and minute" << std::endl;
     std::cerr << "Example: " << argv[0] << " --cab=myStore.cab" << std::endl;
     retCode = 1;
   } else {
@@ -76,14 +82,17 @@ int32_t main(int32_t argc, char **argv) {
         std::clog << "[" << argv[0] << "]: No database '" << DB << "' found in " << CABINET << "." << std::endl;
       }
       else {
-        if (std::string::npos != DB.find("-morton")) {
-          mdb_set_compare(txn, dbi, &compareMortonKeys);
+        const Curve CURVE{curveOfTable(DB)};
+        const bool IS_MORTON_TIME{isCurveTimeTable(DB)};
+        if (CURVE_NONE != CURVE) {
+          if (!IS_MORTON_TIME) {
+            mdb_set_compare(txn, dbi, &compareMortonKeys);
+          }
           // Multiple values are stored by existing timeStamp in nanoseconds.
           mdb_set_dupsort(txn, dbi, &compareKeys);
         }
-        // else if (DB == "all") {
-        else {
-          mdb_set_compare(txn, dbi, &compareKeys);
+        else if (("catalog" != DB) && ("timeline" != DB)) {
+          useKeyLayoutOf(txn, dbi);
         }
         uint64_t numberOfEntries{0};
         MDB_stat stat;
@@ -96,24 +105,70 @@ int32_t main(int32_t argc, char **argv) {
         if (!(retCode = mdb_cursor_open(txn, dbi, &cursor))) {
           MDB_val key;
           MDB_val value;
-          while ((retCode = mdb_cursor_get(cursor, &key, &value, MDB_NEXT)) == 0) {
-            if (std::string::npos != DB.find("-morton")) {
-              uint64_t morton = *reinterpret_cast<uint64_t*>(key.mv_data);
-              morton = be64toh(morton);
-              auto decodedLatLon = convertMortonToLatLon(morton);
-              int64_t timeStamp{0};
-              if (value.mv_size == sizeof(int64_t)) {
-                const char *ptr = static_cast<char*>(value.mv_data);
-                std::memcpy(&timeStamp, ptr, value.mv_size);
-                timeStamp = be64toh(timeStamp);
-                std::cout << morton << "(" << decodedLatLon.first << "," << decodedLatLon.second << "): " << timeStamp << std::endl;
+          if (CURVE_NONE != CURVE) {
+            // The timeStamps are read and printed in batches of fixed-size duplicates.
+            std::vector<int64_t> timeStamps;
+            std::string out;
+            std::string prefix;
+            uint64_t prefixMorton{0};
+            std::stringstream sstr;
+            auto printer = [&](const uint64_t &morton, const MDB_val &values) {
+              mortonTimeStampsOf(values, timeStamps);
+              if (prefix.empty() || (prefixMorton != morton)) {
+                auto decodedLatLon = convertCurveToLatLon(CURVE, morton);
+                sstr.str("");
+                sstr << morton << "(" << decodedLatLon.first << "," << decodedLatLon.second << "): ";
+                prefix = sstr.str();
+                prefixMorton = morton;
+              }
+              for (const auto &timeStamp : timeStamps) {
+                out.append(prefix).append(std::to_string(timeStamp)).append(1, '\n');
               }
+              if (out.size() > 64 * 1024) {
+                std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+                out.clear();
+              }
+            };
+            if (IS_MORTON_TIME) {
+              // The keys are ordered by time bucket first.
+              mortonForEachBucket(cursor, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), [&cursor, &printer](const int64_t &bucket) {
+                return mortonForEachInBox(cursor, 0, std::numeric_limits<uint64_t>::max(), printer, &bucket);
+              });
             }
-            // else if (DB == "all") {
             else {
-              const char *ptr = static_cast<char*>(key.mv_data);
-              cabinet::Key storedKey = getKey(ptr, key.mv_size);
-              std::cout << storedKey.timeStamp() << ": " << storedKey.dataType() << "/" << storedKey.senderStamp() << ", userData = 0x" << std::hex << storedKey.userData() << std::dec << std::endl;
+              mortonForEachInBox(cursor, 0, std::numeric_limits<uint64_t>::max(), printer);
+            }
+            std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+            std::cout.flush();
+            retCode = MDB_NOTFOUND;
+          }
+          else {
+            while ((retCode = mdb_cursor_get(cursor, &key, &value, MDB_NEXT)) == 0) {
+              if ("catalog" == DB) {
+                catalog::Entry e;
+                if ((2 * sizeof(uint32_t) == key.mv_size) && catalog::decode(static_cast<char*>(value.mv_data), value.mv_size, e)) {
+                  const char *ptr = static_cast<char*>(key.mv_data);
+                  std::cout << readBigEndian<int32_t>(ptr) << "/" << readBigEndian<uint32_t>(ptr + 4) << ": " << e.count << " entries from " << e.first << " to " << e.last
+                            << ", " << e.rawBytes << " bytes, " << e.storedBytes << " bytes stored, sources =" << std::hex;
+                  for (const auto &source : e.sources) {
+                    std::cout << " 0x" << source.first << "/0x" << source.second;
+                  }
+                  std::cout << std::dec << std::endl;
+                }
+              }
+              else if ("timeline" == DB) {
+                if ((timeline::KEY_SIZE == key.mv_size) && (timeline::VALUE_SIZE == value.mv_size)) {
+                  const auto k = timeline::fromKey(static_cast<char*>(key.mv_data));
+                  const char *ptr = static_cast<char*>(value.mv_data);
+                  std::cout << std::get<0>(k) << "/" << std::get<1>(k) << " at " << std::get<2>(k) * 60 << ": " << readBigEndian<uint64_t>(ptr) << " entries, " << readBigEndian<uint64_t>(ptr + 8) << " bytes" << std::endl;
+                }
+              }
+              // else if (DB == "all") {
+              else {
+                const char *ptr = static_cast<char*>(key.mv_data);
+                cabinet::Key storedKey = getKey(ptr, key.mv_size);
+                std::cout << storedKey.timeStamp() << ": " << storedKey.dataType() << "/" << storedKey.senderStamp() << ", userData = 0x" << std::hex << storedKey.userData() << std::dec << std::endl;
+              }
             }
           }
           mdb_cursor_close(cursor);
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "cluon-complete.hpp"
+#include "cabinet-migrate.hpp"
+
+#include <iostream>
+#include <string>
+
+int32_t main(int32_t argc, char **argv) {
+  int32_t retCode{0};
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if ( (0 == commandlineArguments.count("cab")) || (0 == commandlineArguments.count("out")) ) {
+    std::cerr << argv[0] << " rewrites a cabinet (an lmdb-based key/value-database) into a new cabinet with another key layout." << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --cab=myStore.cab --out=myNewStore.cab [--keylayout=1] [--mem=32024] [--batch=100000] [--block=256] [--blockms=1000] [--codec=lz4hc:12] [--blob=65536] [--verbose]" << std::endl;
+    std::cerr << "         --cab:       name of the database file to read from" << std::endl;
+    std::cerr << "         --out:       name of the database file to be created" << std::endl;
+    std::cerr << "         --keylayout: optional: layout of the keys in the new database: 0 = ordered by compareKeys, 1 = ordered by memcmp (default: 1)" << std::endl;
+    std::cerr << "         --mem:       upper memory size for database in memory in GB, default: 64,000 (representing 64TB)" << std::endl;
+    std::cerr << "         --batch:     optional: commit to the database after this many entries (default: 100000)" << std::endl;
+    std::cerr << "         --block:     optional: pack up to this many consecutive Envelopes of a stream into one compressed block (default: 0 = no blocks; blocks are unpacked)" << std::endl;
+    std::cerr << "         --blockms:   optional: maximum time between the first and the last Envelope of a block in milliseconds (default: 1000)" << std::endl;
+    std::cerr << "         --codec:     optional: comma-separated codecs for blocks and unpacked Envelopes, optionally per dataType as dataType=codec (default: lz4hc:12)" << std::endl;
+    std::cerr << "         --blob:      optional: store values of at least this many bytes after compression in the append-only file myNewStore.cab-blobs next to the new database (default: 0 = never)" << std::endl;
+    std::cerr << "         --verbose:   display information" << std::endl;
+    std::cerr << "Example: " << argv[0] << " --cab=myStore.cab --out=myStore-v1.cab" << std::endl;
+    retCode = 1;
+  } else {
+    const std::string CABINET{commandlineArguments["cab"]};
+    const std::string OUTCABINET{commandlineArguments["out"]};
+    const uint8_t KEY_LAYOUT{(commandlineArguments["keylayout"].size() != 0) ? static_cast<uint8_t>(std::stoul(commandlineArguments["keylayout"])) : KEY_LAYOUT_MEMCMP};
+    const uint64_t MEM{(commandlineArguments["mem"].size() != 0) ? static_cast<uint64_t>(std::stoi(commandlineArguments["mem"])) : 64UL*1024UL};
+    const uint32_t BATCH_ENTRIES{(commandlineArguments["batch"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["batch"])) : 100000};
+    const uint32_t BLOCK_ENTRIES{(commandlineArguments["block"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["block"])) : 0};
+    const uint32_t BLOCK_MS{(commandlineArguments["blockms"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["blockms"])) : 1000};
+    const std::size_t BLOB_SIZE{(commandlineArguments["blob"].size() != 0) ? static_cast<std::size_t>(std::stoull(commandlineArguments["blob"])) : 0};
+    const bool VERBOSE{(commandlineArguments["verbose"].size() != 0)};
+    codec::Selection codecs;
+
+    const std::string ARGV0{argv[0]};
+    if (CABINET == OUTCABINET) {
+      std::cerr << "[" << ARGV0 << "]: --out must name a new database file." << std::endl;
+      retCode = 1;
+    }
+    else if (KEY_LAYOUT_MEMCMP < KEY_LAYOUT) {
+      std::cerr << "[" << ARGV0 << "]: Unknown key layout " << +KEY_LAYOUT << "." << std::endl;
+      retCode = 1;
+    }
+    else if (!codec::parse(commandlineArguments["codec"], codecs)) {
+      std::cerr << "[" << ARGV0 << "]: Invalid or unavailable codec in '" << commandlineArguments["codec"] << "'." << std::endl;
+      retCode = 1;
+    }
+    else {
+      retCode = cabinet_migrate(ARGV0, MEM, CABINET, OUTCABINET, KEY_LAYOUT, VERBOSE, (0 < BATCH_ENTRIES) ? BATCH_ENTRIES : 1, BLOCK_ENTRIES, BLOCK_MS, codecs, BLOB_SIZE);
+    }
+  }
+  return retCode;
+}
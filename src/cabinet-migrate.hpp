@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CABINET_MIGRATE_HPP
+#define CABINET_MIGRATE_HPP
+
+#include "cluon-complete.hpp"
+#include "blobs.hpp"
+#include "block.hpp"
+#include "clustered.hpp"
+#include "codec.hpp"
+#include "hilbert.hpp"
+#include "key.hpp"
+#include "morton.hpp"
+
+#include "lmdb++.h"
+#include "xxhash.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+ * This function rewrites a cabinet into a new cabinet with keys in the given
+ * layout. The keys from "all" are rewritten and the tables
+ * "dataType/senderStamp", "catalog", and "timeline" are rebuilt from them;
+ * the keys and values of "trips" are rewritten as well. All other tables like
+ * "dictionaries" or the "-morton" and "-hilbert" tables are copied as they are. A clustered cabinet stays
+ * clustered with the values in the tables "dataType/senderStamp". With
+ * BLOCK_ENTRIES, the Envelopes of each stream are packed into blocks (cf.
+ * block.hpp); blocks in CABINET are unpacked otherwise. Both layouts order the keys by
+ * (timeStamp, dataType, senderStamp, hash) so that the keys are appended in
+ * the order they are read. Values in the blob file of CABINET are copied into
+ * OUTCABINET or, with BLOB_SIZE, into the blob file of OUTCABINET.
+ *
+ * @param ARGV0 Our name.
+ * @param MEM upper memory size for the databases in GB
+ * @param CABINET cabinet file to read from
+ * @param OUTCABINET new cabinet file to write to
+ * @param KEY_LAYOUT layout of the keys in the new cabinet
+ * @param VERBOSE
+ * @param BATCH_ENTRIES commit after this many entries
+ * @param BLOCK_ENTRIES pack up to this many Envelopes of a stream into one block (0 = no blocks)
+ * @param BLOCK_MS maximum time between the first and the last Envelope of a block in milliseconds
+ * @param CODECS codecs per dataType for blocks and for unpacked Envelopes
+ * @param BLOB_SIZE store values of at least this many bytes after compression in the blob file of OUTCABINET (0 = never)
+ * @return 0 on success, 1 otherwise
+ */
+inline int cabinet_migrate(const std::string &ARGV0, const uint64_t &MEM, const std::string &CABINET, const std::string &OUTCABINET, const uint8_t &KEY_LAYOUT, const bool &VERBOSE, const uint32_t &BATCH_ENTRIES = 100000, const uint32_t &BLOCK_ENTRIES = 0, const uint32_t &BLOCK_MS = 1000, const codec::Selection &CODECS = codec::Selection(), const std::size_t &BLOB_SIZE = 0) {
+  int32_t retCode{0};
+  const uint64_t MAXKEYSIZE = 511;
+  try {
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM/2 * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINET.c_str(), MDB_NOSUBDIR|MDB_RDONLY, 0600);
+
+    auto envout = lmdb::env::create();
+    envout.set_mapsize(MEM/2 * 1024UL * 1024UL * 1024UL);
+    envout.set_max_dbs(100);
+    envout.open(OUTCABINET.c_str(), MDB_NOSUBDIR, 0600);
+
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    codec::Dictionaries dictionaries;
+    dictionaries.load(rotxn.handle());
+    blobs::Reader blobReader(blobs::fileOf(CABINET));
+
+    // Collect the names of all tables.
+    std::vector<std::string> tables;
+    {
+      auto dbMain = lmdb::dbi::open(rotxn, nullptr);
+      auto cursor = lmdb::cursor::open(rotxn, dbMain);
+      MDB_val key;
+      while (cursor.get(&key, nullptr, MDB_NEXT_NODUP)) {
+        if (nullptr == std::memchr(key.mv_data, '\0', key.mv_size)) {
+          tables.emplace_back(static_cast<char*>(key.mv_data), key.mv_size);
+        }
+      }
+      cursor.close();
+    }
+    if (tables.end() == std::find(tables.begin(), tables.end(), "all")) {
+      std::cerr << "[" << ARGV0 << "]: No table 'all' found in " << CABINET << "." << std::endl;
+      return 1;
+    }
+
+    auto dbAll = lmdb::dbi::open(rotxn, "all");
+    const uint8_t LAYOUT{useKeyLayoutOf(rotxn.handle(), dbAll.handle())};
+    const bool CLUSTERED{clustered::isClustered(rotxn.handle(), dbAll.handle())};
+
+    // Large values are appended to the blob file of the new cabinet and only referenced.
+    clustered::Store store(blobs::fileOf(OUTCABINET), KEY_LAYOUT, CLUSTERED, 0, BLOB_SIZE);
+
+    // The write transaction is committed every BATCH_ENTRIES entries.
+    lmdb::txn txn{nullptr};
+    uint32_t entriesInBatch{0};
+    auto writeTxn = [&txn, &envout, &store]() -> MDB_txn* {
+      if (nullptr == txn.handle()) {
+        txn = lmdb::txn::begin(envout);
+        const int32_t rc{store.begin(txn.handle())};
+        if (MDB_SUCCESS != rc) {
+          lmdb::error::raise("clustered::Store::begin", rc);
+        }
+      }
+      return txn.handle();
+    };
+    auto commit = [&txn, &store]() {
+      const int32_t rc{store.flush(txn.handle())};
+      if (MDB_SUCCESS != rc) {
+        lmdb::error::raise("clustered::Store::flush", rc);
+      }
+      txn.commit();
+    };
+    auto commitIfFull = [&entriesInBatch, &commit, BATCH_ENTRIES]() {
+      entriesInBatch++;
+      if (BATCH_ENTRIES <= entriesInBatch) {
+        commit();
+        entriesInBatch = 0;
+      }
+    };
+
+    // Rewrite a stored key into the new layout.
+    auto migrateKey = [KEY_LAYOUT](const MDB_val &key) {
+      cabinet::Key k = getKey(static_cast<char*>(key.mv_data), key.mv_size);
+      k.version(codec::version(KEY_LAYOUT, codec::codecOf(k)));
+      return k;
+    };
+
+    std::vector<char> _key;
+    _key.reserve(MAXKEYSIZE);
+    std::vector<char> _value;
+    _value.reserve(MAXKEYSIZE);
+
+    // 1. Rewrite "all" and rebuild "dataType/senderStamp".
+    uint64_t entries{0};
+    uint64_t skipped{0};
+    uint64_t unresolved{0};
+    {
+      clustered::Entries storedEntries(rotxn.handle(), LAYOUT);
+      const uint64_t totalEntries = dbAll.size(rotxn);
+      std::clog << "[" << ARGV0 << "]: Migrating " << totalEntries << " entries in 'all' from key layout " << +LAYOUT << " to " << +KEY_LAYOUT << "." << std::endl;
+
+      MDB_stat stat;
+      if ((MDB_SUCCESS == mdb_stat(writeTxn(), store.all(), &stat)) && (0 < stat.ms_entries)) {
+        std::cerr << "[" << ARGV0 << "]: Table 'all' in " << OUTCABINET << " is not empty." << std::endl;
+        txn.abort();
+        return 1;
+      }
+
+      // Store an entry in "all" and in its table "dataType/senderStamp".
+      auto storeEntry = [&](const cabinet::Key &k, const MDB_val &storedValue, const bool &INLINE, const uint64_t &rawBytes) {
+        const int32_t rc{store.put(writeTxn(), k, static_cast<char*>(storedValue.mv_data), storedValue.mv_size, rawBytes, INLINE)};
+        if (MDB_KEYEXIST == rc) {
+          skipped++;
+          return;
+        }
+        if (MDB_SUCCESS != rc) {
+          lmdb::error::raise("clustered::Store::put", rc);
+        }
+        commitIfFull();
+        entries++;
+      };
+
+      std::vector<char> decodeBuffer;
+
+      // Envelopes are packed into blocks or stored one by one with the codec selected for their dataType.
+      block::Packer packer(BLOCK_ENTRIES, static_cast<int64_t>(BLOCK_MS) * 1000 * 1000);
+      std::vector<block::Block> full;
+      std::vector<char> compressedValue;
+      auto storeBlocks = [&]() {
+        for (auto &b : full) {
+          const uint8_t APPLIED{codec::encode(CODECS.select(b.dataType), b.envelopes.data(), b.envelopes.size(), compressedValue)};
+          const MDB_val storedValue{(codec::NONE != APPLIED) ? MDB_val{compressedValue.size(), compressedValue.data()} : MDB_val{b.envelopes.size(), b.envelopes.data()}};
+          storeEntry(block::keyOf(b, codec::version(KEY_LAYOUT, APPLIED)), storedValue, false, b.envelopes.size());
+        }
+        full.clear();
+      };
+      auto storeEnvelope = [&](const int64_t &timeStamp, const uint64_t &userData, cluon::EnvelopeView &e) {
+        if (0 < BLOCK_ENTRIES) {
+          packer.add(e.dataType(), e.senderStamp(), userData, timeStamp, e.data(), e.size(), full);
+          // The Envelopes of blocks are added to the timeline one by one.
+          store.timeline().add(e.dataType(), e.senderStamp(), timeStamp, e.size());
+          storeBlocks();
+          return;
+        }
+        const uint8_t APPLIED{codec::encode(CODECS.select(e.dataType()), e.data(), e.size(), compressedValue)};
+        const MDB_val storedValue{(codec::NONE != APPLIED) ? MDB_val{compressedValue.size(), compressedValue.data()} : MDB_val{e.size(), const_cast<char*>(e.data())}};
+        cabinet::Key k;
+        k.timeStamp(timeStamp)
+         .dataType(e.dataType())
+         .senderStamp(e.senderStamp())
+         .hash(XXH64(e.data(), e.size(), 0))
+         .length(static_cast<uint16_t>(e.size()))
+         .userData(userData)
+         .version(codec::version(KEY_LAYOUT, APPLIED));
+        storeEntry(k, storedValue, false, e.size());
+      };
+
+      int32_t oldPercentage{-1};
+      uint64_t entriesRead{0};
+      auto progress = [&]() {
+        const int32_t percentage = static_cast<int32_t>((static_cast<float>(entriesRead) * 100.0f) / static_cast<float>(totalEntries));
+        if ((percentage % 5 == 0) && (percentage != oldPercentage)) {
+          std::clog << "[" << ARGV0 << "]: Processed " << percentage << "% (" << entriesRead << " entries) from " << CABINET << std::endl;
+          oldPercentage = percentage;
+        }
+      };
+      auto cursor = lmdb::cursor::open(rotxn, dbAll);
+      MDB_val key;
+      MDB_val value;
+      if ( (0 < BLOCK_ENTRIES) || block::isPacked(rotxn.handle(), dbAll.handle()) ) {
+        // Blocks are unpacked in the order of the sampleTimeStamps and the Envelopes are packed anew or stored one by one.
+        block::Envelopes envelopes([&](MDB_val &k, MDB_val &v) {
+          if (!cursor.get(&key, &value, MDB_NEXT)) {
+            return false;
+          }
+          entriesRead++;
+          progress();
+          std::tie(k, v) = storedEntries.entryOf(key, value);
+          return true;
+        }, &dictionaries, &blobReader);
+        int64_t timeStamp{0};
+        cluon::EnvelopeView e;
+        while (envelopes.next(timeStamp, e)) {
+          storeEnvelope(timeStamp, envelopes.userData(), e);
+        }
+        if (0 < envelopes.failed()) {
+          std::cerr << "[" << ARGV0 << "]: Could not decode " << envelopes.failed() << " values." << std::endl;
+        }
+      }
+      else {
+        while (cursor.get(&key, &value, MDB_NEXT)) {
+          entriesRead++;
+          const auto entry = storedEntries.entryOf(key, value);
+          // Values stored inline stay inline.
+          bool isInline{(KEY_SIZE <= entry.first.mv_size) && (0 != (keyVersion(static_cast<char*>(entry.first.mv_data)) & KEY_INLINE_VALUE))};
+          cabinet::Key k{migrateKey(entry.first)};
+          MDB_val storedValue{storedValueOf(entry.first, entry.second)};
+          if (codec::BLOB == codec::codecOf(k)) {
+            // References into the blob file of CABINET are replaced by the bytes they refer to.
+            blobs::Reference r;
+            const char *ptr{blobs::getReference(static_cast<char*>(storedValue.mv_data), storedValue.mv_size, r) ? blobReader.get(r) : nullptr};
+            if (nullptr == ptr) {
+              unresolved++;
+              progress();
+              continue;
+            }
+            storedValue = MDB_val{static_cast<std::size_t>(r.length), const_cast<char*>(ptr)};
+            k.version(static_cast<uint8_t>((k.version() & 0x0F) | (r.codec << 4)));
+            isInline = false;
+          }
+          // The length in the key is only known modulo 2^16.
+          decodeBuffer.clear();
+          const auto decoded = codec::decode(k, static_cast<char*>(storedValue.mv_data), storedValue.mv_size, decodeBuffer, &dictionaries, &blobReader);
+          storeEntry(k, storedValue, isInline, (nullptr != decoded.first) ? decoded.second : k.length());
+          progress();
+        }
+      }
+      cursor.close();
+      packer.flush(full);
+      storeBlocks();
+    }
+
+    // 2. Rewrite "trips" and copy all other tables as they are.
+    for (auto table : tables) {
+      const bool IS_MORTON{CURVE_NONE != curveOfTable(table)};
+      const bool IS_STREAM{!IS_MORTON && (std::string::npos != table.find('/'))};
+      if (("all" == table) || ("catalog" == table) || ("timeline" == table) || IS_STREAM) {
+        continue;
+      }
+
+      auto dbi = lmdb::dbi::open(rotxn, table.c_str());
+      const unsigned int FLAGS{dbi.flags(rotxn) & (MDB_REVERSEKEY|MDB_DUPSORT|MDB_INTEGERKEY|MDB_DUPFIXED|MDB_INTEGERDUP|MDB_REVERSEDUP)};
+      auto dbiOut = lmdb::dbi::open(writeTxn(), table.c_str(), MDB_CREATE|FLAGS);
+      if (IS_MORTON) {
+        // Multiple values are stored by existing timeStamp in nanoseconds; the keys
+        // of the "-time" tables are ordered with memcmp (cf. mortonKeyOf).
+        if (!isCurveTimeTable(table)) {
+          dbi.set_compare(rotxn, &compareMortonKeys);
+          dbiOut.set_compare(txn, &compareMortonKeys);
+        }
+        lmdb::dbi_set_dupsort(rotxn, dbi.handle(), &compareKeys);
+        lmdb::dbi_set_dupsort(txn, dbiOut.handle(), &compareKeys);
+      }
+      else if ("trips" == table) {
+        setKeyCompare(rotxn.handle(), dbi.handle(), LAYOUT);
+        setKeyCompare(txn.handle(), dbiOut.handle(), KEY_LAYOUT);
+      }
+
+      uint64_t copied{0};
+      auto cursor = lmdb::cursor::open(rotxn, dbi);
+      MDB_val key;
+      MDB_val value;
+      while (cursor.get(&key, &value, MDB_NEXT)) {
+        if ("trips" == table) {
+          // Both, key and value, are cabinet::Keys.
+          MDB_val newKey{setKey(migrateKey(key), _key.data(), _key.capacity()), _key.data()};
+          MDB_val newValue{setKey(migrateKey(value), _value.data(), _value.capacity()), _value.data()};
+          lmdb::dbi_put(writeTxn(), dbiOut, &newKey, &newValue, 0);
+        }
+        else {
+          lmdb::dbi_put(writeTxn(), dbiOut, &key, &value, 0);
+        }
+        commitIfFull();
+        copied++;
+      }
+      cursor.close();
+      if (VERBOSE) {
+        std::clog << "[" << ARGV0 << "]: Copied " << copied << " entries from '" << table << "'." << std::endl;
+      }
+    }
+    if (nullptr != txn.handle()) {
+      commit();
+    }
+    rotxn.abort();
+
+    if (0 < unresolved) {
+      std::cerr << "[" << ARGV0 << "]: Could not resolve " << unresolved << " values in " << blobs::fileOf(CABINET) << "." << std::endl;
+    }
+    if (0 < store.valuesInBlobFile()) {
+      std::clog << "[" << ARGV0 << "]: Stored " << store.valuesInBlobFile() << " values in " << blobs::fileOf(OUTCABINET) << " (" << store.bytesInBlobFile() << " bytes)." << std::endl;
+    }
+
+    std::clog << "[" << ARGV0 << "]: Migrated " << entries << " entries (" << skipped << " duplicates skipped) from " << CABINET << " to " << OUTCABINET << " with key layout " << +KEY_LAYOUT;
+    if (0 < BLOCK_ENTRIES) {
+      std::clog << " in blocks of up to " << BLOCK_ENTRIES << " Envelopes or " << BLOCK_MS << "ms";
+    }
+    std::clog << "." << std::endl;
+  }
+  catch(const lmdb::error &e) {
+    std::cerr << "[" << ARGV0 << "]: " << e.what() << std::endl;
+    retCode = 1;
+  }
+  catch(const std::runtime_error &e) {
+    std::cerr << "[" << ARGV0 << "]: " << e.what() << std::endl;
+    retCode = 1;
+  }
+  return retCode;
+}
+
+#endif
@@ -7,12 +7,16 @@
  */
 
 #include "cluon-complete.hpp"
+#include "catalog.hpp"
 
 #include "lmdb.h"
 
+#include <iomanip>
 #include <iostream>
 #include <locale>
+#include <map>
 #include <sstream>
+#include <string>
 
 struct space_out : std::numpunct<char> {
   char do_thousands_sep()   const { return ','; }  // separate with spaces
@@ -106,6 +110,25 @@ int32_t main(int32_t argc, char **argv) {
           mdb_close(env, dbAll);
         }
 
+        // The table "catalog" summarizes each stream without scanning it.
+        std::map<std::string, catalog::Entry> entries;
+        {
+          catalog::Catalog c;
+          if (c.load(txn)) {
+            catalog::Entry total;
+            for (const auto &e : c.entries()) {
+              entries[std::to_string(e.first.first) + "/" + std::to_string(e.first.second)] = e.second;
+              total.merge(e.second);
+            }
+            if (0 < total.count) {
+              std::clog << "[" << argv[0] << "]: 'catalog': " << total.count << " Envelopes from " << total.first << " to " << total.last << ", "
+                        << total.rawBytes << " bytes, " << total.storedBytes << " bytes stored (" << std::fixed << std::setprecision(2)
+                        << static_cast<double>(total.rawBytes) / static_cast<double>(std::max<uint64_t>(total.storedBytes, 1)) << "x), "
+                        << total.sources.size() << " source(s)" << std::defaultfloat << std::endl;
+            }
+          }
+        }
+
         MDB_cursor *cursor;
         if (!(retCode = mdb_cursor_open(txn, dbi, &cursor))) {
           int rc{0};
@@ -139,7 +162,16 @@ int32_t main(int32_t argc, char **argv) {
                   cluon::MetaMessage m = scope[std::stoi(dataTypeName)];
                   name = m.messageName();
                 }
-                std::clog << "[" << argv[0] << "]: " << dataTypeName << "/" << senderStamp << " ('" << name << "'): " << mst.ms_entries << " entries" << std::endl;
+                std::clog << "[" << argv[0] << "]: " << dataTypeName << "/" << senderStamp << " ('" << name << "'): " << mst.ms_entries << " entries";
+                auto entry = entries.find(s);
+                if (entries.end() != entry) {
+                  const catalog::Entry &e = entry->second;
+                  std::clog << ", " << e.count << " Envelopes from " << e.first << " to " << e.last << " (" << std::fixed << std::setprecision(3)
+                            << static_cast<double>(e.last - e.first) / (1000.0 * 1000.0 * 1000.0) << "s), " << e.rawBytes << " bytes, "
+                            << e.storedBytes << " bytes stored (" << std::setprecision(2) << static_cast<double>(e.rawBytes) / static_cast<double>(std::max<uint64_t>(e.storedBytes, 1))
+                            << "x), " << e.sources.size() << " source(s)" << std::defaultfloat;
+                }
+                std::clog << std::endl;
               }
               else {
                 if (s != "all") {
@@ -9,32 +9,52 @@
 #include "cluon-complete.hpp"
 #include "key.hpp"
 #include "db.hpp"
+#include "geofence.hpp"
+#include "hilbert.hpp"
 #include "lmdb.h"
 #include "morton.hpp"
 
+#include <cmath>
 #include <cstdio>
 #include <cstring>
 #include <cstdint>
 
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <iomanip>
+#include <limits>
+#include <sstream>
 #include <string>
+#include <vector>
 
 int32_t main(int32_t argc, char **argv) {
   int32_t retCode{0};
   auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
-  if ( (0 == commandlineArguments.count("cab")) || (0 == commandlineArguments.count("geobox")) ) {
+  if ( (0 == commandlineArguments.count("cab")) || ((0 == commandlineArguments.count("geobox")) && (0 == commandlineArguments.count("polygon")) && (0 == commandlineArguments.count("corridor"))) ) {
     std::cerr << argv[0] << " query a cabinet (an lmdb-based key/value-database)." << std::endl;
-    std::cerr << "Usage:   " << argv[0] << " --cab=myStore.cab [--mem=32024] --geobox=bottom-left-latitude,bottom-left-longitude,top-right-latitude,top-right-longitude" << std::endl;
-    std::cerr << "         --cab:    name of the database file" << std::endl;
-    std::cerr << "         --mem:    upper memory size for database in memory in GB, default: 64,000 (representing 64TB)" << std::endl;
-    std::cerr << "         --geobox: return all timeStamps for GPS locations within this rectangle specified by bottom-left and top-right lat/longs" << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --cab=myStore.cab [--mem=32024] --geobox=bottom-left-latitude,bottom-left-longitude,top-right-latitude,top-right-longitude|--polygon=lat1,lon1;lat2,lon2;...|--corridor=lat1,lon1;lat2,lon2;...,width [--start=1569916731] [--end=+3600] [--curve=morton|hilbert]" << std::endl;
+    std::cerr << "         --cab:      name of the database file" << std::endl;
+    std::cerr << "         --mem:      upper memory size for database in memory in GB, default: 64,000 (representing 64TB)" << std::endl;
+    std::cerr << "         --geobox:   return all timeStamps for GPS locations within this rectangle specified by bottom-left and top-right lat/longs" << std::endl;
+    std::cerr << "         --polygon:  return all timeStamps for GPS locations within this polygon of lat/longs" << std::endl;
+    std::cerr << "         --corridor: return all timeStamps for GPS locations within width meters of this polyline of lat/longs" << std::endl;
+    std::cerr << "         --start:    return only timeStamps from this time stamp in Unix epoch seconds on" << std::endl;
+    std::cerr << "         --end:      return only timeStamps until this time stamp in Unix epoch seconds; or +duration in seconds" << std::endl;
+    std::cerr << "         --curve:    query the table '19/0-morton' or '19/0-hilbert'; default: the one found, preferring morton" << std::endl;
     std::cerr << "Example: " << argv[0] << " --cab=myStore.cab --geobox=57.679000,12.309931,57.679690,12.312700" << std::endl;
+    std::cerr << "         " << argv[0] << " --cab=myStore.cab --polygon=\"57.730744,12.159515;57.717822,12.189958;57.710000,12.150000\"" << std::endl;
+    std::cerr << "         " << argv[0] << " --cab=myStore.cab --corridor=\"57.730744,12.159515;57.717822,12.189958,25\" --start=1569916731 --end=+3600" << std::endl;
     retCode = 1;
   } else {
     const std::string CABINET{commandlineArguments["cab"]};
     const uint64_t MEM{(commandlineArguments["mem"].size() != 0) ? static_cast<uint64_t>(std::stoi(commandlineArguments["mem"])) : 64UL*1024UL};
     const bool VERBOSE{commandlineArguments["verbose"].size() != 0};
+    const Curve REQUESTED_CURVE{curveOfName(commandlineArguments["curve"])};
+    if ( (0 != commandlineArguments["curve"].size()) && (CURVE_NONE == REQUESTED_CURVE) ) {
+      std::cerr << "[" << argv[0] << "]: Unknown curve '" << commandlineArguments["curve"] << "'; use morton or hilbert." << std::endl;
+      return 1;
+    }
     const std::string GEOBOX{commandlineArguments["geobox"]};
     std::vector<std::string> geoboxStrings = stringtoolbox::split(GEOBOX, ',');
     std::pair<float,float> geoboxBL;
@@ -46,7 +66,83 @@ int32_t main(int32_t argc, char **argv) {
       geoboxTR.second = std::stof(geoboxStrings.at(3));
     }
 
+    // Time range in Unix epoch seconds (inclusive); it uses the table '19/0-morton-time' if available.
+    const bool HAS_START{0 != commandlineArguments["start"].size()};
+    const bool HAS_END{0 != commandlineArguments["end"].size()};
+    const bool HAS_TIME{HAS_START || HAS_END};
+    const int64_t START{HAS_START ? static_cast<int64_t>(std::stoll(commandlineArguments["start"])) : 0};
+    int64_t END{HAS_END ? static_cast<int64_t>(std::stoll(commandlineArguments["end"])) : 0};
+    if (HAS_END && ('+' == commandlineArguments["end"].at(0))) {
+      // relative end notation was used.
+      END += START;
+    }
+    constexpr int64_t NS{1000L * 1000L * 1000L};
+    const int64_t FROM{HAS_START ? START * NS : std::numeric_limits<int64_t>::min()};
+    const int64_t TO{HAS_END ? END * NS + (NS - 1) : std::numeric_limits<int64_t>::max()};
+
+    // Polygons and corridors are given as lat/lon; the corridor's width is given in meters.
+    const bool IS_POLYGON{0 != commandlineArguments["polygon"].size()};
+    const bool IS_CORRIDOR{!IS_POLYGON && (0 != commandlineArguments["corridor"].size())};
+    std::string area{IS_POLYGON ? commandlineArguments["polygon"] : commandlineArguments["corridor"]};
+    double width{0.0};
+    if (IS_CORRIDOR && (std::string::npos != area.rfind(','))) {
+      width = std::stod(area.substr(area.rfind(',') + 1));
+      area = area.substr(0, area.rfind(','));
+    }
+    std::vector<std::array<double,2>> points;
+    for (auto coordinate : stringtoolbox::split(area, ';')) {
+      std::vector<std::string> latLon = stringtoolbox::split(coordinate, ',');
+      if (2 == latLon.size()) {
+        points.push_back(std::array<double,2>{{std::stod(latLon.at(0)), std::stod(latLon.at(1))}});
+      }
+    }
+    if ( (IS_POLYGON && (3 > points.size())) || (IS_CORRIDOR && points.empty()) ) {
+      std::cerr << "[" << argv[0] << "]: A polygon needs at least three and a corridor at least one lat/lon pair." << std::endl;
+      return 1;
+    }
+
+    // Distances are computed in an equirectangular projection around the area where
+    // the longitudes are scaled by the cosine of the mean latitude; one degree of
+    // latitude is about 111,195m.
+    double scale{1.0};
+    if (!points.empty()) {
+      double meanLatitude{0.0};
+      for (const auto &p : points) {
+        meanLatitude += p[0] / static_cast<double>(points.size());
+      }
+      scale = (std::max)(std::cos(meanLatitude * M_PI / 180.0), 1.0e-6);
+    }
+    const double WIDTH{width / 111195.0};
+    std::vector<std::array<double,2>> area2D;
+    for (const auto &p : points) {
+      area2D.push_back(std::array<double,2>{{p[0], p[1] * scale}});
+    }
+    // The cells are computed on Morton codes; the entries are decoded with the curve of the table.
+    Curve curve{CURVE_MORTON};
+    auto planarOfGrid = [scale](const std::pair<uint32_t,uint32_t> &XY) {
+      return std::array<double,2>{{XY.first / 100000.0 - 90.0, (XY.second / 100000.0 - 180.0) * scale}};
+    };
+    auto planarOfCell = [&planarOfGrid](const uint64_t &morton) {
+      return planarOfGrid(mortonDecode(morton));
+    };
+    auto planarOf = [&planarOfGrid, &curve](const uint64_t &code) {
+      return planarOfGrid(curveDecode(curve, code));
+    };
+    if (!points.empty()) {
+      // Bounding box around the area with a margin for the resolution of the Morton codes.
+      const double MARGIN{0.00003};
+      geoboxBL = std::make_pair(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+      geoboxTR = std::make_pair(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+      for (const auto &p : points) {
+        geoboxBL.first = (std::min)(geoboxBL.first, static_cast<float>(p[0] - WIDTH - MARGIN));
+        geoboxBL.second = (std::min)(geoboxBL.second, static_cast<float>(p[1] - WIDTH / scale - MARGIN));
+        geoboxTR.first = (std::max)(geoboxTR.first, static_cast<float>(p[0] + WIDTH + MARGIN));
+        geoboxTR.second = (std::max)(geoboxTR.second, static_cast<float>(p[1] + WIDTH / scale + MARGIN));
+      }
+    }
+
     MDB_env *env{nullptr};
+    const std::size_t MAX_CELLS{1024};
     const int numberOfDatabases{100};
     const int64_t SIZE_DB = MEM * 1024UL * 1024UL * 1024UL;
 
@@ -81,12 +177,28 @@ int32_t main(int32_t argc, char **argv) {
         mdb_env_close(env);
         return (retCode = 1);
       }
-      retCode = mdb_dbi_open(txn, "19/0-morton", 0 , &dbi);
+      // The curve is recorded in the name of the table.
+      if (CURVE_NONE != REQUESTED_CURVE) {
+        curve = REQUESTED_CURVE;
+      }
+      else if ( (MDB_SUCCESS != mdb_dbi_open(txn, "19/0-morton", 0, &dbi)) && (MDB_SUCCESS == mdb_dbi_open(txn, "19/0-hilbert", 0, &dbi)) ) {
+        curve = CURVE_HILBERT;
+      }
+      const std::string BASE{"19/0" + curveSuffixOf(curve)};
+      // Time ranges are scanned per time bucket in the table '19/0-morton-time' (or '19/0-hilbert-time'); otherwise, the timeStamps are filtered afterwards.
+      const bool TIMED{HAS_TIME && (MDB_SUCCESS == mdb_dbi_open(txn, (BASE + "-time").c_str(), 0, &dbi))};
+      if (HAS_TIME && !TIMED) {
+        std::clog << "[" << argv[0] << "]: No database '" << BASE << "-time' found in " << CABINET << "; filtering the timeStamps from '" << BASE << "'." << std::endl;
+      }
+      const std::string TABLE{TIMED ? BASE + "-time" : BASE};
+      retCode = TIMED ? MDB_SUCCESS : mdb_dbi_open(txn, BASE.c_str(), 0 , &dbi);
       if (MDB_NOTFOUND  == retCode) {
-        std::clog << "[" << argv[0] << "]: No database '19/0-morton' found in " << CABINET << "." << std::endl;
+        std::clog << "[" << argv[0] << "]: No database '" << BASE << "' found in " << CABINET << "." << std::endl;
       }
       else {
-        mdb_set_compare(txn, dbi, &compareMortonKeys);
+        if (!TIMED) {
+          mdb_set_compare(txn, dbi, &compareMortonKeys);
+        }
         // Multiple values are stored by existing timeStamp in nanoseconds.
         mdb_set_dupsort(txn, dbi, &compareKeys);
 
@@ -95,38 +207,91 @@ int32_t main(int32_t argc, char **argv) {
         if (!mdb_stat(txn, dbi, &stat)) {
           numberOfEntries = stat.ms_entries;
         }
-        std::clog << "[" << argv[0] << "]: Found " << numberOfEntries << " entries in database '19/0-morton' in " << CABINET << std::endl;
+        std::clog << "[" << argv[0] << "]: Found " << numberOfEntries << " entries in database '" << TABLE << "' in " << CABINET << std::endl;
 
-        // Query around a known coordinate (southern-most point at right connection to GOT FastFood area when using the example):
-        uint64_t bl_morton = convertLatLonToMorton(geoboxBL);
-        uint64_t tr_morton = convertLatLonToMorton(geoboxTR);
+        // The corners may be given in any order; only entries within the box are visited and returned.
+        const auto box = convertLatLonBoxToMorton(geoboxBL, geoboxTR);
+        const uint64_t bl_morton{box.first};
+        const uint64_t tr_morton{box.second};
         std::clog << "[" << argv[0] << "]: Morton code: " <<  bl_morton << ", " << tr_morton << std::endl;
+        // Polygons and corridors are covered by cells at an adaptive level; only the entries in cells at the border are checked individually.
+        auto coverOf = (CURVE_HILBERT == curve) ? &hilbertCoverOf : &mortonCoverOf;
+        std::vector<MortonCell> cells;
+        if (IS_POLYGON) {
+          cells = coverOf(bl_morton, tr_morton, [&area2D, &planarOfCell](const uint64_t &bl, const uint64_t &tr) {
+            return geofence::overlapOfPolygon(area2D, planarOfCell(bl), planarOfCell(tr));
+          }, MAX_CELLS);
+        }
+        else if (IS_CORRIDOR) {
+          cells = coverOf(bl_morton, tr_morton, [&area2D, &planarOfCell, WIDTH](const uint64_t &bl, const uint64_t &tr) {
+            return geofence::overlapOfCorridor(area2D, WIDTH, planarOfCell(bl), planarOfCell(tr));
+          }, MAX_CELLS);
+        }
+        if (IS_POLYGON || IS_CORRIDOR) {
+          std::clog << "[" << argv[0] << "]: Covered the " << (IS_POLYGON ? "polygon" : "corridor") << " with " << cells.size() << " range(s) of " << ((CURVE_HILBERT == curve) ? "Hilbert" : "Morton") << " codes." << std::endl;
+        }
         MDB_cursor *cursor;
         if (!(retCode = mdb_cursor_open(txn, dbi, &cursor))) {
-          MDB_val key;
-          MDB_val value;
-
-          key.mv_size = sizeof(bl_morton);
-          auto _bl_morton = htobe64(bl_morton);
-          key.mv_data = &_bl_morton;
-          if (MDB_NOTFOUND != mdb_cursor_get(cursor, &key, &value, MDB_SET_RANGE)) {
-            while (mdb_cursor_get(cursor, &key, &value, MDB_NEXT) == 0) {
-              uint64_t morton = *reinterpret_cast<uint64_t*>(key.mv_data);
-              morton = be64toh(morton);
-              if (morton > tr_morton) break;
-              auto decodedLatLon = convertMortonToLatLon(morton);
-              int64_t timeStamp{0};
-              if (value.mv_size == sizeof(int64_t)) {
-                const char *ptr = static_cast<char*>(value.mv_data);
-                std::memcpy(&timeStamp, ptr, value.mv_size);
-                timeStamp = be64toh(timeStamp);
-                if (VERBOSE) {
-                  std::cout << bl_morton << ";" << morton << ";" << tr_morton << ";";
-                }
-                std::cout << std::setprecision(10) << decodedLatLon.first << ";" << decodedLatLon.second << ";" << timeStamp << std::endl;
+          // Results are formatted per batch of duplicates and written in chunks.
+          uint64_t found{0};
+          std::vector<int64_t> timeStamps;
+          std::string out;
+          std::string prefix;
+          uint64_t prefixMorton{0};
+          std::stringstream sstr;
+          sstr << std::setprecision(10);
+          auto printer = [&](const uint64_t &morton, const MDB_val &values) {
+            mortonTimeStampsOf(values, timeStamps);
+            if (HAS_TIME) {
+              // Only the first and last time buckets may contain timeStamps outside of the range.
+              timeStamps.erase(std::remove_if(timeStamps.begin(), timeStamps.end(), [FROM, TO](const int64_t &timeStamp) {
+                return (timeStamp < FROM) || (timeStamp > TO);
+              }), timeStamps.end());
+            }
+            if (timeStamps.empty()) {
+              return;
+            }
+            if (prefix.empty() || (prefixMorton != morton)) {
+              auto decodedLatLon = convertCurveToLatLon(curve, morton);
+              sstr.str("");
+              if (VERBOSE) {
+                sstr << bl_morton << ";" << morton << ";" << tr_morton << ";";
               }
+              sstr << decodedLatLon.first << ";" << decodedLatLon.second << ";";
+              prefix = sstr.str();
+              prefixMorton = morton;
+            }
+            for (const auto &timeStamp : timeStamps) {
+              out.append(prefix).append(std::to_string(timeStamp)).append(1, '\n');
+            }
+            found += timeStamps.size();
+            if (out.size() > 64 * 1024) {
+              std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+              out.clear();
+            }
+          };
+          auto scan = [&](const int64_t *bucket) {
+            if (IS_POLYGON) {
+              return mortonForEachInCells(cursor, cells, [&area2D, &planarOf](const uint64_t &morton) {
+                std::array<double,2> p{planarOf(morton)};
+                return geofence::isIn(area2D, p);
+              }, printer, bucket);
+            }
+            if (IS_CORRIDOR) {
+              return mortonForEachInCells(cursor, cells, [&area2D, &planarOf, WIDTH](const uint64_t &morton) {
+                return geofence::isInCorridor(area2D, WIDTH, planarOf(morton));
+              }, printer, bucket);
+            }
+            if (CURVE_HILBERT == curve) {
+              return hilbertForEachInBox(cursor, bl_morton, tr_morton, printer, bucket);
             }
-          }
+            return mortonForEachInBox(cursor, bl_morton, tr_morton, printer, bucket);
+          };
+          const uint64_t seeks{TIMED ? mortonForEachBucket(cursor, FROM, TO, [&scan](const int64_t &bucket) { return scan(&bucket); }) : scan(nullptr)};
+          std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+          std::cout.flush();
+          mdb_cursor_close(cursor);
+          std::clog << "[" << argv[0] << "]: Found " << found << " entries within the " << (IS_POLYGON ? "polygon" : (IS_CORRIDOR ? "corridor" : "geobox")) << " using " << seeks << " seek(s)." << std::endl;
         }
       }
       mdb_txn_abort(txn);
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "cluon-complete.hpp"
+#include "cabinet-record.hpp"
+
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include <iomanip>
+#include <locale>
+#include <string>
+
+struct space_out : std::numpunct<char> {
+  char do_thousands_sep()   const { return ','; }  // separate with spaces
+  std::string do_grouping() const { return "\3"; } // groups of 3 digit
+};
+
+static std::atomic<bool> running{true};
+
+static void stopRecording(int) {
+  running.store(false);
+}
+
+int32_t main(int32_t argc, char **argv) {
+  int32_t retCode{0};
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if ( (0 == commandlineArguments.count("cid")) || (0 == commandlineArguments.count("cab")) ) {
+    std::cerr << argv[0] << " records the Envelopes from a running OD4Session into an lmdb-based key/value-database until Ctrl-C." << std::endl;
+    std::cerr << "If the specified database exists, the Envelopes are added." << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --cid=111 --cab=myFile.cab [--verbose] [--mem=32024] [--userdata=1234] [--batchentries=1000] [--batchms=100] [--buffer=65536] [--codec=lz4hc:12,1055=none] [--keylayout=1] [--inline=128] [--clustered] [--blob=65536]" << std::endl;
+    std::cerr << "         --cid:          OD4Session to record" << std::endl;
+    std::cerr << "         --cab:          name of the database file" << std::endl;
+    std::cerr << "         --mem:          upper memory size for database in memory in GB, default: 64,000 (representing 64TB)" << std::endl;
+    std::cerr << "         --userdata:     optional: uint64_t user supplied optional data (default: 0), which can be used to add further information to this recording" << std::endl;
+    std::cerr << "         --batchentries: optional: commit after this many Envelopes (default: 1000)" << std::endl;
+    std::cerr << "         --batchms:      optional: commit at the latest after this many milliseconds (default: 100)" << std::endl;
+    std::cerr << "         --buffer:       optional: number of Envelopes to buffer between receiving and storing; further Envelopes are dropped (default: 65536)" << std::endl;
+    std::cerr << "         --codec:        optional: comma-separated codecs to compress values: none, lz4[:acceleration], lz4hc[:level], or zstd[:level] (if available), optionally per dataType as dataType=codec (default: lz4hc:12)" << std::endl;
+    std::cerr << "         --keylayout:    optional: layout of the keys for a new database: 0 = ordered by compareKeys, 1 = ordered by memcmp (default: 0)" << std::endl;
+    std::cerr << "         --inline:       optional: store values of up to this many bytes after compression inline in their key (default: 0 = never, max: " << KEY_MAX_INLINE_VALUE << ")" << std::endl;
+    std::cerr << "         --clustered:    optional: store the values per stream in the tables dataType/senderStamp and only the keys in 'all' for a new database" << std::endl;
+    std::cerr << "         --blob:         optional: store values of at least this many bytes after compression in the append-only file myFile.cab-blobs next to the database (default: 0 = never)" << std::endl;
+    std::cerr << "         --verbose:      display information" << std::endl;
+    std::cerr << "Example: " << argv[0] << " --cid=111 --cab=myStore.cab --batchms=50" << std::endl;
+    retCode = 1;
+  } else {
+    std::clog.imbue(std::locale(std::cout.getloc(), new space_out));
+    const uint16_t CID{static_cast<uint16_t>(std::stoi(commandlineArguments["cid"]))};
+    const std::string CABINET{commandlineArguments["cab"]};
+    const uint64_t MEM{(commandlineArguments["mem"].size() != 0) ? static_cast<uint64_t>(std::stoi(commandlineArguments["mem"])) : 64UL*1024UL};
+    const uint64_t USERDATA{(commandlineArguments["userdata"].size() != 0) ? static_cast<uint64_t>(std::stoll(commandlineArguments["userdata"])) : 0};
+    const uint32_t BATCH_ENTRIES{(commandlineArguments["batchentries"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["batchentries"])) : 1000};
+    const uint32_t BATCH_MS{(commandlineArguments["batchms"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["batchms"])) : 100};
+    const std::size_t BUFFER_SIZE{(commandlineArguments["buffer"].size() != 0) ? static_cast<std::size_t>(std::stoul(commandlineArguments["buffer"])) : 64 * 1024};
+    const uint8_t KEY_LAYOUT{(commandlineArguments["keylayout"].size() != 0) ? static_cast<uint8_t>(std::stoul(commandlineArguments["keylayout"])) : KEY_LAYOUT_COMPARE_KEYS};
+    const bool CLUSTERED{(commandlineArguments["clustered"].size() != 0)};
+    const uint64_t MAX_INLINE_VALUE{(commandlineArguments["inline"].size() != 0) ? static_cast<uint64_t>(std::stoull(commandlineArguments["inline"])) : 0};
+    const std::size_t BLOB_SIZE{(commandlineArguments["blob"].size() != 0) ? static_cast<std::size_t>(std::stoull(commandlineArguments["blob"])) : 0};
+    const bool VERBOSE{(commandlineArguments["verbose"].size() != 0)};
+
+    const std::string ARGV0{argv[0]};
+    codec::Selection codecs;
+    if (!codec::parse(commandlineArguments["codec"], codecs)) {
+      std::cerr << "[" << ARGV0 << "]: Invalid or unavailable codec in '" << commandlineArguments["codec"] << "'." << std::endl;
+      retCode = 1;
+    }
+    else if (KEY_LAYOUT_MEMCMP < KEY_LAYOUT) {
+      std::cerr << "[" << ARGV0 << "]: Unknown key layout " << +KEY_LAYOUT << "." << std::endl;
+      retCode = 1;
+    }
+    else if (KEY_MAX_INLINE_VALUE < MAX_INLINE_VALUE) {
+      std::cerr << "[" << ARGV0 << "]: Values of up to " << KEY_MAX_INLINE_VALUE << " bytes can be stored inline." << std::endl;
+      retCode = 1;
+    }
+    else {
+      std::signal(SIGINT, stopRecording);
+      std::signal(SIGTERM, stopRecording);
+      retCode = cabinet_record(ARGV0, MEM, CID, CABINET, USERDATA, VERBOSE, running, BATCH_ENTRIES, BATCH_MS, BUFFER_SIZE, codecs, KEY_LAYOUT, static_cast<uint16_t>(MAX_INLINE_VALUE), CLUSTERED, BLOB_SIZE);
+    }
+  }
+  return retCode;
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CABINET_RECORD_HPP
+#define CABINET_RECORD_HPP
+
+#include "cluon-complete.hpp"
+#include "blobs.hpp"
+#include "block.hpp"
+#include "clustered.hpp"
+#include "codec.hpp"
+#include "key.hpp"
+#include "db.hpp"
+#include "rec-file-view.hpp"
+#include "spsc-queue.hpp"
+
+#include "lmdb++.h"
+#include "xxhash.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * This function records the Envelopes from a running OD4Session directly into
+ * a cabinet. The UDP receiving thread of the OD4Session serializes each
+ * Envelope into a bounded, lock-free ring buffer; Envelopes that do not fit
+ * into the ring buffer are dropped and counted as overruns. The calling thread
+ * is the only writer to the database: It compresses the Envelopes and stores
+ * them in "all" and "dataType/senderStamp" within a write transaction that is
+ * committed after BATCH_ENTRIES Envelopes or at the latest BATCH_MS
+ * milliseconds after its first Envelope to bound the latency until an
+ * Envelope is visible to readers.
+ *
+ * @param ARGV0 Our name.
+ * @param MEM upper memory size for the database in GB
+ * @param CID OD4Session to record
+ * @param CABINET cabinet file to record into
+ * @param USERDATA user-supplied data to be stored in each key
+ * @param VERBOSE
+ * @param running recording continues while true; the Envelopes in the ring buffer are stored afterwards
+ * @param BATCH_ENTRIES commit after this many Envelopes
+ * @param BATCH_MS commit at the latest after this many milliseconds
+ * @param BUFFER_SIZE number of Envelopes in the ring buffer
+ * @param CODECS codecs to compress the values per dataType
+ * @param KEY_LAYOUT layout of the keys for a new cabinet; an existing cabinet keeps its layout
+ * @param MAX_INLINE_VALUE store values of up to this many bytes after compression inline in their key in "all" (0 = never)
+ * @param CLUSTERED store the values in the tables "dataType/senderStamp" and only the keys in "all" for a new cabinet; an existing cabinet keeps its choice
+ * @param BLOB_SIZE store values of at least this many bytes after compression in the blob file of the cabinet (0 = never)
+ * @return 0 on success, 1 otherwise
+ */
+inline int cabinet_record(const std::string &ARGV0, const uint64_t &MEM, const uint16_t &CID, const std::string &CABINET, const uint64_t &USERDATA, const bool &VERBOSE, std::atomic<bool> &running, const uint32_t &BATCH_ENTRIES = 1000, const uint32_t &BATCH_MS = 100, const std::size_t &BUFFER_SIZE = 64 * 1024, const codec::Selection &CODECS = codec::Selection(), const uint8_t &KEY_LAYOUT = KEY_LAYOUT_COMPARE_KEYS, const uint16_t &MAX_INLINE_VALUE = 0, const bool &CLUSTERED = false, const std::size_t &BLOB_SIZE = 0) {
+  int32_t retCode{0};
+  const int numberOfDatabases{100};
+  const int64_t SIZE_DB = MEM * 1024UL * 1024UL * 1024UL;
+  try {
+    auto env = lmdb::env::create();
+    env.set_mapsize(SIZE_DB);
+    env.set_max_dbs(numberOfDatabases);
+    env.open(CABINET.c_str(), MDB_NOSUBDIR, 0600);
+
+    // Load the existing dictionaries to continue using them for their streams.
+    codec::Dictionaries dictionaries;
+    {
+      auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+      dictionaries.load(rotxn.handle());
+      // The keys of blocks hold the last timeStamp and the number of
+      // Envelopes instead of the xxhash; hence, duplicates cannot be detected.
+      MDB_dbi dbAll{0};
+      if ( (MDB_SUCCESS == mdb_dbi_open(rotxn.handle(), "all", 0, &dbAll))
+        && block::isPacked(rotxn.handle(), dbAll) ) {
+        std::cerr << "[" << ARGV0 << "]: " << CABINET << " stores blocks of Envelopes; unpack it with cabinet-migrate before recording into it." << std::endl;
+        return 1;
+      }
+      rotxn.abort();
+    }
+    codec::DictionaryTrainer dictionaryTrainer(dictionaries);
+    codec::DictionaryIds dictionaryIds(dictionaries);
+
+    // All Envelopes from this session share the same hashOfRecFile.
+    const std::string SOURCE{"od4session:" + std::to_string(CID)};
+    const XXH32_hash_t hashOfSource = XXH32(SOURCE.c_str(), SOURCE.size(), 0);
+
+    // Stage 1: Serialize the Envelopes on the UDP receiving thread.
+    cluon::SPSC_Queue<std::string> ringBuffer(BUFFER_SIZE);
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> overruns{0};
+    cluon::OD4Session od4{CID, [&ringBuffer, &received, &overruns](cluon::data::Envelope &&envelope) {
+      received++;
+      if (!ringBuffer.push(cluon::serializeEnvelope(std::move(envelope)))) {
+        overruns++;
+      }
+    }};
+    if (!od4.isRunning()) {
+      std::cerr << "[" << ARGV0 << "]: Could not join OD4Session " << CID << "." << std::endl;
+      return 1;
+    }
+    std::clog << "[" << ARGV0 << "]: Recording OD4Session " << CID << " into " << CABINET << std::endl;
+
+    // Stage 2: Store the Envelopes in batches.
+    lmdb::txn txn{nullptr};
+    // Large values are appended to the blob file and only referenced.
+    clustered::Store store(blobs::fileOf(CABINET), KEY_LAYOUT, CLUSTERED, MAX_INLINE_VALUE, BLOB_SIZE);
+
+    uint64_t entries{0};
+    uint64_t duplicates{0};
+    uint64_t commits{0};
+    uint32_t entriesInBatch{0};
+    int64_t maxBatchLatency{0};
+    cluon::data::TimeStamp batchStart{cluon::time::now()};
+    auto commitBatch = [&txn, &store, &commits, &entriesInBatch, &maxBatchLatency, &batchStart]() {
+      if (nullptr != txn.handle()) {
+        const int32_t rc{store.flush(txn.handle())};
+        if (MDB_SUCCESS != rc) {
+          lmdb::error::raise("clustered::Store::flush", rc);
+        }
+        txn.commit();
+        commits++;
+        maxBatchLatency = std::max(maxBatchLatency, cluon::time::deltaInMicroseconds(cluon::time::now(), batchStart));
+      }
+      entriesInBatch = 0;
+    };
+
+    std::vector<char> compressedValue;
+    std::string envelope;
+    while (running.load() || !ringBuffer.empty()) {
+      if (!ringBuffer.pop(envelope)) {
+        if ((0 < entriesInBatch) && (static_cast<int64_t>(BATCH_MS) * 1000 <= cluon::time::deltaInMicroseconds(cluon::time::now(), batchStart))) {
+          commitBatch();
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        continue;
+      }
+
+      // No transaction available, create one.
+      if (nullptr == txn.handle()) {
+        txn = lmdb::txn::begin(env);
+        batchStart = cluon::time::now();
+        const int32_t rc{store.begin(txn.handle())};
+        if (MDB_SUCCESS != rc) {
+          lmdb::error::raise("clustered::Store::begin", rc);
+        }
+      }
+
+      // Only the fields for the key are decoded from the Envelope.
+      cluon::EnvelopeView e(envelope.data(), envelope.size(), 0);
+      const XXH64_hash_t hash = XXH64(envelope.data(), envelope.size(), 0);
+
+      // Compress value with the codec selected for its dataType.
+      const codec::Config &config = CODECS.select(e.dataType());
+      std::shared_ptr<const codec::Dictionary> dictionary;
+      if (codec::usesDictionary(config.codec)) {
+        dictionary = dictionaryTrainer.sample(e.dataType(), e.senderStamp(), envelope.data(), envelope.size());
+      }
+      const uint8_t appliedCodec{codec::encode(config, envelope.data(), envelope.size(), compressedValue, dictionary.get())};
+
+      // Store a new dictionary within the same transaction as its first value.
+      if (codec::usesDictionary(appliedCodec)) {
+        const int32_t rc{dictionaryIds.store(txn.handle(), *dictionary, compressedValue)};
+        if (MDB_SUCCESS != rc) {
+          lmdb::error::raise("codec::Dictionaries::store", rc);
+        }
+      }
+
+      cabinet::Key k;
+      k.dataType(e.dataType())
+       .senderStamp(e.senderStamp())
+       .hash(hash)
+       .hashOfRecFile(hashOfSource)
+       .length(envelope.size())
+       .userData(USERDATA)
+       .version(codec::version(store.layout(), appliedCodec));
+
+      // Envelopes arrive mostly in temporal order and are appended.
+      k.timeStamp(e.sampleTimeStamp() * 1000UL);
+      const bool IS_COMPRESSED{codec::NONE != appliedCodec};
+      const int32_t rc{store.put(txn.handle(), k, IS_COMPRESSED ? compressedValue.data() : envelope.data(), IS_COMPRESSED ? compressedValue.size() : envelope.size(), envelope.size())};
+      if (MDB_KEYEXIST == rc) {
+        duplicates++;
+        continue;
+      }
+      if (MDB_SUCCESS != rc) {
+        lmdb::error::raise("clustered::Store::put", rc);
+      }
+      entries++;
+
+      // Commit write when the batch is full.
+      entriesInBatch++;
+      if ( ((0 < BATCH_ENTRIES) && (BATCH_ENTRIES <= entriesInBatch))
+        || (static_cast<int64_t>(BATCH_MS) * 1000 <= cluon::time::deltaInMicroseconds(cluon::time::now(), batchStart)) ) {
+        commitBatch();
+      }
+      if (VERBOSE) {
+        std::clog << "[" << ARGV0 << "]: Stored " << e.dataType() << "/" << e.senderStamp() << " at " << e.sampleTimeStamp() << std::endl;
+      }
+    }
+    // Commit the last, partially filled batch.
+    commitBatch();
+
+    std::clog << "[" << ARGV0 << "]: Received " << received.load() << " envelopes, stored " << entries << " entries in " << commits << " commits (max. "
+              << maxBatchLatency / 1000 << "ms per batch), " << overruns.load() << " envelopes dropped on overruns, " << duplicates << " duplicates skipped." << std::endl;
+  }
+  catch(const lmdb::error &e) {
+    std::cerr << "[" << ARGV0 << "]: " << e.what() << std::endl;
+    retCode = 1;
+  }
+  catch(const std::exception &e) {
+    std::cerr << "[" << ARGV0 << "]: " << e.what() << std::endl;
+    retCode = 1;
+  }
+  return retCode;
+}
+
+#endif
@@ -27,7 +27,7 @@ int32_t main(int32_t argc, char **argv) {
     std::cerr << "         --cab:     name of the database file" << std::endl;
     std::cerr << "         --mem:     upper memory size for database in memory in GB, default: 64,000 (representing 64TB)" << std::endl;
     std::cerr << "         --verbose: display information on stderr" << std::endl;
-    std::cerr << "         --start:   start time stamp in Unix epoch seconds (export begins AFTER this time point)" << std::endl;
+    std::cerr << "         --start:   start time stamp in Unix epoch seconds (export begins AT this time point)" << std::endl;
     std::cerr << "         --end:     end time stamp in Unix epoch seconds; or +duration in seconds (export ends BEFORE this time point)" << std::endl;
     std::cerr << "         --export:  <list of messageID/senderStamp pairs to export, default: all>" << std::endl;
     std::cerr << "Example: " << argv[0] << " --cab=myStore.cab" << std::endl;
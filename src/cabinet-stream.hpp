@@ -10,20 +10,25 @@
 #define CABINET_STREAM_HPP
 
 #include "cluon-complete.hpp"
+#include "blobs.hpp"
+#include "block.hpp"
+#include "clustered.hpp"
+#include "codec.hpp"
 #include "db.hpp"
 #include "key.hpp"
 #include "lmdb.h"
-#include "lz4.h"
-#include "lz4hc.h"
 
 #include <cstdio>
 #include <cstring>
 #include <cstdint>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <memory>
 #include <string>
+#include <tuple>
 
 /**
  * This function streams the content of the given cabinet file.
@@ -75,12 +80,15 @@ inline int cabinet_stream(const std::string &ARGV0, const uint64_t &MEM, const s
     mdb_env_close(env);
     return (retCode = 1);
   }
+  codec::Dictionaries dictionaries;
+  dictionaries.load(txn);
+  blobs::Reader blobReader(blobs::fileOf(CABINET));
   retCode = mdb_dbi_open(txn, "all", 0 , &dbi);
   if ((MDB_NOTFOUND  == retCode) && VERBOSE) {
     std::cerr << "[" << ARGV0 << "]: No database 'all' found in " << CABINET << "." << std::endl;
   }
   else {
-    mdb_set_compare(txn, dbi, &compareKeys);
+    const uint8_t LAYOUT{useKeyLayoutOf(txn, dbi)};
 
     uint64_t numberOfEntries{0};
     MDB_stat stat;
@@ -91,75 +99,77 @@ inline int cabinet_stream(const std::string &ARGV0, const uint64_t &MEM, const s
       std::cerr << "[" << ARGV0 << "]: Found " << numberOfEntries << " entries in database 'all' in " << CABINET << std::endl;
     }
 
-    MDB_cursor *cursor;
-    if (!(retCode = mdb_cursor_open(txn, dbi, &cursor))) {
+    // The cursors are closed at the end of this scope before the transaction.
+    {
       int32_t oldPercentage{-1};
       MDB_val key;
       MDB_val val;
 
-      if (START_IN_NS > 0) {
-        const uint64_t MAXKEYSIZE = 511;
-        std::vector<char> _key;
-        _key.reserve(MAXKEYSIZE);
-
-        cabinet::Key query;
-        query.timeStamp(START_IN_NS);
-        
-        key.mv_size = setKey(query, _key.data(), _key.capacity());
-        key.mv_data = _key.data();
-
-        if (!checkErrorCode(mdb_cursor_get(cursor, &key, &val, MDB_SET_RANGE), __LINE__, "mdb_cursor_get")) {
-          return retCode;
-        }
+      std::vector<std::string> tables;
+      for (auto e : mapOfEnvelopesToExport) {
+        tables.push_back(e.first);
       }
+      // A clustered cabinet stores the values per stream; hence, selected
+      // streams are merged from their own tables without reading "all".
+      const bool MERGE{(0 < tables.size()) && clustered::isClustered(txn, dbi)};
+      if (MERGE && VERBOSE) {
+        std::cerr << "[" << ARGV0 << "]: Reading " << tables.size() << " stream(s) from their own tables." << std::endl;
+      }
+      // Entries are read from where all Envelopes from the start time point on are found.
+      clustered::Entries storedEntries(txn, LAYOUT);
+      block::Cursor entriesFromStart(txn, dbi, tables.empty() ? clustered::tablesOf(txn) : tables, MERGE, std::max<int64_t>(START_IN_NS, 0), LAYOUT);
+
+      // Only the entries of the selected streams are decoded.
+      uint64_t entriesRead{0};
+      auto next = [&](MDB_val &k, MDB_val &v) {
+        while (entriesFromStart.next(key, val)) {
+          entriesRead++;
+          const char *ptr = static_cast<char*>(key.mv_data);
+          if (KEY_SIZE > key.mv_size) {
+            continue;
+          }
 
-      cabinet::Key storedKey;
-      while ((retCode = mdb_cursor_get(cursor, &key, &val, MDB_NEXT_NODUP)) == 0) {
-        bool print{mapOfEnvelopesToExport.size() == 0};
-
-        const char *ptr = static_cast<char*>(key.mv_data);
-        storedKey = getKey(ptr, key.mv_size);
-
-        // Out of range.
-        if ( (END_IN_NS > 0) && (storedKey.timeStamp() > END_IN_NS) ) {
-          break;
-        }
-
-        if (VERBOSE) {
-          std::cerr << storedKey.timeStamp() << ": " << storedKey.dataType() << "/" << storedKey.senderStamp() << std::endl;
-        }
-
-        if (mapOfEnvelopesToExport.size() > 0) {
-          std::stringstream sstr;
-          sstr << storedKey.dataType() << "/" << storedKey.senderStamp();
-          std::string str = sstr.str();
-          print = (mapOfEnvelopesToExport.count(str) > 0);
-        }
+          // Out of range.
+          if ( (END_IN_NS > 0) && (keyTimeStamp(ptr) > END_IN_NS) ) {
+            return false;
+          }
 
-        if (print) {
-          if (storedKey.length() > val.mv_size) {
-            std::vector<char> decompressedValue;
-            decompressedValue.reserve(storedKey.length());
-            const ssize_t decompressedSize = LZ4_decompress_safe(static_cast<char*>(val.mv_data), decompressedValue.data(), val.mv_size, decompressedValue.capacity());
-            std::cout.write(static_cast<char*>(decompressedValue.data()), decompressedSize);
+          if (VERBOSE) {
+            std::cerr << keyTimeStamp(ptr) << ": " << keyDataType(ptr) << "/" << keySenderStamp(ptr) << std::endl;
           }
-          else {
-            // Value to dump is uncompressed.
-            std::cout.write(static_cast<char*>(val.mv_data), val.mv_size);
+
+          if (START == 0) {
+            const int32_t percentage = static_cast<int32_t>(static_cast<float>(entriesRead * 100.0f) / static_cast<float>(numberOfEntries));
+            if (((percentage % 5 == 0) && (percentage != oldPercentage)) && VERBOSE) {
+              std::cerr << "[" << ARGV0 << "]: Processed " << percentage << "% (" << entries << " entries) from " << CABINET << "." << std::endl;
+              oldPercentage = percentage;
+            }
           }
-          std::cout.flush();
-          entries++;
-        }
 
-        if (START == 0) {
-          const int32_t percentage = static_cast<int32_t>(static_cast<float>(entries * 100.0f) / static_cast<float>(numberOfEntries));
-          if (((percentage % 5 == 0) && (percentage != oldPercentage)) && VERBOSE) {
-            std::cerr << "[" << ARGV0 << "]: Processed " << percentage << "% (" << entries << " entries) from " << CABINET << "." << std::endl;
-            oldPercentage = percentage;
+          if ( (0 == mapOfEnvelopesToExport.size()) || (0 < mapOfEnvelopesToExport.count(clustered::tableOf(keyDataType(ptr), keySenderStamp(ptr)))) ) {
+            std::tie(k, v) = storedEntries.entryOf(key, val);
+            return true;
           }
         }
+        return false;
+      };
+
+      // Blocks are unpacked into single Envelopes in the order of their sampleTimeStamps.
+      block::Envelopes envelopes(next, &dictionaries, &blobReader);
+      int64_t timeStamp{0};
+      cluon::EnvelopeView envelope;
+      while (envelopes.next(timeStamp, envelope)) {
+        // Out of range.
+        if ( (END_IN_NS > 0) && (timeStamp > END_IN_NS) ) {
+          break;
+        }
+        if ( (START_IN_NS > 0) && (timeStamp < START_IN_NS) ) {
+          continue;
+        }
+        std::cout.write(envelope.data(), envelope.size());
+        std::cout.flush();
+        entries++;
       }
-      mdb_cursor_close(cursor);
     }
   }
   mdb_txn_abort(txn);
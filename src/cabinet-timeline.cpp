@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "cluon-complete.hpp"
+#include "timeline.hpp"
+
+#include "lmdb.h"
+
+#include <cstdint>
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+int32_t main(int32_t argc, char **argv) {
+  int32_t retCode{0};
+  auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+  if (0 == commandlineArguments.count("cab")) {
+    std::cerr << argv[0] << " prints per stream how many Envelopes were stored between two time points, at which rate, and where the gaps were, using only the table 'timeline' of a cabinet (an lmdb-based key/value-database)." << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --cab=myStore.cab [--mem=32024] [--start=1569916731] [--end=+100] [--export=19/0,25/1] [--verbose]" << std::endl;
+    std::cerr << "         --cab:     name of the database file" << std::endl;
+    std::cerr << "         --mem:     upper memory size for database in memory in GB, default: 64,000 (representing 64TB)" << std::endl;
+    std::cerr << "         --start:   start time stamp in Unix epoch seconds; default: first minute with Envelopes" << std::endl;
+    std::cerr << "         --end:     end time stamp in Unix epoch seconds; or +duration in seconds; default: last minute with Envelopes" << std::endl;
+    std::cerr << "         --export:  <list of messageID/senderStamp pairs to display, default: all>" << std::endl;
+    std::cerr << "         --verbose: display the number of Envelopes per minute" << std::endl;
+    std::cerr << "Example: " << argv[0] << " --cab=myStore.cab --start=1569916731 --end=+3600" << std::endl;
+    retCode = 1;
+  } else {
+    const std::string CABINET{commandlineArguments["cab"]};
+    const uint64_t MEM{(commandlineArguments["mem"].size() != 0) ? static_cast<uint64_t>(std::stoi(commandlineArguments["mem"])) : 64UL*1024UL};
+    const bool VERBOSE{(commandlineArguments["verbose"].size() != 0)};
+
+    std::map<std::string, bool> mapOfEnvelopesToExport{};
+    {
+      std::string tmp{commandlineArguments["export"]};
+      tmp += ",";
+      auto entries = stringtoolbox::split(tmp, ',');
+      for (auto e : entries) {
+        if (0 != e.size()) {
+          auto l = stringtoolbox::split(e, '/');
+          mapOfEnvelopesToExport[(0 == l.size()) ? e + "/0" : e] = true;
+        }
+      }
+    }
+
+    const bool HAS_START{0 != commandlineArguments["start"].size()};
+    const bool HAS_END{0 != commandlineArguments["end"].size()};
+    const int64_t START{HAS_START ? static_cast<int64_t>(std::stoll(commandlineArguments["start"])) : 0};
+    int64_t END{HAS_END ? static_cast<int64_t>(std::stoll(commandlineArguments["end"])) : 0};
+    if (HAS_END && ('+' == commandlineArguments["end"].at(0))) {
+      // relative end notation was used.
+      END += START;
+    }
+    constexpr int64_t NS{1000L * 1000L * 1000L};
+    const int64_t FROM{HAS_START ? START * NS : std::numeric_limits<int64_t>::min()};
+    const int64_t TO{HAS_END ? END * NS + (NS - 1) : std::numeric_limits<int64_t>::max()};
+
+    // lambda to check the interaction with the database.
+    auto checkErrorCode = [_argv=argv](int32_t rc, int32_t line, std::string caller) {
+      if (0 != rc) {
+        std::cerr << "[" << _argv[0] << "]: " << caller << ", line " << line << ": (" << rc << ") " << mdb_strerror(rc) << std::endl;
+      }
+      return (0 == rc);
+    };
+
+    MDB_env *env{nullptr};
+    if (!checkErrorCode(mdb_env_create(&env), __LINE__, "mdb_env_create")) {
+      return 1;
+    }
+    if (!checkErrorCode(mdb_env_set_maxdbs(env, 100), __LINE__, "mdb_env_set_maxdbs")) {
+      mdb_env_close(env);
+      return 1;
+    }
+    if (!checkErrorCode(mdb_env_set_mapsize(env, MEM * 1024UL * 1024UL * 1024UL), __LINE__, "mdb_env_set_mapsize")) {
+      mdb_env_close(env);
+      return 1;
+    }
+    if (!checkErrorCode(mdb_env_open(env, CABINET.c_str(), MDB_NOSUBDIR|MDB_RDONLY, 0600), __LINE__, "mdb_env_open")) {
+      mdb_env_close(env);
+      return 1;
+    }
+
+    MDB_txn *txn{nullptr};
+    if (!checkErrorCode(mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn), __LINE__, "mdb_txn_begin")) {
+      mdb_env_close(env);
+      return 1;
+    }
+    std::map<timeline::Timeline::Stream, std::vector<timeline::Bucket>> buckets;
+    if (!timeline::query(txn, FROM, TO, buckets)) {
+      std::cerr << "[" << argv[0] << "]: No table 'timeline' found in " << CABINET << "; use cabinet-migrate to create it." << std::endl;
+      retCode = 1;
+    }
+    mdb_txn_abort(txn);
+    mdb_env_close(env);
+
+    if (0 == retCode) {
+      if (!mapOfEnvelopesToExport.empty()) {
+        for (auto it = buckets.begin(); it != buckets.end();) {
+          const std::string s{std::to_string(it->first.first) + "/" + std::to_string(it->first.second)};
+          it = (0 == mapOfEnvelopesToExport.count(s)) ? buckets.erase(it) : std::next(it);
+        }
+      }
+
+      // Without a start or end, the range is limited to the minutes with Envelopes.
+      int64_t first{std::numeric_limits<int64_t>::max()};
+      int64_t last{std::numeric_limits<int64_t>::min()};
+      for (const auto &b : buckets) {
+        first = std::min(first, b.second.front().minute);
+        last = std::max(last, b.second.back().minute);
+      }
+      first = HAS_START ? timeline::minuteOf(FROM) : first;
+      last = HAS_END ? timeline::minuteOf(TO) : last;
+
+      if (buckets.empty() || (first > last)) {
+        std::cout << "No Envelopes found." << std::endl;
+      }
+      else {
+        const int64_t MINUTES{last - first + 1};
+        std::cout << "From " << first * 60 << " to " << (last + 1) * 60 << " (" << MINUTES << " minutes):" << std::endl;
+        for (const auto &e : buckets) {
+          uint64_t count{0};
+          uint64_t rawBytes{0};
+          uint64_t peak{0};
+          for (const auto &b : e.second) {
+            count += b.count;
+            rawBytes += b.rawBytes;
+            peak = std::max(peak, b.count);
+          }
+          const auto gaps = timeline::gapsOf(e.second, first, last);
+          std::cout << e.first.first << "/" << e.first.second << ": " << count << " Envelopes, " << rawBytes << " bytes, active in "
+                    << e.second.size() << " of " << MINUTES << " minutes, " << std::fixed << std::setprecision(2)
+                    << static_cast<double>(count) / (static_cast<double>(MINUTES) * 60.0) << " Hz on average, "
+                    << static_cast<double>(peak) / 60.0 << " Hz at most, " << gaps.size() << " gap(s)" << std::defaultfloat << std::endl;
+          if (VERBOSE) {
+            for (const auto &b : e.second) {
+              std::cout << "  " << b.minute * 60 << ": " << b.count << " Envelopes, " << b.rawBytes << " bytes" << std::endl;
+            }
+          }
+          for (const auto &g : gaps) {
+            std::cout << "  gap from " << g.first * 60 << " to " << (g.second + 1) * 60 << " (" << (g.second - g.first + 1) << " minutes)" << std::endl;
+          }
+        }
+      }
+    }
+  }
+  return retCode;
+}
@@ -27,7 +27,7 @@ int32_t main(int32_t argc, char **argv) {
     std::cerr << "         --cab:     name of the database file" << std::endl;
     std::cerr << "         --rec:     name of the rec file (optional; otherwise, a new file based on the .cab file with .rec as suffix is created)" << std::endl;
     std::cerr << "         --mem:     upper memory size for database in memory in GB, default: 64,000 (representing 64TB)" << std::endl;
-    std::cerr << "         --start:   start time of the export in Unix epoch seconds; default: 0" << std::endl;
+    std::cerr << "         --start:   start time of the export in Unix epoch seconds, included; default: 0" << std::endl;
     std::cerr << "         --end:     end time of the export in Unix epoch seconds; default: inf" << std::endl;
     std::cerr << "         --verbose: display information" << std::endl;
     std::cerr << "Example: " << argv[0] << " --cab=myStore.cab --rec=myRecFile.rec" << std::endl;
@@ -10,21 +10,26 @@
 #define CABINET2REC_HPP
 
 #include "cluon-complete.hpp"
+#include "blobs.hpp"
+#include "block.hpp"
+#include "clustered.hpp"
+#include "codec.hpp"
 #include "db.hpp"
 #include "key.hpp"
 #include "lmdb.h"
-#include "lz4.h"
-#include "lz4hc.h"
 #include "xxhash.h"
 
 #include <cstdio>
 #include <cstring>
 #include <cstdint>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <memory>
 #include <string>
+#include <tuple>
 
 inline int cabinet2rec(const std::string &ARGV0, const uint64_t &MEM, const std::string &CABINET, const std::string &REC, const int64_t START, const int64_t END, const bool &VERBOSE) {
   int32_t retCode{0};
@@ -65,12 +70,16 @@ inline int cabinet2rec(const std::string &ARGV0, const uint64_t &MEM, const std:
       mdb_env_close(env);
       return (retCode = 1);
     }
+    codec::Dictionaries dictionaries;
+    dictionaries.load(txn);
+    blobs::Reader blobReader(blobs::fileOf(CABINET));
     retCode = mdb_dbi_open(txn, "all", 0 , &dbi);
     if (MDB_NOTFOUND  == retCode) {
       std::clog << "[" << ARGV0 << "]: No database 'all' found in " << CABINET << "." << std::endl;
     }
     else {
-      mdb_set_compare(txn, dbi, &compareKeys);
+      const uint8_t LAYOUT{useKeyLayoutOf(txn, dbi)};
+      const bool CLUSTERED{clustered::isClustered(txn, dbi)};
 
       uint64_t numberOfEntries{0};
       MDB_stat stat;
@@ -79,8 +88,8 @@ inline int cabinet2rec(const std::string &ARGV0, const uint64_t &MEM, const std:
       }
       std::clog << "[" << ARGV0 << "]: Found " << numberOfEntries << " entries in database 'all' in " << CABINET << std::endl;
 
-      MDB_cursor *cursor;
-      if (!(retCode = mdb_cursor_open(txn, dbi, &cursor))) {
+      // The cursors are closed at the end of this scope before the transaction.
+      {
         uint64_t entries{0};
         int32_t oldPercentage{-1};
         MDB_val key;
@@ -93,81 +102,52 @@ inline int cabinet2rec(const std::string &ARGV0, const uint64_t &MEM, const std:
           endTimeStamp = END * 1000UL * 1000UL * 1000UL;
         }
 
-        if (startTimeStamp > 0) {
-          const uint64_t MAXKEYSIZE = 511;
-          std::vector<char> _key;
-          _key.reserve(MAXKEYSIZE);
-
-          cabinet::Key k;
-          k.timeStamp(startTimeStamp);
-
-          key.mv_size = setKey(k, _key.data(), _key.capacity());
-          key.mv_data = _key.data();
-          if (MDB_NOTFOUND != mdb_cursor_get(cursor, &key, &val, MDB_SET_RANGE)) {
-            std::clog << "[" << ARGV0 << "]: Positioned cursor successfully." << std::endl;
-          }
+        // Entries are read from where all Envelopes from the start time point on are found.
+        clustered::Entries storedEntries(txn, LAYOUT);
+        block::Cursor entriesFromStart(txn, dbi, clustered::tablesOf(txn), CLUSTERED, std::max<int64_t>(startTimeStamp, 0), LAYOUT);
+        if (entriesFromStart.isPositioned()) {
+          std::clog << "[" << ARGV0 << "]: Positioned cursor successfully." << std::endl;
         }
-
-        while ((retCode = mdb_cursor_get(cursor, &key, &val, MDB_NEXT_NODUP)) == 0) {
-          const char *ptr = static_cast<char*>(key.mv_data);
-          cabinet::Key storedKey = getKey(ptr, key.mv_size);
-
-          // If the size of the stored value is smaller than the original one, it has been compressed
-          if (storedKey.length() > val.mv_size) {
-            std::vector<char> decompressedValue;
-            decompressedValue.reserve(storedKey.length());
-            const ssize_t decompressedSize = LZ4_decompress_safe(static_cast<char*>(val.mv_data), decompressedValue.data(), val.mv_size, decompressedValue.capacity());
-            if (VERBOSE) {
-              XXH64_hash_t hashDecompressed = XXH64(decompressedValue.data(), decompressedSize, 0);
-              std::cout << storedKey.timeStamp() << ": " << storedKey.dataType() << "/" << storedKey.senderStamp() << ", hash from original value: 0x" << std::hex << storedKey.hash() << std::dec << ", hash from decompressed value: " << std::hex << "0x" << hashDecompressed << std::dec << ", match = " << (storedKey.hash() == hashDecompressed) << ", vs = " << val.mv_size << ", ds = " << decompressedSize << std::endl;
-            }
-            if (storedKey.timeStamp() > endTimeStamp) {
-              break;
-            }
-            recFile.write(decompressedValue.data(), storedKey.length());
+        uint64_t entriesRead{0};
+        auto next = [&entriesFromStart, &storedEntries, &key, &val, &entriesRead](MDB_val &k, MDB_val &v) {
+          const bool FOUND{entriesFromStart.next(key, val)};
+          if (FOUND) {
+            std::tie(k, v) = storedEntries.entryOf(key, val);
+            entriesRead++;
           }
-          else {
-            // Stored value is uncompressed.
-            recFile.write(static_cast<char*>(val.mv_data), val.mv_size);
+          return FOUND;
+        };
+
+        // Blocks are unpacked into single Envelopes in the order of their sampleTimeStamps.
+        block::Envelopes envelopes(next, &dictionaries, &blobReader);
+        int64_t timeStamp{0};
+        cluon::EnvelopeView envelope;
+        while (envelopes.next(timeStamp, envelope)) {
+          if (timeStamp > endTimeStamp) {
+            break;
           }
-          entries++;
-#if 0
-          char *ptr = static_cast<char*>(key.mv_data);
-          // b0-b7: int64_t for timeStamp in nanoseconds
-          uint16_t offset{sizeof(int64_t) /*field 1: timeStamp in nanoseconds*/};
-          // b8-b11: int32_t for dataType
-          offset += sizeof(int32_t);
-          // b12-b15: uint32_t for senderStamp
-          offset += sizeof(uint32_t);
-          // b16: uint8_t: version
-          uint8_t version{0};
-          offset += sizeof(uint8_t);
-          if (0 == version) {
-            // b17-b18: uint16_t: length of the in-key value
-            const uint16_t length = *(reinterpret_cast<uint16_t*>(ptr + offset));
-            offset += sizeof(uint16_t);
-            if (0 < length) {
-              // value if contained in the key
-              recFile.write(ptr + offset, length);
-            }
-            else {
-              // value is not stored in the key
-              recFile.write(static_cast<char*>(val.mv_data), val.mv_size);
-            }
-            entries++;
+          if ( (startTimeStamp > 0) && (timeStamp < startTimeStamp) ) {
+            continue;
           }
-#endif
+          if (VERBOSE) {
+            XXH64_hash_t hashDecompressed = XXH64(envelope.data(), envelope.size(), 0);
+            std::cout << timeStamp << ": " << envelope.dataType() << "/" << envelope.senderStamp() << ", hash from decompressed value: " << std::hex << "0x" << hashDecompressed << std::dec << ", ds = " << envelope.size() << std::endl;
+          }
+          recFile.write(envelope.data(), envelope.size());
+          entries++;
  
-          const int32_t percentage = static_cast<int32_t>(static_cast<float>(entries * 100.0f) / static_cast<float>(numberOfEntries));
+          const int32_t percentage = static_cast<int32_t>(static_cast<float>(entriesRead * 100.0f) / static_cast<float>(numberOfEntries));
           if ((percentage % 5 == 0) && (percentage != oldPercentage)) {
             std::clog << "[" << ARGV0 << "]: Processed " << percentage << "% (" << entries << " entries) from " << CABINET << "." << std::endl;
             oldPercentage = percentage;
             recFile.flush();
           }
         }
+        if (0 < envelopes.failed()) {
+          std::cerr << "[" << ARGV0 << "]: Could not decode " << envelopes.failed() << " values." << std::endl;
+        }
         recFile.flush();
         recFile.close();
-        mdb_cursor_close(cursor);
       }
     }
     mdb_txn_abort(txn);
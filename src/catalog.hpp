@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CATALOG_HPP
+#define CATALOG_HPP
+
+#include "key.hpp"
+#include "lmdb.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+/**
+ * Summary per stream of a cabinet, stored in the table "catalog" in format
+ * (all values are big Endian):
+ *
+ *    key:   int32_t dataType, uint32_t senderStamp
+ *    value: int64_t first, int64_t last, uint64_t count, uint64_t rawBytes,
+ *           uint64_t storedBytes, followed by (uint32_t hashOfRecFile,
+ *           uint64_t userData) per source
+ *
+ * first and last are the timeStamps in nanoseconds of the Envelopes, rawBytes
+ * are the bytes of the Envelopes, and storedBytes are the bytes after
+ * compression, either in the cabinet or in its blob file. The writers collect
+ * the changes and merge them into the table within the same write transaction
+ * as the Envelopes so that both are committed atomically.
+ */
+namespace catalog {
+
+constexpr std::size_t HEADER_SIZE{5 * sizeof(uint64_t)};
+constexpr std::size_t SOURCE_SIZE{sizeof(uint32_t) + sizeof(uint64_t)};
+
+struct Entry {
+  int64_t first{std::numeric_limits<int64_t>::max()};
+  int64_t last{std::numeric_limits<int64_t>::min()};
+  uint64_t count{0};
+  uint64_t rawBytes{0};
+  uint64_t storedBytes{0};
+  // Pairs of hashOfRecFile and userData.
+  std::set<std::pair<uint32_t, uint64_t>> sources{};
+
+  void merge(const Entry &other) {
+    first = std::min(first, other.first);
+    last = std::max(last, other.last);
+    count += other.count;
+    rawBytes += other.rawBytes;
+    storedBytes += other.storedBytes;
+    sources.insert(other.sources.begin(), other.sources.end());
+  }
+};
+
+/**
+ * @param src stored value
+ * @param len length of the stored value
+ * @param e entry to fill
+ * @return true if src is a valid entry
+ */
+inline bool decode(const char *src, const std::size_t &len, Entry &e) {
+  if ((HEADER_SIZE > len) || (0 != ((len - HEADER_SIZE) % SOURCE_SIZE))) {
+    return false;
+  }
+  e.first = readBigEndian<int64_t>(src);
+  e.last = readBigEndian<int64_t>(src + 8);
+  e.count = readBigEndian<uint64_t>(src + 16);
+  e.rawBytes = readBigEndian<uint64_t>(src + 24);
+  e.storedBytes = readBigEndian<uint64_t>(src + 32);
+  e.sources.clear();
+  for (std::size_t i{HEADER_SIZE}; i < len; i += SOURCE_SIZE) {
+    e.sources.emplace(readBigEndian<uint32_t>(src + i), readBigEndian<uint64_t>(src + i + 4));
+  }
+  return true;
+}
+
+inline void encode(const Entry &e, std::vector<char> &dst) {
+  dst.clear();
+  appendBigEndian(e.first, dst);
+  appendBigEndian(e.last, dst);
+  appendBigEndian(e.count, dst);
+  appendBigEndian(e.rawBytes, dst);
+  appendBigEndian(e.storedBytes, dst);
+  for (const auto &s : e.sources) {
+    appendBigEndian(s.first, dst);
+    appendBigEndian(s.second, dst);
+  }
+}
+
+/**
+ * The entries per stream as (dataType, senderStamp).
+ */
+class Catalog {
+ public:
+  using Stream = std::pair<int32_t, uint32_t>;
+
+  /**
+   * This method adds stored Envelopes of a stream to the changes.
+   *
+   * @param dataType
+   * @param senderStamp
+   * @param first timeStamp of the first Envelope in nanoseconds
+   * @param last timeStamp of the last Envelope in nanoseconds
+   * @param count number of Envelopes
+   * @param rawBytes bytes of the Envelopes
+   * @param storedBytes bytes of the Envelopes after compression
+   * @param hashOfRecFile source of the Envelopes
+   * @param userData user-supplied data of the Envelopes
+   */
+  void add(const int32_t &dataType, const uint32_t &senderStamp, const int64_t &first, const int64_t &last, const uint64_t &count, const uint64_t &rawBytes, const uint64_t &storedBytes, const uint32_t &hashOfRecFile, const uint64_t &userData) {
+    Entry &e = m_entries[std::make_pair(dataType, senderStamp)];
+    e.first = std::min(e.first, first);
+    e.last = std::max(e.last, last);
+    e.count += count;
+    e.rawBytes += rawBytes;
+    e.storedBytes += storedBytes;
+    e.sources.emplace(hashOfRecFile, userData);
+  }
+
+  /**
+   * This method merges the changes into the table "catalog" and clears them.
+   *
+   * @param txn write transaction
+   * @return MDB_SUCCESS or LMDB error code
+   */
+  int32_t store(MDB_txn *txn) {
+    if (m_entries.empty()) {
+      return MDB_SUCCESS;
+    }
+    MDB_dbi dbi{0};
+    int32_t rc = mdb_dbi_open(txn, "catalog", MDB_CREATE, &dbi);
+    std::vector<char> k;
+    std::vector<char> v;
+    for (auto it = m_entries.begin(); (MDB_SUCCESS == rc) && (m_entries.end() != it); it++) {
+      keyOf(it->first, k);
+      MDB_val key{k.size(), k.data()};
+      MDB_val value;
+      Entry e;
+      if ( (MDB_SUCCESS == mdb_get(txn, dbi, &key, &value))
+        && decode(static_cast<const char*>(value.mv_data), value.mv_size, e) ) {
+        e.merge(it->second);
+      }
+      else {
+        e = it->second;
+      }
+      encode(e, v);
+      value = MDB_val{v.size(), v.data()};
+      rc = mdb_put(txn, dbi, &key, &value, 0);
+    }
+    if (MDB_SUCCESS == rc) {
+      m_entries.clear();
+    }
+    return rc;
+  }
+
+  /**
+   * This method replaces the entries with the ones from the table "catalog".
+   *
+   * @param txn transaction to read from
+   * @return true if the table exists
+   */
+  bool load(MDB_txn *txn) {
+    m_entries.clear();
+    MDB_dbi dbi{0};
+    MDB_cursor *cursor{nullptr};
+    if ( (MDB_SUCCESS != mdb_dbi_open(txn, "catalog", 0, &dbi))
+      || (MDB_SUCCESS != mdb_cursor_open(txn, dbi, &cursor)) ) {
+      return false;
+    }
+    MDB_val key;
+    MDB_val value;
+    while (MDB_SUCCESS == mdb_cursor_get(cursor, &key, &value, MDB_NEXT)) {
+      Entry e;
+      if ( (2 * sizeof(uint32_t) == key.mv_size)
+        && decode(static_cast<const char*>(value.mv_data), value.mv_size, e) ) {
+        const char *ptr{static_cast<const char*>(key.mv_data)};
+        m_entries[std::make_pair(readBigEndian<int32_t>(ptr), readBigEndian<uint32_t>(ptr + 4))] = std::move(e);
+      }
+    }
+    mdb_cursor_close(cursor);
+    return true;
+  }
+
+  const std::map<Stream, Entry> &entries() const noexcept { return m_entries; }
+
+  void clear() noexcept { m_entries.clear(); }
+
+ private:
+  static void keyOf(const Stream &s, std::vector<char> &k) {
+    k.clear();
+    appendBigEndian(s.first, k);
+    appendBigEndian(s.second, k);
+  }
+
+ private:
+  std::map<Stream, Entry> m_entries{};
+};
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include "lmdb.h"
+
+#include <endian.h>
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Progress of importing a .rec file into a cabinet, stored in the table
+ * "checkpoints" in format (all values are big Endian):
+ *
+ *    key:   uint32_t hashOfRecFile
+ *    value: uint64_t offset, uint64_t envelopes, uint64_t fileSize
+ *
+ * The checkpoint is updated within the same write transaction as the
+ * Envelopes up to offset so that both are committed atomically.
+ */
+struct Checkpoint {
+  // Offset in the .rec file after the last Envelope that was committed.
+  uint64_t offset{0};
+  // Number of Envelopes read from the .rec file up to offset.
+  uint64_t envelopes{0};
+  // Size of the .rec file when the checkpoint was written.
+  uint64_t fileSize{0};
+
+  /**
+   * @param txn transaction to read from
+   * @param hashOfRecFile .rec file to read the checkpoint for
+   * @return true if a checkpoint was found
+   */
+  bool load(MDB_txn *txn, const uint32_t &hashOfRecFile) {
+    bool retVal{false};
+    MDB_dbi dbi{0};
+    if (MDB_SUCCESS == mdb_dbi_open(txn, "checkpoints", 0, &dbi)) {
+      const uint32_t k{htobe32(hashOfRecFile)};
+      MDB_val key{sizeof(k), const_cast<uint32_t*>(&k)};
+      MDB_val value;
+      if ((MDB_SUCCESS == mdb_get(txn, dbi, &key, &value)) && (3 * sizeof(uint64_t) == value.mv_size)) {
+        uint64_t v[3];
+        std::memcpy(v, value.mv_data, sizeof(v));
+        offset = be64toh(v[0]);
+        envelopes = be64toh(v[1]);
+        fileSize = be64toh(v[2]);
+        retVal = true;
+      }
+    }
+    return retVal;
+  }
+
+  /**
+   * @param txn write transaction to store the checkpoint in
+   * @param hashOfRecFile .rec file to store the checkpoint for
+   * @return MDB_SUCCESS or LMDB error code
+   */
+  int32_t store(MDB_txn *txn, const uint32_t &hashOfRecFile) const {
+    MDB_dbi dbi{0};
+    int32_t rc = mdb_dbi_open(txn, "checkpoints", MDB_CREATE, &dbi);
+    if (MDB_SUCCESS == rc) {
+      const uint32_t k{htobe32(hashOfRecFile)};
+      uint64_t v[3]{htobe64(offset), htobe64(envelopes), htobe64(fileSize)};
+      MDB_val key{sizeof(k), const_cast<uint32_t*>(&k)};
+      MDB_val value{sizeof(v), v};
+      rc = mdb_put(txn, dbi, &key, &value, 0);
+    }
+    return rc;
+  }
+
+  /**
+   * @return true if the .rec file was completely imported
+   */
+  bool isComplete() const {
+    return (0 < fileSize) && (offset == fileSize);
+  }
+};
+
+#endif
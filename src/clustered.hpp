@@ -0,0 +1,544 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CLUSTERED_HPP
+#define CLUSTERED_HPP
+
+#include "blobs.hpp"
+#include "catalog.hpp"
+#include "codec.hpp"
+#include "duplicate-filter.hpp"
+#include "key.hpp"
+#include "timeline.hpp"
+
+#include "lmdb.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * In a clustered cabinet, the tables "dataType/senderStamp" store the keys
+ * together with their values and "all" is a time-ordered index that stores
+ * only the fixed fields of the keys with empty values. Hence, the Envelopes
+ * of one stream can be read from its own table without touching the pages of
+ * other streams. Entries in "all" with neither a value nor an inline value
+ * refer to the entry with the same fixed fields in their stream table.
+ */
+namespace clustered {
+
+/**
+ * @param dataType dataType of the stream
+ * @param senderStamp senderStamp of the stream
+ * @return name of the table for the stream
+ */
+inline std::string tableOf(const int32_t &dataType, const uint32_t &senderStamp) {
+  return std::to_string(dataType) + "/" + std::to_string(senderStamp);
+}
+
+/**
+ * @param txn transaction to read from
+ * @return names of the tables "dataType/senderStamp"
+ */
+inline std::vector<std::string> tablesOf(MDB_txn *txn) noexcept {
+  std::vector<std::string> tables;
+  MDB_dbi dbMain{0};
+  MDB_cursor *cursor{nullptr};
+  if ( (MDB_SUCCESS == mdb_dbi_open(txn, nullptr, 0, &dbMain))
+    && (MDB_SUCCESS == mdb_cursor_open(txn, dbMain, &cursor)) ) {
+    MDB_val key;
+    while (MDB_SUCCESS == mdb_cursor_get(cursor, &key, nullptr, MDB_NEXT_NODUP)) {
+      const std::string table(static_cast<char*>(key.mv_data), key.mv_size);
+      if ( (std::string::npos != table.find('/'))
+        && (std::string::npos == table.find("-morton"))
+        && (std::string::npos == table.find("-hilbert"))
+        && (std::string::npos == table.find('\0')) ) {
+        tables.push_back(table);
+      }
+    }
+    mdb_cursor_close(cursor);
+  }
+  return tables;
+}
+
+/**
+ * This function detects from the first entry in "all" whether the values are
+ * stored in the tables per stream; all entries in a cabinet are stored alike.
+ *
+ * @param txn transaction to read from
+ * @param dbAll table "all"
+ * @param defaultClustered result for an empty table
+ * @return true if the values are stored in the tables per stream
+ */
+inline bool isClustered(MDB_txn *txn, const MDB_dbi &dbAll, const bool &defaultClustered = false) noexcept {
+  bool clustered{defaultClustered};
+  MDB_cursor *cursor{nullptr};
+  if (MDB_SUCCESS == mdb_cursor_open(txn, dbAll, &cursor)) {
+    // MDB_FIRST does not compare keys and works before setting a comparator.
+    MDB_val key;
+    MDB_val value;
+    if (MDB_SUCCESS == mdb_cursor_get(cursor, &key, &value, MDB_FIRST)) {
+      clustered = (0 == storedValueOf(key, value).mv_size);
+    }
+    mdb_cursor_close(cursor);
+  }
+  return clustered;
+}
+
+/**
+ * This class resolves the entries from "all" to the keys and values as they
+ * are stored, i.e., either the entry from "all" itself or the entry from its
+ * table per stream in a clustered cabinet.
+ */
+class Entries {
+ private:
+  Entries(const Entries &) = delete;
+  Entries(Entries &&)      = delete;
+  Entries &operator=(const Entries &) = delete;
+  Entries &operator=(Entries &&) = delete;
+
+ public:
+  /**
+   * @param txn transaction to read from
+   * @param layout layout of the keys in the cabinet
+   */
+  Entries(MDB_txn *txn, const uint8_t &layout) :
+    m_txn(txn),
+    m_layout(layout) {}
+
+  ~Entries() {
+    for (auto &c : m_cursors) {
+      if (nullptr != c.second) {
+        mdb_cursor_close(c.second);
+      }
+    }
+  }
+
+  /**
+   * @param key key from "all"
+   * @param value value from "all"
+   * @return key and value as stored; use storedValueOf to get the value to decode
+   */
+  std::pair<MDB_val, MDB_val> entryOf(const MDB_val &key, const MDB_val &value) {
+    if ( (0 < storedValueOf(key, value).mv_size) || (KEY_SIZE > key.mv_size) ) {
+      return std::make_pair(key, value);
+    }
+    const char *ptr{static_cast<const char*>(key.mv_data)};
+    MDB_cursor *cursor{cursorOf(tableOf(keyDataType(ptr), keySenderStamp(ptr)))};
+    if (nullptr != cursor) {
+      // The fixed fields in "all" are a prefix of the key in the stream table.
+      MDB_val k{key.mv_size, key.mv_data};
+      MDB_val v;
+      if ( (MDB_SUCCESS == mdb_cursor_get(cursor, &k, &v, MDB_SET_RANGE))
+        && (KEY_SIZE <= k.mv_size)
+        && (0 == std::memcmp(k.mv_data, key.mv_data, KEY_SIZE)) ) {
+        return std::make_pair(k, v);
+      }
+    }
+    return std::make_pair(key, MDB_val{0, nullptr});
+  }
+
+ private:
+  MDB_cursor *cursorOf(const std::string &table) {
+    auto it = m_cursors.find(table);
+    if (m_cursors.end() == it) {
+      MDB_cursor *cursor{nullptr};
+      MDB_dbi dbi{0};
+      if (MDB_SUCCESS == mdb_dbi_open(m_txn, table.c_str(), 0, &dbi)) {
+        setKeyCompare(m_txn, dbi, m_layout);
+        if (MDB_SUCCESS != mdb_cursor_open(m_txn, dbi, &cursor)) {
+          cursor = nullptr;
+        }
+      }
+      it = m_cursors.emplace(table, cursor).first;
+    }
+    return it->second;
+  }
+
+ private:
+  MDB_txn *m_txn{nullptr};
+  uint8_t m_layout{KEY_LAYOUT_COMPARE_KEYS};
+  std::map<std::string, MDB_cursor*> m_cursors{};
+};
+
+/**
+ * This class merges the entries of several tables per stream in the order of
+ * their keys to read only the pages of the selected streams.
+ */
+class Merge {
+ private:
+  Merge(const Merge &) = delete;
+  Merge(Merge &&)      = delete;
+  Merge &operator=(const Merge &) = delete;
+  Merge &operator=(Merge &&) = delete;
+
+ public:
+  /**
+   * @param txn transaction to read from
+   * @param tables names of the tables per stream; missing tables are skipped
+   * @param layout layout of the keys in the cabinet
+   * @param start first timeStamp in nanoseconds to return
+   */
+  Merge(MDB_txn *txn, const std::vector<std::string> &tables, const uint8_t &layout, const int64_t &start) :
+    m_txn(txn) {
+    for (auto table : tables) {
+      Head head;
+      if (MDB_SUCCESS != mdb_dbi_open(txn, table.c_str(), 0, &head.dbi)) {
+        continue;
+      }
+      setKeyCompare(txn, head.dbi, layout);
+      if (MDB_SUCCESS != mdb_cursor_open(txn, head.dbi, &head.cursor)) {
+        continue;
+      }
+      char prefix[sizeof(int64_t)];
+      head.key = MDB_val{setKeyPrefix(start, layout, prefix, sizeof(prefix)), prefix};
+      head.valid = (MDB_SUCCESS == mdb_cursor_get(head.cursor, &head.key, &head.value, MDB_SET_RANGE));
+      m_heads.push_back(head);
+    }
+  }
+
+  ~Merge() {
+    for (auto &h : m_heads) {
+      mdb_cursor_close(h.cursor);
+    }
+  }
+
+  /**
+   * @param key next key in the order of the keys
+   * @param value its value
+   * @return false if all tables are exhausted
+   */
+  bool next(MDB_val &key, MDB_val &value) noexcept {
+    Head *smallest{nullptr};
+    for (auto &h : m_heads) {
+      if (h.valid && ((nullptr == smallest) || (0 > mdb_cmp(m_txn, h.dbi, &h.key, &smallest->key)))) {
+        smallest = &h;
+      }
+    }
+    if (nullptr == smallest) {
+      return false;
+    }
+    key = smallest->key;
+    value = smallest->value;
+    smallest->valid = (MDB_SUCCESS == mdb_cursor_get(smallest->cursor, &smallest->key, &smallest->value, MDB_NEXT));
+    return true;
+  }
+
+ private:
+  struct Head {
+    MDB_dbi dbi{0};
+    MDB_cursor *cursor{nullptr};
+    MDB_val key{0, nullptr};
+    MDB_val value{0, nullptr};
+    bool valid{false};
+  };
+
+  MDB_txn *m_txn{nullptr};
+  std::vector<Head> m_heads{};
+};
+
+/**
+ * This class stores the entries of an import in "all" and in their tables
+ * "dataType/senderStamp", clustered or not, and summarizes them in "catalog"
+ * and "timeline". A value is stored in the blob file, inline in its key, or
+ * as value of its key. Keys beyond the last key of a table are appended with
+ * MDB_APPEND; LMDB then fills the pages completely instead of splitting them.
+ * Failures of the blob file throw std::runtime_error (cf. blobs::Writer).
+ */
+class Store {
+ private:
+  Store(const Store &) = delete;
+  Store(Store &&)      = delete;
+  Store &operator=(const Store &) = delete;
+  Store &operator=(Store &&) = delete;
+
+ public:
+  /**
+   * @param blobFile blob file of the cabinet
+   * @param KEY_LAYOUT layout of the keys for a new cabinet; an existing cabinet keeps its layout
+   * @param CLUSTERED store the values in the tables "dataType/senderStamp" for a new cabinet; an existing cabinet keeps its choice
+   * @param MAX_INLINE_VALUE store values of up to this many bytes after compression inline in their key in "all" (0 = never)
+   * @param BLOB_SIZE store values of at least this many bytes after compression in the blob file (0 = never)
+   * @param filter filter with the xxhashes of the keys in "all" to skip duplicated Envelopes or nullptr
+   */
+  Store(const std::string &blobFile, const uint8_t &KEY_LAYOUT, const bool &CLUSTERED, const uint16_t &MAX_INLINE_VALUE = 0, const std::size_t &BLOB_SIZE = 0, DuplicateFilter *filter = nullptr) :
+    m_blobWriter(blobFile, BLOB_SIZE),
+    m_layout(KEY_LAYOUT),
+    m_isClustered(CLUSTERED),
+    m_maxInlineValue(std::min<std::size_t>(MAX_INLINE_VALUE, KEY_MAX_INLINE_VALUE)),
+    m_filter(filter) {
+    m_key.reserve(KEY_SIZE + KEY_MAX_INLINE_VALUE);
+  }
+
+  /**
+   * This method must be called after beginning a write transaction; the
+   * first call opens "all" and determines the layout and whether the cabinet
+   * is clustered.
+   *
+   * @param txn write transaction
+   * @return MDB_SUCCESS or the error from LMDB
+   */
+  int32_t begin(MDB_txn *txn) {
+    if (!m_isOpen) {
+      const int32_t rc{mdb_dbi_open(txn, "all", MDB_CREATE, &m_dbAll)};
+      if (MDB_SUCCESS != rc) {
+        return rc;
+      }
+      m_layout = keyLayoutOf(txn, m_dbAll, m_layout);
+      setKeyCompare(txn, m_dbAll, m_layout);
+      m_isClustered = clustered::isClustered(txn, m_dbAll, m_isClustered);
+      m_isOpen = true;
+    }
+    // Other processes might have stored later keys since the previous
+    // transaction; MDB_APPEND would then fail with MDB_KEYEXIST.
+    int32_t rc{lastKeyOf(txn, m_dbAll, m_lastKeyInAll)};
+    for (auto it = m_streams.begin(); (MDB_SUCCESS == rc) && (m_streams.end() != it); it++) {
+      rc = lastKeyOf(txn, it->second.dbi, it->second.lastKey);
+    }
+    // They might also have appended values to the blob file.
+    m_blobWriter.begin();
+    return rc;
+  }
+
+  /**
+   * This method stores an entry unless it is stored already.
+   *
+   * @param txn write transaction
+   * @param k key with the codec that was applied to the value
+   * @param value value as it is to be stored
+   * @param length length of the value
+   * @param rawBytes length of the Envelopes before compression
+   * @param keepInline store the value inline regardless of its length, e.g., when it was inline before
+   * @return MDB_SUCCESS, MDB_KEYEXIST for a duplicate, or the error from LMDB
+   */
+  int32_t put(MDB_txn *txn, cabinet::Key k, const char *value, std::size_t length, const uint64_t &rawBytes, const bool &keepInline = false) {
+    // Skip Envelopes that are already stored; the table is only looked up
+    // if the Envelope might be stored.
+    if (nullptr != m_filter) {
+      if (!m_filter->mightContain(k.hash())) {
+        m_lookupsSaved++;
+      }
+      else if (DuplicateFilter::isStored(txn, m_dbAll, k.timeStamp(), k.hash(), m_layout)) {
+        return MDB_KEYEXIST;
+      }
+    }
+    // Without a filter, only KEY_LAYOUT_MEMCMP needs the lookup as its keys
+    // of the same Envelope can differ after the xxhash (cf. key.hpp); keys
+    // after the last timeStamp in "all" cannot be stored yet.
+    else if ( (KEY_LAYOUT_MEMCMP == m_layout)
+           && (0 == (k.version() & KEY_BLOCK))
+           && !m_lastKeyInAll.empty()
+           && (k.timeStamp() <= keyTimeStamp(m_lastKeyInAll.data()))
+           && DuplicateFilter::isStored(txn, m_dbAll, k.timeStamp(), k.hash(), m_layout) ) {
+      return MDB_KEYEXIST;
+    }
+
+    const uint64_t STORED_BYTES{length};
+    blobs::Reference blob;
+    const bool IN_BLOB_FILE{!keepInline && m_blobWriter.accepts(length)};
+    if (IN_BLOB_FILE) {
+      blob = m_blobWriter.append(codec::codecOf(k), value, length, m_reference);
+      value = m_reference.data();
+      length = m_reference.size();
+      // Replace only the codec to keep the flag of a block.
+      k.version(static_cast<uint8_t>((k.version() & 0x0F) | (codec::BLOB << 4)));
+    }
+
+    // Small values are stored inline after the fields of the key.
+    const bool INLINE{keepInline || ((0 < length) && (length <= m_maxInlineValue))};
+    MDB_val key;
+    key.mv_size = INLINE ? setKey(k, value, length, m_key.data(), m_key.capacity()) : setKey(k, m_key.data(), m_key.capacity());
+    key.mv_data = m_key.data();
+    MDB_val val{INLINE ? 0 : length, INLINE ? nullptr : const_cast<char*>(value)};
+
+    // A clustered cabinet stores only the fixed fields of the key in "all".
+    MDB_val keyInAll{m_isClustered ? fixedFieldsOf(key) : key};
+    MDB_val valueInAll{m_isClustered ? MDB_val{0, nullptr} : val};
+    const bool APPEND{isAfter(txn, m_dbAll, keyInAll, m_lastKeyInAll)};
+    int32_t rc{mdb_put(txn, m_dbAll, &keyInAll, &valueInAll, APPEND ? MDB_APPEND : MDB_NOOVERWRITE)};
+    if (MDB_SUCCESS != rc) {
+      // MDB_KEYEXIST: The same Envelope was stored before.
+      if (IN_BLOB_FILE) {
+        m_blobWriter.discard(blob);
+      }
+      return rc;
+    }
+    if (APPEND) {
+      m_lastKeyInAll.assign(m_key.data(), m_key.data() + keyInAll.mv_size);
+      m_appended++;
+    }
+    else {
+      m_inserted++;
+    }
+
+    // A clustered cabinet stores the values with the keys per stream.
+    Table *stream{nullptr};
+    if (MDB_SUCCESS != (rc = streamOf(txn, k, stream))) {
+      return rc;
+    }
+    MDB_val keyInStream{m_isClustered ? key : fixedFieldsOf(key)};
+    MDB_val valueInStream{m_isClustered ? val : MDB_val{0, nullptr}};
+    const bool APPEND_TO_STREAM{isAfter(txn, stream->dbi, keyInStream, stream->lastKey)};
+    if (MDB_SUCCESS != (rc = mdb_put(txn, stream->dbi, &keyInStream, &valueInStream, APPEND_TO_STREAM ? MDB_APPEND : 0))) {
+      return rc;
+    }
+    if (APPEND_TO_STREAM) {
+      stream->lastKey.assign(m_key.data(), m_key.data() + keyInStream.mv_size);
+    }
+
+    // Blocks use the field hashOfRecFile for their number of Envelopes; the
+    // caller adds the Envelopes of a block to the timeline.
+    const char *ptr{m_key.data()};
+    m_catalog.add(k.dataType(), k.senderStamp(), k.timeStamp(), keyBlockLastTimeStamp(ptr), keyBlockCount(ptr), rawBytes, STORED_BYTES, keyIsBlock(ptr) ? 0 : k.hashOfRecFile(), k.userData());
+    if (!keyIsBlock(ptr)) {
+      m_timeline.add(k.dataType(), k.senderStamp(), k.timeStamp(), rawBytes);
+    }
+    if (nullptr != m_filter) {
+      m_filter->insert(k.hash());
+    }
+    m_valuesInBlobFile += IN_BLOB_FILE ? 1 : 0;
+    return MDB_SUCCESS;
+  }
+
+  /**
+   * This method must be called before committing the write transaction.
+   *
+   * @param txn write transaction
+   * @return MDB_SUCCESS, EIO if the blob file could not be written, or the error from LMDB
+   */
+  int32_t flush(MDB_txn *txn) {
+    // The values in the blob file must be on disk before their references.
+    if (!m_blobWriter.sync()) {
+      return EIO;
+    }
+    const int32_t rc{m_catalog.store(txn)};
+    return (MDB_SUCCESS == rc) ? m_timeline.store(txn) : rc;
+  }
+
+  /**
+   * @return true after the first call to begin
+   */
+  bool isOpen() const noexcept { return m_isOpen; }
+
+  /**
+   * @return layout of the keys in the cabinet
+   */
+  uint8_t layout() const noexcept { return m_layout; }
+
+  /**
+   * @return true if the values are stored in the tables per stream
+   */
+  bool isClustered() const noexcept { return m_isClustered; }
+
+  /**
+   * @return table "all"
+   */
+  MDB_dbi all() const noexcept { return m_dbAll; }
+
+  /**
+   * @return Envelopes per stream and minute that are not yet merged into "timeline"
+   */
+  timeline::Timeline &timeline() noexcept { return m_timeline; }
+
+  /**
+   * @return number of keys appended to "all"
+   */
+  uint64_t appended() const noexcept { return m_appended; }
+
+  /**
+   * @return number of keys inserted into "all" before its last key
+   */
+  uint64_t inserted() const noexcept { return m_inserted; }
+
+  /**
+   * @return number of lookups in "all" that the duplicate filter avoided
+   */
+  uint64_t lookupsSaved() const noexcept { return m_lookupsSaved; }
+
+  /**
+   * @return number of values stored in the blob file
+   */
+  uint64_t valuesInBlobFile() const noexcept { return m_valuesInBlobFile; }
+
+  /**
+   * @return size of the blob file in bytes
+   */
+  uint64_t bytesInBlobFile() const noexcept { return m_blobWriter.size(); }
+
+ private:
+  struct Table {
+    MDB_dbi dbi{0};
+    std::vector<char> lastKey{};
+  };
+
+  int32_t streamOf(MDB_txn *txn, const cabinet::Key &k, Table *&stream) {
+    const std::string table{tableOf(k.dataType(), k.senderStamp())};
+    auto it = m_streams.find(table);
+    if (m_streams.end() == it) {
+      Table t;
+      int32_t rc{mdb_dbi_open(txn, table.c_str(), MDB_CREATE, &t.dbi)};
+      if ( (MDB_SUCCESS != rc)
+        || (MDB_SUCCESS != (rc = setKeyCompare(txn, t.dbi, m_layout)))
+        || (MDB_SUCCESS != (rc = lastKeyOf(txn, t.dbi, t.lastKey))) ) {
+        return rc;
+      }
+      it = m_streams.emplace(table, std::move(t)).first;
+    }
+    stream = &it->second;
+    return MDB_SUCCESS;
+  }
+
+  static int32_t lastKeyOf(MDB_txn *txn, const MDB_dbi &dbi, std::vector<char> &lastKey) {
+    lastKey.clear();
+    MDB_cursor *cursor{nullptr};
+    int32_t rc{mdb_cursor_open(txn, dbi, &cursor)};
+    if (MDB_SUCCESS == rc) {
+      MDB_val key;
+      MDB_val value;
+      rc = mdb_cursor_get(cursor, &key, &value, MDB_LAST);
+      if (MDB_SUCCESS == rc) {
+        lastKey.assign(static_cast<char*>(key.mv_data), static_cast<char*>(key.mv_data) + key.mv_size);
+      }
+      mdb_cursor_close(cursor);
+    }
+    return (MDB_NOTFOUND == rc) ? MDB_SUCCESS : rc;
+  }
+
+  static bool isAfter(MDB_txn *txn, const MDB_dbi &dbi, const MDB_val &key, const std::vector<char> &lastKey) noexcept {
+    MDB_val last{lastKey.size(), const_cast<char*>(lastKey.data())};
+    return lastKey.empty() || (0 < mdb_cmp(txn, dbi, &key, &last));
+  }
+
+ private:
+  blobs::Writer m_blobWriter;
+  std::vector<char> m_reference{};
+  catalog::Catalog m_catalog{};
+  timeline::Timeline m_timeline{};
+  uint8_t m_layout{KEY_LAYOUT_COMPARE_KEYS};
+  bool m_isClustered{false};
+  std::size_t m_maxInlineValue{0};
+  DuplicateFilter *m_filter{nullptr};
+  bool m_isOpen{false};
+  MDB_dbi m_dbAll{0};
+  std::vector<char> m_key{};
+  std::vector<char> m_lastKeyInAll{};
+  std::map<std::string, Table> m_streams{};
+  uint64_t m_appended{0};
+  uint64_t m_inserted{0};
+  uint64_t m_lookupsSaved{0};
+  uint64_t m_valuesInBlobFile{0};
+};
+
+} // clustered
+#endif
@@ -0,0 +1,809 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CODEC_HPP
+#define CODEC_HPP
+
+#include "blobs.hpp"
+#include "db.hpp"
+#include "key.hpp"
+#include "lmdb.h"
+
+// The vendored lz4 is linked statically; allows to reuse compression states.
+#define LZ4_STATIC_LINKING_ONLY
+#define LZ4_HC_STATIC_LINKING_ONLY
+#include "lz4.h"
+#include "lz4hc.h"
+#ifdef HAVE_ZSTD
+  #include "zstd.h"
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Codecs to compress the values stored in a cabinet.
+ *
+ * The codec that was used for a value is recorded in the upper four bits of
+ * cabinet::Key.version; bits 0-1 hold the key layout (KEY_LAYOUT_MASK), bit 2
+ * marks a block of Envelopes (KEY_BLOCK), and bit 3 marks a value stored
+ * inline in its key (KEY_INLINE_VALUE, cf. key.hpp). Keys written before codecs were recorded have codec LEGACY, for
+ * which a value is LZ4-compressed iff the Key's length is larger than the
+ * stored value.
+ *
+ * Values compressed with LZ4 or LZ4HC start with the length of the
+ * uncompressed value as varint followed by the LZ4 block; values compressed
+ * with a dictionary start with the id of the dictionary as varint before
+ * that length. The dictionaries are stored in the table "dictionaries" of
+ * the same cabinet.
+ *
+ * Values with codec BLOB are references into the blob file of the cabinet,
+ * which hold the codec that was applied to the bytes in the blob file.
+ */
+namespace codec {
+
+enum Codec : uint8_t {
+  LEGACY = 0,
+  NONE   = 1,
+  LZ4    = 2, // level: acceleration of LZ4_compress_fast
+  LZ4HC  = 3, // level: LZ4HC_CLEVEL_MIN..LZ4HC_CLEVEL_MAX
+  ZSTD   = 4, // level: 1..ZSTD_maxCLevel(); only if built with libzstd
+  LZ4_DICT   = 5, // LZ4 with a dictionary trained per stream
+  LZ4HC_DICT = 6, // LZ4HC with a dictionary trained per stream
+  BLOB       = 7, // reference into the blob file of the cabinet, cf. blobs.hpp
+};
+
+/**
+ * @param c codec
+ * @return true if c compresses with a dictionary
+ */
+inline bool usesDictionary(const uint8_t &c) noexcept {
+  return (LZ4_DICT == c) || (LZ4HC_DICT == c);
+}
+
+/**
+ * A codec together with its compression level.
+ */
+struct Config {
+  uint8_t codec{LZ4HC};
+  int32_t level{LZ4HC_CLEVEL_MAX};
+};
+
+/**
+ * @param k Key
+ * @return codec of the value stored with k
+ */
+inline uint8_t codecOf(const cabinet::Key &k) noexcept {
+  return static_cast<uint8_t>(k.version() >> 4);
+}
+
+/**
+ * @param k Key
+ * @return version of the key layout without codec and flags
+ */
+inline uint8_t layoutOf(const cabinet::Key &k) noexcept {
+  return static_cast<uint8_t>(k.version() & KEY_LAYOUT_MASK);
+}
+
+/**
+ * @param layout version of the key layout
+ * @param c codec
+ * @return value for cabinet::Key.version
+ */
+inline uint8_t version(const uint8_t &layout, const uint8_t &c) noexcept {
+  return static_cast<uint8_t>(((c & 0x0F) << 4) | (layout & KEY_LAYOUT_MASK));
+}
+
+/**
+ * @param c codec
+ * @return true if c can be used with this build
+ */
+inline bool isAvailable(const uint8_t &c) noexcept {
+#ifdef HAVE_ZSTD
+  return (c <= LZ4HC_DICT);
+#else
+  return (c <= LZ4HC_DICT) && (ZSTD != c);
+#endif
+}
+
+inline std::string name(const uint8_t &c) {
+  switch (c) {
+    case LEGACY: return "legacy";
+    case NONE:   return "none";
+    case LZ4:    return "lz4";
+    case LZ4HC:  return "lz4hc";
+    case ZSTD:   return "zstd";
+    case LZ4_DICT:   return "lz4dict";
+    case LZ4HC_DICT: return "lz4hcdict";
+    case BLOB:       return "blob";
+    default:     return "unknown";
+  }
+}
+
+inline std::string toString(const Config &c) {
+  return ((NONE == c.codec) ? name(c.codec) : name(c.codec) + ":" + std::to_string(c.level));
+}
+
+/**
+ * This function parses a codec in format name[:level], i.e., none, lz4[:acceleration],
+ * lz4hc[:level], zstd[:level], lz4dict[:acceleration], or lz4hcdict[:level].
+ *
+ * @param spec codec to parse
+ * @param c parsed codec
+ * @return true if spec describes an available codec
+ */
+inline bool parse(const std::string &spec, Config &c) {
+  const std::size_t colon{spec.find(':')};
+  const std::string NAME{spec.substr(0, colon)};
+  int32_t level{0};
+  if (std::string::npos != colon) {
+    try {
+      level = std::stoi(spec.substr(colon + 1));
+    }
+    catch (...) {
+      return false;
+    }
+  }
+
+  Config tmp;
+  if ("none" == NAME) {
+    tmp.codec = NONE;
+    tmp.level = 0;
+  }
+  else if ("lz4" == NAME) {
+    tmp.codec = LZ4;
+    tmp.level = (std::string::npos != colon) ? level : 1;
+  }
+  else if ("lz4hc" == NAME) {
+    tmp.codec = LZ4HC;
+    tmp.level = (std::string::npos != colon) ? level : LZ4HC_CLEVEL_MAX;
+  }
+  else if ("lz4dict" == NAME) {
+    tmp.codec = LZ4_DICT;
+    tmp.level = (std::string::npos != colon) ? level : 1;
+  }
+  else if ("lz4hcdict" == NAME) {
+    tmp.codec = LZ4HC_DICT;
+    tmp.level = (std::string::npos != colon) ? level : LZ4HC_CLEVEL_MAX;
+  }
+  else if ("zstd" == NAME) {
+    tmp.codec = ZSTD;
+    tmp.level = (std::string::npos != colon) ? level : 3;
+  }
+  else {
+    return false;
+  }
+  if (!isAvailable(tmp.codec)) {
+    return false;
+  }
+  c = tmp;
+  return true;
+}
+
+/**
+ * Codecs selected per dataType with a fallback for all other dataTypes.
+ */
+struct Selection {
+  Config defaultConfig{};
+  std::map<int32_t, Config> perDataType{};
+
+  const Config &select(const int32_t &dataType) const noexcept {
+    auto it = perDataType.find(dataType);
+    return (perDataType.end() != it) ? it->second : defaultConfig;
+  }
+};
+
+/**
+ * This function parses a comma-separated list of codecs, in which an entry
+ * either sets the default codec (codec) or the codec for one dataType
+ * (dataType=codec), e.g., lz4,1055=none,19=zstd:19.
+ *
+ * @param spec list of codecs to parse
+ * @param s parsed selection
+ * @return true if all entries describe available codecs
+ */
+inline bool parse(const std::string &spec, Selection &s) {
+  Selection tmp{s};
+  std::stringstream sstr{spec};
+  for (std::string entry; std::getline(sstr, entry, ',');) {
+    if (entry.empty()) {
+      continue;
+    }
+    Config c;
+    const std::size_t equal{entry.find('=')};
+    if (std::string::npos == equal) {
+      if (!parse(entry, c)) {
+        return false;
+      }
+      tmp.defaultConfig = c;
+    }
+    else {
+      int32_t dataType{0};
+      try {
+        dataType = std::stoi(entry.substr(0, equal));
+      }
+      catch (...) {
+        return false;
+      }
+      if (!parse(entry.substr(equal + 1), c)) {
+        return false;
+      }
+      tmp.perDataType[dataType] = c;
+    }
+  }
+  s = tmp;
+  return true;
+}
+
+/**
+ * A dictionary for the values of one stream (dataType/senderStamp) together
+ * with the LZ4 and LZ4HC streams into which it is loaded once so that it can
+ * be attached to the compression of each value cheaply.
+ */
+class Dictionary {
+ private:
+  Dictionary(const Dictionary &) = delete;
+  Dictionary(Dictionary &&)      = delete;
+  Dictionary &operator=(const Dictionary &) = delete;
+  Dictionary &operator=(Dictionary &&) = delete;
+
+ public:
+  Dictionary(const uint32_t &id, const int32_t &dataType, const uint32_t &senderStamp, std::string &&bytes) :
+    m_id(id),
+    m_dataType(dataType),
+    m_senderStamp(senderStamp),
+    m_bytes(std::move(bytes)),
+    m_fast(LZ4_createStream()),
+    m_hc(LZ4_createStreamHC()) {
+    LZ4_loadDict(m_fast, m_bytes.data(), static_cast<int>(m_bytes.size()));
+    LZ4_loadDictHC(m_hc, m_bytes.data(), static_cast<int>(m_bytes.size()));
+  }
+
+  ~Dictionary() {
+    LZ4_freeStream(m_fast);
+    LZ4_freeStreamHC(m_hc);
+  }
+
+  uint32_t id() const noexcept { return m_id; }
+  int32_t dataType() const noexcept { return m_dataType; }
+  uint32_t senderStamp() const noexcept { return m_senderStamp; }
+  const std::string &bytes() const noexcept { return m_bytes; }
+  const LZ4_stream_t *fast() const noexcept { return m_fast; }
+  const LZ4_streamHC_t *hc() const noexcept { return m_hc; }
+
+ private:
+  uint32_t m_id{0};
+  int32_t m_dataType{0};
+  uint32_t m_senderStamp{0};
+  std::string m_bytes{};
+  LZ4_stream_t *m_fast{nullptr};
+  LZ4_streamHC_t *m_hc{nullptr};
+};
+
+/**
+ * All dictionaries of a cabinet. In the table "dictionaries", the key is the
+ * id as big endian uint32_t and the value consists of dataType (int32_t) and
+ * senderStamp (uint32_t) in big endian followed by the dictionary.
+ */
+class Dictionaries {
+ public:
+  /**
+   * This method loads all dictionaries from the table "dictionaries".
+   *
+   * @param txn transaction to read from
+   * @return true if the table exists or does not exist; false on errors
+   */
+  bool load(MDB_txn *txn) {
+    MDB_dbi dbi{0};
+    int32_t rc = mdb_dbi_open(txn, "dictionaries", 0, &dbi);
+    if (MDB_NOTFOUND == rc) {
+      return true;
+    }
+    MDB_cursor *cursor{nullptr};
+    if ( (MDB_SUCCESS != rc) || (MDB_SUCCESS != mdb_cursor_open(txn, dbi, &cursor)) ) {
+      return false;
+    }
+    MDB_val key;
+    MDB_val value;
+    while (MDB_SUCCESS == mdb_cursor_get(cursor, &key, &value, MDB_NEXT)) {
+      if ( (sizeof(uint32_t) != key.mv_size) || (sizeof(int32_t) + sizeof(uint32_t) > value.mv_size) ) {
+        continue;
+      }
+      uint32_t id{0};
+      int32_t dataType{0};
+      uint32_t senderStamp{0};
+      const char *ptr{static_cast<const char*>(value.mv_data)};
+      std::memcpy(&id, key.mv_data, sizeof(id));
+      std::memcpy(&dataType, ptr, sizeof(dataType));
+      std::memcpy(&senderStamp, ptr + sizeof(dataType), sizeof(senderStamp));
+      std::string bytes(ptr + sizeof(dataType) + sizeof(senderStamp), value.mv_size - sizeof(dataType) - sizeof(senderStamp));
+      add(be32toh(id), static_cast<int32_t>(be32toh(static_cast<uint32_t>(dataType))), be32toh(senderStamp), std::move(bytes));
+    }
+    mdb_cursor_close(cursor);
+    return true;
+  }
+
+  /**
+   * This method stores a dictionary with its id in the table "dictionaries".
+   *
+   * @param txn write transaction
+   * @param d dictionary to store
+   * @return MDB_SUCCESS if stored or if the same dictionary is stored with
+   *         this id already, MDB_KEYEXIST if another dictionary has this id,
+   *         or the lmdb error code
+   */
+  static int32_t store(MDB_txn *txn, const Dictionary &d) {
+    MDB_dbi dbi{0};
+    int32_t rc = mdb_dbi_open(txn, "dictionaries", MDB_CREATE, &dbi);
+    if (MDB_SUCCESS == rc) {
+      const uint32_t id{htobe32(d.id())};
+      const std::string v{valueOf(d)};
+      MDB_val key{sizeof(id), const_cast<uint32_t*>(&id)};
+      MDB_val value{v.size(), const_cast<char*>(v.data())};
+      rc = mdb_put(txn, dbi, &key, &value, MDB_NOOVERWRITE);
+      if ( (MDB_KEYEXIST == rc) && (value.mv_size == v.size()) && (0 == std::memcmp(value.mv_data, v.data(), v.size())) ) {
+        rc = MDB_SUCCESS;
+      }
+    }
+    return rc;
+  }
+
+  /**
+   * This method stores a dictionary under the next free id of the table
+   * "dictionaries": The id is determined within the write transaction as
+   * other processes might have added dictionaries since they were loaded.
+   *
+   * @param txn write transaction
+   * @param d dictionary to store; its id is ignored
+   * @param id id under which the dictionary was stored
+   * @return MDB_SUCCESS or the lmdb error code
+   */
+  static int32_t store(MDB_txn *txn, const Dictionary &d, uint32_t &id) {
+    MDB_dbi dbi{0};
+    int32_t rc = mdb_dbi_open(txn, "dictionaries", MDB_CREATE, &dbi);
+    MDB_cursor *cursor{nullptr};
+    if ( (MDB_SUCCESS == rc) && (MDB_SUCCESS == (rc = mdb_cursor_open(txn, dbi, &cursor))) ) {
+      MDB_val key;
+      MDB_val value;
+      id = 1;
+      rc = mdb_cursor_get(cursor, &key, &value, MDB_LAST);
+      if ( (MDB_SUCCESS == rc) && (sizeof(uint32_t) == key.mv_size) ) {
+        uint32_t last{0};
+        std::memcpy(&last, key.mv_data, sizeof(last));
+        id = be32toh(last) + 1;
+      }
+      mdb_cursor_close(cursor);
+      if ( (MDB_SUCCESS == rc) || (MDB_NOTFOUND == rc) ) {
+        const uint32_t k{htobe32(id)};
+        const std::string v{valueOf(d)};
+        key = MDB_val{sizeof(k), const_cast<uint32_t*>(&k)};
+        value = MDB_val{v.size(), const_cast<char*>(v.data())};
+        rc = mdb_put(txn, dbi, &key, &value, MDB_NOOVERWRITE);
+      }
+    }
+    return rc;
+  }
+
+  /**
+   * This method adds a dictionary; it is the latest one for its stream.
+   *
+   * @param id id of the dictionary; 0 to use the next id after the loaded and
+   *        added ones, which might be taken in the cabinet when the dictionary
+   *        is stored (cf. DictionaryIds)
+   * @return added dictionary
+   */
+  std::shared_ptr<const Dictionary> add(uint32_t id, const int32_t &dataType, const uint32_t &senderStamp, std::string &&bytes) {
+    id = (0 == id) ? m_nextId : id;
+    m_nextId = std::max(m_nextId, id + 1);
+    auto d = std::make_shared<const Dictionary>(id, dataType, senderStamp, std::move(bytes));
+    m_byId[id] = d;
+    m_latest[std::make_pair(dataType, senderStamp)] = d;
+    return d;
+  }
+
+  std::shared_ptr<const Dictionary> byId(const uint32_t &id) const {
+    auto it = m_byId.find(id);
+    return (m_byId.end() != it) ? it->second : nullptr;
+  }
+
+  std::shared_ptr<const Dictionary> latest(const int32_t &dataType, const uint32_t &senderStamp) const {
+    auto it = m_latest.find(std::make_pair(dataType, senderStamp));
+    return (m_latest.end() != it) ? it->second : nullptr;
+  }
+
+  std::vector<uint32_t> ids() const {
+    std::vector<uint32_t> ids;
+    for (auto &e : m_byId) {
+      ids.push_back(e.first);
+    }
+    return ids;
+  }
+
+  std::size_t size() const noexcept { return m_byId.size(); }
+
+ private:
+  /**
+   * @param d dictionary
+   * @return value in the table "dictionaries" for d
+   */
+  static std::string valueOf(const Dictionary &d) {
+    const int32_t dataType{static_cast<int32_t>(htobe32(static_cast<uint32_t>(d.dataType())))};
+    const uint32_t senderStamp{htobe32(d.senderStamp())};
+    std::string v(sizeof(dataType) + sizeof(senderStamp), '\0');
+    std::memcpy(&v[0], &dataType, sizeof(dataType));
+    std::memcpy(&v[sizeof(dataType)], &senderStamp, sizeof(senderStamp));
+    v += d.bytes();
+    return v;
+  }
+
+  uint32_t m_nextId{1};
+  std::map<uint32_t, std::shared_ptr<const Dictionary>> m_byId{};
+  std::map<std::pair<int32_t, uint32_t>, std::shared_ptr<const Dictionary>> m_latest{};
+};
+
+/**
+ * Trains a dictionary per stream from the first values of that stream: The
+ * distinct sampled values are concatenated, keeping the latest DICTIONARY_SIZE
+ * bytes as LZ4 can only refer to the last 64KB. Streams with a dictionary
+ * already in the cabinet reuse their latest dictionary.
+ */
+class DictionaryTrainer {
+ private:
+  DictionaryTrainer(const DictionaryTrainer &) = delete;
+  DictionaryTrainer(DictionaryTrainer &&)      = delete;
+  DictionaryTrainer &operator=(const DictionaryTrainer &) = delete;
+  DictionaryTrainer &operator=(DictionaryTrainer &&) = delete;
+
+ public:
+  explicit DictionaryTrainer(Dictionaries &dictionaries, const std::size_t &DICTIONARY_SIZE = 16 * 1024, const uint32_t &SAMPLES = 256) :
+    m_dictionaries(dictionaries),
+    m_dictionarySize(std::min<std::size_t>(DICTIONARY_SIZE, 64 * 1024)),
+    m_samples(SAMPLES) {}
+
+  /**
+   * @param dataType
+   * @param senderStamp
+   * @param value value of this stream to sample
+   * @param len length of the value
+   * @return dictionary for this stream or nullptr while still sampling
+   */
+  std::shared_ptr<const Dictionary> sample(const int32_t &dataType, const uint32_t &senderStamp, const char *value, const std::size_t &len) {
+    auto d = m_dictionaries.latest(dataType, senderStamp);
+    if (nullptr != d) {
+      return d;
+    }
+    auto &samples = m_samplesPerStream[std::make_pair(dataType, senderStamp)];
+    samples.emplace_back(value, len);
+    m_bytesPerStream[std::make_pair(dataType, senderStamp)] += len;
+    if ( (samples.size() < m_samples) && (m_bytesPerStream[std::make_pair(dataType, senderStamp)] < 4 * m_dictionarySize) ) {
+      return nullptr;
+    }
+
+    std::string bytes;
+    std::vector<std::string> distinct;
+    for (auto it = samples.rbegin(); (it != samples.rend()) && (bytes.size() < m_dictionarySize); it++) {
+      if (std::find(distinct.begin(), distinct.end(), *it) == distinct.end()) {
+        distinct.push_back(*it);
+        bytes.insert(0, *it);
+      }
+    }
+    if (bytes.size() > m_dictionarySize) {
+      bytes.erase(0, bytes.size() - m_dictionarySize);
+    }
+    m_samplesPerStream.erase(std::make_pair(dataType, senderStamp));
+    m_bytesPerStream.erase(std::make_pair(dataType, senderStamp));
+    return m_dictionaries.add(0, dataType, senderStamp, std::move(bytes));
+  }
+
+ private:
+  Dictionaries &m_dictionaries;
+  std::size_t m_dictionarySize;
+  uint32_t m_samples;
+  std::map<std::pair<int32_t, uint32_t>, std::vector<std::string>> m_samplesPerStream{};
+  std::map<std::pair<int32_t, uint32_t>, std::size_t> m_bytesPerStream{};
+};
+
+/**
+ * This function writes an unsigned integer as varint with seven bits per
+ * byte, least significant first.
+ *
+ * @param v value to write
+ * @param dst buffer with at least ten bytes
+ * @return number of bytes written
+ */
+inline std::size_t putVarint(uint64_t v, char *dst) noexcept {
+  std::size_t offset{0};
+  for (; ; v >>= 7) {
+    dst[offset++] = static_cast<char>((v & 0x7F) | ((v > 0x7F) ? 0x80 : 0));
+    if (v <= 0x7F) {
+      break;
+    }
+  }
+  return offset;
+}
+
+/**
+ * This function reads a varint written with putVarint and advances src.
+ *
+ * @param src buffer to read from; advanced past the varint
+ * @param len remaining length of src; reduced by the length of the varint
+ * @param v value that was read
+ * @return true if a complete varint was read
+ */
+inline bool getVarint(const char *&src, std::size_t &len, uint64_t &v) noexcept {
+  v = 0;
+  for (uint8_t shift{0}; (0 < len) && (shift < 64); shift += 7) {
+    const uint8_t b{static_cast<uint8_t>(*src++)};
+    len--;
+    v |= static_cast<uint64_t>(b & 0x7F) << shift;
+    if (0 == (b & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * This function writes the id of a dictionary as varint, which is how values
+ * compressed with a dictionary start.
+ *
+ * @param id id of the dictionary
+ * @param dst buffer with at least five bytes
+ * @return number of bytes written
+ */
+inline std::size_t putDictionaryId(uint32_t id, char *dst) noexcept {
+  return putVarint(id, dst);
+}
+
+/**
+ * Ids of the dictionaries in a cabinet: The dictionaries are trained with
+ * preliminary ids and a new dictionary gets its id when it is stored with its
+ * first value (cf. Dictionaries::store), which is within the same write
+ * transaction; values that were encoded with a different preliminary id get
+ * the stored one.
+ */
+class DictionaryIds {
+ private:
+  DictionaryIds(const DictionaryIds &) = delete;
+  DictionaryIds(DictionaryIds &&)      = delete;
+  DictionaryIds &operator=(const DictionaryIds &) = delete;
+  DictionaryIds &operator=(DictionaryIds &&) = delete;
+
+ public:
+  /**
+   * @param dictionaries dictionaries loaded from the cabinet before training new ones
+   */
+  explicit DictionaryIds(const Dictionaries &dictionaries) {
+    for (auto id : dictionaries.ids()) {
+      m_ids[dictionaries.byId(id).get()] = id;
+    }
+  }
+
+  /**
+   * This method stores a dictionary unless it was stored before and sets its
+   * stored id in a value that was encoded with it.
+   *
+   * @param txn write transaction for the value
+   * @param d dictionary that the value was encoded with
+   * @param value encoded value starting with the preliminary id of d
+   * @return MDB_SUCCESS or the lmdb error code
+   */
+  int32_t store(MDB_txn *txn, const Dictionary &d, std::vector<char> &value) {
+    auto it = m_ids.find(&d);
+    if (m_ids.end() == it) {
+      uint32_t id{0};
+      const int32_t rc{Dictionaries::store(txn, d, id)};
+      if (MDB_SUCCESS != rc) {
+        return rc;
+      }
+      it = m_ids.emplace(&d, id).first;
+    }
+    if (it->second != d.id()) {
+      char varint[5];
+      const std::size_t OLD_LENGTH{putDictionaryId(d.id(), varint)};
+      const std::size_t NEW_LENGTH{putDictionaryId(it->second, varint)};
+      if (OLD_LENGTH <= value.size()) {
+        value.erase(value.begin(), value.begin() + static_cast<std::ptrdiff_t>(OLD_LENGTH));
+        value.insert(value.begin(), varint, varint + NEW_LENGTH);
+      }
+    }
+    return MDB_SUCCESS;
+  }
+
+ private:
+  std::map<const Dictionary*, uint32_t> m_ids{};
+};
+
+/**
+ * Compression states for LZ4 and LZ4HC that are initialized once per thread
+ * instead of once per value, which dominates the time to compress small values.
+ */
+struct LZ4States {
+  LZ4States() :
+    fast(static_cast<std::size_t>(LZ4_sizeofState())),
+    hc(static_cast<std::size_t>(LZ4_sizeofStateHC())) {
+    LZ4_initStream(fast.data(), fast.size());
+    LZ4_initStreamHC(hc.data(), hc.size());
+  }
+  std::vector<char> fast;
+  std::vector<char> hc;
+};
+
+/**
+ * @return compression states of the calling thread
+ */
+inline LZ4States &lz4States() {
+  static thread_local LZ4States states;
+  return states;
+}
+
+/**
+ * This function compresses a value.
+ *
+ * @param c codec to use
+ * @param src value to compress
+ * @param len length of the value
+ * @param dst buffer for the compressed value
+ * @param dictionary dictionary for the stream of this value if c uses one;
+ *        without dictionary, LZ4_DICT and LZ4HC_DICT fall back to LZ4 and LZ4HC
+ * @return codec that was actually applied: NONE if the compressed value
+ *         would not be smaller than the original one, whereupon dst is
+ *         unused and the original value is to be stored
+ */
+inline uint8_t encode(const Config &c, const char *src, const std::size_t &len, std::vector<char> &dst, const Dictionary *dictionary = nullptr) {
+  uint8_t applied{c.codec};
+  int64_t compressedSize{0};
+  if (usesDictionary(c.codec) && (nullptr != dictionary)) {
+    LZ4States &states = lz4States();
+    // The value starts with the id of the dictionary and the uncompressed length as varints.
+    dst.resize(5 + 10 + LZ4_compressBound(static_cast<int>(len)));
+    std::size_t offset{putDictionaryId(dictionary->id(), dst.data())};
+    offset += putVarint(len, dst.data() + offset);
+    if (LZ4_DICT == c.codec) {
+      LZ4_stream_t *stream{reinterpret_cast<LZ4_stream_t*>(states.fast.data())};
+      LZ4_resetStream_fast(stream);
+      LZ4_attach_dictionary(stream, dictionary->fast());
+      compressedSize = LZ4_compress_fast_continue(stream, src, dst.data() + offset, static_cast<int>(len), static_cast<int>(dst.size() - offset), c.level);
+    }
+    else {
+      LZ4_streamHC_t *stream{reinterpret_cast<LZ4_streamHC_t*>(states.hc.data())};
+      LZ4_resetStreamHC_fast(stream, c.level);
+      LZ4_attach_HC_dictionary(stream, dictionary->hc());
+      compressedSize = LZ4_compress_HC_continue(stream, src, dst.data() + offset, static_cast<int>(len), static_cast<int>(dst.size() - offset));
+    }
+    compressedSize += (0 < compressedSize) ? static_cast<int64_t>(offset) : 0;
+  }
+  else if ( (LZ4 == c.codec) || (LZ4HC == c.codec) || usesDictionary(c.codec) ) {
+    LZ4States &states = lz4States();
+    applied = ((LZ4 == c.codec) || (LZ4_DICT == c.codec)) ? LZ4 : LZ4HC;
+    // The value starts with the uncompressed length as varint.
+    dst.resize(10 + LZ4_compressBound(static_cast<int>(len)));
+    const std::size_t offset{putVarint(len, dst.data())};
+    compressedSize = (LZ4 == applied) ?
+      LZ4_compress_fast_extState_fastReset(states.fast.data(), src, dst.data() + offset, static_cast<int>(len), static_cast<int>(dst.size() - offset), c.level) :
+      LZ4_compress_HC_extStateHC_fastReset(states.hc.data(), src, dst.data() + offset, static_cast<int>(len), static_cast<int>(dst.size() - offset), c.level);
+    compressedSize += (0 < compressedSize) ? static_cast<int64_t>(offset) : 0;
+  }
+#ifdef HAVE_ZSTD
+  else if (ZSTD == c.codec) {
+    dst.resize(ZSTD_compressBound(len));
+    const std::size_t retVal{ZSTD_compress(dst.data(), dst.size(), src, len, c.level)};
+    compressedSize = ZSTD_isError(retVal) ? 0 : static_cast<int64_t>(retVal);
+  }
+#endif
+  if ( (0 < compressedSize) && (static_cast<uint64_t>(compressedSize) < len) ) {
+    dst.resize(static_cast<std::size_t>(compressedSize));
+    return applied;
+  }
+  return NONE;
+}
+
+/**
+ * This function decompresses the value that was stored with the given key.
+ * The uncompressed value is either the stored value itself or placed into
+ * buffer.
+ *
+ * @param k Key of the value
+ * @param src stored value
+ * @param len length of the stored value
+ * @param buffer buffer for the uncompressed value
+ * @param dictionaries dictionaries of the cabinet; required for values
+ *        compressed with a dictionary
+ * @param blobReader blob file of the cabinet; required for values in the blob file
+ * @return pointer to and length of the uncompressed value; nullptr on failure
+ */
+inline std::pair<const char*, std::size_t> decode(const cabinet::Key &k, const char *src, std::size_t len, std::vector<char> &buffer, const Dictionaries *dictionaries = nullptr, blobs::Reader *blobReader = nullptr) {
+  uint8_t c{codecOf(k)};
+  if (BLOB == c) {
+    // Resolve the reference; uncompressed values are not copied.
+    blobs::Reference r;
+    src = ( (nullptr != blobReader) && blobs::getReference(src, len, r) && (BLOB != r.codec) ) ? blobReader->get(r) : nullptr;
+    if (nullptr == src) {
+      return std::make_pair(nullptr, 0);
+    }
+    c = r.codec;
+    len = static_cast<std::size_t>(r.length);
+  }
+  if ( (NONE == c) || ((LEGACY == c) && (k.length() <= len)) ) {
+    return std::make_pair(src, len);
+  }
+  if ( (LEGACY == c) || (LZ4 == c) || (LZ4HC == c) || usesDictionary(c) ) {
+    std::shared_ptr<const Dictionary> dictionary;
+    if (usesDictionary(c)) {
+      // The value starts with the id of the dictionary as varint.
+      uint64_t id{0};
+      if (!getVarint(src, len, id) || (id > std::numeric_limits<uint32_t>::max())) {
+        return std::make_pair(nullptr, 0);
+      }
+      dictionary = (nullptr != dictionaries) ? dictionaries->byId(static_cast<uint32_t>(id)) : nullptr;
+      if (nullptr == dictionary) {
+        return std::make_pair(nullptr, 0);
+      }
+    }
+
+    if (LEGACY != c) {
+      // The uncompressed length precedes the LZ4 block as varint.
+      uint64_t length{0};
+      if (!getVarint(src, len, length) || (length > LZ4_MAX_INPUT_SIZE)) {
+        return std::make_pair(nullptr, 0);
+      }
+      buffer.resize(length);
+      const int retVal{(nullptr == dictionary) ?
+        LZ4_decompress_safe(src, buffer.data(), static_cast<int>(len), static_cast<int>(length)) :
+        LZ4_decompress_safe_usingDict(src, buffer.data(), static_cast<int>(len), static_cast<int>(length), dictionary->bytes().data(), static_cast<int>(dictionary->bytes().size()))};
+      if ( (0 <= retVal) && (length == static_cast<uint64_t>(retVal)) ) {
+        return std::make_pair(buffer.data(), static_cast<std::size_t>(retVal));
+      }
+      return std::make_pair(nullptr, 0);
+    }
+
+    // Legacy values do not record their uncompressed length and Key.length
+    // is an uint16_t; hence, the length of larger values is only known modulo
+    // 2^16. LZ4 expands incompressible data only slightly so that the search
+    // can start just below the stored length.
+    const uint64_t MODULO{static_cast<uint64_t>(1) << 16};
+    const uint64_t MIN_LENGTH{(len > 16) ? (len - 16) - (len - 16) / 256 : 0};
+    const uint64_t MAX_LENGTH{std::min<uint64_t>(static_cast<uint64_t>(len) * 255 + MODULO, LZ4_MAX_INPUT_SIZE)};
+    uint64_t length{k.length()};
+    if (length < MIN_LENGTH) {
+      length += ((MIN_LENGTH - length + MODULO - 1) / MODULO) * MODULO;
+    }
+    for (; length <= MAX_LENGTH; length += MODULO) {
+      buffer.resize(length);
+      const int retVal{LZ4_decompress_safe(src, buffer.data(), static_cast<int>(len), static_cast<int>(length))};
+      if (0 <= retVal) {
+        return std::make_pair(buffer.data(), static_cast<std::size_t>(retVal));
+      }
+    }
+  }
+#ifdef HAVE_ZSTD
+  else if (ZSTD == c) {
+    const unsigned long long length{ZSTD_getFrameContentSize(src, len)};
+    if ( (ZSTD_CONTENTSIZE_UNKNOWN != length) && (ZSTD_CONTENTSIZE_ERROR != length) ) {
+      buffer.resize(static_cast<std::size_t>(length));
+      const std::size_t retVal{ZSTD_decompress(buffer.data(), buffer.size(), src, len)};
+      if (!ZSTD_isError(retVal)) {
+        return std::make_pair(buffer.data(), retVal);
+      }
+    }
+  }
+#endif
+  return std::make_pair(nullptr, 0);
+}
+
+} // codec
+#endif
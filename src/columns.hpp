@@ -0,0 +1,679 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef COLUMNS_HPP
+#define COLUMNS_HPP
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "key.hpp"
+
+#include "lmdb.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * A column cabinet stores the numeric fields of selected messages decoded
+ * from a cabinet in one table per field named "dataType/senderStamp.field",
+ * e.g., "1046/0.groundSpeed". A table holds blocks of up to BLOCK_SIZE values
+ * with the first timeStamp of the block in network byte order as key. A
+ * block has a header followed by the timeStamps encoded as delta-of-delta
+ * and the values as doubles encoded by XOR with their predecessor (cf.
+ * Pelkonen et al., Gorilla: A Fast, Scalable, In-Memory Time Series
+ * Database, VLDB 2015):
+ *
+ *    format(1) count(4) unit(4) first(8) last(8) min(8) max(8) bits...
+ *
+ * The timeStamps are encoded in multiples of unit nanoseconds, i.e., 1000 for
+ * the microseconds of cluon::data::TimeStamp. Readers skip blocks by their
+ * timeStamps and aggregate whole blocks from min/max without decoding them.
+ */
+namespace columns {
+
+constexpr uint32_t BLOCK_SIZE{1024};
+constexpr uint8_t FORMAT{1};
+constexpr std::size_t HEADER_SIZE{1 + 4 + 4 + 8 + 8 + 8 + 8};
+
+/**
+ * Header of a block.
+ */
+struct Header {
+  uint32_t count{0};
+  uint32_t unit{1};
+  int64_t first{0};
+  int64_t last{0};
+  double min{std::numeric_limits<double>::quiet_NaN()};
+  double max{std::numeric_limits<double>::quiet_NaN()};
+};
+
+/**
+ * Decoded values of a column in contiguous arrays.
+ */
+struct Series {
+  std::vector<int64_t> timeStamps{};
+  std::vector<double> values{};
+};
+
+/**
+ * Aggregates of a column.
+ */
+struct Summary {
+  uint64_t count{0};
+  double min{std::numeric_limits<double>::quiet_NaN()};
+  double max{std::numeric_limits<double>::quiet_NaN()};
+  uint64_t blocksDecoded{0};
+};
+
+inline uint8_t leadingZeros(const uint64_t &v) noexcept {
+#if defined(__GNUC__)
+  return static_cast<uint8_t>((0 == v) ? 64 : __builtin_clzll(v));
+#else
+  uint8_t n{0};
+  for (uint64_t mask{1ULL << 63}; (0 != mask) && (0 == (v & mask)); mask >>= 1) { n++; }
+  return n;
+#endif
+}
+
+inline uint8_t trailingZeros(const uint64_t &v) noexcept {
+#if defined(__GNUC__)
+  return static_cast<uint8_t>((0 == v) ? 64 : __builtin_ctzll(v));
+#else
+  uint8_t n{0};
+  for (uint64_t mask{1}; (0 != mask) && (0 == (v & mask)); mask <<= 1) { n++; }
+  return n;
+#endif
+}
+
+/**
+ * This class appends bits most significant bit first.
+ */
+class BitWriter {
+ public:
+  explicit BitWriter(std::vector<char> &dst) :
+    m_dst(dst) {}
+
+  /**
+   * @param bits value whose lower n bits are appended
+   * @param n number of bits (at most 64)
+   */
+  void write(const uint64_t &bits, uint8_t n) {
+    while (0 < n) {
+      if (0 == m_used) {
+        m_dst.push_back(0);
+      }
+      const uint8_t FREE{static_cast<uint8_t>(8 - m_used)};
+      const uint8_t TAKE{std::min(FREE, n)};
+      const uint8_t CHUNK{static_cast<uint8_t>((bits >> (n - TAKE)) & ((1U << TAKE) - 1))};
+      m_dst.back() = static_cast<char>(static_cast<uint8_t>(m_dst.back()) | static_cast<uint8_t>(CHUNK << (FREE - TAKE)));
+      m_used = static_cast<uint8_t>((m_used + TAKE) % 8);
+      n = static_cast<uint8_t>(n - TAKE);
+    }
+  }
+
+ private:
+  std::vector<char> &m_dst;
+  uint8_t m_used{0};
+};
+
+/**
+ * This class reads bits most significant bit first.
+ */
+class BitReader {
+ public:
+  BitReader(const char *src, const std::size_t &size) :
+    m_src(reinterpret_cast<const uint8_t*>(src)),
+    m_bits(size * 8) {}
+
+  /**
+   * @param n number of bits (at most 64)
+   * @return next n bits; 0 beyond the end
+   */
+  uint64_t read(const uint8_t &n) noexcept {
+    if ( (0 == n) || (m_bits < m_position + n) ) {
+      m_failed = m_failed || (0 < n);
+      m_position = (0 < n) ? m_bits : m_position;
+      return 0;
+    }
+    // Take the bits from a window of the next 8 bytes and, if needed, one more byte.
+    const uint64_t BYTE{m_position / 8};
+    const uint8_t SHIFT{static_cast<uint8_t>(m_position % 8)};
+    uint64_t v{0};
+    if (BYTE + 8 <= m_bits / 8) {
+      std::memcpy(&v, m_src + BYTE, sizeof(v));
+      v = be64toh(v);
+    }
+    else {
+      for (uint64_t i{0}; i < 8; i++) {
+        v = (v << 8) | byteAt(BYTE + i);
+      }
+    }
+    v <<= SHIFT;
+    if (64 < SHIFT + n) {
+      v |= byteAt(BYTE + 8) >> (8 - SHIFT);
+    }
+    m_position += n;
+    return v >> (64 - n);
+  }
+
+  bool failed() const noexcept {
+    return m_failed;
+  }
+
+ private:
+  uint64_t byteAt(const uint64_t &i) const noexcept {
+    return (i < m_bits / 8) ? m_src[i] : 0;
+  }
+
+ private:
+  const uint8_t *m_src{nullptr};
+  uint64_t m_bits{0};
+  uint64_t m_position{0};
+  bool m_failed{false};
+};
+
+inline uint64_t bitsOf(const double &d) noexcept {
+  uint64_t bits{0};
+  std::memcpy(&bits, &d, sizeof(bits));
+  return bits;
+}
+
+inline double doubleOf(const uint64_t &bits) noexcept {
+  double d{0};
+  std::memcpy(&d, &bits, sizeof(d));
+  return d;
+}
+
+/**
+ * @param src block
+ * @param size size of the block
+ * @param header header of the block
+ * @return false if src is no valid block
+ */
+inline bool headerOf(const char *src, const std::size_t &size, Header &header) noexcept {
+  if ( (nullptr == src) || (HEADER_SIZE > size) || (FORMAT != static_cast<uint8_t>(src[0])) ) {
+    return false;
+  }
+  header.count = readBigEndian<uint32_t>(src + 1);
+  header.unit = std::max<uint32_t>(1, readBigEndian<uint32_t>(src + 5));
+  header.first = readBigEndian<int64_t>(src + 9);
+  header.last = readBigEndian<int64_t>(src + 17);
+  header.min = doubleOf(readBigEndian<uint64_t>(src + 25));
+  header.max = doubleOf(readBigEndian<uint64_t>(src + 33));
+  return true;
+}
+
+// Buckets for the delta-of-delta: prefix bits, length of the prefix, and bits for the value.
+struct Bucket {
+  uint64_t prefix;
+  uint8_t prefixBits;
+  uint8_t valueBits;
+};
+constexpr Bucket BUCKETS[]{{0x2, 2, 7}, {0x6, 3, 9}, {0xE, 4, 12}, {0x1E, 5, 32}, {0x1F, 5, 64}};
+
+/**
+ * This function encodes timeStamps and values into a block.
+ *
+ * @param timeStamps timeStamps in nanoseconds in ascending order
+ * @param values values
+ * @param count number of timeStamps and values
+ * @param dst block is appended here
+ */
+inline void encode(const int64_t *timeStamps, const double *values, const uint32_t &count, std::vector<char> &dst) {
+  Header h;
+  h.count = count;
+  h.unit = 1000;
+  for (uint32_t i{0}; i < count; i++) {
+    h.unit = (0 == (timeStamps[i] % 1000)) ? h.unit : 1;
+    h.min = std::fmin(h.min, values[i]);
+    h.max = std::fmax(h.max, values[i]);
+  }
+  h.first = (0 < count) ? timeStamps[0] : 0;
+  h.last = (0 < count) ? timeStamps[count - 1] : 0;
+
+  dst.push_back(static_cast<char>(FORMAT));
+  appendBigEndian(h.count, dst);
+  appendBigEndian(h.unit, dst);
+  appendBigEndian(h.first, dst);
+  appendBigEndian(h.last, dst);
+  appendBigEndian(bitsOf(h.min), dst);
+  appendBigEndian(bitsOf(h.max), dst);
+  if (0 == count) {
+    return;
+  }
+
+  BitWriter w(dst);
+  // timeStamps: first one in full, then the differences between consecutive deltas.
+  uint64_t previous{static_cast<uint64_t>(timeStamps[0] / h.unit)};
+  uint64_t previousDelta{0};
+  w.write(previous, 64);
+  for (uint32_t i{1}; i < count; i++) {
+    const uint64_t CURRENT{static_cast<uint64_t>(timeStamps[i] / h.unit)};
+    const uint64_t DELTA{CURRENT - previous};
+    const int64_t DOD{static_cast<int64_t>(DELTA - previousDelta)};
+    if (0 == DOD) {
+      w.write(0, 1);
+    }
+    else {
+      for (const auto &b : BUCKETS) {
+        const int64_t LIMIT{(64 == b.valueBits) ? 0 : (1LL << (b.valueBits - 1))};
+        if ( (64 == b.valueBits) || ((-LIMIT <= DOD) && (DOD < LIMIT)) ) {
+          w.write(b.prefix, b.prefixBits);
+          w.write(static_cast<uint64_t>(DOD) & ((64 == b.valueBits) ? ~0ULL : ((1ULL << b.valueBits) - 1)), b.valueBits);
+          break;
+        }
+      }
+    }
+    previousDelta = DELTA;
+    previous = CURRENT;
+  }
+
+  // values: first one in full, then the XOR with the previous one.
+  uint64_t previousBits{bitsOf(values[0])};
+  uint8_t previousLeading{0xFF};
+  uint8_t previousTrailing{0};
+  w.write(previousBits, 64);
+  for (uint32_t i{1}; i < count; i++) {
+    const uint64_t BITS{bitsOf(values[i])};
+    const uint64_t XOR{BITS ^ previousBits};
+    if (0 == XOR) {
+      w.write(0, 1);
+    }
+    else {
+      const uint8_t LEADING{std::min<uint8_t>(31, leadingZeros(XOR))};
+      const uint8_t TRAILING{trailingZeros(XOR)};
+      if ( (0xFF != previousLeading) && (LEADING >= previousLeading) && (TRAILING >= previousTrailing) ) {
+        // The meaningful bits fit into the window of the previous value.
+        w.write(0x2, 2);
+        w.write(XOR >> previousTrailing, static_cast<uint8_t>(64 - previousLeading - previousTrailing));
+      }
+      else {
+        const uint8_t MEANINGFUL{static_cast<uint8_t>(64 - LEADING - TRAILING)};
+        w.write(0x3, 2);
+        w.write(LEADING, 5);
+        w.write(MEANINGFUL - 1U, 6);
+        w.write(XOR >> TRAILING, MEANINGFUL);
+        previousLeading = LEADING;
+        previousTrailing = TRAILING;
+      }
+    }
+    previousBits = BITS;
+  }
+}
+
+/**
+ * This function decodes a block.
+ *
+ * @param src block
+ * @param size size of the block
+ * @param timeStamps decoded timeStamps in nanoseconds are appended here
+ * @param values decoded values are appended here
+ * @return false if the block could not be decoded
+ */
+inline bool decode(const char *src, const std::size_t &size, std::vector<int64_t> &timeStamps, std::vector<double> &values) {
+  Header h;
+  if (!headerOf(src, size, h)) {
+    return false;
+  }
+  if (0 == h.count) {
+    return true;
+  }
+  const std::size_t FIRST{timeStamps.size()};
+  if (timeStamps.capacity() < FIRST + h.count) {
+    // Grow geometrically when many blocks are appended.
+    timeStamps.reserve(std::max<std::size_t>(FIRST + h.count, 2 * timeStamps.capacity()));
+  }
+  if (values.capacity() < values.size() + h.count) {
+    values.reserve(std::max<std::size_t>(values.size() + h.count, 2 * values.capacity()));
+  }
+
+  BitReader r(src + HEADER_SIZE, size - HEADER_SIZE);
+  uint64_t previous{r.read(64)};
+  uint64_t previousDelta{0};
+  timeStamps.push_back(static_cast<int64_t>(previous * h.unit));
+  for (uint32_t i{1}; i < h.count; i++) {
+    int64_t dod{0};
+    if (0 != r.read(1)) {
+      uint8_t valueBits{64};
+      for (const auto &b : BUCKETS) {
+        if ( (64 == b.valueBits) || (0 == r.read(1)) ) {
+          valueBits = b.valueBits;
+          break;
+        }
+      }
+      const uint64_t V{r.read(valueBits)};
+      // Sign extension from valueBits.
+      dod = (64 == valueBits) ? static_cast<int64_t>(V) : (static_cast<int64_t>(V << (64 - valueBits)) >> (64 - valueBits));
+    }
+    previousDelta += static_cast<uint64_t>(dod);
+    previous += previousDelta;
+    timeStamps.push_back(static_cast<int64_t>(previous * h.unit));
+  }
+
+  uint64_t previousBits{r.read(64)};
+  uint8_t leading{0};
+  uint8_t meaningful{64};
+  values.push_back(doubleOf(previousBits));
+  for (uint32_t i{1}; i < h.count; i++) {
+    if (0 != r.read(1)) {
+      if (0 != r.read(1)) {
+        leading = static_cast<uint8_t>(r.read(5));
+        meaningful = static_cast<uint8_t>(r.read(6) + 1);
+      }
+      previousBits ^= r.read(meaningful) << (64 - leading - meaningful);
+    }
+    values.push_back(doubleOf(previousBits));
+  }
+  if (r.failed()) {
+    timeStamps.resize(FIRST);
+    values.resize(FIRST);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @param txn transaction to read from
+ * @return names of the column tables
+ */
+inline std::vector<std::string> columnsOf(MDB_txn *txn) noexcept {
+  std::vector<std::string> names;
+  MDB_dbi dbMain{0};
+  MDB_cursor *cursor{nullptr};
+  if ( (MDB_SUCCESS == mdb_dbi_open(txn, nullptr, 0, &dbMain))
+    && (MDB_SUCCESS == mdb_cursor_open(txn, dbMain, &cursor)) ) {
+    MDB_val key;
+    while (MDB_SUCCESS == mdb_cursor_get(cursor, &key, nullptr, MDB_NEXT_NODUP)) {
+      const std::string name(static_cast<char*>(key.mv_data), key.mv_size);
+      if ( (std::string::npos != name.find('.')) && (std::string::npos == name.find('\0')) ) {
+        names.push_back(name);
+      }
+    }
+    mdb_cursor_close(cursor);
+  }
+  return names;
+}
+
+/**
+ * This function calls f(src, size, header) for each block of a column that
+ * holds values between start and end.
+ *
+ * @param txn transaction to read from
+ * @param column name of the column table
+ * @param start first timeStamp in nanoseconds
+ * @param end last timeStamp in nanoseconds
+ * @param f function to call; returns false to stop
+ * @return false if the column does not exist
+ */
+template <class F>
+inline bool forEachBlock(MDB_txn *txn, const std::string &column, const int64_t &start, const int64_t &end, F &&f) {
+  MDB_dbi dbi{0};
+  MDB_cursor *cursor{nullptr};
+  if ( (MDB_SUCCESS != mdb_dbi_open(txn, column.c_str(), 0, &dbi))
+    || (MDB_SUCCESS != mdb_cursor_open(txn, dbi, &cursor)) ) {
+    return false;
+  }
+  // The block before the first one starting from start might still hold values from start on.
+  std::vector<char> _start;
+  appendBigEndian(std::max<int64_t>(start, 0), _start);
+  MDB_val key{_start.size(), _start.data()};
+  MDB_val value;
+  int32_t rc{mdb_cursor_get(cursor, &key, &value, MDB_SET_RANGE)};
+  rc = (MDB_SUCCESS == rc) ? mdb_cursor_get(cursor, &key, &value, MDB_PREV) : mdb_cursor_get(cursor, &key, &value, MDB_LAST);
+  if (MDB_SUCCESS != rc) {
+    rc = mdb_cursor_get(cursor, &key, &value, MDB_FIRST);
+  }
+  for (; MDB_SUCCESS == rc; rc = mdb_cursor_get(cursor, &key, &value, MDB_NEXT)) {
+    Header h;
+    if (!headerOf(static_cast<const char*>(value.mv_data), value.mv_size, h) || (h.last < start)) {
+      continue;
+    }
+    if ( (h.first > end) || !f(static_cast<const char*>(value.mv_data), value.mv_size, h) ) {
+      break;
+    }
+  }
+  mdb_cursor_close(cursor);
+  return true;
+}
+
+/**
+ * This function reads the values of a column between start and end.
+ *
+ * @param txn transaction to read from
+ * @param column name of the column table, e.g., "1046/0.groundSpeed"
+ * @param start first timeStamp in nanoseconds
+ * @param end last timeStamp in nanoseconds
+ * @param series timeStamps and values are appended here
+ * @return false if the column does not exist or a block could not be decoded
+ */
+inline bool read(MDB_txn *txn, const std::string &column, const int64_t &start, const int64_t &end, Series &series) {
+  bool decoded{true};
+  const bool FOUND{forEachBlock(txn, column, start, end, [&](const char *src, const std::size_t &size, const Header &h) {
+    if ( (start <= h.first) && (h.last <= end) ) {
+      decoded = decode(src, size, series.timeStamps, series.values);
+      return decoded;
+    }
+    Series tmp;
+    decoded = decode(src, size, tmp.timeStamps, tmp.values);
+    for (std::size_t i{0}; decoded && (i < tmp.timeStamps.size()); i++) {
+      if ( (start <= tmp.timeStamps[i]) && (tmp.timeStamps[i] <= end) ) {
+        series.timeStamps.push_back(tmp.timeStamps[i]);
+        series.values.push_back(tmp.values[i]);
+      }
+    }
+    return decoded;
+  })};
+  return FOUND && decoded;
+}
+
+/**
+ * This function aggregates the values of a column between start and end;
+ * only the blocks at the boundaries are decoded.
+ *
+ * @param txn transaction to read from
+ * @param column name of the column table
+ * @param start first timeStamp in nanoseconds
+ * @param end last timeStamp in nanoseconds
+ * @param summary aggregates
+ * @return false if the column does not exist or a block could not be decoded
+ */
+inline bool summarize(MDB_txn *txn, const std::string &column, const int64_t &start, const int64_t &end, Summary &summary) {
+  bool decoded{true};
+  const bool FOUND{forEachBlock(txn, column, start, end, [&](const char *src, const std::size_t &size, const Header &h) {
+    if ( (start <= h.first) && (h.last <= end) ) {
+      summary.count += h.count;
+      summary.min = std::fmin(summary.min, h.min);
+      summary.max = std::fmax(summary.max, h.max);
+      return true;
+    }
+    Series tmp;
+    decoded = decode(src, size, tmp.timeStamps, tmp.values);
+    summary.blocksDecoded++;
+    for (std::size_t i{0}; decoded && (i < tmp.timeStamps.size()); i++) {
+      if ( (start <= tmp.timeStamps[i]) && (tmp.timeStamps[i] <= end) ) {
+        summary.count++;
+        summary.min = std::fmin(summary.min, tmp.values[i]);
+        summary.max = std::fmax(summary.max, tmp.values[i]);
+      }
+    }
+    return decoded;
+  })};
+  return FOUND && decoded;
+}
+
+/**
+ * Selection of fields to materialize: dataType, optionally a senderStamp, and
+ * optionally the name of a field; all numeric fields otherwise.
+ */
+struct Field {
+  int32_t dataType{0};
+  bool anySenderStamp{true};
+  uint32_t senderStamp{0};
+  std::string name{};
+};
+
+/**
+ * @param spec comma-separated list of dataType[/senderStamp][.field], e.g., "1046/0.groundSpeed,1030,19"
+ * @param fields parsed fields
+ * @return false if spec is invalid
+ */
+inline bool parse(const std::string &spec, std::vector<Field> &fields) {
+  std::stringstream sstr(spec);
+  std::string item;
+  while (std::getline(sstr, item, ',')) {
+    if (item.empty()) {
+      continue;
+    }
+    Field f;
+    const std::size_t DOT{item.find('.')};
+    if (std::string::npos != DOT) {
+      f.name = item.substr(DOT + 1);
+      item = item.substr(0, DOT);
+    }
+    const std::size_t SLASH{item.find('/')};
+    try {
+      std::size_t used{0};
+      f.dataType = std::stoi(item.substr(0, SLASH), &used);
+      if (used != item.substr(0, SLASH).size()) {
+        return false;
+      }
+      if (std::string::npos != SLASH) {
+        f.anySenderStamp = false;
+        f.senderStamp = static_cast<uint32_t>(std::stoul(item.substr(SLASH + 1)));
+      }
+    }
+    catch (...) {
+      return false;
+    }
+    fields.push_back(f);
+  }
+  return !fields.empty();
+}
+
+/**
+ * @param fields selected fields
+ * @param dataType dataType of a stream
+ * @param senderStamp senderStamp of a stream
+ * @return true if fields of the stream are selected
+ */
+inline bool selects(const std::vector<Field> &fields, const int32_t &dataType, const uint32_t &senderStamp) noexcept {
+  for (const auto &f : fields) {
+    if ( (f.dataType == dataType) && (f.anySenderStamp || (f.senderStamp == senderStamp)) ) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @param fields selected fields
+ * @param dataType dataType of a stream
+ * @param senderStamp senderStamp of a stream
+ * @param name name of a field
+ * @return true if the field of the stream is selected
+ */
+inline bool selects(const std::vector<Field> &fields, const int32_t &dataType, const uint32_t &senderStamp, const std::string &name) noexcept {
+  for (const auto &f : fields) {
+    if ( (f.dataType == dataType) && (f.anySenderStamp || (f.senderStamp == senderStamp)) && (f.name.empty() || (f.name == name)) ) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * This class collects the numeric fields of a message by name.
+ */
+class NumericFields {
+ public:
+  explicit NumericFields(std::vector<std::pair<std::string, double>> &fields) :
+    m_fields(fields) {}
+
+  void preVisit(int32_t, const std::string &, const std::string &) noexcept {}
+  void postVisit() noexcept {}
+
+  void visit(uint32_t, std::string &&, std::string &&name, bool &v) noexcept { add(name, v ? 1.0 : 0.0); }
+  void visit(uint32_t, std::string &&, std::string &&, char &) noexcept {}
+  void visit(uint32_t, std::string &&, std::string &&name, int8_t &v) noexcept { add(name, v); }
+  void visit(uint32_t, std::string &&, std::string &&name, uint8_t &v) noexcept { add(name, v); }
+  void visit(uint32_t, std::string &&, std::string &&name, int16_t &v) noexcept { add(name, v); }
+  void visit(uint32_t, std::string &&, std::string &&name, uint16_t &v) noexcept { add(name, v); }
+  void visit(uint32_t, std::string &&, std::string &&name, int32_t &v) noexcept { add(name, v); }
+  void visit(uint32_t, std::string &&, std::string &&name, uint32_t &v) noexcept { add(name, v); }
+  void visit(uint32_t, std::string &&, std::string &&name, int64_t &v) noexcept { add(name, static_cast<double>(v)); }
+  void visit(uint32_t, std::string &&, std::string &&name, uint64_t &v) noexcept { add(name, static_cast<double>(v)); }
+  void visit(uint32_t, std::string &&, std::string &&name, float &v) noexcept { add(name, v); }
+  void visit(uint32_t, std::string &&, std::string &&name, double &v) noexcept { add(name, v); }
+  void visit(uint32_t, std::string &&, std::string &&, std::string &) noexcept {}
+
+  // Nested messages are not materialized.
+  template <typename T>
+  void visit(uint32_t &, std::string &&, std::string &&, T &) noexcept {}
+
+ private:
+  void add(const std::string &name, const double &v) {
+    m_fields.emplace_back(name, v);
+  }
+
+ private:
+  std::vector<std::pair<std::string, double>> &m_fields;
+};
+
+template <typename T>
+inline bool extractFields(cluon::data::Envelope &&envelope, std::vector<std::pair<std::string, double>> &fields) {
+  T msg{cluon::extractMessage<T>(std::move(envelope))};
+  NumericFields visitor(fields);
+  msg.accept(visitor);
+  return true;
+}
+
+/**
+ * This function decodes the numeric fields of the readings from the
+ * opendlv.proxy message set.
+ *
+ * @param envelope Envelope to decode
+ * @param fields pairs of field name and value are appended here
+ * @return false if the dataType is not supported
+ */
+inline bool fieldsOf(cluon::data::Envelope &&envelope, std::vector<std::pair<std::string, double>> &fields) {
+  using Extract = bool(*)(cluon::data::Envelope&&, std::vector<std::pair<std::string, double>>&);
+  static const std::map<int32_t, Extract> EXTRACT{
+    {opendlv::proxy::GeodeticWgs84Reading::ID(), &extractFields<opendlv::proxy::GeodeticWgs84Reading>},
+    {opendlv::proxy::AccelerationReading::ID(), &extractFields<opendlv::proxy::AccelerationReading>},
+    {opendlv::proxy::AngularVelocityReading::ID(), &extractFields<opendlv::proxy::AngularVelocityReading>},
+    {opendlv::proxy::MagneticFieldReading::ID(), &extractFields<opendlv::proxy::MagneticFieldReading>},
+    {opendlv::proxy::AltitudeReading::ID(), &extractFields<opendlv::proxy::AltitudeReading>},
+    {opendlv::proxy::PressureReading::ID(), &extractFields<opendlv::proxy::PressureReading>},
+    {opendlv::proxy::TemperatureReading::ID(), &extractFields<opendlv::proxy::TemperatureReading>},
+    {opendlv::proxy::TorqueReading::ID(), &extractFields<opendlv::proxy::TorqueReading>},
+    {opendlv::proxy::VoltageReading::ID(), &extractFields<opendlv::proxy::VoltageReading>},
+    {opendlv::proxy::AngleReading::ID(), &extractFields<opendlv::proxy::AngleReading>},
+    {opendlv::proxy::DistanceReading::ID(), &extractFields<opendlv::proxy::DistanceReading>},
+    {opendlv::proxy::SwitchStateReading::ID(), &extractFields<opendlv::proxy::SwitchStateReading>},
+    {opendlv::proxy::PedalPositionReading::ID(), &extractFields<opendlv::proxy::PedalPositionReading>},
+    {opendlv::proxy::GroundSteeringReading::ID(), &extractFields<opendlv::proxy::GroundSteeringReading>},
+    {opendlv::proxy::GroundSpeedReading::ID(), &extractFields<opendlv::proxy::GroundSpeedReading>},
+    {opendlv::proxy::WheelSpeedReading::ID(), &extractFields<opendlv::proxy::WheelSpeedReading>},
+    {opendlv::proxy::WeightReading::ID(), &extractFields<opendlv::proxy::WeightReading>},
+    {opendlv::proxy::GeodeticHeadingReading::ID(), &extractFields<opendlv::proxy::GeodeticHeadingReading>}
+  };
+  auto it = EXTRACT.find(envelope.dataType());
+  return (EXTRACT.end() != it) && it->second(std::move(envelope), fields);
+}
+
+} // columns
+#endif
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef DUPLICATE_FILTER_HPP
+#define DUPLICATE_FILTER_HPP
+
+#include "key.hpp"
+
+#include "lmdb.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Blocked Bloom filter over the xxhashes of the keys stored in a table to
+ * detect duplicated Envelopes during an import without looking up every
+ * Envelope in LMDB: Each xxhash sets eight bits in one block of 512 bits,
+ * i.e., one cache line. The memory is bounded by MAX_BYTES; an Envelope that
+ * might be stored is confirmed with the table (cf. isStored).
+ *
+ * Cabinets written by earlier versions stored colliding timeStamps in the
+ * next free nanosecond slot; hence, a stored key's timeStamp may be slightly
+ * larger than its Envelope's sampleTimeStamp. As the xxhash covers the
+ * complete Envelope including its sampleTimeStamp, the filter holds only the
+ * xxhashes and a stored timeStamp within [timeStamp, timeStamp + MAX_COLLISIONS)
+ * with the same xxhash is a duplicate.
+ */
+class DuplicateFilter {
+ public:
+  static constexpr int64_t MAX_COLLISIONS{1000};
+  static constexpr uint64_t BITS_PER_ENTRY{16};
+  static constexpr uint64_t MAX_BYTES{256UL * 1024UL * 1024UL};
+
+ private:
+  using Block = std::array<uint64_t, 8>;
+
+ public:
+  /**
+   * @param entries expected number of keys
+   */
+  explicit DuplicateFilter(const uint64_t &entries = 0) {
+    reserve(entries);
+  }
+
+  /**
+   * This method resizes the filter for the expected number of keys and
+   * removes all keys.
+   *
+   * @param entries expected number of keys
+   */
+  void reserve(const uint64_t &entries) {
+    const uint64_t MAX_BLOCKS{MAX_BYTES / sizeof(Block)};
+    const uint64_t BLOCKS{std::min<uint64_t>(MAX_BLOCKS, (entries * BITS_PER_ENTRY + 8 * sizeof(Block) - 1) / (8 * sizeof(Block)))};
+    uint64_t n{1};
+    while (n < BLOCKS) {
+      n <<= 1;
+    }
+    m_blocks.assign(n, Block{});
+    m_mask = n - 1;
+    m_size = 0;
+  }
+
+  /**
+   * @param hash xxhash of the Envelope
+   * @return false if no key with this xxhash was added
+   */
+  bool mightContain(const uint64_t &hash) const noexcept {
+    const Block &b = m_blocks[blockOf(hash)];
+    uint64_t bits{bitsOf(hash)};
+    for (const uint64_t &word : b) {
+      if (0 == (word & (1ULL << (bits & 63)))) {
+        return false;
+      }
+      bits >>= 6;
+    }
+    return true;
+  }
+
+  /**
+   * @param hash xxhash of the stored Envelope
+   */
+  void insert(const uint64_t &hash) noexcept {
+    Block &b = m_blocks[blockOf(hash)];
+    uint64_t bits{bitsOf(hash)};
+    for (uint64_t &word : b) {
+      word |= (1ULL << (bits & 63));
+      bits >>= 6;
+    }
+    m_size++;
+  }
+
+  /**
+   * This method sizes the filter for the keys from a table within a temporal
+   * range and the keys to be added afterwards and adds the keys from the table.
+   *
+   * @param txn transaction to read from
+   * @param dbi table with its comparator set for layout
+   * @param from first timeStamp in nanoseconds
+   * @param to last timeStamp in nanoseconds
+   * @param layout layout of the keys in the table
+   * @param additional expected number of keys to be added after seeding
+   * @return number of added keys
+   */
+  uint64_t seed(MDB_txn *txn, const MDB_dbi &dbi, const int64_t &from, const int64_t &to, const uint8_t &layout = KEY_LAYOUT_COMPARE_KEYS, const uint64_t &additional = 0) {
+    // The keys are counted first to size the filter.
+    reserve(forEachKey(txn, dbi, from, to, layout, nullptr) + additional);
+    return forEachKey(txn, dbi, from, to, layout, this);
+  }
+
+  /**
+   * This method confirms that an Envelope is stored in a table.
+   *
+   * @param txn transaction to read from
+   * @param dbi table with its comparator set for layout
+   * @param timeStamp timeStamp in nanoseconds of the key before resolving collisions
+   * @param hash xxhash of the Envelope
+   * @param layout layout of the keys in the table
+   * @return true if a key with this xxhash is stored within [timeStamp, timeStamp + MAX_COLLISIONS)
+   */
+  static bool isStored(MDB_txn *txn, const MDB_dbi &dbi, const int64_t &timeStamp, const uint64_t &hash, const uint8_t &layout = KEY_LAYOUT_COMPARE_KEYS) {
+    bool stored{false};
+    MDB_cursor *cursor{nullptr};
+    if (MDB_SUCCESS == mdb_cursor_open(txn, dbi, &cursor)) {
+      char start[sizeof(int64_t)];
+      MDB_val key{setKeyPrefix(timeStamp, layout, start, sizeof(start)), start};
+      MDB_val value;
+      int32_t rc{mdb_cursor_get(cursor, &key, &value, MDB_SET_RANGE)};
+      while (!stored && (MDB_SUCCESS == rc)) {
+        const char *ptr{static_cast<char*>(key.mv_data)};
+        if ((KEY_SIZE > key.mv_size) || (keyTimeStamp(ptr) >= timeStamp + MAX_COLLISIONS)) {
+          break;
+        }
+        stored = (keyHash(ptr) == hash);
+        rc = mdb_cursor_get(cursor, &key, &value, MDB_NEXT);
+      }
+      mdb_cursor_close(cursor);
+    }
+    return stored;
+  }
+
+  /**
+   * @return number of added keys
+   */
+  uint64_t size() const noexcept { return m_size; }
+
+  /**
+   * @return memory of the filter in bytes
+   */
+  uint64_t bytes() const noexcept { return m_blocks.size() * sizeof(Block); }
+
+ private:
+  uint64_t blockOf(const uint64_t &hash) const noexcept {
+    return (hash ^ (hash >> 32)) & m_mask;
+  }
+
+  static uint64_t bitsOf(const uint64_t &hash) noexcept {
+    // Remix the xxhash so that the bits within a block are independent of the block.
+    return hash * 0x9E3779B97F4A7C15ULL;
+  }
+
+  /**
+   * @param filter filter to add the keys to or nullptr to count them
+   * @return number of keys within [from, to + MAX_COLLISIONS]
+   */
+  static uint64_t forEachKey(MDB_txn *txn, const MDB_dbi &dbi, const int64_t &from, const int64_t &to, const uint8_t &layout, DuplicateFilter *filter) {
+    uint64_t keys{0};
+    MDB_cursor *cursor{nullptr};
+    if (MDB_SUCCESS == mdb_cursor_open(txn, dbi, &cursor)) {
+      char start[sizeof(int64_t)];
+      MDB_val key{setKeyPrefix(from, layout, start, sizeof(start)), start};
+      MDB_val value;
+      int32_t rc{mdb_cursor_get(cursor, &key, &value, MDB_SET_RANGE)};
+      while (MDB_SUCCESS == rc) {
+        const char *ptr{static_cast<char*>(key.mv_data)};
+        if ((KEY_SIZE > key.mv_size) || (keyTimeStamp(ptr) > to + MAX_COLLISIONS)) {
+          break;
+        }
+        if (nullptr != filter) {
+          filter->insert(keyHash(ptr));
+        }
+        keys++;
+        rc = mdb_cursor_get(cursor, &key, &value, MDB_NEXT);
+      }
+      mdb_cursor_close(cursor);
+    }
+    return keys;
+  }
+
+ private:
+  std::vector<Block> m_blocks{};
+  uint64_t m_mask{0};
+  uint64_t m_size{0};
+};
+
+#endif
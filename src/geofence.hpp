@@ -134,5 +134,161 @@ inline bool isIn(std::vector<std::array<T,2>> &polygon, std::array<T,2> &p) {
   return inside;
 }
 
+
+/**
+ * Overlap of an axis-aligned box with a geofenced area.
+ */
+enum Overlap : uint8_t {
+  OUTSIDE = 0,
+  PARTIAL = 1,
+  INSIDE = 2
+};
+
+/**
+ * @param a start of a segment
+ * @param b end of a segment
+ * @param bl bottom-left corner of a box
+ * @param tr top-right corner of a box
+ * @return true if the segment touches the (closed) box
+ */
+template <typename T>
+inline bool intersects(const std::array<T,2> &a, const std::array<T,2> &b, const std::array<T,2> &bl, const std::array<T,2> &tr) {
+  static_assert(std::is_arithmetic<T>::value, "T must be an arithmetic type");
+  // Liang-Barsky clipping of the segment a + t*(b-a), t in [0, 1], against the box.
+  double t0{0.0};
+  double t1{1.0};
+  for (uint8_t k{0}; k < 2; k++) {
+    const double D{static_cast<double>(b[k]) - static_cast<double>(a[k])};
+    const std::array<double,2> P{{-D, D}};
+    const std::array<double,2> Q{{static_cast<double>(a[k]) - static_cast<double>(bl[k]), static_cast<double>(tr[k]) - static_cast<double>(a[k])}};
+    for (uint8_t i{0}; i < 2; i++) {
+      if (!(P[i] < 0.0) && !(P[i] > 0.0) /*P[i] == 0*/) {
+        if (Q[i] < 0.0) {
+          return false;
+        }
+      }
+      else {
+        const double R{Q[i] / P[i]};
+        if (P[i] < 0.0) {
+          t0 = (std::max)(t0, R);
+        }
+        else {
+          t1 = (std::min)(t1, R);
+        }
+        if (t0 > t1) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * @param a start of a segment
+ * @param b end of a segment
+ * @param p point
+ * @return Euclidean distance between p and the segment
+ */
+template <typename T>
+inline double distanceToSegment(const std::array<T,2> &a, const std::array<T,2> &b, const std::array<T,2> &p) {
+  static_assert(std::is_arithmetic<T>::value, "T must be an arithmetic type");
+  const double DX{static_cast<double>(b[0]) - static_cast<double>(a[0])};
+  const double DY{static_cast<double>(b[1]) - static_cast<double>(a[1])};
+  const double LENGTH2{DX * DX + DY * DY};
+  double t{0.0};
+  if (0.0 < LENGTH2) {
+    t = ((static_cast<double>(p[0]) - static_cast<double>(a[0])) * DX + (static_cast<double>(p[1]) - static_cast<double>(a[1])) * DY) / LENGTH2;
+    t = (std::max)(0.0, (std::min)(1.0, t));
+  }
+  return std::hypot(static_cast<double>(a[0]) + t * DX - static_cast<double>(p[0]), static_cast<double>(a[1]) + t * DY - static_cast<double>(p[1]));
+}
+
+/**
+ * @param bl bottom-left corner of a box
+ * @param tr top-right corner of a box
+ * @param p point
+ * @return Euclidean distance between p and the (closed) box
+ */
+template <typename T>
+inline double distanceToBox(const std::array<T,2> &bl, const std::array<T,2> &tr, const std::array<T,2> &p) {
+  static_assert(std::is_arithmetic<T>::value, "T must be an arithmetic type");
+  const double DX{(std::max)({static_cast<double>(bl[0]) - static_cast<double>(p[0]), 0.0, static_cast<double>(p[0]) - static_cast<double>(tr[0])})};
+  const double DY{(std::max)({static_cast<double>(bl[1]) - static_cast<double>(p[1]), 0.0, static_cast<double>(p[1]) - static_cast<double>(tr[1])})};
+  return std::hypot(DX, DY);
+}
+
+/**
+ * @param polygon describing a geofenced area
+ * @param bl bottom-left corner of a box
+ * @param tr top-right corner of a box
+ * @return INSIDE if the box lies completely within the polygon, OUTSIDE if
+ *         it does not overlap, PARTIAL if an edge of the polygon touches it
+ */
+template <typename T>
+inline Overlap overlapOfPolygon(std::vector<std::array<T,2>> &polygon, const std::array<T,2> &bl, const std::array<T,2> &tr) {
+  static_assert(std::is_arithmetic<T>::value, "T must be an arithmetic type");
+  const std::size_t POINTS{polygon.size()};
+  for (std::size_t i{0}, j{POINTS - 1}; i < POINTS; j = i++) {
+    if (intersects(polygon.at(j), polygon.at(i), bl, tr)) {
+      return PARTIAL;
+    }
+  }
+  // Without an edge in the box, the box is either completely in- or outside.
+  std::array<T,2> center{{(bl[0] + tr[0]) / 2, (bl[1] + tr[1]) / 2}};
+  return isIn(polygon, center) ? INSIDE : OUTSIDE;
+}
+
+/**
+ * @param polyline center line of a corridor
+ * @param width maximum distance to the center line
+ * @param p point to test whether inside or not
+ * @return true if p is within width of any segment of the polyline
+ */
+template <typename T>
+inline bool isInCorridor(const std::vector<std::array<T,2>> &polyline, const double &width, const std::array<T,2> &p) {
+  static_assert(std::is_arithmetic<T>::value, "T must be an arithmetic type");
+  for (std::size_t i{0}; i < polyline.size(); i++) {
+    if (distanceToSegment(polyline.at(i), polyline.at((0 == i) ? 0 : i - 1), p) <= width) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @param polyline center line of a corridor
+ * @param width maximum distance to the center line
+ * @param bl bottom-left corner of a box
+ * @param tr top-right corner of a box
+ * @return INSIDE if the box lies completely within the corridor, OUTSIDE if
+ *         it does not overlap, PARTIAL otherwise
+ */
+template <typename T>
+inline Overlap overlapOfCorridor(const std::vector<std::array<T,2>> &polyline, const double &width, const std::array<T,2> &bl, const std::array<T,2> &tr) {
+  static_assert(std::is_arithmetic<T>::value, "T must be an arithmetic type");
+  const std::array<std::array<T,2>,4> CORNERS{{bl, {{bl[0], tr[1]}}, tr, {{tr[0], bl[1]}}}};
+  Overlap overlap{OUTSIDE};
+  for (std::size_t i{0}; i < polyline.size(); i++) {
+    const std::array<T,2> &a{polyline.at((0 == i) ? 0 : i - 1)};
+    const std::array<T,2> &b{polyline.at(i)};
+    // The area around a segment is convex; hence, it contains the box if it contains all corners.
+    double farthest{0.0};
+    double nearest{(std::min)(distanceToBox(bl, tr, a), distanceToBox(bl, tr, b))};
+    for (const auto &c : CORNERS) {
+      const double D{distanceToSegment(a, b, c)};
+      farthest = (std::max)(farthest, D);
+      nearest = (std::min)(nearest, D);
+    }
+    if (farthest <= width) {
+      return INSIDE;
+    }
+    if (intersects(a, b, bl, tr) || (nearest <= width)) {
+      overlap = PARTIAL;
+    }
+  }
+  return overlap;
+}
+
 }
 #endif
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef HILBERT_HPP
+#define HILBERT_HPP
+
+#include "geofence.hpp"
+#include "morton.hpp"
+#include "lmdb.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Tables "19/<senderStamp>-hilbert" (and "-hilbert-time") index the same
+ * grid of 1e-5 degrees as the tables "-morton" but along a Hilbert curve:
+ * Unlike the Z-order curve, consecutive codes are always neighbouring grid
+ * points, so an area is covered by fewer and longer ranges of codes. Like
+ * with Morton codes, every cell of the quadtree is a single range of codes;
+ * hence, areas are covered with mortonCellsOf and the cells are mapped to
+ * ranges of Hilbert codes (cf. hilbertCoverOf) that are visited with
+ * mortonForEachInCells. The keys are big endian like in the tables
+ * "-morton"; the curve of a table is recorded in its name.
+ */
+enum Curve : uint8_t {
+  CURVE_NONE,
+  CURVE_MORTON,
+  CURVE_HILBERT,
+};
+
+/**
+ * Lookup tables to convert between Morton and Hilbert codes a byte, i.e.,
+ * four levels of the quadtree, at a time: The orientation of the curve within
+ * a cell is one of four states (bit 0: the coordinates are flipped, bit 1: the
+ * coordinates are swapped); per state and byte, the tables hold the converted
+ * byte and the state for the next byte in the upper bits.
+ */
+struct HilbertTables {
+  uint16_t fromMorton[4][256];
+  uint16_t toMorton[4][256];
+
+  constexpr HilbertTables() : fromMorton{}, toMorton{} {
+    for (uint32_t state{0}; state < 4; state++) {
+      for (uint32_t morton{0}; morton < 256; morton++) {
+        uint32_t flipped{state & 1};
+        uint32_t swapped{state >> 1};
+        uint32_t hilbert{0};
+        for (uint32_t level{4}; 0 < level--;) {
+          const uint32_t X{(morton >> (2 * level)) & 1};
+          const uint32_t Y{(morton >> (2 * level + 1)) & 1};
+          const uint32_t RX{((0 != swapped) ? Y : X) ^ flipped};
+          const uint32_t RY{((0 != swapped) ? X : Y) ^ flipped};
+          hilbert |= ((3 * RX) ^ RY) << (2 * level);
+          // Rotate the quadrant so that the lower levels follow the curve.
+          if (0 == RY) {
+            flipped ^= RX;
+            swapped ^= 1;
+          }
+        }
+        const uint32_t NEXT{flipped | (swapped << 1)};
+        fromMorton[state][morton] = static_cast<uint16_t>(hilbert | (NEXT << 8));
+        toMorton[state][hilbert] = static_cast<uint16_t>(morton | (NEXT << 8));
+      }
+    }
+  }
+};
+
+constexpr HilbertTables HILBERT_TABLES{};
+
+/**
+ * @param morton Morton code
+ * @return Hilbert code of the same grid point
+ */
+inline uint64_t hilbertFromMorton(const uint64_t &morton) noexcept {
+  uint64_t code{0};
+  uint32_t state{0};
+  for (uint32_t byte{8}; 0 < byte--;) {
+    const uint16_t ENTRY{HILBERT_TABLES.fromMorton[state][(morton >> (8 * byte)) & 0xFF]};
+    code = (code << 8) | (ENTRY & 0xFF);
+    state = ENTRY >> 8;
+  }
+  return code;
+}
+
+/**
+ * @param code Hilbert code
+ * @return Morton code of the same grid point
+ */
+inline uint64_t mortonFromHilbert(const uint64_t &code) noexcept {
+  uint64_t morton{0};
+  uint32_t state{0};
+  for (uint32_t byte{8}; 0 < byte--;) {
+    const uint16_t ENTRY{HILBERT_TABLES.toMorton[state][(code >> (8 * byte)) & 0xFF]};
+    morton = (morton << 8) | (ENTRY & 0xFF);
+    state = ENTRY >> 8;
+  }
+  return morton;
+}
+
+/**
+ * @param xy grid point as (latitude, longitude)
+ * @return Hilbert code of the grid point
+ */
+inline uint64_t hilbertEncode(const std::pair<uint32_t,uint32_t> &xy) noexcept {
+  return hilbertFromMorton(mortonEncode(xy));
+}
+
+/**
+ * @param code Hilbert code
+ * @return grid point as (latitude, longitude)
+ */
+inline std::pair<uint32_t,uint32_t> hilbertDecode(const uint64_t &code) noexcept {
+  return mortonDecode(mortonFromHilbert(code));
+}
+
+inline uint64_t convertLatLonToHilbert(const std::pair<float,float> &coordinate) {
+  return hilbertFromMorton(convertLatLonToMorton(coordinate));
+}
+
+inline std::pair<float,float> convertHilbertToLatLon(const uint64_t &code) {
+  return convertMortonToLatLon(mortonFromHilbert(code));
+}
+
+/**
+ * @param table name of a table
+ * @return curve of a table "-morton", "-hilbert", or their "-time" tables
+ */
+inline Curve curveOfTable(const std::string &table) noexcept {
+  if (std::string::npos != table.find("-hilbert")) {
+    return CURVE_HILBERT;
+  }
+  return (std::string::npos != table.find("-morton")) ? CURVE_MORTON : CURVE_NONE;
+}
+
+/**
+ * @param table name of a table
+ * @return true for the tables "-morton-time" and "-hilbert-time" (cf. mortonKeyOf)
+ */
+inline bool isCurveTimeTable(const std::string &table) noexcept {
+  const std::string TIME{"-time"};
+  return (CURVE_NONE != curveOfTable(table)) && (table.size() > TIME.size()) && (0 == table.compare(table.size() - TIME.size(), TIME.size(), TIME));
+}
+
+/**
+ * @param curve
+ * @return suffix of the tables for the curve, e.g., "-hilbert"
+ */
+inline std::string curveSuffixOf(const Curve &curve) {
+  return (CURVE_HILBERT == curve) ? "-hilbert" : "-morton";
+}
+
+/**
+ * @param name "morton" or "hilbert"
+ * @return curve or CURVE_NONE for unknown names
+ */
+inline Curve curveOfName(const std::string &name) noexcept {
+  return ("hilbert" == name) ? CURVE_HILBERT : (("morton" == name) ? CURVE_MORTON : CURVE_NONE);
+}
+
+inline uint64_t convertLatLonToCurve(const Curve &curve, const std::pair<float,float> &coordinate) {
+  return (CURVE_HILBERT == curve) ? convertLatLonToHilbert(coordinate) : convertLatLonToMorton(coordinate);
+}
+
+inline std::pair<float,float> convertCurveToLatLon(const Curve &curve, const uint64_t &code) {
+  return (CURVE_HILBERT == curve) ? convertHilbertToLatLon(code) : convertMortonToLatLon(code);
+}
+
+inline std::pair<uint32_t,uint32_t> curveDecode(const Curve &curve, const uint64_t &code) noexcept {
+  return (CURVE_HILBERT == curve) ? hilbertDecode(code) : mortonDecode(code);
+}
+
+/**
+ * This function covers an area with cells of the quadtree (cf. mortonCellsOf)
+ * and maps each cell to its range of Hilbert codes: The codes of a cell with
+ * 4^k grid points share all but their lowest 2k bits. Adjacent ranges are
+ * merged; along the Hilbert curve, neighbouring cells are adjacent more often
+ * than along the Z-order curve.
+ *
+ * @param zmin Morton code of the bottom-left corner of the bounding box
+ * @param zmax Morton code of the top-right corner of the bounding box
+ * @param overlapOf returns the overlap of the area with the cell spanned by
+ *        the Morton codes of its bottom-left and top-right corners
+ * @param maxCells upper limit of cells before merging
+ * @return ranges of Hilbert codes in ascending order
+ */
+inline std::vector<MortonCell> hilbertCoverOf(const uint64_t &zmin, const uint64_t &zmax, std::function<geofence::Overlap(const uint64_t &bl, const uint64_t &tr)> overlapOf, const std::size_t &maxCells) {
+  std::vector<MortonCell> cells{mortonCellsOf(zmin, zmax, overlapOf, maxCells)};
+  for (auto &c : cells) {
+    const uint64_t SPAN{c.last - c.first};
+    c.first = hilbertFromMorton(c.first) & ~SPAN;
+    c.last = c.first | SPAN;
+  }
+  return mortonMergeCells(cells);
+}
+
+/**
+ * This function visits all entries of a table "-hilbert" (opened with
+ * compareMortonKeys) within a box. The box is covered by up to maxCells
+ * ranges of Hilbert codes (cf. hilbertCoverOf) and only the entries in
+ * ranges at the border of the box are checked individually.
+ *
+ * @param cursor cursor on the table "-hilbert"
+ * @param zmin Morton code of the bottom-left corner of the box
+ * @param zmax Morton code of the top-right corner of the box
+ * @param delegate called with a Hilbert code in the box and a batch of its
+ *        values (cf. mortonForEachInBox)
+ * @param bucket time bucket to scan in a table "-hilbert-time" or nullptr
+ * @param maxCells upper limit of cells to cover the box
+ * @return number of seeks
+ */
+inline uint64_t hilbertForEachInBox(MDB_cursor *cursor, const uint64_t &zmin, const uint64_t &zmax, std::function<void(const uint64_t &code, const MDB_val &values)> delegate, const int64_t *bucket = nullptr, const std::size_t &maxCells = 256) {
+  const auto BL{mortonDecode(zmin)};
+  const auto TR{mortonDecode(zmax)};
+  const std::vector<MortonCell> cells{hilbertCoverOf(zmin, zmax, [&BL, &TR](const uint64_t &bl, const uint64_t &tr) {
+    const auto CELL_BL{mortonDecode(bl)};
+    const auto CELL_TR{mortonDecode(tr)};
+    if ( (CELL_TR.first < BL.first) || (CELL_BL.first > TR.first) || (CELL_TR.second < BL.second) || (CELL_BL.second > TR.second) ) {
+      return geofence::OUTSIDE;
+    }
+    if ( (BL.first <= CELL_BL.first) && (CELL_TR.first <= TR.first) && (BL.second <= CELL_BL.second) && (CELL_TR.second <= TR.second) ) {
+      return geofence::INSIDE;
+    }
+    return geofence::PARTIAL;
+  }, maxCells)};
+  return mortonForEachInCells(cursor, cells, [&BL, &TR](const uint64_t &code) {
+    const auto P{hilbertDecode(code)};
+    return (BL.first <= P.first) && (P.first <= TR.first) && (BL.second <= P.second) && (P.second <= TR.second);
+  }, delegate, bucket);
+}
+
+#endif
@@ -13,8 +13,70 @@
 #include "db.hpp"
 #include "lmdb.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/**
+ * Layouts of the keys, stored in the lower two bits of cabinet::Key.version:
+ *
+ * KEY_LAYOUT_COMPARE_KEYS: all fields in big Endian; tables with such keys
+ *                          must be opened with compareKeys, which orders them
+ *                          by (timeStamp, dataType, senderStamp, hash).
+ * KEY_LAYOUT_MEMCMP: like KEY_LAYOUT_COMPARE_KEYS but with flipped sign bits
+ *                    for timeStamp and dataType so that LMDB's default memcmp
+ *                    orders the keys by (timeStamp, dataType, senderStamp,
+ *                    hash, ...); tables with such keys need no comparator.
+ *
+ * The layouts differ for duplicated Envelopes: compareKeys ignores the fields
+ * after the xxhash and hence, storing an Envelope again fails with
+ * MDB_KEYEXIST. With memcmp, the keys of the same Envelope differ if, e.g.,
+ * hashOfRecFile or userData differ; such a duplicate must be found by its
+ * xxhash before storing it (cf. DuplicateFilter::isStored).
+ */
+constexpr uint8_t KEY_LAYOUT_COMPARE_KEYS{0};
+constexpr uint8_t KEY_LAYOUT_MEMCMP{1};
+constexpr uint8_t KEY_LAYOUT_MASK{0x03};
+
+/**
+ * Flag in cabinet::Key.version for keys of blocks: The value holds
+ * consecutive Envelopes of one stream concatenated like in a .rec file and
+ * encoded together with the codec from the upper four bits of the version.
+ * The field timeStamp is the first timeStamp in the block, the field xxhash
+ * holds the last timeStamp, the field xxhash of source file holds the number
+ * of Envelopes, and the field length holds the length of the uncompressed
+ * block modulo 2^16.
+ */
+constexpr uint8_t KEY_BLOCK{0x04};
+
+/**
+ * Flag in cabinet::Key.version for keys in "all" that carry their value:
+ * The value, encoded with the codec from the upper four bits of the version,
+ * follows the fixed fields of the key and the LMDB value is empty. Tables
+ * like "dataType/senderStamp" store only the fixed fields of such keys.
+ */
+constexpr uint8_t KEY_INLINE_VALUE{0x08};
+
+/**
+ * @param v signed value
+ * @return v with flipped sign bit to make its big Endian representation byte-comparable
+ */
+constexpr int64_t flipSignBit(const int64_t &v) noexcept {
+  return static_cast<int64_t>(static_cast<uint64_t>(v) ^ 0x8000000000000000ULL);
+}
+constexpr int32_t flipSignBit(const int32_t &v) noexcept {
+  return static_cast<int32_t>(static_cast<uint32_t>(v) ^ 0x80000000UL);
+}
+
 /**
- * This function compares two lmdb keys based on the nanoseconds time stamp.
+ * This function compares two lmdb keys based on the nanoseconds time stamp,
+ * followed by dataType, senderStamp, and xxhash so that Envelopes with the same
+ * sampleTimeStamp are stored side by side with their original time stamp.
+ * Shorter keys like the time stamp to position a cursor are ordered before
+ * longer keys with the same prefix. Older cabinets resolved collisions by
+ * shifting the time stamp by 1ns; as their time stamps are unique, they are
+ * ordered identically.
  *
  * @param a LHS
  * @param b RHS
@@ -34,10 +96,144 @@ inline int compareKeys(const MDB_val *a, const MDB_val *b) {
   int64_t rhs{*(static_cast<int64_t*>(b->mv_data))};
   lhs = be64toh(lhs);
   rhs = be64toh(rhs);
-  const int64_t delta{lhs - rhs};
-  return (delta < 0 ? -1 : (delta > 0 ? 1 : 0));
+  if (lhs != rhs) {
+    return (lhs < rhs ? -1 : 1);
+  }
+
+  // Fields b8-b23 that are present in both keys.
+  constexpr size_t END_OF_HASH{24};
+  const size_t A_SIZE{std::min(a->mv_size, END_OF_HASH)};
+  const size_t B_SIZE{std::min(b->mv_size, END_OF_HASH)};
+  const size_t LEN{std::min(A_SIZE, B_SIZE)};
+  const char *lhsFields{static_cast<const char*>(a->mv_data)};
+  const char *rhsFields{static_cast<const char*>(b->mv_data)};
+  if (LEN >= 12) {
+    // b8-b11: int32_t for dataType
+    int32_t lhsDataType{0};
+    int32_t rhsDataType{0};
+    std::memcpy(&lhsDataType, lhsFields + 8, sizeof(int32_t));
+    std::memcpy(&rhsDataType, rhsFields + 8, sizeof(int32_t));
+    lhsDataType = static_cast<int32_t>(be32toh(lhsDataType));
+    rhsDataType = static_cast<int32_t>(be32toh(rhsDataType));
+    if (lhsDataType != rhsDataType) {
+      return (lhsDataType < rhsDataType ? -1 : 1);
+    }
+    // b12-b15: uint32_t for senderStamp, b16-b23: uint64_t for xxhash; both
+    // unsigned in big Endian and hence, byte-comparable.
+    const int delta{std::memcmp(lhsFields + 12, rhsFields + 12, LEN - 12)};
+    if (0 != delta) {
+      return (delta < 0 ? -1 : 1);
+    }
+  }
+  return (A_SIZE < B_SIZE ? -1 : (A_SIZE > B_SIZE ? 1 : 0));
 };
 
+/**
+ * Fixed layout of a serialized cabinet::Key; all fields are stored in big
+ * Endian at these offsets:
+ *
+ * b0-b7: int64_t for timeStamp in nanoseconds
+ * b8-b11: int32_t for dataType
+ * b12-b15: uint32_t for senderStamp
+ * b16-b23: uint64_t for xxhash
+ * b24-b27: uint32_t for xxhash of source file
+ * b28-b29: uint16_t for length of uncompressed Envelope
+ * b30-b37: uint64_t for userData
+ * b38: uint8_t for version
+ */
+constexpr size_t KEY_OFFSET_TIMESTAMP{0};
+constexpr size_t KEY_OFFSET_DATATYPE{8};
+constexpr size_t KEY_OFFSET_SENDERSTAMP{12};
+constexpr size_t KEY_OFFSET_HASH{16};
+constexpr size_t KEY_OFFSET_HASHOFRECFILE{24};
+constexpr size_t KEY_OFFSET_LENGTH{28};
+constexpr size_t KEY_OFFSET_USERDATA{30};
+constexpr size_t KEY_OFFSET_VERSION{38};
+constexpr size_t KEY_SIZE{39};
+
+/**
+ * Largest value that fits inline into a key with LMDB's default maximum key
+ * size of 511 bytes.
+ */
+constexpr size_t KEY_MAX_INLINE_VALUE{511 - KEY_SIZE};
+
+/**
+ * @param src char array with at least sizeof(T) bytes in big Endian
+ * @return value in host byte order
+ */
+template <typename T>
+constexpr T readBigEndian(const char *src) noexcept {
+  uint64_t v{0};
+  for (size_t i{0}; i < sizeof(T); i++) {
+    v = (v << 8) | static_cast<uint8_t>(src[i]);
+  }
+  return static_cast<T>(v);
+}
+
+/**
+ * @param v value in host byte order
+ * @param dest char array with at least sizeof(T) bytes to write v in big Endian
+ */
+template <typename T>
+constexpr void writeBigEndian(const T &v, char *dest) noexcept {
+  for (size_t i{0}; i < sizeof(T); i++) {
+    dest[i] = static_cast<char>(static_cast<uint64_t>(v) >> (8 * (sizeof(T) - 1 - i)));
+  }
+}
+
+/**
+ * @param v value in host byte order
+ * @param dest buffer to append v in big Endian to
+ */
+template <typename T>
+inline void appendBigEndian(const T &v, std::vector<char> &dest) {
+  const size_t SIZE{dest.size()};
+  dest.resize(SIZE + sizeof(T));
+  writeBigEndian(v, dest.data() + SIZE);
+}
+
+/*
+ * The following functions read a single field from a serialized key of at
+ * least KEY_SIZE bytes without extracting a cabinet::Key; timeStamp and
+ * dataType are returned with their original sign in both layouts.
+ */
+constexpr uint8_t keyVersion(const char *src) noexcept {
+  return readBigEndian<uint8_t>(src + KEY_OFFSET_VERSION);
+}
+constexpr uint8_t keyLayout(const char *src) noexcept {
+  return static_cast<uint8_t>(keyVersion(src) & KEY_LAYOUT_MASK);
+}
+constexpr int64_t keyTimeStamp(const char *src) noexcept {
+  return (KEY_LAYOUT_MEMCMP == keyLayout(src)) ? flipSignBit(readBigEndian<int64_t>(src + KEY_OFFSET_TIMESTAMP)) : readBigEndian<int64_t>(src + KEY_OFFSET_TIMESTAMP);
+}
+constexpr int32_t keyDataType(const char *src) noexcept {
+  return (KEY_LAYOUT_MEMCMP == keyLayout(src)) ? flipSignBit(readBigEndian<int32_t>(src + KEY_OFFSET_DATATYPE)) : readBigEndian<int32_t>(src + KEY_OFFSET_DATATYPE);
+}
+constexpr uint32_t keySenderStamp(const char *src) noexcept {
+  return readBigEndian<uint32_t>(src + KEY_OFFSET_SENDERSTAMP);
+}
+constexpr uint64_t keyHash(const char *src) noexcept {
+  return readBigEndian<uint64_t>(src + KEY_OFFSET_HASH);
+}
+constexpr uint32_t keyHashOfRecFile(const char *src) noexcept {
+  return readBigEndian<uint32_t>(src + KEY_OFFSET_HASHOFRECFILE);
+}
+constexpr uint16_t keyLength(const char *src) noexcept {
+  return readBigEndian<uint16_t>(src + KEY_OFFSET_LENGTH);
+}
+constexpr uint64_t keyUserData(const char *src) noexcept {
+  return readBigEndian<uint64_t>(src + KEY_OFFSET_USERDATA);
+}
+constexpr bool keyIsBlock(const char *src) noexcept {
+  return 0 != (keyVersion(src) & KEY_BLOCK);
+}
+constexpr int64_t keyBlockLastTimeStamp(const char *src) noexcept {
+  return keyIsBlock(src) ? static_cast<int64_t>(keyHash(src)) : keyTimeStamp(src);
+}
+constexpr uint32_t keyBlockCount(const char *src) noexcept {
+  return keyIsBlock(src) ? keyHashOfRecFile(src) : 1;
+}
+
 /**
  * This function writes the data structure cabinet::Key into a char array.
  *
@@ -46,45 +242,67 @@ inline int compareKeys(const MDB_val *a, const MDB_val *b) {
  * @param len size of the char array
  * @return bytes dumped
  */
-inline size_t setKey(cabinet::Key k, char *dest, const size_t &len) noexcept {
-  // b0-b7: int64_t for timeStamp in nanoseconds
-  // b8-b11: int32_t for dataType
-  // b12-b15: uint32_t for senderStamp
-  // b16-b23: uint64_t for xxhash
-  // b24-b27: uint32_t for xxhash of source file
-  // b28-b29: uint16_t for length of uncompressed Envelope
-  // b30-b37: uint64_t for userData
-  // b38: uint8_t for version
-  const size_t MIN_LEN{sizeof(decltype(k.timeStamp()))
-                      +sizeof(decltype(k.dataType()))
-                      +sizeof(decltype(k.senderStamp()))
-                      +sizeof(decltype(k.hash()))
-                      +sizeof(decltype(k.hashOfRecFile()))
-                      +sizeof(decltype(k.length()))
-                      +sizeof(decltype(k.userData()))
-                      +sizeof(decltype(k.version()))};
-  if ( (nullptr != dest) && (MIN_LEN <= len) ) {
-    uint16_t offset{0};
-    // "visiting" message data structure that describes a key
-    k.accept([](uint32_t, const std::string &, const std::string &) {},
-             [dest, &offset](uint32_t field, std::string &&, std::string &&, auto v) {
-              // only dump the first 8 fields.
-              if (8 >= field) {
-                // convert values to network byte order.
-                decltype(v) hton{v};
-                if (2 == sizeof(v)) { hton = htobe16(v); }
-                else if (4 == sizeof(v)) { hton = htobe32(v); }
-                else if (8 == sizeof(v)) { hton = htobe64(v); }
-                // dump values as specified in .odvd file
-                std::memcpy(dest + offset, reinterpret_cast<const char*>(&hton), sizeof(hton));
-                offset += sizeof(hton);
-              }
-             },
-             [](){}
-            );
-    return offset;   
+inline size_t setKey(const cabinet::Key &k, char *dest, const size_t &len) noexcept {
+  if ( (nullptr == dest) || (KEY_SIZE > len) ) {
+    return 0;
   }
-  return 0;
+  const bool FLIP{KEY_LAYOUT_MEMCMP == (k.version() & KEY_LAYOUT_MASK)};
+  writeBigEndian(FLIP ? flipSignBit(k.timeStamp()) : k.timeStamp(), dest + KEY_OFFSET_TIMESTAMP);
+  writeBigEndian(FLIP ? flipSignBit(k.dataType()) : k.dataType(), dest + KEY_OFFSET_DATATYPE);
+  writeBigEndian(k.senderStamp(), dest + KEY_OFFSET_SENDERSTAMP);
+  writeBigEndian(k.hash(), dest + KEY_OFFSET_HASH);
+  writeBigEndian(k.hashOfRecFile(), dest + KEY_OFFSET_HASHOFRECFILE);
+  writeBigEndian(k.length(), dest + KEY_OFFSET_LENGTH);
+  writeBigEndian(k.userData(), dest + KEY_OFFSET_USERDATA);
+  writeBigEndian(k.version(), dest + KEY_OFFSET_VERSION);
+  return KEY_SIZE;
+}
+
+/**
+ * This function writes the data structure cabinet::Key followed by its value
+ * into a char array and marks the key with KEY_INLINE_VALUE.
+ *
+ * @param k Key to write
+ * @param value value to store inline, already encoded with the codec of k
+ * @param valueLength length of the value
+ * @param dest char array to write to
+ * @param len size of the char array
+ * @return bytes dumped or 0 if the value does not fit into dest
+ */
+inline size_t setKey(const cabinet::Key &k, const char *value, const size_t &valueLength, char *dest, const size_t &len) noexcept {
+  if ( (KEY_SIZE + valueLength > len) || ((nullptr == value) && (0 < valueLength)) || (KEY_SIZE != setKey(k, dest, len)) ) {
+    return 0;
+  }
+  dest[KEY_OFFSET_VERSION] = static_cast<char>(k.version() | KEY_INLINE_VALUE);
+  if (0 < valueLength) {
+    std::memcpy(dest + KEY_SIZE, value, valueLength);
+  }
+  return KEY_SIZE + valueLength;
+}
+
+/**
+ * This function returns the stored value of an entry from "all", which is
+ * either the LMDB value or inline in its key; decode the returned value with
+ * the codec from the key.
+ *
+ * @param key key of the entry
+ * @param value LMDB value of the entry
+ * @return stored value
+ */
+inline MDB_val storedValueOf(const MDB_val &key, const MDB_val &value) noexcept {
+  const char *src{static_cast<const char*>(key.mv_data)};
+  if ( (nullptr != src) && (KEY_SIZE <= key.mv_size) && (0 != (keyVersion(src) & KEY_INLINE_VALUE)) ) {
+    return MDB_val{key.mv_size - KEY_SIZE, const_cast<char*>(src + KEY_SIZE)};
+  }
+  return value;
+}
+
+/**
+ * @param key key from "all" possibly with an inline value
+ * @return fixed fields of the key as stored in tables like "dataType/senderStamp"
+ */
+inline MDB_val fixedFieldsOf(const MDB_val &key) noexcept {
+  return MDB_val{std::min(key.mv_size, KEY_SIZE), key.mv_data};
 }
 
 /**
@@ -96,39 +314,114 @@ inline size_t setKey(cabinet::Key k, char *dest, const size_t &len) noexcept {
  */
 inline cabinet::Key getKey(const char *src, const size_t &len) noexcept {
   cabinet::Key k;
-  const size_t MIN_LEN{sizeof(decltype(k.timeStamp()))
-                      +sizeof(decltype(k.dataType()))
-                      +sizeof(decltype(k.senderStamp()))
-                      +sizeof(decltype(k.hash()))
-                      +sizeof(decltype(k.hashOfRecFile()))
-                      +sizeof(decltype(k.length()))
-                      +sizeof(decltype(k.userData()))
-                      +sizeof(decltype(k.version()))};
-  if ( (nullptr != src) && (MIN_LEN <= len) ) {
-    uint16_t offset{0};
-    // "visiting" message data structure to read a key
-    k.accept([](uint32_t, const std::string &, const std::string &) {},
-             [src, &offset](uint32_t field, std::string &&, std::string &&, auto &v) {
-              // only extract the first 8 fields.
-              if (8 >= field) {
-                decltype(v) ntoh{v};
-
-                // read values as specified in .odvd file
-                std::memcpy(reinterpret_cast<char*>(&ntoh), src + offset, sizeof(ntoh));
-                offset += sizeof(ntoh);
-
-                // convert values to host byte order.
-                if (2 == sizeof(v)) { ntoh = be16toh(v); }
-                else if (4 == sizeof(v)) { ntoh = be32toh(v); }
-                else if (8 == sizeof(v)) { ntoh = be64toh(v); }
-
-                v = ntoh;
-              }
-             },
-             [](){}
-            );
+  if ( (nullptr != src) && (KEY_SIZE <= len) ) {
+    k.timeStamp(keyTimeStamp(src))
+     .dataType(keyDataType(src))
+     .senderStamp(keySenderStamp(src))
+     .hash(keyHash(src))
+     .hashOfRecFile(keyHashOfRecFile(src))
+     .length(keyLength(src))
+     .userData(keyUserData(src))
+     .version(keyVersion(src));
   }
   return k;
 }
 
+/**
+ * This function extracts selected fields from many keys at once into columns,
+ * for instance to filter a batch of keys read from a cursor. Columns passed
+ * as nullptr are skipped; keys shorter than KEY_SIZE yield 0 in all columns.
+ *
+ * @param keys array of keys to read from
+ * @param n number of keys
+ * @param timeStamps column for n timeStamps or nullptr
+ * @param dataTypes column for n dataTypes or nullptr
+ * @param senderStamps column for n senderStamps or nullptr
+ * @param hashes column for n xxhashes or nullptr
+ * @return number of keys with KEY_SIZE or more bytes
+ */
+inline size_t getKeyColumns(const MDB_val *keys, const size_t &n, int64_t *timeStamps, int32_t *dataTypes, uint32_t *senderStamps, uint64_t *hashes = nullptr) noexcept {
+  size_t decoded{0};
+  for (size_t i{0}; (nullptr != keys) && (i < n); i++) {
+    const char *src{static_cast<const char*>(keys[i].mv_data)};
+    const bool VALID{(nullptr != src) && (KEY_SIZE <= keys[i].mv_size)};
+    if (nullptr != timeStamps) { timeStamps[i] = VALID ? keyTimeStamp(src) : 0; }
+    if (nullptr != dataTypes) { dataTypes[i] = VALID ? keyDataType(src) : 0; }
+    if (nullptr != senderStamps) { senderStamps[i] = VALID ? keySenderStamp(src) : 0; }
+    if (nullptr != hashes) { hashes[i] = VALID ? keyHash(src) : 0; }
+    decoded += VALID ? 1 : 0;
+  }
+  return decoded;
+}
+
+/**
+ * This function writes the shortest key to position a cursor with
+ * MDB_SET_RANGE at the first key not before the given timeStamp.
+ *
+ * @param timeStamp timeStamp in nanoseconds
+ * @param layout layout of the keys in the table
+ * @param dest char array to write to
+ * @param len size of the char array
+ * @return bytes dumped
+ */
+inline size_t setKeyPrefix(const int64_t &timeStamp, const uint8_t &layout, char *dest, const size_t &len) noexcept {
+  if ( (nullptr != dest) && (sizeof(timeStamp) <= len) ) {
+    const int64_t hton = htobe64((KEY_LAYOUT_MEMCMP == layout) ? flipSignBit(timeStamp) : timeStamp);
+    std::memcpy(dest, &hton, sizeof(hton));
+    return sizeof(hton);
+  }
+  return 0;
+}
+
+/**
+ * This function detects the layout of the keys in a table from its first
+ * key; all keys in a cabinet share the same layout.
+ *
+ * @param txn transaction to read from
+ * @param dbi table with cabinet::Keys
+ * @param defaultLayout layout to return for an empty table
+ * @return layout of the keys in the table
+ */
+inline uint8_t keyLayoutOf(MDB_txn *txn, const MDB_dbi &dbi, const uint8_t &defaultLayout = KEY_LAYOUT_COMPARE_KEYS) noexcept {
+  uint8_t layout{defaultLayout};
+  MDB_cursor *cursor{nullptr};
+  if (MDB_SUCCESS == mdb_cursor_open(txn, dbi, &cursor)) {
+    // MDB_FIRST does not compare keys and works before setting a comparator.
+    MDB_val key;
+    MDB_val value;
+    if (MDB_SUCCESS == mdb_cursor_get(cursor, &key, &value, MDB_FIRST)) {
+      layout = (KEY_SIZE <= key.mv_size) ? keyLayout(static_cast<char*>(key.mv_data)) : KEY_LAYOUT_COMPARE_KEYS;
+    }
+    mdb_cursor_close(cursor);
+  }
+  return layout;
+}
+
+/**
+ * This function sets the comparator for a table with cabinet::Keys in the
+ * given layout; it must be called before the first lookup in the table.
+ *
+ * @param txn transaction
+ * @param dbi table with cabinet::Keys
+ * @param layout layout of the keys in the table
+ * @return MDB_SUCCESS or LMDB error code
+ */
+inline int setKeyCompare(MDB_txn *txn, const MDB_dbi &dbi, const uint8_t &layout) noexcept {
+  return (KEY_LAYOUT_COMPARE_KEYS == layout) ? mdb_set_compare(txn, dbi, &compareKeys) : MDB_SUCCESS;
+}
+
+/**
+ * This function detects the layout of the keys in a table opened for reading
+ * and sets its comparator accordingly.
+ *
+ * @param txn transaction
+ * @param dbi table with cabinet::Keys
+ * @return layout of the keys in the table
+ */
+inline uint8_t useKeyLayoutOf(MDB_txn *txn, const MDB_dbi &dbi) noexcept {
+  const uint8_t layout{keyLayoutOf(txn, dbi)};
+  setKeyCompare(txn, dbi, layout);
+  return layout;
+}
+
 #endif
@@ -10,9 +10,15 @@
 #define MORTON_HPP
 
 #include "cluon-complete.hpp"
+#include "geofence.hpp"
 #include "lmdb.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <utility>
+#include <vector>
 #include <cmath>
+#include <cstring>
 
 /**
  * This function compares two lmdb keys based on computed Morton keys.
@@ -87,5 +93,495 @@ inline std::pair<float,float> convertMortonToLatLon(uint64_t code) {
   return std::make_pair(_lat, _lon);
 }
 
+/**
+ * Helpers for BIGMIN and LITMAX: For the dimension of bit in a Morton code,
+ * mortonLoad1000 sets bit and clears the lower bits of that dimension,
+ * mortonLoad0111 clears bit and sets the lower bits of that dimension.
+ */
+inline uint64_t mortonBelowInDimension(const uint32_t &bit) {
+  const uint64_t DIMENSION{(0 == (bit % 2)) ? 0x5555555555555555ULL : 0xAAAAAAAAAAAAAAAAULL};
+  return DIMENSION & ((1ULL << bit) - 1ULL);
+}
+
+inline uint64_t mortonLoad1000(const uint64_t &code, const uint32_t &bit) {
+  return (code | (1ULL << bit)) & ~mortonBelowInDimension(bit);
+}
+
+inline uint64_t mortonLoad0111(const uint64_t &code, const uint32_t &bit) {
+  return (code & ~(1ULL << bit)) | mortonBelowInDimension(bit);
+}
+
+/**
+ * This function computes BIGMIN (Tropf and Herzog, 1981): the smallest Morton
+ * code larger than code within the box spanned by the Morton codes of its
+ * bottom-left and top-right corners.
+ *
+ * @param code Morton code outside of the box with zmin < code < zmax
+ * @param zmin Morton code of the bottom-left corner of the box
+ * @param zmax Morton code of the top-right corner of the box
+ * @return BIGMIN
+ */
+inline uint64_t mortonBigMin(const uint64_t &code, uint64_t zmin, uint64_t zmax) {
+  uint64_t bigmin{0};
+  for (uint32_t bit{64}; 0 < bit--;) {
+    const uint64_t MASK{1ULL << bit};
+    const bool C{0 != (code & MASK)};
+    const bool MIN{0 != (zmin & MASK)};
+    const bool MAX{0 != (zmax & MASK)};
+    if (!C && !MIN && MAX) {
+      bigmin = mortonLoad1000(zmin, bit);
+      zmax = mortonLoad0111(zmax, bit);
+    }
+    else if (!C && MIN && MAX) {
+      return zmin;
+    }
+    else if (C && !MIN && !MAX) {
+      return bigmin;
+    }
+    else if (C && !MIN && MAX) {
+      zmin = mortonLoad1000(zmin, bit);
+    }
+  }
+  return bigmin;
+}
+
+/**
+ * This function computes LITMAX (Tropf and Herzog, 1981): the largest Morton
+ * code smaller than code within the box spanned by the Morton codes of its
+ * bottom-left and top-right corners.
+ *
+ * @param code Morton code outside of the box with zmin < code < zmax
+ * @param zmin Morton code of the bottom-left corner of the box
+ * @param zmax Morton code of the top-right corner of the box
+ * @return LITMAX
+ */
+inline uint64_t mortonLitMax(const uint64_t &code, uint64_t zmin, uint64_t zmax) {
+  uint64_t litmax{0};
+  for (uint32_t bit{64}; 0 < bit--;) {
+    const uint64_t MASK{1ULL << bit};
+    const bool C{0 != (code & MASK)};
+    const bool MIN{0 != (zmin & MASK)};
+    const bool MAX{0 != (zmax & MASK)};
+    if (!C && !MIN && MAX) {
+      zmax = mortonLoad0111(zmax, bit);
+    }
+    else if (!C && MIN && MAX) {
+      return litmax;
+    }
+    else if (C && !MIN && !MAX) {
+      return zmax;
+    }
+    else if (C && !MIN && MAX) {
+      litmax = mortonLoad0111(zmax, bit);
+      zmin = mortonLoad1000(zmin, bit);
+    }
+  }
+  return litmax;
+}
+
+/**
+ * @param code Morton code
+ * @param zmin Morton code of the bottom-left corner of the box
+ * @param zmax Morton code of the top-right corner of the box
+ * @return true if code is within the box
+ */
+inline bool mortonIsInBox(const uint64_t &code, const uint64_t &zmin, const uint64_t &zmax) {
+  const auto p = mortonDecode(code);
+  const auto bl = mortonDecode(zmin);
+  const auto tr = mortonDecode(zmax);
+  return (bl.first <= p.first) && (p.first <= tr.first) && (bl.second <= p.second) && (p.second <= tr.second);
+}
+
+/**
+ * @param a corner of a box as latitude/longitude
+ * @param b opposite corner of the box as latitude/longitude
+ * @return Morton codes of the bottom-left and top-right corners of the box
+ */
+inline std::pair<uint64_t, uint64_t> convertLatLonBoxToMorton(const std::pair<float,float> &a, const std::pair<float,float> &b) {
+  const auto A = mortonDecode(convertLatLonToMorton(a));
+  const auto B = mortonDecode(convertLatLonToMorton(b));
+  return std::make_pair(mortonEncode(std::make_pair(std::min(A.first, B.first), std::min(A.second, B.second))),
+                        mortonEncode(std::make_pair(std::max(A.first, B.first), std::max(A.second, B.second))));
+}
+
+/**
+ * This function decodes a batch of timeStamps in big endian, i.e., the
+ * fixed-size duplicates of a table "-morton" as returned by
+ * MDB_GET_MULTIPLE/MDB_NEXT_MULTIPLE.
+ *
+ * @param values duplicates of a Morton code
+ * @param timeStamps decoded timeStamps in nanoseconds
+ */
+inline void mortonTimeStampsOf(const MDB_val &values, std::vector<int64_t> &timeStamps) {
+  const std::size_t N{values.mv_size / sizeof(int64_t)};
+  timeStamps.resize(N);
+  if (0 < N) {
+    std::memcpy(timeStamps.data(), values.mv_data, N * sizeof(int64_t));
+  }
+  // A plain loop over the copied batch so that the compiler can vectorize the byte swaps.
+  uint64_t *ptr{reinterpret_cast<uint64_t*>(timeStamps.data())};
+  for (std::size_t i{0}; i < N; i++) {
+    ptr[i] = be64toh(ptr[i]);
+  }
+}
+
+/**
+ * Tables "19/<senderStamp>-morton-time" index the timeStamps additionally by
+ * time: Their keys are a bucket of MORTON_TIME_BUCKET nanoseconds (with a
+ * flipped sign bit) followed by the Morton code, both big endian, so that
+ * LMDB's default memcmp orders them by bucket and then along the Z-order
+ * curve; the values are the timeStamps like in the tables "-morton". Hence,
+ * an area within a time range is scanned once per bucket with entries in the
+ * range instead of visiting all entries of the area across all time.
+ */
+constexpr int64_t MORTON_TIME_BUCKET{3600L * 1000L * 1000L * 1000L};
+
+/**
+ * @param timeStamp in nanoseconds
+ * @return time bucket of the timeStamp
+ */
+inline int64_t mortonBucketOf(const int64_t &timeStamp) noexcept {
+  return (timeStamp / MORTON_TIME_BUCKET) - (((timeStamp % MORTON_TIME_BUCKET) < 0) ? 1 : 0);
+}
+
+/**
+ * @param bucket time bucket for tables "-morton-time" or nullptr for tables "-morton"
+ * @param morton Morton code
+ * @param buffer of two uint64_t for the key
+ * @return key pointing to buffer
+ */
+inline MDB_val mortonKeyOf(const int64_t *bucket, const uint64_t &morton, uint64_t *buffer) noexcept {
+  if (nullptr == bucket) {
+    buffer[0] = htobe64(morton);
+    return MDB_val{sizeof(uint64_t), buffer};
+  }
+  buffer[0] = htobe64(static_cast<uint64_t>(*bucket) ^ 0x8000000000000000ULL);
+  buffer[1] = htobe64(morton);
+  return MDB_val{2 * sizeof(uint64_t), buffer};
+}
+
+/**
+ * @param key key of a table "-morton-time"
+ * @param bucket time bucket of the key
+ * @return false if the key is not from a table "-morton-time"
+ */
+inline bool mortonBucketFromKey(const MDB_val &key, int64_t &bucket) noexcept {
+  if (2 * sizeof(uint64_t) != key.mv_size) {
+    return false;
+  }
+  uint64_t tmp{0};
+  std::memcpy(&tmp, key.mv_data, sizeof(tmp));
+  bucket = static_cast<int64_t>(be64toh(tmp) ^ 0x8000000000000000ULL);
+  return true;
+}
+
+/**
+ * @param key key of a table "-morton" or "-morton-time"
+ * @param bucket time bucket that the key must belong to or nullptr for tables "-morton"
+ * @param morton Morton code of the key
+ * @return false if the key does not belong to the bucket
+ */
+inline bool mortonFromKey(const MDB_val &key, const int64_t *bucket, uint64_t &morton) noexcept {
+  std::size_t offset{0};
+  if (nullptr != bucket) {
+    int64_t b{0};
+    if (!mortonBucketFromKey(key, b) || (b != *bucket)) {
+      return false;
+    }
+    offset = sizeof(uint64_t);
+  }
+  else if (sizeof(uint64_t) > key.mv_size) {
+    return false;
+  }
+  std::memcpy(&morton, static_cast<const char*>(key.mv_data) + offset, sizeof(morton));
+  morton = be64toh(morton);
+  return true;
+}
+
+/**
+ * This function passes the values at the cursor to delegate and moves the
+ * cursor to the next value (without MDB_DUPFIXED) or to the next Morton code
+ * (with MDB_DUPFIXED, where the duplicates are fetched a page at a time).
+ *
+ * @param cursor cursor on the table "-morton" at the first value of morton
+ * @param key current key; updated to the next key
+ * @param value current value; updated to the next value
+ * @param MULTIPLE true if the table was created with MDB_DUPFIXED
+ * @param morton current Morton code
+ * @param delegate called with morton and a batch of its values
+ * @return result of the last cursor operation
+ */
+inline int32_t mortonVisitValues(MDB_cursor *cursor, MDB_val &key, MDB_val &value, const bool &MULTIPLE, const uint64_t &morton, const std::function<void(const uint64_t &morton, const MDB_val &values)> &delegate) {
+  int32_t rc{MDB_SUCCESS};
+  // LMDB keeps the state of the duplicates of a previous key when moving to a key
+  // with a single value; hence, MDB_GET_MULTIPLE is only used with duplicates.
+  std::size_t count{1};
+  if (MULTIPLE && (MDB_SUCCESS == mdb_cursor_count(cursor, &count)) && (1 < count)) {
+    // The cursor is at the first duplicate.
+    rc = mdb_cursor_get(cursor, &key, &value, MDB_GET_MULTIPLE);
+    while (MDB_SUCCESS == rc) {
+      if (delegate) {
+        delegate(morton, value);
+      }
+      rc = mdb_cursor_get(cursor, &key, &value, MDB_NEXT_MULTIPLE);
+    }
+    rc = mdb_cursor_get(cursor, &key, &value, MDB_NEXT_NODUP);
+  }
+  else {
+    if (delegate) {
+      delegate(morton, value);
+    }
+    rc = mdb_cursor_get(cursor, &key, &value, MDB_NEXT);
+  }
+  return rc;
+}
+
+/**
+ * This function visits all entries of a table "-morton" (opened with
+ * compareMortonKeys) within a box. Instead of scanning all keys between zmin
+ * and zmax, the cursor jumps to BIGMIN whenever it leaves the box so that only
+ * the pages with keys in the box and the pages at its borders are read. For
+ * tables with MDB_DUPFIXED, the duplicates of a Morton code are fetched a
+ * page at a time with MDB_GET_MULTIPLE/MDB_NEXT_MULTIPLE.
+ *
+ * @param cursor cursor on the table "-morton"
+ * @param zmin Morton code of the bottom-left corner of the box
+ * @param zmax Morton code of the top-right corner of the box
+ * @param delegate called with a Morton code in the box and a batch of its
+ *        values, i.e., one or more consecutive fixed-size duplicates; it is
+ *        called several times for Morton codes with more than a page of
+ *        duplicates
+ * @param bucket time bucket to scan in a table "-morton-time" or nullptr
+ * @return number of seeks
+ */
+inline uint64_t mortonForEachInBox(MDB_cursor *cursor, const uint64_t &zmin, const uint64_t &zmax, std::function<void(const uint64_t &morton, const MDB_val &values)> delegate, const int64_t *bucket = nullptr) {
+  unsigned int flags{0};
+  mdb_dbi_flags(mdb_cursor_txn(cursor), mdb_cursor_dbi(cursor), &flags);
+  const bool MULTIPLE{0 != (flags & MDB_DUPFIXED)};
+
+  uint64_t seeks{1};
+  uint64_t next[2];
+  MDB_val key{mortonKeyOf(bucket, zmin, next)};
+  MDB_val value;
+  int32_t rc{mdb_cursor_get(cursor, &key, &value, MDB_SET_RANGE)};
+  uint64_t morton{0};
+  while ( (MDB_SUCCESS == rc) && mortonFromKey(key, bucket, morton) ) {
+    if (morton > zmax) {
+      break;
+    }
+    if (mortonIsInBox(morton, zmin, zmax)) {
+      rc = mortonVisitValues(cursor, key, value, MULTIPLE, morton, delegate);
+    }
+    else {
+      const uint64_t BIGMIN{mortonBigMin(morton, zmin, zmax)};
+      if (BIGMIN <= morton) {
+        break;
+      }
+      key = mortonKeyOf(bucket, BIGMIN, next);
+      rc = mdb_cursor_get(cursor, &key, &value, MDB_SET_RANGE);
+      seeks++;
+    }
+  }
+  return seeks;
+}
+
+/**
+ * A cell of the quadtree spanned by the Morton codes, i.e., all Morton codes
+ * from first to last; partial is true if the cell is not completely within
+ * the queried area and hence, its entries need to be checked individually.
+ */
+struct MortonCell {
+  uint64_t first{0};
+  uint64_t last{0};
+  bool partial{false};
+};
+
+/**
+ * This function covers an area with cells of the quadtree spanned by the
+ * Morton codes at an adaptive level: Starting from the smallest cell that
+ * contains the bounding box of the area, the cells that overlap the border of
+ * the area are split into their four children level by level as long as the
+ * number of cells stays below maxCells; cells outside the area are dropped.
+ *
+ * @param zmin Morton code of the bottom-left corner of the bounding box
+ * @param zmax Morton code of the top-right corner of the bounding box
+ * @param overlapOf returns the overlap of the area with the cell spanned by
+ *        the Morton codes of its bottom-left and top-right corners
+ * @param maxCells upper limit of cells
+ * @return cells of the quadtree in no particular order
+ */
+inline std::vector<MortonCell> mortonCellsOf(const uint64_t &zmin, const uint64_t &zmax, std::function<geofence::Overlap(const uint64_t &bl, const uint64_t &tr)> overlapOf, const std::size_t &maxCells) {
+  std::vector<MortonCell> cells;
+  // The smallest cell containing both corners shares their common prefix of full levels.
+  uint32_t bits{0};
+  while ( (bits < 64) && ((zmin >> bits) != (zmax >> bits)) ) {
+    bits += 2;
+  }
+  auto cellOf = [](const uint64_t &code, const uint32_t &b) {
+    const uint64_t MASK{(64 == b) ? ~0ULL : ((1ULL << b) - 1ULL)};
+    return std::make_pair(code & ~MASK, code | MASK);
+  };
+
+  std::vector<std::pair<uint64_t, uint64_t>> partial;
+  {
+    const auto CELL{cellOf(zmin, bits)};
+    const geofence::Overlap OVERLAP{overlapOf(CELL.first, CELL.second)};
+    if (geofence::INSIDE == OVERLAP) {
+      cells.push_back(MortonCell{CELL.first, CELL.second, false});
+    }
+    else if (geofence::PARTIAL == OVERLAP) {
+      partial.push_back(CELL);
+    }
+  }
+  while ( !partial.empty() && (0 < bits) && (cells.size() + 4 * partial.size() <= maxCells) ) {
+    bits -= 2;
+    std::vector<std::pair<uint64_t, uint64_t>> next;
+    for (const auto &p : partial) {
+      for (uint64_t child{0}; child < 4; child++) {
+        const auto CELL{cellOf(p.first | (child << bits), bits)};
+        const geofence::Overlap OVERLAP{overlapOf(CELL.first, CELL.second)};
+        if (geofence::INSIDE == OVERLAP) {
+          cells.push_back(MortonCell{CELL.first, CELL.second, false});
+        }
+        else if (geofence::PARTIAL == OVERLAP) {
+          next.push_back(CELL);
+        }
+      }
+    }
+    partial.swap(next);
+  }
+  for (const auto &p : partial) {
+    cells.push_back(MortonCell{p.first, p.second, true});
+  }
+  return cells;
+}
+
+/**
+ * This function sorts cells and merges adjacent cells that are both either
+ * completely or partially within an area.
+ *
+ * @param cells cells in no particular order
+ * @return cells ordered by their codes
+ */
+inline std::vector<MortonCell> mortonMergeCells(std::vector<MortonCell> cells) {
+  std::sort(cells.begin(), cells.end(), [](const MortonCell &a, const MortonCell &b) { return a.first < b.first; });
+  std::vector<MortonCell> merged;
+  for (const auto &c : cells) {
+    if (!merged.empty() && (merged.back().partial == c.partial) && (merged.back().last + 1 == c.first)) {
+      merged.back().last = c.last;
+    }
+    else {
+      merged.push_back(c);
+    }
+  }
+  return merged;
+}
+
+/**
+ * This function covers an area with cells of the quadtree (cf. mortonCellsOf)
+ * and merges adjacent cells (cf. mortonMergeCells).
+ *
+ * @param zmin Morton code of the bottom-left corner of the bounding box
+ * @param zmax Morton code of the top-right corner of the bounding box
+ * @param overlapOf returns the overlap of the area with the cell spanned by
+ *        the Morton codes of its bottom-left and top-right corners
+ * @param maxCells upper limit of cells before merging
+ * @return cells ordered by their Morton codes
+ */
+inline std::vector<MortonCell> mortonCoverOf(const uint64_t &zmin, const uint64_t &zmax, std::function<geofence::Overlap(const uint64_t &bl, const uint64_t &tr)> overlapOf, const std::size_t &maxCells) {
+  return mortonMergeCells(mortonCellsOf(zmin, zmax, overlapOf, maxCells));
+}
+
+/**
+ * This function visits all entries of a table "-morton" (opened with
+ * compareMortonKeys) within the cells covering an area (cf. mortonCoverOf).
+ * Each cell is a range of Morton codes that is read with one seek unless the
+ * cursor is already there; the entries of cells that are only partially
+ * within the area are checked per Morton code with isIn.
+ *
+ * @param cursor cursor on the table "-morton"
+ * @param cells cells ordered by their Morton codes
+ * @param isIn returns true if a Morton code is within the area
+ * @param delegate called with a Morton code in the area and a batch of its
+ *        values (cf. mortonForEachInBox)
+ * @param bucket time bucket to scan in a table "-morton-time" or nullptr
+ * @return number of seeks
+ */
+inline uint64_t mortonForEachInCells(MDB_cursor *cursor, const std::vector<MortonCell> &cells, std::function<bool(const uint64_t &morton)> isIn, std::function<void(const uint64_t &morton, const MDB_val &values)> delegate, const int64_t *bucket = nullptr) {
+  unsigned int flags{0};
+  mdb_dbi_flags(mdb_cursor_txn(cursor), mdb_cursor_dbi(cursor), &flags);
+  const bool MULTIPLE{0 != (flags & MDB_DUPFIXED)};
+
+  uint64_t seeks{0};
+  uint64_t next[2];
+  MDB_val key;
+  MDB_val value;
+  int32_t rc{MDB_NOTFOUND};
+  // The cursor stays at the first Morton code after a cell, which may be in the next cells.
+  uint64_t morton{0};
+  bool positioned{false};
+  for (const auto &cell : cells) {
+    if (!positioned || (morton < cell.first)) {
+      key = mortonKeyOf(bucket, cell.first, next);
+      rc = mdb_cursor_get(cursor, &key, &value, MDB_SET_RANGE);
+      seeks++;
+    }
+    while (MDB_SUCCESS == rc) {
+      if (!mortonFromKey(key, bucket, morton)) {
+        // Any later cell starts beyond this table or bucket as well.
+        return seeks;
+      }
+      positioned = true;
+      if (morton > cell.last) {
+        break;
+      }
+      if (!cell.partial || !isIn || isIn(morton)) {
+        rc = mortonVisitValues(cursor, key, value, MULTIPLE, morton, delegate);
+      }
+      else {
+        rc = mdb_cursor_get(cursor, &key, &value, MDB_NEXT_NODUP);
+      }
+    }
+    if (MDB_SUCCESS != rc) {
+      break;
+    }
+  }
+  return seeks;
+}
+
+/**
+ * This function calls scan for every time bucket with entries in a table
+ * "-morton-time" between two timeStamps; empty buckets are skipped with a
+ * single seek to the next bucket with entries.
+ *
+ * @param cursor cursor on the table "-morton-time"
+ * @param from timeStamp in nanoseconds
+ * @param to timeStamp in nanoseconds (inclusive)
+ * @param scan visits the entries of a bucket (e.g., with mortonForEachInBox)
+ *        and returns its number of seeks
+ * @return number of seeks
+ */
+inline uint64_t mortonForEachBucket(MDB_cursor *cursor, const int64_t &from, const int64_t &to, std::function<uint64_t(const int64_t &bucket)> scan) {
+  uint64_t seeks{0};
+  const int64_t LAST{mortonBucketOf(to)};
+  int64_t bucket{mortonBucketOf(from)};
+  uint64_t next[2];
+  MDB_val value;
+  while (bucket <= LAST) {
+    MDB_val key{mortonKeyOf(&bucket, 0, next)};
+    seeks++;
+    if ( (MDB_SUCCESS != mdb_cursor_get(cursor, &key, &value, MDB_SET_RANGE)) || !mortonBucketFromKey(key, bucket) || (bucket > LAST) ) {
+      break;
+    }
+    if (scan) {
+      seeks += scan(bucket);
+    }
+    if (LAST == bucket) {
+      break;
+    }
+    bucket++;
+  }
+  return seeks;
+}
 
 #endif
@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef REC_FILE_VIEW
+#define REC_FILE_VIEW
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cluon {
+
+/**
+ * One Envelope inside a memory-mapped .rec file in format:
+ *
+ *    0x0D 0xA4 LEN0 LEN1 LEN2 Proto-encoded cluon::data::Envelope
+ *
+ * data()/size() span the complete frame including the 5 bytes OD4 header,
+ * i.e., exactly the bytes that cluon::serializeEnvelope would produce. The
+ * fields needed for a cabinet::Key are decoded lazily on first access.
+ */
+class EnvelopeView {
+ public:
+  EnvelopeView() = default;
+  EnvelopeView(const char *data, const std::size_t &size, const uint64_t &offset) :
+    m_data(data),
+    m_size(size),
+    m_offset(offset) {}
+
+  const char *data() const { return m_data; }
+  std::size_t size() const { return m_size; }
+  uint64_t offset() const { return m_offset; }
+
+  int32_t dataType() { decode(); return m_dataType; }
+  uint32_t senderStamp() { decode(); return m_senderStamp; }
+  /**
+   * @return sampleTimeStamp in microseconds, cf. cluon::time::toMicroseconds
+   */
+  int64_t sampleTimeStamp() { decode(); return m_sampleTimeStamp; }
+
+ private:
+  static constexpr std::size_t OD4_HEADER_SIZE{5};
+
+  static bool readVarInt(const char *&ptr, const char *end, uint64_t &v) {
+    v = 0;
+    for (uint8_t shift{0}; (ptr < end) && (shift < 64); shift += 7) {
+      const uint8_t b{static_cast<uint8_t>(*ptr++)};
+      v |= static_cast<uint64_t>(b & 0x7F) << shift;
+      if (0 == (b & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static int64_t fromZigZag(const uint64_t &v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 0x1);
+  }
+
+  // Walk the fields of a proto-encoded message and call f(fieldId, value) for
+  // each varint and f(fieldId, begin, end) for each length-delimited field.
+  template <class VarIntField, class LengthDelimitedField>
+  static void walk(const char *ptr, const char *end, VarIntField &&varIntField, LengthDelimitedField &&lengthDelimitedField) {
+    uint64_t tag{0};
+    while ((ptr < end) && readVarInt(ptr, end, tag)) {
+      const uint32_t fieldId{static_cast<uint32_t>(tag >> 3)};
+      uint64_t v{0};
+      switch (tag & 0x7) {
+        case 0: // varint
+          if (!readVarInt(ptr, end, v)) { return; }
+          varIntField(fieldId, v);
+          break;
+        case 1: // 64 bit
+          ptr += 8;
+          break;
+        case 2: // length-delimited
+          if (!readVarInt(ptr, end, v) || (v > static_cast<uint64_t>(end - ptr))) { return; }
+          lengthDelimitedField(fieldId, ptr, ptr + v);
+          ptr += v;
+          break;
+        case 5: // 32 bit
+          ptr += 4;
+          break;
+        default:
+          return;
+      }
+    }
+  }
+
+  void decode() {
+    if (m_decoded || (nullptr == m_data) || (m_size < OD4_HEADER_SIZE)) {
+      return;
+    }
+    m_decoded = true;
+    // cluon::data::Envelope: 1 = dataType, 5 = sampleTimeStamp, 6 = senderStamp
+    walk(m_data + OD4_HEADER_SIZE, m_data + m_size,
+         [this](uint32_t fieldId, uint64_t v) {
+           if (1 == fieldId) { m_dataType = static_cast<int32_t>(fromZigZag(v)); }
+           else if (6 == fieldId) { m_senderStamp = static_cast<uint32_t>(v); }
+         },
+         [this](uint32_t fieldId, const char *begin, const char *end) {
+           if (5 == fieldId) {
+             // cluon::data::TimeStamp: 1 = seconds, 2 = microseconds
+             int64_t seconds{0};
+             int64_t microseconds{0};
+             walk(begin, end,
+                  [&seconds, &microseconds](uint32_t _fieldId, uint64_t v) {
+                    if (1 == _fieldId) { seconds = static_cast<int32_t>(fromZigZag(v)); }
+                    else if (2 == _fieldId) { microseconds = static_cast<int32_t>(fromZigZag(v)); }
+                  },
+                  [](uint32_t, const char *, const char *) {});
+             m_sampleTimeStamp = seconds * static_cast<int64_t>(1000 * 1000) + microseconds;
+           }
+         });
+  }
+
+ private:
+  const char *m_data{nullptr};
+  std::size_t m_size{0};
+  uint64_t m_offset{0};
+  bool m_decoded{false};
+  int32_t m_dataType{0};
+  uint32_t m_senderStamp{0};
+  int64_t m_sampleTimeStamp{0};
+};
+
+/**
+ * Read-only, memory-mapped view on a .rec file to iterate through its
+ * Envelopes in place without copying or decoding them; it can also view
+ * Envelopes that are concatenated in memory like in a .rec file.
+ */
+class RecFileView {
+ private:
+  RecFileView(const RecFileView &) = delete;
+  RecFileView(RecFileView &&)      = delete;
+  RecFileView &operator=(const RecFileView &) = delete;
+  RecFileView &operator=(RecFileView &&) = delete;
+
+ public:
+  explicit RecFileView(const std::string &filename) {
+    const int fd{::open(filename.c_str(), O_RDONLY)};
+    if (0 <= fd) {
+      struct stat s;
+      if ((0 == ::fstat(fd, &s)) && (0 < s.st_size)) {
+        void *ptr{::mmap(nullptr, static_cast<std::size_t>(s.st_size), PROT_READ, MAP_PRIVATE, fd, 0)};
+        if (MAP_FAILED != ptr) {
+          m_data = static_cast<const char*>(ptr);
+          m_size = static_cast<std::size_t>(s.st_size);
+          m_mapped = true;
+          ::madvise(ptr, m_size, MADV_SEQUENTIAL);
+        }
+      }
+      ::close(fd);
+    }
+  }
+
+  /**
+   * @param data Envelopes concatenated like in a .rec file; must outlive this view
+   * @param size number of bytes
+   */
+  RecFileView(const char *data, const std::size_t &size) :
+    m_data(data),
+    m_size(size) {}
+
+  ~RecFileView() {
+    if (m_mapped && (nullptr != m_data)) {
+      ::munmap(const_cast<char*>(m_data), m_size);
+    }
+  }
+
+  bool good() const { return nullptr != m_data; }
+  const char *data() const { return m_data; }
+  std::size_t size() const { return m_size; }
+
+  /**
+   * @return offset of the next Envelope to be returned by next()
+   */
+  uint64_t position() const { return m_position; }
+
+  /**
+   * Continue iterating at the given offset, which must point to an OD4 header.
+   */
+  void seek(const uint64_t &position) { m_position = position; }
+
+  /**
+   * This method scans the Envelopes from the current position to the end for
+   * their earliest and latest sampleTimeStamp without changing the current
+   * position.
+   *
+   * @param first earliest sampleTimeStamp in microseconds
+   * @param last latest sampleTimeStamp in microseconds
+   * @return true if at least one Envelope was found
+   */
+  bool timeRange(int64_t &first, int64_t &last) {
+    const uint64_t POSITION{m_position};
+    bool found{false};
+    EnvelopeView e;
+    while (next(e)) {
+      const int64_t TIMESTAMP{e.sampleTimeStamp()};
+      first = (found && (first < TIMESTAMP)) ? first : TIMESTAMP;
+      last = (found && (last > TIMESTAMP)) ? last : TIMESTAMP;
+      found = true;
+    }
+    m_position = POSITION;
+    return found;
+  }
+
+  /**
+   * @param e view on the next Envelope
+   * @return true if a complete Envelope was found; false at the end of the
+   *         file or when the remaining bytes are not a valid Envelope
+   */
+  bool next(EnvelopeView &e) {
+    constexpr std::size_t OD4_HEADER_SIZE{5};
+    if ((nullptr == m_data) || (m_position + OD4_HEADER_SIZE > m_size)) {
+      return false;
+    }
+    const uint8_t *header{reinterpret_cast<const uint8_t*>(m_data + m_position)};
+    if ((0x0D != header[0]) || (0xA4 != header[1])) {
+      return false;
+    }
+    // LEN0 LEN1 LEN2 are little Endian.
+    const std::size_t LENGTH{static_cast<std::size_t>(header[2]) | (static_cast<std::size_t>(header[3]) << 8) | (static_cast<std::size_t>(header[4]) << 16)};
+    if (m_position + OD4_HEADER_SIZE + LENGTH > m_size) {
+      return false;
+    }
+    e = EnvelopeView(m_data + m_position, OD4_HEADER_SIZE + LENGTH, m_position);
+    m_position += OD4_HEADER_SIZE + LENGTH;
+    return true;
+  }
+
+ private:
+  const char *m_data{nullptr};
+  std::size_t m_size{0};
+  uint64_t m_position{0};
+  bool m_mapped{false};
+};
+
+} // cluon
+#endif
@@ -10,31 +10,70 @@
 #define REC2CABINET_HPP
 
 #include "cluon-complete.hpp"
+#include "blobs.hpp"
+#include "block.hpp"
+#include "checkpoint.hpp"
+#include "clustered.hpp"
+#include "codec.hpp"
+#include "duplicate-filter.hpp"
 #include "key.hpp"
 #include "db.hpp"
 #include "in-ranges.hpp"
+#include "rec-file-view.hpp"
 
 #include "lmdb.h"
-#include "lz4.h"
-#include "lz4hc.h"
 #include "xxhash.h"
 
 #include <cstdio>
 #include <cstring>
 #include <cstdint>
 
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <locale>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
-inline int rec2cabinet(const std::string &ARGV0, const uint64_t &MEM, const std::string &REC, const std::string &CABINET, const uint64_t &USERDATA, cluon::In_Ranges<int64_t> ranges,  const bool &VERBOSE) {
+/**
+ * This function imports the Envelopes from a .rec file into a cabinet.
+ *
+ * Envelopes are written in batches: A write transaction is kept open until
+ * BATCH_ENTRIES Envelopes, BATCH_BYTES bytes read from the .rec file, or
+ * BATCH_MS milliseconds have passed, whatever comes first; a limit of 0
+ * disables the respective criterion. BATCH_ENTRIES = 1 commits every single
+ * Envelope (default); all limits set to 0 commit only once at the end.
+ *
+ * With each batch, the offset in the .rec file after the last committed
+ * Envelope is stored as Checkpoint in the table "checkpoints". When RESUME is
+ * set, the import continues at this offset; a completely imported .rec file
+ * is skipped.
+ *
+ * @param ARGV0 Our name.
+ * @param MEM upper memory size for the database in GB
+ * @param REC .rec file to import
+ * @param CABINET cabinet file to import into
+ * @param USERDATA user-supplied data to be stored in each key
+ * @param ranges temporal ranges that Envelopes to import must reside in
+ * @param VERBOSE
+ * @param BATCH_ENTRIES commit after this many Envelopes
+ * @param BATCH_BYTES commit after this many bytes
+ * @param BATCH_MS commit after this many milliseconds
+ * @param CODECS codecs to compress the values per dataType
+ * @param RESUME continue at the last checkpoint for this .rec file
+ * @param KEY_LAYOUT layout of the keys for a new cabinet; an existing cabinet keeps its layout
+ * @param MAX_INLINE_VALUE store values of up to this many bytes after compression inline in their key in "all" (0 = never)
+ * @param CLUSTERED store the values in the tables "dataType/senderStamp" and only the keys in "all" for a new cabinet; an existing cabinet keeps its choice
+ * @param BLOB_SIZE store values of at least this many bytes after compression in the blob file of the cabinet (0 = never)
+ * @return 0 on success, 1 otherwise
+ */
+inline int rec2cabinet(const std::string &ARGV0, const uint64_t &MEM, const std::string &REC, const std::string &CABINET, const uint64_t &USERDATA, cluon::In_Ranges<int64_t> ranges,  const bool &VERBOSE, const uint32_t &BATCH_ENTRIES = 1, const uint64_t &BATCH_BYTES = 0, const uint32_t &BATCH_MS = 0, const codec::Selection &CODECS = codec::Selection(), const bool &RESUME = false, const uint8_t &KEY_LAYOUT = KEY_LAYOUT_COMPARE_KEYS, const uint16_t &MAX_INLINE_VALUE = 0, const bool &CLUSTERED = false, const std::size_t &BLOB_SIZE = 0) {
   int32_t retCode{0};
   MDB_env *env{nullptr};
   const int numberOfDatabases{100};
   const int64_t SIZE_DB = MEM * 1024UL * 1024UL * 1024UL;
-  const uint64_t MAXKEYSIZE = 511;
 
   // lambda to check the interaction with the database.
   auto checkErrorCode = [argv0=ARGV0](int32_t rc, int32_t line, std::string caller) {
@@ -87,267 +126,286 @@ inline int rec2cabinet(const std::string &ARGV0, const uint64_t &MEM, const std:
 
   printNumberOfEntries();
 
+  // Load the existing dictionaries to continue using them for their streams.
+  codec::Dictionaries dictionaries;
+  {
+    MDB_txn *txn{nullptr};
+    if (!checkErrorCode(mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn), __LINE__, "mdb_txn_begin")) {
+      mdb_env_close(env);
+      return 1;
+    }
+    dictionaries.load(txn);
+    mdb_txn_abort(txn);
+  }
+  codec::DictionaryTrainer dictionaryTrainer(dictionaries);
+  codec::DictionaryIds dictionaryIds(dictionaries);
+
   // Iterate through .rec file and fill database.
   {
-    std::fstream recFile;
-    recFile.open(REC.c_str(), std::ios_base::in | std::ios_base::binary);
+    // Memory-map the .rec file to access the Envelopes in place.
+    cluon::RecFileView recFile(REC);
 
     if (recFile.good()) {
       const XXH32_hash_t hashOfFilename = XXH32(REC.c_str(), REC.size(), 0);
       uint32_t entries{0};
+
+      // Continue after the last committed Envelope; a .rec file that is
+      // smaller than at the last checkpoint was replaced and is imported
+      // from its beginning.
+      Checkpoint checkpoint;
+      bool isImported{false};
+      if (RESUME) {
+        MDB_txn *txn{nullptr};
+        if (MDB_SUCCESS == mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn)) {
+          if (checkpoint.load(txn, hashOfFilename)) {
+            if ((recFile.size() < checkpoint.fileSize) || (recFile.size() < checkpoint.offset)) {
+              std::clog << "[" << ARGV0 << "]: " << REC << " has " << recFile.size() << " bytes but had " << checkpoint.fileSize << " bytes at the last checkpoint; importing it from the beginning." << std::endl;
+            }
+            else {
+              isImported = checkpoint.isComplete() && (recFile.size() == checkpoint.fileSize);
+              recFile.seek(checkpoint.offset);
+              entries = static_cast<uint32_t>(checkpoint.envelopes);
+              if (isImported) {
+                std::clog << "[" << ARGV0 << "]: Skipping " << REC << " as its " << checkpoint.envelopes << " entries were imported completely." << std::endl;
+              }
+              else {
+                std::clog << "[" << ARGV0 << "]: Resuming " << REC << " at offset " << checkpoint.offset << " after " << checkpoint.envelopes << " entries." << std::endl;
+              }
+            }
+          }
+          mdb_txn_abort(txn);
+        }
+      }
+
+      // Load the keys stored within the time range of the .rec file to skip duplicated Envelopes;
+      // the filter is sized for them and for the Envelopes of the .rec file, which take at least
+      // ENVELOPE_MIN_SIZE bytes each.
+      const uint64_t ENVELOPE_MIN_SIZE{32};
+      DuplicateFilter duplicateFilter(static_cast<uint64_t>(recFile.size()) / ENVELOPE_MIN_SIZE);
+      uint64_t duplicates{0};
+      {
+        int64_t first{0};
+        int64_t last{0};
+        MDB_txn *txn{nullptr};
+        MDB_dbi dbi{0};
+        if (!isImported && recFile.timeRange(first, last)
+            && (MDB_SUCCESS == mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn))) {
+          if (MDB_SUCCESS == mdb_dbi_open(txn, "all", 0/*no flags*/, &dbi)) {
+            const uint8_t LAYOUT{useKeyLayoutOf(txn, dbi)};
+            const uint64_t seeded{duplicateFilter.seed(txn, dbi, first * 1000UL, last * 1000UL, LAYOUT, static_cast<uint64_t>(recFile.size()) / ENVELOPE_MIN_SIZE)};
+            std::clog << "[" << ARGV0 << "]: Loaded " << seeded << " entries from table 'all' (" << duplicateFilter.bytes() / 1024 << " KB) to check for duplicates." << std::endl;
+          }
+          mdb_txn_abort(txn);
+        }
+      }
+
       uint64_t totalBytesRead = 0;
 
       // Determine file size to display progress.
-      recFile.seekg(0, recFile.end);
-      int64_t fileLength = recFile.tellg();
-      recFile.seekg(0, recFile.beg);
+      int64_t fileLength = recFile.size();
+
+      // The current write transaction is kept open across several Envelopes
+      // and the handles to the tables are kept open across transactions.
+      MDB_txn *txn{nullptr};
+      // Large values are appended to the blob file and only referenced.
+      clustered::Store store(blobs::fileOf(CABINET), KEY_LAYOUT, CLUSTERED, MAX_INLINE_VALUE, BLOB_SIZE, &duplicateFilter);
+      uint32_t entriesInBatch{0};
+      uint64_t bytesInBatch{0};
+      uint64_t commits{0};
+      cluon::data::TimeStamp batchStart{cluon::time::now()};
+
+      // lambda to commit the current batch together with its checkpoint.
+      auto commitBatch = [argv0=ARGV0, &txn, &store, &entriesInBatch, &bytesInBatch, &commits, &batchStart, &recFile, &entries, hashOfFilename]() {
+        int32_t rc{MDB_SUCCESS};
+        if (nullptr != txn) {
+          Checkpoint c;
+          c.offset = recFile.position();
+          c.envelopes = entries;
+          c.fileSize = recFile.size();
+          if (MDB_SUCCESS != (rc = c.store(txn, hashOfFilename))) {
+            std::cerr << argv0 << ": " << "Checkpoint::store: (" << rc << ") " << mdb_strerror(rc) << std::endl;
+            mdb_txn_abort(txn);
+          }
+          else if (MDB_SUCCESS != (rc = store.flush(txn))) {
+            std::cerr << argv0 << ": " << "clustered::Store::flush: (" << rc << ") " << mdb_strerror(rc) << std::endl;
+            mdb_txn_abort(txn);
+          }
+          else if (MDB_SUCCESS != (rc = mdb_txn_commit(txn))) {
+            std::cerr << argv0 << ": " << "mdb_txn_commit: (" << rc << ") " << mdb_strerror(rc) << std::endl;
+          }
+          txn = nullptr;
+          commits++;
+        }
+        entriesInBatch = 0;
+        bytesInBatch = 0;
+        batchStart = cluon::time::now();
+        return rc;
+      };
 
       // Read complete file and store file positions to Envelopes to create
       // index of available data. The actual reading of Envelopes is deferred.
       const cluon::data::TimeStamp BEFORE{cluon::time::now()};
       {
         int32_t oldPercentage{-1};
-        while (recFile.good()) {
-          const uint64_t POS_BEFORE = static_cast<uint64_t>(recFile.tellg());
-          auto retVal               = cluon::extractEnvelope(recFile);
-          const uint64_t POS_AFTER  = static_cast<uint64_t>(recFile.tellg());
+        cluon::EnvelopeView e;
+        try {
+          while (recFile.next(e)) {
+            const uint64_t POS_BEFORE = e.offset();
+            const uint64_t POS_AFTER  = e.offset() + e.size();
 
-          if (!recFile.eof() && retVal.first) {
             entries++;
             totalBytesRead += (POS_AFTER - POS_BEFORE);
 
-            cluon::data::Envelope e{std::move(retVal.second)};
-            auto sampleTimeStamp{cluon::time::toMicroseconds(e.sampleTimeStamp())};
+            // Only the fields for the key are decoded from the Envelope.
+            auto sampleTimeStamp{e.sampleTimeStamp()};
 
             if (!ranges.empty() && !(ranges.isInAnyRange(sampleTimeStamp * 1000UL))) {
               // This Envelope resides temporally not within any allowed start/end range.
               continue;
             }
 
-            // Create bytes to store in "all".
-            std::string sVal{cluon::serializeEnvelope(std::move(e))};
-            char *ptrToValue = const_cast<char*>(sVal.data());
-            ssize_t lengthOfValue = sVal.size();
+            // Store the bytes of the Envelope as they are in the .rec file in "all".
+            const char *ptrToEnvelope{e.data()};
+            const std::size_t lengthOfEnvelope{e.size()};
+            char *ptrToValue = const_cast<char*>(ptrToEnvelope);
+            ssize_t lengthOfValue = lengthOfEnvelope;
 
-            XXH64_hash_t hash = XXH64(sVal.data(), sVal.size(), 0);
+            XXH64_hash_t hash = XXH64(ptrToEnvelope, lengthOfEnvelope, 0);
             if (VERBOSE) {
-              std::clog << "hash: " << std::hex << "0x" << hash << std::dec << ", value size = " << sVal.size() << std::endl;
+              std::clog << "hash: " << std::hex << "0x" << hash << std::dec << ", value size = " << lengthOfEnvelope << std::endl;
+            }
+            // Compress value with the codec selected for its dataType.
+            const codec::Config &config = CODECS.select(e.dataType());
+            std::shared_ptr<const codec::Dictionary> dictionary;
+            if (codec::usesDictionary(config.codec)) {
+              dictionary = dictionaryTrainer.sample(e.dataType(), e.senderStamp(), ptrToEnvelope, lengthOfEnvelope);
             }
-            // Compress value via lz4.
             std::vector<char> compressedValue;
-            ssize_t compressedSize{0};
-            {
-              ssize_t expectedCompressedSize = LZ4_compressBound(sVal.size());
-              compressedValue.reserve(expectedCompressedSize);
-              //compressedSize = LZ4_compress_default(sVal.data(), compressedValue.data(), sVal.size(), compressedValue.capacity());
-              compressedSize = LZ4_compress_HC(sVal.data(), compressedValue.data(), sVal.size(), compressedValue.capacity(), LZ4HC_CLEVEL_MAX);
-              if (VERBOSE) {
-                std::clog << "lz4 actual size: " << compressedSize << std::endl;
-              }
-              if ( (compressedSize > 0) && (compressedSize < lengthOfValue) ) {
-                ptrToValue = compressedValue.data();
-                lengthOfValue = compressedSize;
-              }
-
-#if 0
-              {
-                std::vector<char> decompressedValue;
-                decompressedValue.reserve(sVal.size());
-                const int decompressedSize = LZ4_decompress_safe(compressedValue.data(), decompressedValue.data(), compressedSize, decompressedValue.capacity());
-                XXH64_hash_t hashDecompressed = XXH64(decompressedValue.data(), decompressedSize, 0);
-                if (VERBOSE) {
-                  std::clog << "lz4 decompressed size: " << decompressedSize << ", org hash: " << std::hex << "0x" << hash << ", dec hash: " << "0x" << hashDecompressed << std::dec << std::endl << std::endl;
-                }
-              }
-#endif
+            const uint8_t appliedCodec{codec::encode(config, ptrToEnvelope, lengthOfEnvelope, compressedValue, dictionary.get())};
+            if (codec::NONE != appliedCodec) {
+              ptrToValue = compressedValue.data();
+              lengthOfValue = compressedValue.size();
             }
-/*
-            // Compress value using zstd.
-            std::string compressedValue{};
-            if (COMPRESS) {
-              size_t estimatedCompressedSize{ZSTD_compressBound(sVal.size())};
-              compressedValue.resize(estimatedCompressedSize);
-
-              constexpr const int LEVEL{22};
-              auto compressedSize = ZSTD_compress((void*)compressedValue.data(), estimatedCompressedSize, sVal.data(), sVal.size(), LEVEL);
-
-              compressedValue.resize(compressedSize);
-              compressedValue.shrink_to_fit();
-
-              value.mv_size = compressedValue.size();
-              value.mv_data = const_cast<char*>(compressedValue.data());
+            if (VERBOSE) {
+              std::clog << codec::name(appliedCodec) << " actual size: " << lengthOfValue << std::endl;
             }
-*/
-            std::vector<char> _key;
-            _key.reserve(MAXKEYSIZE);
-            
-            MDB_dbi dbAll{0}; 
-            MDB_txn *txn{nullptr};
 
             // No transaction available, create one.
             if (nullptr == txn) {
               if (!checkErrorCode(mdb_txn_begin(env, nullptr, 0, &txn), __LINE__, "mdb_txn_begin")) {
-                mdb_env_close(env);
-                return 1;
+                retCode = 1;
+                break;
+              }
+              const bool IS_OPEN{store.isOpen()};
+              if (!checkErrorCode(store.begin(txn), __LINE__, "clustered::Store::begin")) {
+                mdb_txn_abort(txn);
+                txn = nullptr;
+                retCode = 1;
+                break;
+              }
+              // The keys of blocks hold the last timeStamp and the number of
+              // Envelopes instead of the xxhash; hence, duplicates cannot be detected.
+              if (!IS_OPEN && block::isPacked(txn, store.all())) {
+                std::cerr << "[" << ARGV0 << "]: " << CABINET << " stores blocks of Envelopes; unpack it with cabinet-migrate before importing into it." << std::endl;
+                mdb_txn_abort(txn);
+                txn = nullptr;
+                retCode = 1;
+                break;
+              }
+              if (!IS_OPEN && (store.layout() != KEY_LAYOUT)) {
+                std::clog << "[" << ARGV0 << "]: Using key layout " << +store.layout() << " of " << CABINET << "." << std::endl;
+              }
+              if (!IS_OPEN && (store.isClustered() != CLUSTERED)) {
+                std::clog << "[" << ARGV0 << "]: Storing values " << (store.isClustered() ? "per stream" : "in 'all'") << " like in " << CABINET << "." << std::endl;
               }
             }
 
-            // Make sure to have a database "all" and that we have it open.
-            if (!checkErrorCode(mdb_dbi_open(txn, "all", MDB_CREATE, &dbAll), __LINE__, "mdb_dbi_open")) {
-              mdb_txn_abort(txn);
-              mdb_env_close(env);
-              break;
-            }
-            mdb_set_compare(txn, dbAll, &compareKeys);
-#if 0
-              {
-                // version 0:
-                // if (511 - (value.mv_size + offset) > 0) --> store value directly in key 
-                if ( MAXKEYSIZE > (offset + value.mv_size) )  {
-                  // b25-b26: uint16_t: length of the value
-                  const uint16_t length = static_cast<uint16_t>(value.mv_size);
-                  std::memcpy(_key.data() + offset, reinterpret_cast<const char*>(&length), sizeof(uint16_t));
-                  offset += sizeof(uint16_t);
-
-                  std::memcpy(_key.data() + offset, reinterpret_cast<const char*>(value.mv_data), value.mv_size);
-                  offset += value.mv_size;
-                  value.mv_size = 0;
-                  value.mv_data = 0;
-                }
-                else {
-                  // b25-b26: uint16_t: length of the value
-                  const uint16_t length = 0;
-                  std::memcpy(_key.data() + offset, reinterpret_cast<const char*>(&length), sizeof(uint16_t));
-                  offset += sizeof(uint16_t);
-                }
+            // Store a new dictionary within the same transaction as its first value.
+            if (codec::usesDictionary(appliedCodec)) {
+              if (!checkErrorCode(dictionaryIds.store(txn, *dictionary, compressedValue), __LINE__, "codec::Dictionaries::store")) {
+                mdb_txn_abort(txn);
+                txn = nullptr;
+                retCode = 1;
+                break;
               }
-#endif
+              ptrToValue = compressedValue.data();
+              lengthOfValue = compressedValue.size();
+            }
             cabinet::Key k;
             k.dataType(e.dataType())
               .senderStamp(e.senderStamp())
               .hash(hash)
               .hashOfRecFile(hashOfFilename)
-              .length(sVal.size())
+              .length(lengthOfEnvelope)
               .userData(USERDATA)
-              .version(0);
-
-            MDB_val key;
-            MDB_val value;
-            int64_t sampleTimeStampOffsetToAvoidCollision{0};
-            do {
-              k.timeStamp(sampleTimeStamp * 1000UL + sampleTimeStampOffsetToAvoidCollision);
-
-              key.mv_size = setKey(k, _key.data(), _key.capacity());
-              key.mv_data = _key.data();
-
-              value.mv_size = lengthOfValue;
-              value.mv_data = ptrToValue;
-
-              // Check for duplicated entries.
-              {
-                bool duplicate{false};
-                MDB_cursor *cursor{nullptr};
-                if (MDB_SUCCESS == mdb_cursor_open(txn, dbAll, &cursor)) {
-                  // Check if the key exists; if so, retrieve the key and check hash to skip duplicated data.
-                  MDB_val tmpKey = key;
-                  MDB_val tmpVal;
-                  if (MDB_SUCCESS == mdb_cursor_get(cursor, &tmpKey, &tmpVal, MDB_SET_KEY)) {
-                    // Extract xxhash from found key and compare with calculated key to maybe skip adding this value.
-                    const char *ptr = static_cast<char*>(tmpKey.mv_data);
-                    cabinet::Key storedKey = getKey(ptr, tmpKey.mv_size);
-                    duplicate = (hash == storedKey.hash());
-                    if (VERBOSE) {
-                      std::cerr << std::hex << "hash-to-store: 0x" << hash << ", hash-stored: 0x" << storedKey.hash() << std::dec << ", is duplicate = " << duplicate << std::endl;
-                    }
-                  }
-                }
-                mdb_cursor_close(cursor);
-                if (duplicate) {
-                  // value is existing, skip storing
-                  retCode = 0;
-                  break;
-                }
+              .version(codec::version(store.layout(), appliedCodec));
+
+            // Envelopes with the same sampleTimeStamp are ordered by their
+            // dataType, senderStamp, and xxhash.
+            k.timeStamp(sampleTimeStamp * 1000UL);
+            retCode = store.put(txn, k, ptrToValue, static_cast<std::size_t>(lengthOfValue), lengthOfEnvelope);
+            if (MDB_KEYEXIST == retCode) {
+              if (VERBOSE) {
+                std::cerr << std::hex << "hash-to-store: 0x" << hash << std::dec << " is duplicate" << std::endl;
               }
-             
-              // Try next slot if already taken.
-              sampleTimeStampOffsetToAvoidCollision++;
-            } while ( MDB_KEYEXIST == (retCode = mdb_put(txn, dbAll, &key, &value, MDB_NOOVERWRITE)) );
+              retCode = MDB_SUCCESS;
+              duplicates++;
+              continue;
+            }
             if (0 != retCode) {
-              std::cerr << ARGV0 << ": " << "mdb_put: (" << retCode << ") " << mdb_strerror(retCode) << ", stored " << entries << std::endl;
+              std::cerr << ARGV0 << ": " << "clustered::Store::put: (" << retCode << ") " << mdb_strerror(retCode) << ", stored " << entries << std::endl;
               mdb_txn_abort(txn);
-              mdb_env_close(env);
-              break;
-            }
-
-            // Commit write.
-            {
-              if (MDB_SUCCESS != (retCode = mdb_txn_commit(txn))) {
-                std::cerr << ARGV0 << ": " << "mdb_txn_commit: (" << retCode << ") " << mdb_strerror(retCode) << std::endl;
-                mdb_env_close(env);
-                break;
-              }
               txn = nullptr;
-              mdb_dbi_close(env, dbAll);
-              dbAll = -1;
+              break;
             }
 
-            // Add key to separate database named "dataType/senderStamp".
-            {
-              MDB_txn *_txn{nullptr};
-              if (nullptr == _txn) {
-                if (!checkErrorCode(mdb_txn_begin(env, nullptr, 0, &_txn), __LINE__, "mdb_txn_begin")) {
-                  mdb_env_close(env);
-                  return 1;
-                }
-              }
-
-              std::stringstream _dataType_senderStamp;
-              _dataType_senderStamp << e.dataType() << '/'<< e.senderStamp();
-              const std::string _shortKey{_dataType_senderStamp.str()};
-
-              // Make sure to have a database "dataType/senderStamp" and that we have it open.
-              MDB_dbi dbDataTypeSenderStamp{0}; 
-              if (!checkErrorCode(mdb_dbi_open(_txn, _shortKey.c_str(), MDB_CREATE, &dbDataTypeSenderStamp), __LINE__, "mdb_dbi_open")) {
-                mdb_txn_abort(_txn);
-                mdb_env_close(env);
+            // Commit write when the batch is full.
+            entriesInBatch++;
+            bytesInBatch += (POS_AFTER - POS_BEFORE);
+            if ( ((0 < BATCH_ENTRIES) && (BATCH_ENTRIES <= entriesInBatch))
+              || ((0 < BATCH_BYTES) && (BATCH_BYTES <= bytesInBatch))
+              || ((0 < BATCH_MS) && (static_cast<int64_t>(BATCH_MS) * 1000 <= cluon::time::deltaInMicroseconds(cluon::time::now(), batchStart))) ) {
+              if (MDB_SUCCESS != (retCode = commitBatch())) {
                 break;
               }
-              mdb_set_compare(_txn, dbDataTypeSenderStamp, &compareKeys);
-
-              key.mv_size = setKey(k, _key.data(), _key.capacity());
-              key.mv_data = _key.data();
-
-              value.mv_size = 0;
-              value.mv_data = nullptr;
-
-              if (MDB_SUCCESS != (retCode = mdb_put(_txn, dbDataTypeSenderStamp, &key, &value, 0))) {
-                std::cerr << ARGV0 << ": " << "mdbx_put: (" << retCode << ") " << mdb_strerror(retCode) << std::endl;
-              }
-
-              // Commit write.
-              {
-                if (MDB_SUCCESS != (retCode = mdb_txn_commit(_txn))) {
-                  std::cerr << ARGV0 << ": " << "mdb_txn_commit: (" << retCode << ") " << mdb_strerror(retCode) << std::endl;
-                  mdb_env_close(env);
-                  break;
-                }
-                _txn = nullptr;
-                mdb_dbi_close(env, dbDataTypeSenderStamp);
-              }
             }
 
-            const int32_t percentage = static_cast<int32_t>((static_cast<float>(recFile.tellg()) * 100.0f) / static_cast<float>(fileLength));
+            const int32_t percentage = static_cast<int32_t>((static_cast<float>(recFile.position()) * 100.0f) / static_cast<float>(fileLength));
             if ((percentage % 5 == 0) && (percentage != oldPercentage)) {
               std::clog << "[" << ARGV0 << "]: Processed " << percentage << "% (" << entries << " entries) from " << REC << std::endl;
               oldPercentage = percentage;
             }
           }
         }
+        catch(const std::runtime_error &error) {
+          // The blob file could not be written.
+          std::cerr << "[" << ARGV0 << "]: " << error.what() << std::endl;
+          retCode = 1;
+        }
+      }
+      // Commit the last, partially filled batch; the final checkpoint marks the .rec file as complete.
+      if ((0 == retCode) && !isImported && (nullptr == txn)) {
+        retCode = mdb_txn_begin(env, nullptr, 0, &txn);
+      }
+      if (0 == retCode) {
+        retCode = commitBatch();
+      }
+      else if (nullptr != txn) {
+        mdb_txn_abort(txn);
+        txn = nullptr;
       }
       const cluon::data::TimeStamp AFTER{cluon::time::now()};
 
+      const double duration{static_cast<double>(cluon::time::deltaInMicroseconds(AFTER, BEFORE)) / (1000.0 * 1000.0)};
+      const double envelopesPerSecond{(duration > 0) ? static_cast<double>(entries) / duration : 0.0};
+      const double megaBytesPerSecond{(duration > 0) ? (static_cast<double>(totalBytesRead) / (1024.0 * 1024.0)) / duration : 0.0};
       std::clog << "[" << ARGV0 << "]: Processed 100% (" << entries << " entries) from " << REC << "; total bytes read: " << totalBytesRead
-                << " in " << cluon::time::deltaInMicroseconds(AFTER, BEFORE) / static_cast<int64_t>(1000 * 1000) << "s." << std::endl;
+                << " in " << cluon::time::deltaInMicroseconds(AFTER, BEFORE) / static_cast<int64_t>(1000 * 1000) << "s"
+                << " (" << static_cast<uint64_t>(envelopesPerSecond) << " envelopes/s, " << std::setprecision(4) << megaBytesPerSecond << " MB/s, "
+                << commits << " commits, " << duplicates << " duplicates skipped, " << store.lookupsSaved() << " lookups saved)." << std::endl;
+      if (0 < store.valuesInBlobFile()) {
+        std::clog << "[" << ARGV0 << "]: Stored " << store.valuesInBlobFile() << " values in " << blobs::fileOf(CABINET) << " (" << store.bytesInBlobFile() << " bytes)." << std::endl;
+      }
     }
     else {
       std::clog << "[" << ARGV0 << "]: " << REC << " could not be opened." << std::endl;
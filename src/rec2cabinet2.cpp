@@ -14,6 +14,7 @@
 #include <iomanip>
 #include <locale>
 #include <string>
+#include <vector>
 
 struct space_out : std::numpunct<char> {
   char do_thousands_sep()   const { return ','; }  // separate with spaces
@@ -24,25 +25,38 @@ int32_t main(int32_t argc, char **argv) {
   int32_t retCode{0};
   auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
   if (0 == commandlineArguments.count("rec")) {
-    std::cerr << argv[0] << " transforms a .rec file with Envelopes to an lmdb-based key/value-database." << std::endl;
+    std::cerr << argv[0] << " transforms one or more .rec files with Envelopes to an lmdb-based key/value-database." << std::endl;
     std::cerr << "If the specified database exists, the content of the .rec file is added." << std::endl;
-    std::cerr << "Usage:   " << argv[0] << " --rec=MyFile.rec [--verbose] [--cab=myFile.cab] [--mem=32024] [--userdata=1234] [--temporalrange=times.csv]" << std::endl;
-    std::cerr << "         --rec:            name of the recording file" << std::endl;
-    std::cerr << "         --cab:            name of the database file (optional; otherwise, a new file based on the .rec file with .cab as suffix is created)" << std::endl;
+    std::cerr << "Usage:   " << argv[0] << " --rec=MyFile.rec [--verbose] [--cab=myFile.cab] [--mem=32024] [--userdata=1234] [--temporalrange=times.csv] [--threads=4] [--codec=lz4hc:12,1055=none] [--keylayout=1] [--inline=128] [--clustered] [--blob=65536]" << std::endl;
+    std::cerr << "         --rec:            name of the recording file; several files and directories with .rec files can be given comma-separated" << std::endl;
+    std::cerr << "         --cab:            name of the database file (optional for a single .rec file; otherwise, a new file based on the .rec file with .cab as suffix is created)" << std::endl;
     std::cerr << "         --mem:            upper memory size for database in memory in GB, default: 64,000 (representing 64TB)" << std::endl;
     std::cerr << "         --userdata:       optional: uint64_t user supplied optional data (default: 0), which can be used to add further information to this import" << std::endl;
     std::cerr << "         --temporalranges: optional: csv file (format: start-timestamp;end-timestamp) to specify, in which temporal range a data sample to add must reside" << std::endl;
+    std::cerr << "         --threads:        optional: number of threads to hash and compress Envelopes in parallel (default: 1)" << std::endl;
+    std::cerr << "         --codec:          optional: comma-separated codecs to compress values: none, lz4[:acceleration], lz4hc[:level], or zstd[:level] (if available), optionally per dataType as dataType=codec (default: lz4hc:12)" << std::endl;
+    std::cerr << "         --keylayout:      optional: layout of the keys for a new database: 0 = ordered by compareKeys, 1 = ordered by memcmp (default: 0)" << std::endl;
+    std::cerr << "         --inline:         optional: store values of up to this many bytes after compression inline in their key (default: 0 = never, max: " << KEY_MAX_INLINE_VALUE << ")" << std::endl;
+    std::cerr << "         --clustered:      optional: store the values per stream in the tables dataType/senderStamp and only the keys in 'all' for a new database" << std::endl;
+    std::cerr << "         --blob:           optional: store values of at least this many bytes after compression in the append-only file myFile.cab-blobs next to the database (default: 0 = never)" << std::endl;
     std::cerr << "         --verbose:        display information" << std::endl;
     std::cerr << "Example: " << argv[0] << " --rec=myFile.rec --cab=myStore.cab --mem=64000" << std::endl;
+    std::cerr << "         " << argv[0] << " --rec=a.rec,b.rec,/data/2022-05-04 --cab=myStore.cab --threads=16" << std::endl;
     retCode = 1;
   } else {
     std::clog.imbue(std::locale(std::cout.getloc(), new space_out));
     const std::string REC{commandlineArguments["rec"]};
+    const std::vector<std::string> RECS{listRecFiles(REC)};
     const std::string CABINET{(commandlineArguments["cab"].size() != 0) ? commandlineArguments["cab"] : "./" + REC + ".cab"};
     const uint64_t MEM{(commandlineArguments["mem"].size() != 0) ? static_cast<uint64_t>(std::stoi(commandlineArguments["mem"])) : 64UL*1024UL};
     const uint64_t USERDATA{(commandlineArguments["userdata"].size() != 0) ? static_cast<uint64_t>(std::stoll(commandlineArguments["userdata"])) : 0};
     const std::string TEMPORAL_RANGES{(commandlineArguments["temporalranges"].size() != 0) ? commandlineArguments["temporalranges"] : ""};
     const bool VERBOSE{(commandlineArguments["verbose"].size() != 0)};
+    const uint32_t THREADS{(commandlineArguments["threads"].size() != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["threads"])) : 1};
+    const uint8_t KEY_LAYOUT{(commandlineArguments["keylayout"].size() != 0) ? static_cast<uint8_t>(std::stoul(commandlineArguments["keylayout"])) : KEY_LAYOUT_COMPARE_KEYS};
+    const bool CLUSTERED{(commandlineArguments["clustered"].size() != 0)};
+    const uint64_t MAX_INLINE_VALUE{(commandlineArguments["inline"].size() != 0) ? static_cast<uint64_t>(std::stoull(commandlineArguments["inline"])) : 0};
+    const std::size_t BLOB_SIZE{(commandlineArguments["blob"].size() != 0) ? static_cast<std::size_t>(std::stoull(commandlineArguments["blob"])) : 0};
 
     cluon::In_Ranges<int64_t> ranges;
     {
@@ -59,7 +73,26 @@ int32_t main(int32_t argc, char **argv) {
     }
 
     const std::string ARGV0{argv[0]};
-    retCode = rec2cabinet(ARGV0, MEM, REC, CABINET, USERDATA, ranges, VERBOSE);
+    codec::Selection codecs;
+    if (!codec::parse(commandlineArguments["codec"], codecs)) {
+      std::cerr << "[" << ARGV0 << "]: Invalid or unavailable codec in '" << commandlineArguments["codec"] << "'." << std::endl;
+      retCode = 1;
+    }
+    else if (RECS.empty() || ((1 < RECS.size() || (RECS.front() != REC)) && (commandlineArguments["cab"].size() == 0))) {
+      std::cerr << "[" << ARGV0 << "]: No .rec file found in '" << REC << "' or --cab missing for several .rec files." << std::endl;
+      retCode = 1;
+    }
+    else if (KEY_LAYOUT_MEMCMP < KEY_LAYOUT) {
+      std::cerr << "[" << ARGV0 << "]: Unknown key layout " << +KEY_LAYOUT << "." << std::endl;
+      retCode = 1;
+    }
+    else if (KEY_MAX_INLINE_VALUE < MAX_INLINE_VALUE) {
+      std::cerr << "[" << ARGV0 << "]: Values of up to " << KEY_MAX_INLINE_VALUE << " bytes can be stored inline." << std::endl;
+      retCode = 1;
+    }
+    else {
+      retCode = rec2cabinet(ARGV0, MEM, RECS, CABINET, USERDATA, ranges, VERBOSE, THREADS, codecs, KEY_LAYOUT, static_cast<uint16_t>(MAX_INLINE_VALUE), CLUSTERED, BLOB_SIZE);
+    }
   }
   return retCode;
 }
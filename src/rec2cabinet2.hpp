@@ -10,41 +10,143 @@
 #define REC2CABINET2_HPP
 
 #include "cluon-complete.hpp"
+#include "blobs.hpp"
+#include "block.hpp"
+#include "clustered.hpp"
+#include "codec.hpp"
+#include "duplicate-filter.hpp"
 #include "key.hpp"
 #include "db.hpp"
 #include "in-ranges.hpp"
+#include "rec-file-view.hpp"
+#include "spsc-queue.hpp"
 
 #include "lmdb++.h"
-#include "lz4.h"
-#include "lz4hc.h"
 #include "xxhash.h"
 
+#include <dirent.h>
+
 #include <cstdio>
 #include <cstring>
 #include <cstdint>
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <iomanip>
+#include <limits>
 #include <locale>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
-inline int rec2cabinet(const std::string &ARGV0, const uint64_t &MEM, const std::string &REC, const std::string &CABINET, const uint64_t &USERDATA, cluon::In_Ranges<int64_t> ranges,  const bool &VERBOSE) {
+/**
+ * An Envelope travelling through the import pipeline:
+ * reader --> hash/compress worker --> writer. value points to the bytes of
+ * the Envelope inside the memory-mapped .rec file.
+ */
+struct Rec2CabinetItem {
+  const char *value{nullptr};
+  std::size_t valueSize{0};
+  int32_t dataType{0};
+  uint32_t senderStamp{0};
+  int64_t sampleTimeStamp{0};
+  uint32_t file{0};
+  uint64_t filePosition{0};
+  uint64_t bytesRead{0};
+  std::vector<char> compressedValue{};
+  uint8_t codecId{codec::NONE};
+  XXH64_hash_t hash{0};
+  std::shared_ptr<const codec::Dictionary> dictionary{nullptr};
+};
+
+/**
+ * This function lists the .rec files to import.
+ *
+ * @param REC comma-separated list of .rec files and/or directories; for a
+ *            directory, all contained files ending with .rec are listed in
+ *            alphabetical order
+ * @return list of .rec files
+ */
+inline std::vector<std::string> listRecFiles(const std::string &REC) {
+  std::vector<std::string> recFiles;
+  std::stringstream sstr{REC};
+  for (std::string entry; std::getline(sstr, entry, ',');) {
+    if (entry.empty()) {
+      continue;
+    }
+    DIR *dir{::opendir(entry.c_str())};
+    if (nullptr == dir) {
+      recFiles.push_back(entry);
+      continue;
+    }
+    std::vector<std::string> filesInDirectory;
+    while (struct dirent *d = ::readdir(dir)) {
+      const std::string name{d->d_name};
+      const std::string SUFFIX{".rec"};
+      if ((name.size() > SUFFIX.size()) && (0 == name.compare(name.size() - SUFFIX.size(), SUFFIX.size(), SUFFIX))) {
+        filesInDirectory.push_back(entry + (('/' == entry.back()) ? "" : "/") + name);
+      }
+    }
+    ::closedir(dir);
+    std::sort(filesInDirectory.begin(), filesInDirectory.end());
+    recFiles.insert(recFiles.end(), filesInDirectory.begin(), filesInDirectory.end());
+  }
+  return recFiles;
+}
+
+/**
+ * This function imports the Envelopes from several .rec files into a cabinet
+ * using a pipeline of one reader thread, THREADS hash/compress worker threads, and
+ * the calling thread as the only writer to the database. The reader hands the
+ * Envelopes round-robin to the workers and the writer collects the results in
+ * the same round-robin order so that the insertion order is deterministic and
+ * independent of THREADS. All queues are bounded to limit the memory usage.
+ * As .rec files are usually ordered by sampleTimeStamp, keys beyond the last
+ * key of a table are appended using MDB_APPEND; out-of-order keys fall back
+ * to regular puts. Duplicated Envelopes are detected in memory before
+ * touching the database. The .rec files are read one after another while
+ * the workers hash and compress the Envelopes of all files concurrently;
+ * hashOfRecFile is computed per file.
+ *
+ * @param ARGV0 Our name.
+ * @param MEM upper memory size for the database in GB
+ * @param RECS .rec files to import
+ * @param CABINET cabinet file to import into
+ * @param USERDATA user-supplied data to be stored in each key
+ * @param ranges temporal ranges that Envelopes to import must reside in
+ * @param VERBOSE
+ * @param THREADS number of hash/compress worker threads
+ * @param CODECS codecs to compress the values per dataType
+ * @param KEY_LAYOUT layout of the keys for a new cabinet; an existing cabinet keeps its layout
+ * @param MAX_INLINE_VALUE store values of up to this many bytes after compression inline in their key in "all" (0 = never)
+ * @param CLUSTERED store the values in the tables "dataType/senderStamp" and only the keys in "all" for a new cabinet; an existing cabinet keeps its choice
+ * @param BLOB_SIZE store values of at least this many bytes after compression in the blob file of the cabinet (0 = never)
+ * @return 0 on success, 1 otherwise
+ */
+inline int rec2cabinet(const std::string &ARGV0, const uint64_t &MEM, const std::vector<std::string> &RECS, const std::string &CABINET, const uint64_t &USERDATA, cluon::In_Ranges<int64_t> ranges,  const bool &VERBOSE, const uint32_t &THREADS = 1, const codec::Selection &CODECS = codec::Selection(), const uint8_t &KEY_LAYOUT = KEY_LAYOUT_COMPARE_KEYS, const uint16_t &MAX_INLINE_VALUE = 0, const bool &CLUSTERED = false, const std::size_t &BLOB_SIZE = 0) {
   int32_t retCode{0};
   const int numberOfDatabases{100};
   const int64_t SIZE_DB = MEM * 1024UL * 1024UL * 1024UL;
-  const uint64_t MAXKEYSIZE = 511;
+  const uint32_t NUMBER_OF_WORKERS{(0 < THREADS) ? THREADS : 1};
+  const std::size_t QUEUE_SIZE{1024};
   try {
     auto env = lmdb::env::create();
     env.set_mapsize(SIZE_DB);
     env.set_max_dbs(numberOfDatabases);
     env.open(CABINET.c_str(), MDB_NOSUBDIR, 0600);
 
+    // Load the existing dictionaries to continue using them for their streams.
+    codec::Dictionaries dictionaries;
     {
       auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+      dictionaries.load(rotxn.handle());
       try {
         auto dbAll = lmdb::dbi::open(rotxn, "all");
-        dbAll.set_compare(rotxn, &compareKeys);
         const uint64_t totalEntries = dbAll.size(rotxn);
         std::clog << "[" << ARGV0 << "]: Found " << totalEntries << " entries in table 'all' in " << CABINET << std::endl;
         lmdb::dbi_close(env, dbAll);
@@ -55,161 +157,327 @@ inline int rec2cabinet(const std::string &ARGV0, const uint64_t &MEM, const std:
       rotxn.abort();
     }
 
-    const XXH32_hash_t hashOfFilename = XXH32(REC.c_str(), REC.size(), 0);
+    codec::DictionaryTrainer dictionaryTrainer(dictionaries);
+    codec::DictionaryIds dictionaryIds(dictionaries);
 
     const cluon::data::TimeStamp BEFORE{cluon::time::now()};
     uint32_t entries{0};
-    std::fstream recFile;
-    recFile.open(REC.c_str(), std::ios_base::in | std::ios_base::binary);
+    // Memory-map the .rec files to access the Envelopes in place; they stay
+    // mapped until the writer has stored all Envelopes.
+    std::vector<std::unique_ptr<cluon::RecFileView>> recFiles;
+    std::vector<std::string> recFileNames;
+    std::vector<XXH32_hash_t> hashesOfFilenames;
+    for (auto REC : RECS) {
+      std::unique_ptr<cluon::RecFileView> recFile{new cluon::RecFileView(REC)};
+      if (recFile->good()) {
+        recFiles.push_back(std::move(recFile));
+        recFileNames.push_back(REC);
+        hashesOfFilenames.push_back(XXH32(REC.c_str(), REC.size(), 0));
+      }
+      else {
+        std::clog << "[" << ARGV0 << "]: " << REC << " could not be opened." << std::endl;
+        retCode = 1;
+      }
+    }
 
-    if (recFile.good()) {
-      auto txn = lmdb::txn::begin(env);
-      auto dbAll = lmdb::dbi::open(txn, "all", MDB_CREATE);
-      dbAll.set_compare(txn, &compareKeys);
+    if (!recFiles.empty()) {
+      // Determine total file size to display progress.
+      int64_t fileLength{0};
+      for (auto &recFile : recFiles) {
+        fileLength += recFile->size();
+      }
 
-      uint64_t totalBytesRead = 0;
-      // Determine file size to display progress.
-      recFile.seekg(0, recFile.end);
-      int64_t fileLength = recFile.tellg();
-      recFile.seekg(0, recFile.beg);
+      // The filter is sized for the keys stored within the time range of the .rec files and for
+      // the Envelopes of the .rec files, which take at least ENVELOPE_MIN_SIZE bytes each.
+      const uint64_t ENVELOPE_MIN_SIZE{32};
+      DuplicateFilter duplicateFilter(static_cast<uint64_t>(fileLength) / ENVELOPE_MIN_SIZE);
 
-      int32_t oldPercentage{-1};
-      while (recFile.good()) {
-        const uint64_t POS_BEFORE = static_cast<uint64_t>(recFile.tellg());
-        auto retVal               = cluon::extractEnvelope(recFile);
-        const uint64_t POS_AFTER  = static_cast<uint64_t>(recFile.tellg());
-
-        if (!recFile.eof() && retVal.first) {
-          totalBytesRead += (POS_AFTER - POS_BEFORE);
+      // Large values are appended to the blob file and only referenced.
+      clustered::Store store(blobs::fileOf(CABINET), KEY_LAYOUT, CLUSTERED, MAX_INLINE_VALUE, BLOB_SIZE, &duplicateFilter);
+      auto txn = lmdb::txn::begin(env);
+      const int32_t BEGIN_RC{store.begin(txn.handle())};
+      if (MDB_SUCCESS != BEGIN_RC) {
+        lmdb::error::raise("clustered::Store::begin", BEGIN_RC);
+      }
+      // The keys of blocks hold the last timeStamp and the number of
+      // Envelopes instead of the xxhash; hence, duplicates cannot be detected.
+      if (block::isPacked(txn.handle(), store.all())) {
+        std::cerr << "[" << ARGV0 << "]: " << CABINET << " stores blocks of Envelopes; unpack it with cabinet-migrate before importing into it." << std::endl;
+        return 1;
+      }
+      const uint8_t LAYOUT{store.layout()};
+      if (LAYOUT != KEY_LAYOUT) {
+        std::clog << "[" << ARGV0 << "]: Using key layout " << +LAYOUT << " of " << CABINET << "." << std::endl;
+      }
+      if (store.isClustered() != CLUSTERED) {
+        std::clog << "[" << ARGV0 << "]: Storing values " << (store.isClustered() ? "per stream" : "in 'all'") << " like in " << CABINET << "." << std::endl;
+      }
 
-          cluon::data::Envelope e{std::move(retVal.second)};
-          auto sampleTimeStamp{cluon::time::toMicroseconds(e.sampleTimeStamp())};
+      // Load the keys stored within the time range of the .rec files to skip duplicated Envelopes.
+      {
+        int64_t first{std::numeric_limits<int64_t>::max()};
+        int64_t last{std::numeric_limits<int64_t>::min()};
+        for (auto &recFile : recFiles) {
+          int64_t _first{0};
+          int64_t _last{0};
+          if (recFile->timeRange(_first, _last)) {
+            first = std::min(first, _first);
+            last = std::max(last, _last);
+          }
+        }
+        if (first <= last) {
+          const uint64_t seeded{duplicateFilter.seed(txn.handle(), store.all(), first * 1000UL, last * 1000UL, LAYOUT, static_cast<uint64_t>(fileLength) / ENVELOPE_MIN_SIZE)};
+          std::clog << "[" << ARGV0 << "]: Loaded " << seeded << " entries from table 'all' (" << duplicateFilter.bytes() / 1024 << " KB) to check for duplicates." << std::endl;
+        }
+      }
 
-          if (!ranges.empty() && !(ranges.isInAnyRange(sampleTimeStamp * 1000UL))) {
-            // This Envelope resides temporally not within any allowed start/end range.
-            if (VERBOSE) {
-              std::cerr << "not in range: " << sampleTimeStamp << std::endl;
+      // Per-file statistics.
+      struct FileStatistics {
+        uint64_t envelopes{0};
+        uint64_t bytes{0};
+        uint64_t stored{0};
+        uint64_t duplicates{0};
+        cluon::data::TimeStamp start{};
+        cluon::data::TimeStamp end{};
+      };
+      std::vector<FileStatistics> fileStatistics(recFiles.size());
+
+      // One queue from the reader to each worker and one queue from each worker to the writer.
+      std::vector<std::unique_ptr<cluon::SPSC_Queue<Rec2CabinetItem>>> toWorkers;
+      std::vector<std::unique_ptr<cluon::SPSC_Queue<Rec2CabinetItem>>> toWriter;
+      for (uint32_t i{0}; i < NUMBER_OF_WORKERS; i++) {
+        toWorkers.emplace_back(new cluon::SPSC_Queue<Rec2CabinetItem>(QUEUE_SIZE));
+        toWriter.emplace_back(new cluon::SPSC_Queue<Rec2CabinetItem>(QUEUE_SIZE));
+      }
+      std::atomic<bool> readerDone{false};
+      std::atomic<bool> abortPipeline{false};
+      std::atomic<uint64_t> itemsRead{0};
+
+      // Per-stage counters.
+      uint64_t totalBytesRead{0};
+      uint64_t readerStalls{0};
+      int64_t readerDuration{0};
+      std::vector<uint64_t> workerBytesIn(NUMBER_OF_WORKERS, 0);
+      std::vector<uint64_t> workerBytesOut(NUMBER_OF_WORKERS, 0);
+      std::vector<int64_t> workerBusy(NUMBER_OF_WORKERS, 0);
+      uint64_t writerStalls{0};
+      uint64_t duplicates{0};
+
+      // Stage 1: Read Envelopes and hand them round-robin to the workers.
+      std::thread reader([&]() {
+        const cluon::data::TimeStamp START{cluon::time::now()};
+        uint64_t sequence{0};
+        uint64_t bytesOfPreviousFiles{0};
+        for (uint32_t file{0}; (file < recFiles.size()) && !abortPipeline.load(); file++) {
+          cluon::EnvelopeView e;
+          while (!abortPipeline.load() && recFiles[file]->next(e)) {
+            const uint64_t POS_BEFORE = e.offset();
+            const uint64_t POS_AFTER  = e.offset() + e.size();
+
+            totalBytesRead += (POS_AFTER - POS_BEFORE);
+
+            // Only the fields for the key are decoded from the Envelope.
+            Rec2CabinetItem item;
+            item.value = e.data();
+            item.valueSize = e.size();
+            item.dataType = e.dataType();
+            item.senderStamp = e.senderStamp();
+            item.sampleTimeStamp = e.sampleTimeStamp();
+            item.file = file;
+            item.filePosition = bytesOfPreviousFiles + POS_AFTER;
+            item.bytesRead = POS_AFTER - POS_BEFORE;
+
+            if (!ranges.empty() && !(ranges.isInAnyRange(item.sampleTimeStamp * 1000UL))) {
+              // This Envelope resides temporally not within any allowed start/end range.
+              if (VERBOSE) {
+                std::cerr << "not in range: " << item.sampleTimeStamp << std::endl;
+              }
+              continue;
             }
-            continue;
-          }
 
-          cabinet::Key k;
-          k.dataType(e.dataType())
-           .senderStamp(e.senderStamp())
-           .hashOfRecFile(hashOfFilename)
-           .userData(USERDATA)
-           .version(0);
-
-          // Create bytes to store in "all".
-          std::string sVal{cluon::serializeEnvelope(std::move(e))};
-          char *ptrToValue = const_cast<char*>(sVal.data());
-          ssize_t lengthOfValue = sVal.size();
-
-          XXH64_hash_t hash = XXH64(sVal.data(), sVal.size(), 0);
-          k.hash(hash)
-           .length(sVal.size());
-
-          // Compress value via lz4.
-          std::vector<char> compressedValue;
-          ssize_t compressedSize{0};
-          {
-            ssize_t expectedCompressedSize = LZ4_compressBound(sVal.size());
-            compressedValue.reserve(expectedCompressedSize);
-            compressedSize = LZ4_compress_HC(sVal.data(), compressedValue.data(), sVal.size(), compressedValue.capacity(), LZ4HC_CLEVEL_MAX);
-            if ( (compressedSize > 0) && (compressedSize < lengthOfValue) ) {
-              ptrToValue = compressedValue.data();
-              lengthOfValue = compressedSize;
+            // Dictionaries are trained in the order of the .rec file.
+            if (codec::usesDictionary(CODECS.select(item.dataType).codec)) {
+              item.dictionary = dictionaryTrainer.sample(item.dataType, item.senderStamp, item.value, item.valueSize);
             }
-          }
 
-          std::vector<char> _key;
-          _key.reserve(MAXKEYSIZE);
-
-          MDB_val key;
-          MDB_val value;
-          int64_t sampleTimeStampOffsetToAvoidCollision{0};
-          bool duplicate{false};
-          do {
-            k.timeStamp(sampleTimeStamp * 1000UL + sampleTimeStampOffsetToAvoidCollision);
-
-            key.mv_size = setKey(k, _key.data(), _key.capacity());
-            key.mv_data = _key.data();
-
-            value.mv_size = lengthOfValue;
-            value.mv_data = ptrToValue;
-
-            // Check for duplicated entries.
-            {
-              try {
-                duplicate = false;
-                auto _rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
-                //auto _dbAll = lmdb::dbi::open(_rotxn, "all");
-                //_dbAll.set_compare(txn, &compareKeys);
-                auto _cursor = lmdb::cursor::open(_rotxn, dbAll);
-                MDB_val tmpKey = key;
-                MDB_val tmpVal;
-                //if (MDB_SUCCESS == _cursor.get(&tmpKey, &tmpVal, MDB_SET_KEY)) {
-                if (MDB_SUCCESS == mdb_cursor_get(_cursor, &tmpKey, &tmpVal, MDB_SET_KEY)) {
-                  // Extract xxhash from found key and compare with calculated key to maybe skip adding this value.
-                  const char *ptr = static_cast<char*>(tmpKey.mv_data);
-                  cabinet::Key storedKey = getKey(ptr, tmpKey.mv_size);
-                  duplicate = (hash == storedKey.hash());
-                  if (VERBOSE) {
-                    std::cerr << std::hex << "hash-to-store: 0x" << hash << ", hash-stored: 0x" << storedKey.hash() << std::dec << ", is duplicate = " << duplicate << std::endl;
-                  }
-                }
-                _cursor.close();
-                //lmdb::dbi_close(env, _dbAll);
-                _rotxn.abort();
-                if (duplicate) {
-                  // value is existing, skip storing
-                  retCode = 0;
-                  break;
-                }
+            // Backpressure: Wait for the worker to catch up.
+            while (!toWorkers[sequence % NUMBER_OF_WORKERS]->push(std::move(item))) {
+              if (abortPipeline.load()) {
+                break;
               }
-              catch(...) {
+              readerStalls++;
+              std::this_thread::yield();
+            }
+            sequence++;
+            itemsRead.store(sequence);
+          }
+          bytesOfPreviousFiles += recFiles[file]->size();
+        }
+        readerDuration = cluon::time::deltaInMicroseconds(cluon::time::now(), START);
+        readerDone.store(true);
+      });
+
+      // Stage 2: Hash and compress Envelopes.
+      std::vector<std::thread> workers;
+      for (uint32_t id{0}; id < NUMBER_OF_WORKERS; id++) {
+        workers.emplace_back([&, id]() {
+          Rec2CabinetItem item;
+          while (!abortPipeline.load()) {
+            if (!toWorkers[id]->pop(item)) {
+              if (readerDone.load() && toWorkers[id]->empty()) {
+                break;
               }
+              std::this_thread::yield();
+              continue;
             }
+            const cluon::data::TimeStamp START{cluon::time::now()};
+
+            // The bytes of the Envelope as they are in the .rec file are stored in "all".
+            item.hash = XXH64(item.value, item.valueSize, 0);
+
+            // Compress value with the codec selected for its dataType.
+            item.codecId = codec::encode(CODECS.select(item.dataType), item.value, item.valueSize, item.compressedValue, item.dictionary.get());
+            workerBytesIn[id] += item.valueSize;
+            workerBytesOut[id] += (codec::NONE != item.codecId) ? item.compressedValue.size() : item.valueSize;
+            workerBusy[id] += cluon::time::deltaInMicroseconds(cluon::time::now(), START);
 
-            // Try next slot if already taken.
-            sampleTimeStampOffsetToAvoidCollision++;
-          } while ( MDB_KEYEXIST == (retCode = lmdb::dbi_put2(txn, dbAll, &key, &value, MDB_NOOVERWRITE)) );
-          if (MDB_SUCCESS == retCode) {
-            entries++;
+            while (!toWriter[id]->push(std::move(item))) {
+              if (abortPipeline.load()) {
+                break;
+              }
+              std::this_thread::yield();
+            }
           }
+        });
+      }
 
-          // Add key to separate database named "dataType/senderStamp".
-          if (!duplicate) {
-            std::stringstream _dataType_senderStamp;
-            _dataType_senderStamp << e.dataType() << '/'<< e.senderStamp();
-            const std::string _shortKey{_dataType_senderStamp.str()};
+      auto joinPipeline = [&reader, &workers]() {
+        reader.join();
+        for (auto &w : workers) {
+          w.join();
+        }
+      };
 
-            // Make sure to have a database "dataType/senderStamp" and that we have it open.
-            auto dbDataTypeSenderStamp = lmdb::dbi::open(txn, _shortKey.c_str(), MDB_CREATE);
-            dbDataTypeSenderStamp.set_compare(txn, &compareKeys);
+      // Stage 3: Store the Envelopes in the order they were read.
+      const cluon::data::TimeStamp WRITER_START{cluon::time::now()};
+      int32_t oldPercentage{-1};
+      uint64_t sequence{0};
+      Rec2CabinetItem item;
+      try {
+        while (true) {
+          if (!toWriter[sequence % NUMBER_OF_WORKERS]->pop(item)) {
+            if (readerDone.load() && (sequence == itemsRead.load())) {
+              break;
+            }
+            writerStalls++;
+            std::this_thread::yield();
+            continue;
+          }
+          sequence++;
 
-            key.mv_size = setKey(k, _key.data(), _key.capacity());
-            key.mv_data = _key.data();
+          FileStatistics &fileStatistic = fileStatistics[item.file];
+          if (0 == fileStatistic.envelopes) {
+            fileStatistic.start = cluon::time::now();
+          }
+          fileStatistic.envelopes++;
+          fileStatistic.bytes += item.bytesRead;
+
+          // Store a new dictionary within the same transaction as its first value.
+          if (codec::usesDictionary(item.codecId)) {
+            const int32_t rc{dictionaryIds.store(txn.handle(), *item.dictionary, item.compressedValue)};
+            if (MDB_SUCCESS != rc) {
+              lmdb::error::raise("codec::Dictionaries::store", rc);
+            }
+          }
 
-            value.mv_size = 0;
-            value.mv_data = nullptr;
+          cabinet::Key k;
+          k.timeStamp(item.sampleTimeStamp * 1000UL)
+           .dataType(item.dataType)
+           .senderStamp(item.senderStamp)
+           .hash(item.hash)
+           .hashOfRecFile(hashesOfFilenames[item.file])
+           .length(item.valueSize)
+           .userData(USERDATA)
+           .version(codec::version(LAYOUT, item.codecId));
 
-            lmdb::dbi_put(txn, dbDataTypeSenderStamp, &key, &value, 0);
+          const bool IS_COMPRESSED{codec::NONE != item.codecId};
+          const int32_t rc{store.put(txn.handle(), k, IS_COMPRESSED ? item.compressedValue.data() : item.value, IS_COMPRESSED ? item.compressedValue.size() : item.valueSize, item.valueSize)};
+          if (MDB_KEYEXIST == rc) {
+            if (VERBOSE) {
+              std::cerr << std::hex << "hash-to-store: 0x" << item.hash << std::dec << " is duplicate" << std::endl;
+            }
+            duplicates++;
+            fileStatistic.duplicates++;
+            fileStatistic.end = cluon::time::now();
+            continue;
+          }
+          if (MDB_SUCCESS != rc) {
+            lmdb::error::raise("clustered::Store::put", rc);
           }
+          entries++;
+          fileStatistic.stored++;
 
-          const int32_t percentage = static_cast<int32_t>((static_cast<float>(recFile.tellg()) * 100.0f) / static_cast<float>(fileLength));
+          const int32_t percentage = static_cast<int32_t>((static_cast<float>(item.filePosition) * 100.0f) / static_cast<float>(fileLength));
           if ((percentage % 5 == 0) && (percentage != oldPercentage)) {
-            std::clog << "[" << ARGV0 << "]: Processed " << percentage << "% (" << entries << " entries) from " << REC << std::endl;
+            std::clog << "[" << ARGV0 << "]: Processed " << percentage << "% (" << entries << " entries) from " << recFileNames[item.file] << std::endl;
             oldPercentage = percentage;
           }
+          fileStatistic.end = cluon::time::now();
         }
       }
+      catch(...) {
+        // Stop reader and workers before giving up.
+        abortPipeline.store(true);
+        joinPipeline();
+        throw;
+      }
+      const int64_t writerDuration{cluon::time::deltaInMicroseconds(cluon::time::now(), WRITER_START)};
+      joinPipeline();
 
+      const int32_t FLUSH_RC{store.flush(txn.handle())};
+      if (MDB_SUCCESS != FLUSH_RC) {
+        lmdb::error::raise("clustered::Store::flush", FLUSH_RC);
+      }
       txn.commit();
+      if (0 < store.valuesInBlobFile()) {
+        std::clog << "[" << ARGV0 << "]: Stored " << store.valuesInBlobFile() << " values in " << blobs::fileOf(CABINET) << " (" << store.bytesInBlobFile() << " bytes)." << std::endl;
+      }
+
+      // Display per-stage throughput.
+      {
+        auto perSecond = [](const double &v, const int64_t &durationInMicroseconds) {
+          return (durationInMicroseconds > 0) ? (v * 1000.0 * 1000.0) / static_cast<double>(durationInMicroseconds) : 0.0;
+        };
+        const double MB{1024.0 * 1024.0};
+        uint64_t bytesIn{0};
+        uint64_t bytesOut{0};
+        int64_t busy{0};
+        for (uint32_t id{0}; id < NUMBER_OF_WORKERS; id++) {
+          bytesIn += workerBytesIn[id];
+          bytesOut += workerBytesOut[id];
+          busy += workerBusy[id];
+        }
+        std::clog << std::fixed << std::setprecision(2);
+        std::clog << "[" << ARGV0 << "]: reader: " << itemsRead.load() << " envelopes, " << perSecond(static_cast<double>(itemsRead.load()), readerDuration) << " envelopes/s, "
+                  << perSecond(static_cast<double>(totalBytesRead) / MB, readerDuration) << " MB/s, " << readerStalls << " stalls on full queues" << std::endl;
+        std::clog << "[" << ARGV0 << "]: " << NUMBER_OF_WORKERS << " worker(s): " << perSecond(static_cast<double>(bytesIn) / MB, busy) << " MB/s per worker, "
+                  << perSecond(static_cast<double>(bytesIn) / MB, writerDuration) << " MB/s in total, compressed " << bytesIn << " to " << bytesOut << " bytes" << std::endl;
+        std::clog << "[" << ARGV0 << "]: writer: " << sequence << " envelopes, " << perSecond(static_cast<double>(sequence), writerDuration) << " envelopes/s, "
+                  << store.appended() << " appended, " << store.inserted() << " inserted, " << duplicates << " duplicates skipped, " << store.lookupsSaved() << " lookups saved, " << writerStalls << " stalls on empty queues" << std::endl;
+        if (1 < recFiles.size()) {
+          for (uint32_t file{0}; file < recFiles.size(); file++) {
+            const FileStatistics &f = fileStatistics[file];
+            const int64_t duration{cluon::time::deltaInMicroseconds(f.end, f.start)};
+            std::clog << "[" << ARGV0 << "]: " << recFileNames[file] << ": " << f.envelopes << " envelopes, " << f.stored << " stored, "
+                      << f.duplicates << " duplicates skipped, " << perSecond(static_cast<double>(f.bytes) / MB, duration) << " MB/s" << std::endl;
+          }
+        }
+        std::clog << std::defaultfloat;
+      }
     }
 
     const cluon::data::TimeStamp AFTER{cluon::time::now()};
-    std::clog << "[" << ARGV0 << "]: Processed 100% (" << entries << " entries) from " << REC
+    std::clog << "[" << ARGV0 << "]: Processed 100% (" << entries << " entries) from " << recFiles.size() << " file(s)"
               << " in " << cluon::time::deltaInMicroseconds(AFTER, BEFORE) / static_cast<int64_t>(1000 * 1000) << "s." << std::endl;
   }
   catch(...) {
@@ -219,4 +487,26 @@ inline int rec2cabinet(const std::string &ARGV0, const uint64_t &MEM, const std:
   return retCode;
 }
 
+/**
+ * This function imports the Envelopes from a .rec file into a cabinet.
+ *
+ * @param ARGV0 Our name.
+ * @param MEM upper memory size for the database in GB
+ * @param REC .rec file to import
+ * @param CABINET cabinet file to import into
+ * @param USERDATA user-supplied data to be stored in each key
+ * @param ranges temporal ranges that Envelopes to import must reside in
+ * @param VERBOSE
+ * @param THREADS number of hash/compress worker threads
+ * @param CODECS codecs to compress the values per dataType
+ * @param KEY_LAYOUT layout of the keys for a new cabinet; an existing cabinet keeps its layout
+ * @param MAX_INLINE_VALUE store values of up to this many bytes after compression inline in their key in "all" (0 = never)
+ * @param CLUSTERED store the values in the tables "dataType/senderStamp" and only the keys in "all" for a new cabinet; an existing cabinet keeps its choice
+ * @param BLOB_SIZE store values of at least this many bytes after compression in the blob file of the cabinet (0 = never)
+ * @return 0 on success, 1 otherwise
+ */
+inline int rec2cabinet(const std::string &ARGV0, const uint64_t &MEM, const std::string &REC, const std::string &CABINET, const uint64_t &USERDATA, cluon::In_Ranges<int64_t> ranges,  const bool &VERBOSE, const uint32_t &THREADS = 1, const codec::Selection &CODECS = codec::Selection(), const uint8_t &KEY_LAYOUT = KEY_LAYOUT_COMPARE_KEYS, const uint16_t &MAX_INLINE_VALUE = 0, const bool &CLUSTERED = false, const std::size_t &BLOB_SIZE = 0) {
+  return rec2cabinet(ARGV0, MEM, std::vector<std::string>{REC}, CABINET, USERDATA, ranges, VERBOSE, THREADS, CODECS, KEY_LAYOUT, MAX_INLINE_VALUE, CLUSTERED, BLOB_SIZE);
+}
+
 #endif
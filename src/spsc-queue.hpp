@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef SPSC_QUEUE
+#define SPSC_QUEUE
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace cluon {
+
+/**
+ * Bounded, lock-free queue for exactly one producer thread and exactly one
+ * consumer thread. push() fails when the queue is full so that the producer
+ * can back off; pop() fails when the queue is empty.
+ */
+template <class T>
+class SPSC_Queue {
+ private:
+  SPSC_Queue(const SPSC_Queue &) = delete;
+  SPSC_Queue(SPSC_Queue &&)      = delete;
+  SPSC_Queue &operator=(const SPSC_Queue &) = delete;
+  SPSC_Queue &operator=(SPSC_Queue &&) = delete;
+
+ public:
+  explicit SPSC_Queue(const std::size_t &capacity) :
+    m_buffer(capacity + 1) {}
+
+  std::size_t capacity() const {
+    return m_buffer.size() - 1;
+  }
+
+  bool empty() const {
+    return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @param v value to move into the queue; untouched if the queue is full
+   * @return true if v was enqueued
+   */
+  bool push(T &&v) {
+    const std::size_t head{m_head.load(std::memory_order_relaxed)};
+    const std::size_t next{(head + 1) % m_buffer.size()};
+    if (next == m_tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    m_buffer[head] = std::move(v);
+    m_head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @param v value to move the oldest entry into
+   * @return true if an entry was dequeued
+   */
+  bool pop(T &v) {
+    const std::size_t tail{m_tail.load(std::memory_order_relaxed)};
+    if (tail == m_head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    v = std::move(m_buffer[tail]);
+    m_tail.store((tail + 1) % m_buffer.size(), std::memory_order_release);
+    return true;
+  }
+
+ private:
+  std::vector<T> m_buffer;
+  // Keep producer and consumer indices on separate cache lines.
+  char m_padding0[64] = {};
+  std::atomic<std::size_t> m_head{0};
+  char m_padding1[64] = {};
+  std::atomic<std::size_t> m_tail{0};
+};
+
+} // cluon
+#endif
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef TIMELINE_HPP
+#define TIMELINE_HPP
+
+#include "key.hpp"
+#include "lmdb.h"
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/**
+ * Number of Envelopes and their bytes per stream and minute, stored in the
+ * table "timeline" in format (all values are big Endian):
+ *
+ *    key:   int32_t dataType, uint32_t senderStamp, int64_t minute
+ *    value: uint64_t count, uint64_t rawBytes
+ *
+ * minute is the timeStamp in nanoseconds divided by BUCKET (rounded towards
+ * -inf); the sign bits of dataType and minute are flipped so that LMDB's
+ * default memcmp orders the keys by stream and then by time. Hence, the
+ * buckets of a stream within a time range are read with a single cursor
+ * seek. Like the catalog (cf. catalog.hpp), the writers collect the changes
+ * and merge them into the table within the same write transaction as the
+ * Envelopes.
+ */
+namespace timeline {
+
+constexpr int64_t BUCKET{60L * 1000L * 1000L * 1000L};
+constexpr std::size_t KEY_SIZE{2 * sizeof(uint32_t) + sizeof(int64_t)};
+constexpr std::size_t VALUE_SIZE{2 * sizeof(uint64_t)};
+
+struct Bucket {
+  int64_t minute{0};
+  uint64_t count{0};
+  uint64_t rawBytes{0};
+};
+
+/**
+ * @param timeStamp in nanoseconds
+ * @return minute of the timeStamp
+ */
+inline int64_t minuteOf(const int64_t &timeStamp) noexcept {
+  return (timeStamp / BUCKET) - (((timeStamp % BUCKET) < 0) ? 1 : 0);
+}
+
+/**
+ * @param dataType
+ * @param senderStamp
+ * @param minute
+ * @param dst buffer of KEY_SIZE bytes
+ */
+inline void keyOf(const int32_t &dataType, const uint32_t &senderStamp, const int64_t &minute, char *dst) noexcept {
+  writeBigEndian(static_cast<uint32_t>(dataType) ^ 0x80000000u, dst);
+  writeBigEndian(senderStamp, dst + 4);
+  writeBigEndian(static_cast<uint64_t>(minute) ^ 0x8000000000000000ull, dst + 8);
+}
+
+/**
+ * @param src key of KEY_SIZE bytes
+ * @return (dataType, senderStamp, minute)
+ */
+inline std::tuple<int32_t, uint32_t, int64_t> fromKey(const char *src) noexcept {
+  return std::make_tuple(static_cast<int32_t>(readBigEndian<uint32_t>(src) ^ 0x80000000u),
+                         readBigEndian<uint32_t>(src + 4),
+                         static_cast<int64_t>(readBigEndian<uint64_t>(src + 8) ^ 0x8000000000000000ull));
+}
+
+/**
+ * The buckets per stream as (dataType, senderStamp).
+ */
+class Timeline {
+ public:
+  using Stream = std::pair<int32_t, uint32_t>;
+
+  /**
+   * This method adds a stored Envelope to the changes.
+   *
+   * @param dataType
+   * @param senderStamp
+   * @param timeStamp in nanoseconds
+   * @param rawBytes bytes of the Envelope
+   */
+  void add(const int32_t &dataType, const uint32_t &senderStamp, const int64_t &timeStamp, const uint64_t &rawBytes) {
+    Bucket &b = m_changes[std::make_tuple(dataType, senderStamp, minuteOf(timeStamp))];
+    b.count++;
+    b.rawBytes += rawBytes;
+  }
+
+  /**
+   * This method merges the changes into the table "timeline" and clears them.
+   *
+   * @param txn write transaction
+   * @return MDB_SUCCESS or LMDB error code
+   */
+  int32_t store(MDB_txn *txn) {
+    if (m_changes.empty()) {
+      return MDB_SUCCESS;
+    }
+    MDB_dbi dbi{0};
+    int32_t rc = mdb_dbi_open(txn, "timeline", MDB_CREATE, &dbi);
+    char k[KEY_SIZE];
+    char v[VALUE_SIZE];
+    for (auto it = m_changes.begin(); (MDB_SUCCESS == rc) && (m_changes.end() != it); it++) {
+      keyOf(std::get<0>(it->first), std::get<1>(it->first), std::get<2>(it->first), k);
+      MDB_val key{KEY_SIZE, k};
+      MDB_val value;
+      uint64_t count{it->second.count};
+      uint64_t rawBytes{it->second.rawBytes};
+      if ( (MDB_SUCCESS == mdb_get(txn, dbi, &key, &value)) && (VALUE_SIZE == value.mv_size) ) {
+        count += readBigEndian<uint64_t>(static_cast<const char*>(value.mv_data));
+        rawBytes += readBigEndian<uint64_t>(static_cast<const char*>(value.mv_data) + 8);
+      }
+      writeBigEndian(count, v);
+      writeBigEndian(rawBytes, v + 8);
+      value = MDB_val{VALUE_SIZE, v};
+      rc = mdb_put(txn, dbi, &key, &value, 0);
+    }
+    if (MDB_SUCCESS == rc) {
+      m_changes.clear();
+    }
+    return rc;
+  }
+
+ private:
+  std::map<std::tuple<int32_t, uint32_t, int64_t>, Bucket> m_changes{};
+};
+
+/**
+ * This function reads the buckets of all streams between two timeStamps; it
+ * seeks once per stream to the first bucket in the range and skips to the
+ * next stream after the last one.
+ *
+ * @param txn transaction to read from
+ * @param from timeStamp in nanoseconds
+ * @param to timeStamp in nanoseconds (inclusive)
+ * @param buckets non-empty buckets per stream, ordered by minute
+ * @return false if the table "timeline" does not exist
+ */
+inline bool query(MDB_txn *txn, const int64_t &from, const int64_t &to, std::map<Timeline::Stream, std::vector<Bucket>> &buckets) {
+  buckets.clear();
+  MDB_dbi dbi{0};
+  MDB_cursor *cursor{nullptr};
+  if ( (MDB_SUCCESS != mdb_dbi_open(txn, "timeline", 0, &dbi))
+    || (MDB_SUCCESS != mdb_cursor_open(txn, dbi, &cursor)) ) {
+    return false;
+  }
+  const int64_t FIRST{minuteOf(from)};
+  const int64_t LAST{minuteOf(to)};
+  char k[KEY_SIZE];
+  keyOf(std::numeric_limits<int32_t>::min(), 0, FIRST, k);
+  MDB_val key{KEY_SIZE, k};
+  MDB_val value;
+  int32_t rc{mdb_cursor_get(cursor, &key, &value, MDB_SET_RANGE)};
+  while (MDB_SUCCESS == rc) {
+    if ( (KEY_SIZE != key.mv_size) || (VALUE_SIZE != value.mv_size) ) {
+      rc = mdb_cursor_get(cursor, &key, &value, MDB_NEXT);
+      continue;
+    }
+    int32_t dataType;
+    uint32_t senderStamp;
+    int64_t minute;
+    std::tie(dataType, senderStamp, minute) = fromKey(static_cast<const char*>(key.mv_data));
+    if (minute < FIRST) {
+      // Seek to the range in this stream.
+      keyOf(dataType, senderStamp, FIRST, k);
+    }
+    else if (minute <= LAST) {
+      const char *ptr{static_cast<const char*>(value.mv_data)};
+      buckets[std::make_pair(dataType, senderStamp)].push_back(Bucket{minute, readBigEndian<uint64_t>(ptr), readBigEndian<uint64_t>(ptr + 8)});
+      rc = mdb_cursor_get(cursor, &key, &value, MDB_NEXT);
+      continue;
+    }
+    else if (std::numeric_limits<uint32_t>::max() != senderStamp) {
+      // Seek to the range in the next stream.
+      keyOf(dataType, senderStamp + 1, FIRST, k);
+    }
+    else if (std::numeric_limits<int32_t>::max() != dataType) {
+      keyOf(dataType + 1, 0, FIRST, k);
+    }
+    else {
+      break;
+    }
+    key = MDB_val{KEY_SIZE, k};
+    rc = mdb_cursor_get(cursor, &key, &value, MDB_SET_RANGE);
+  }
+  mdb_cursor_close(cursor);
+  return true;
+}
+
+/**
+ * @param buckets non-empty buckets of a stream, ordered by minute
+ * @param first minute of the range
+ * @param last minute of the range (inclusive)
+ * @return ranges of minutes (first, last) without Envelopes within the range
+ */
+inline std::vector<std::pair<int64_t, int64_t>> gapsOf(const std::vector<Bucket> &buckets, const int64_t &first, const int64_t &last) {
+  std::vector<std::pair<int64_t, int64_t>> gaps;
+  int64_t next{first};
+  for (const auto &b : buckets) {
+    if ((b.minute < first) || (b.minute > last)) {
+      continue;
+    }
+    if (b.minute > next) {
+      gaps.emplace_back(next, b.minute - 1);
+    }
+    next = b.minute + 1;
+  }
+  if (next <= last) {
+    gaps.emplace_back(next, last);
+  }
+  return gaps;
+}
+
+}
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef GPS_TRACES_HPP
+#define GPS_TRACES_HPP
+
+// A lap around AstaZero as "latitude longitude" per line.
+static const char *GPS_TRACE_AZ = R"(
+57.77778901 12.77790337
+57.77734125 12.77817215
+57.77689127 12.77846196
+57.77645616 12.77873826
+57.77601406 12.77902484
+57.77556784 12.77930998
+57.7751248 12.77957598
+57.77467775 12.77975093
+57.77422499 12.77980395
+57.7737736 12.77971304
+57.77332939 12.77949689
+57.77289907 12.77913649
+57.77250135 12.77864161
+57.77216032 12.77803764
+57.77187986 12.77735772
+57.77166482 12.77660913
+57.77151726 12.77580491
+57.77143545 12.77494498
+57.77141137 12.7740273
+57.77140439 12.77307387
+57.77140376 12.77214181
+57.77143701 12.77125741
+57.77152257 12.77038774
+57.77165858 12.76955397
+57.77184604 12.76874014
+57.77209332 12.76794528
+57.77238912 12.76722763
+57.77271621 12.76659785
+57.77306859 12.76606175
+57.77346526 12.76559187
+57.77388869 12.7652073
+57.77434951 12.76490549
+57.77481957 12.76472222
+57.77528843 12.76462972
+57.77575132 12.76465133
+57.77621227 12.76477113
+57.7766734 12.76499178
+57.77711784 12.76531837
+57.77754423 12.7657113
+57.77796038 12.76611514
+57.77839225 12.76651221
+57.77884971 12.76681376
+57.77931949 12.76699075
+57.77979492 12.76706398
+57.78026842 12.76701259
+57.78074233 12.76683419
+57.78119314 12.76654933
+57.78161167 12.76617196
+57.78200969 12.76573402
+57.78240413 12.76527802
+57.78281179 12.76480606
+57.78322918 12.76433381
+57.78365049 12.76384777
+57.78403756 12.76339636
+57.7844396 12.76293542
+57.78485236 12.76245808
+57.78526512 12.76198531
+57.78567563 12.76151412
+57.78607437 12.76105485
+57.78646903 12.76059934
+57.78685972 12.76015645
+57.78729273 12.75972409
+57.78772906 12.7594104
+57.78820149 12.75920448
+57.78868953 12.75913302
+57.78917059 12.75919195
+57.78962594 12.75937305
+57.79006776 12.75967779
+57.79048793 12.76009748
+57.79085991 12.76061729
+57.7912018 12.76126108
+57.79147693 12.76200414
+57.79167706 12.76284685
+57.79178783 12.76368688
+57.79182191 12.7645425
+57.79177819 12.76539516
+57.79164308 12.76628887
+57.79142382 12.76711409
+57.79114957 12.76781077
+57.79081165 12.76841176
+57.79043384 12.76887687
+57.79000543 12.76924681
+57.78957781 12.7695419
+57.78914941 12.7698457
+57.78870819 12.77020802
+57.78828911 12.77061578
+57.78788781 12.77107466
+57.78749761 12.77156274
+57.78711964 12.77203214
+57.7867304 12.77251473
+57.78631662 12.7730335
+57.7859302 12.77351976
+57.78554044 12.77400062
+57.78514573 12.77446785
+57.7847399 12.77489121
+57.78432775 12.77527039
+57.78391069 12.77560755
+57.78348518 12.77590203
+57.78300759 12.7761827
+57.78254842 12.77639931
+57.78209549 12.77657095
+57.78162585 12.7766985
+57.78116643 12.77678231
+57.7807129 12.77686025
+57.78026355 12.77694265
+57.77977698 12.77705753
+57.7793023 12.77720993
+57.77884228 12.7773841
+57.77837325 12.77759546
+)";
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef REC_FILE_ENVELOPES_HPP
+#define REC_FILE_ENVELOPES_HPP
+
+#include "rec-file-view.hpp"
+
+#include <set>
+#include <string>
+
+// The Envelopes of a .rec file independent of their order.
+inline std::multiset<std::string> envelopes(const std::string &FILENAME) {
+  std::multiset<std::string> frames;
+  cluon::RecFileView view(FILENAME);
+  cluon::EnvelopeView e;
+  while (view.next(e)) {
+    frames.emplace(e.data(), e.size());
+  }
+  return frames;
+}
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifdef WIN32
+    #define UNLINK _unlink
+#else
+    #include <unistd.h>
+    #define UNLINK unlink
+#endif
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "blobs.hpp"
+#include "cabinet-migrate.hpp"
+#include "cabinet2rec.hpp"
+#include "codec.hpp"
+#include "rec2cabinet2.hpp"
+#include "rec-file-envelopes.hpp"
+
+#include "lmdb++.h"
+
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+static uint64_t sizeOf(const std::string &filename) {
+  struct stat s;
+  return (0 == ::stat(filename.c_str(), &s)) ? static_cast<uint64_t>(s.st_size) : 0;
+}
+
+TEST_CASE("Test appending values to and reading them from a blob file") {
+  const std::string BLOBS{"tests-blobs.cab-blobs"};
+  UNLINK(BLOBS.c_str());
+
+  const std::string A(1000, 'a');
+  const std::string B(3000, 'b');
+  std::vector<char> reference;
+  blobs::Reference ra;
+  {
+    blobs::Writer none(BLOBS, 0);
+    REQUIRE(!none.accepts(1000000));
+  }
+  REQUIRE(0 == sizeOf(BLOBS));
+
+  blobs::Writer writer(BLOBS, 1000);
+  REQUIRE(!writer.accepts(999));
+  REQUIRE(writer.accepts(1000));
+  ra = writer.append(codec::LZ4, A.data(), A.size(), reference);
+  REQUIRE(writer.sync());
+  REQUIRE(blobs::REFERENCE_SIZE == reference.size());
+
+  blobs::Reference r;
+  REQUIRE(blobs::getReference(reference.data(), reference.size(), r));
+  REQUIRE(codec::LZ4 == r.codec);
+  REQUIRE(0 == r.file);
+  REQUIRE(0 == r.offset);
+  REQUIRE(A.size() == r.length);
+  REQUIRE(!blobs::getReference(reference.data(), reference.size() - 1, r));
+
+  blobs::Reader reader(BLOBS);
+  REQUIRE(reader.good());
+  const char *a{reader.get(ra)};
+  REQUIRE(nullptr != a);
+  REQUIRE(A == std::string(a, ra.length));
+
+  // A discarded value is overwritten by the next one.
+  blobs::Reference discarded{writer.append(codec::NONE, B.data(), B.size(), reference)};
+  writer.discard(discarded);
+  blobs::Reference rb{writer.append(codec::NONE, B.data(), B.size(), reference)};
+  REQUIRE(A.size() == rb.offset);
+  REQUIRE(writer.sync());
+  REQUIRE(A.size() + B.size() == writer.size());
+
+  // The grown file is mapped anew while the previous pointer stays valid.
+  const char *b{reader.get(rb)};
+  REQUIRE(nullptr != b);
+  REQUIRE(B == std::string(b, rb.length));
+  REQUIRE(A == std::string(a, ra.length));
+
+  blobs::Reference beyond{rb};
+  beyond.length++;
+  REQUIRE(nullptr == reader.get(beyond));
+  blobs::Reference otherFile{ra};
+  otherFile.file = 1;
+  REQUIRE(nullptr == reader.get(otherFile));
+  REQUIRE(!blobs::Reader("tests-blobs.missing-blobs").good());
+
+  // Values appended by another writer since the last transaction are not overwritten.
+  {
+    blobs::Writer other(BLOBS, 1000);
+    other.begin();
+    blobs::Reference rc{other.append(codec::NONE, A.data(), A.size(), reference)};
+    REQUIRE(A.size() + B.size() == rc.offset);
+    REQUIRE(other.sync());
+  }
+  writer.begin();
+  blobs::Reference rd{writer.append(codec::NONE, B.data(), B.size(), reference)};
+  REQUIRE(A.size() + B.size() + A.size() == rd.offset);
+  REQUIRE(writer.sync());
+  REQUIRE(2 * (A.size() + B.size()) == sizeOf(BLOBS));
+  const char *d{reader.get(rd)};
+  REQUIRE(nullptr != d);
+  REQUIRE(B == std::string(d, rd.length));
+
+  UNLINK(BLOBS.c_str());
+}
+
+TEST_CASE("Test storing large values in the blob file of a cabinet") {
+  const bool VERBOSE{false};
+  const uint64_t MEM{1};
+  const std::string RECFILENAME{"tests-blobs.rec"};
+  const std::string REC2FILENAME{"tests-blobs.rec2"};
+  const std::string CABINETNAME{"tests-blobs.cab"};
+  const std::string MIGRATEDNAME{"tests-blobs-migrated.cab"};
+  const std::vector<std::string> FILES{CABINETNAME, CABINETNAME + "-lock", blobs::fileOf(CABINETNAME), MIGRATEDNAME, MIGRATEDNAME + "-lock", blobs::fileOf(MIGRATEDNAME), REC2FILENAME};
+
+  // Incompressible "camera frames" of 20kB at 10Hz between small Envelopes at 100Hz.
+  const int32_t IMAGE{1055};
+  const std::size_t FRAME_SIZE{20 * 1024};
+  std::mt19937 rng(7);
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    for (int64_t i{0}; i < 200; i++) {
+      cluon::data::Envelope e;
+      std::string payload{std::to_string(i)};
+      if (0 == (i % 10)) {
+        payload.resize(FRAME_SIZE);
+        for (auto &c : payload) {
+          c = static_cast<char>(rng());
+        }
+      }
+      e.dataType((0 == (i % 10)) ? IMAGE : 19).senderStamp(0).serializedData(payload).sampleTimeStamp(cluon::time::fromMicroseconds(1600000000000000L + i * 10000L));
+      const std::string s{cluon::serializeEnvelope(std::move(e))};
+      rec.write(s.data(), s.size());
+    }
+  }
+
+  for (const bool clustered : {false, true}) {
+    for (auto f : FILES) {
+      UNLINK(f.c_str());
+    }
+    cluon::In_Ranges<int64_t> ranges;
+    REQUIRE(0 == rec2cabinet("tests-blobs", MEM, RECFILENAME, CABINETNAME, 0, ranges, VERBOSE, 1, codec::Selection(), KEY_LAYOUT_MEMCMP, 0, clustered, 4096));
+    const uint64_t BLOBS_SIZE{sizeOf(blobs::fileOf(CABINETNAME))};
+    REQUIRE(20 * FRAME_SIZE < BLOBS_SIZE);
+    REQUIRE(21 * FRAME_SIZE > BLOBS_SIZE);
+    // Importing again neither stores the duplicates nor their values.
+    REQUIRE(0 == rec2cabinet("tests-blobs", MEM, RECFILENAME, CABINETNAME, 0, ranges, VERBOSE, 1, codec::Selection(), KEY_LAYOUT_MEMCMP, 0, clustered, 4096));
+    REQUIRE(BLOBS_SIZE == sizeOf(blobs::fileOf(CABINETNAME)));
+
+    {
+      auto env = lmdb::env::create();
+      env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+      env.set_max_dbs(100);
+      env.open(CABINETNAME.c_str(), MDB_NOSUBDIR|MDB_RDONLY, 0600);
+      auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+      codec::Dictionaries dictionaries;
+      REQUIRE(dictionaries.load(rotxn.handle()));
+      blobs::Reader blobReader(blobs::fileOf(CABINETNAME));
+      REQUIRE(blobReader.good());
+
+      // The cabinet holds only the references to the frames.
+      uint32_t frames{0};
+      uint32_t others{0};
+      auto dbi = lmdb::dbi::open(rotxn, clustered ? "1055/0" : "all");
+      auto cursor = lmdb::cursor::open(rotxn, dbi);
+      MDB_val key;
+      MDB_val value;
+      std::vector<char> buffer;
+      while (cursor.get(&key, &value, MDB_NEXT)) {
+        const cabinet::Key k{getKey(static_cast<char*>(key.mv_data), key.mv_size)};
+        if (IMAGE != k.dataType()) {
+          REQUIRE(codec::BLOB != codec::codecOf(k));
+          others++;
+          continue;
+        }
+        REQUIRE(codec::BLOB == codec::codecOf(k));
+        REQUIRE(blobs::REFERENCE_SIZE == value.mv_size);
+        buffer.clear();
+        auto decoded = codec::decode(k, static_cast<char*>(value.mv_data), value.mv_size, buffer, &dictionaries, &blobReader);
+        REQUIRE(nullptr != decoded.first);
+        REQUIRE(FRAME_SIZE < decoded.second);
+        // Uncompressed values are used directly from the blob file.
+        REQUIRE(buffer.empty());
+        REQUIRE(nullptr == codec::decode(k, static_cast<char*>(value.mv_data), value.mv_size, buffer).first);
+        frames++;
+      }
+      cursor.close();
+      rotxn.abort();
+      REQUIRE(20 == frames);
+      REQUIRE((clustered ? 0 : 180) == others);
+    }
+
+    REQUIRE(0 == cabinet2rec("tests-blobs", MEM, CABINETNAME, REC2FILENAME, 0, std::numeric_limits<int64_t>::max(), VERBOSE));
+    REQUIRE(envelopes(RECFILENAME) == envelopes(REC2FILENAME));
+
+    // Migrating copies the values from the blob file into the new cabinet or into its blob file.
+    for (const std::size_t blobSize : {static_cast<std::size_t>(0), static_cast<std::size_t>(4096)}) {
+      for (auto f : {MIGRATEDNAME, MIGRATEDNAME + "-lock", blobs::fileOf(MIGRATEDNAME), REC2FILENAME}) {
+        UNLINK(f.c_str());
+      }
+      REQUIRE(0 == cabinet_migrate("tests-blobs", MEM, CABINETNAME, MIGRATEDNAME, KEY_LAYOUT_MEMCMP, VERBOSE, 100000, 0, 1000, codec::Selection(), blobSize));
+      REQUIRE(((0 < blobSize) ? BLOBS_SIZE : 0) == sizeOf(blobs::fileOf(MIGRATEDNAME)));
+      REQUIRE(0 == cabinet2rec("tests-blobs", MEM, MIGRATEDNAME, REC2FILENAME, 0, std::numeric_limits<int64_t>::max(), VERBOSE));
+      REQUIRE(envelopes(RECFILENAME) == envelopes(REC2FILENAME));
+    }
+  }
+
+  for (auto f : FILES) {
+    UNLINK(f.c_str());
+  }
+  UNLINK(RECFILENAME.c_str());
+}
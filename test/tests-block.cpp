@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "block.hpp"
+#include "codec.hpp"
+#include "key.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+static std::string envelopeOf(const int32_t &dataType, const int64_t &timeStampInMicroseconds) {
+  cluon::data::Envelope e;
+  e.dataType(dataType).senderStamp(0).serializedData(std::to_string(timeStampInMicroseconds)).sampleTimeStamp(cluon::time::fromMicroseconds(timeStampInMicroseconds));
+  return cluon::serializeEnvelope(std::move(e));
+}
+
+TEST_CASE("Test packing Envelopes into blocks by number and duration") {
+  // Blocks hold at most 3 Envelopes within 1s.
+  block::Packer packer(3, 1000000000LL);
+  std::vector<block::Block> full;
+  for (int64_t i{0}; i < 8; i++) {
+    const std::string s{envelopeOf(19, i * 100000L)};
+    packer.add(19, 0, 0, i * 100000000LL, s.data(), s.size(), full);
+  }
+  // The stream 20/0 has one Envelope per 0.6s.
+  for (int64_t i{0}; i < 3; i++) {
+    const std::string s{envelopeOf(20, i * 600000L)};
+    packer.add(20, 0, 0, i * 600000000LL, s.data(), s.size(), full);
+  }
+  REQUIRE(3 == full.size());
+  REQUIRE(19 == full.at(0).dataType);
+  REQUIRE(3 == full.at(0).count);
+  REQUIRE(0 == full.at(0).first);
+  REQUIRE(200000000LL == full.at(0).last);
+  REQUIRE(3 == full.at(1).count);
+  REQUIRE(20 == full.at(2).dataType);
+  REQUIRE(2 == full.at(2).count);
+
+  packer.flush(full);
+  REQUIRE(5 == full.size());
+  // Pending blocks are flushed in the order of their first timeStamp.
+  REQUIRE(19 == full.at(3).dataType);
+  REQUIRE(600000000LL == full.at(3).first);
+  REQUIRE(2 == full.at(3).count);
+  REQUIRE(20 == full.at(4).dataType);
+  REQUIRE(1200000000LL == full.at(4).first);
+
+  const block::Block &b = full.at(0);
+  std::vector<char> tmp(KEY_SIZE);
+  setKey(block::keyOf(b, KEY_LAYOUT_MEMCMP), tmp.data(), tmp.size());
+  REQUIRE(keyIsBlock(tmp.data()));
+  REQUIRE(KEY_LAYOUT_MEMCMP == (keyVersion(tmp.data()) & KEY_LAYOUT_MASK));
+  REQUIRE(0 == keyTimeStamp(tmp.data()));
+  REQUIRE(200000000LL == keyBlockLastTimeStamp(tmp.data()));
+  REQUIRE(3 == keyBlockCount(tmp.data()));
+  REQUIRE(b.envelopes.size() == keyLength(tmp.data()));
+
+  // Keys of single Envelopes are no blocks.
+  cabinet::Key k;
+  k.timeStamp(1234).version(KEY_LAYOUT_MEMCMP);
+  setKey(k, tmp.data(), tmp.size());
+  REQUIRE(!keyIsBlock(tmp.data()));
+  REQUIRE(1234 == keyBlockLastTimeStamp(tmp.data()));
+  REQUIRE(1 == keyBlockCount(tmp.data()));
+}
+
+TEST_CASE("Test unpacking overlapping blocks in the order of the sampleTimeStamps") {
+  // Two streams with interleaved Envelopes in blocks of 4 and a single Envelope in between.
+  block::Packer packer(4, 1000000000LL);
+  std::vector<block::Block> blocks;
+  for (int64_t i{0}; i < 8; i++) {
+    const int32_t dataType{19 + static_cast<int32_t>(i % 2)};
+    const std::string s{envelopeOf(dataType, 1000 + i * 10)};
+    packer.add(dataType, 0, 0, (1000 + i * 10) * 1000LL, s.data(), s.size(), blocks);
+  }
+  packer.flush(blocks);
+  REQUIRE(2 == blocks.size());
+
+  const uint8_t VERSION{codec::version(KEY_LAYOUT_MEMCMP, codec::NONE)};
+  std::vector<std::pair<std::vector<char>, std::vector<char>>> entries;
+  for (auto &b : blocks) {
+    std::vector<char> k(KEY_SIZE);
+    setKey(block::keyOf(b, VERSION), k.data(), k.size());
+    entries.push_back(std::make_pair(k, b.envelopes));
+  }
+  {
+    const std::string s{envelopeOf(21, 1025)};
+    cabinet::Key single;
+    single.timeStamp(1025000LL).dataType(21).length(static_cast<uint16_t>(s.size())).version(VERSION);
+    std::vector<char> k(KEY_SIZE);
+    setKey(single, k.data(), k.size());
+    entries.push_back(std::make_pair(k, std::vector<char>(s.begin(), s.end())));
+  }
+  std::sort(entries.begin(), entries.end(), [](const std::pair<std::vector<char>, std::vector<char>> &a, const std::pair<std::vector<char>, std::vector<char>> &b) {
+    return 0 > std::memcmp(a.first.data(), b.first.data(), KEY_SIZE);
+  });
+
+  std::size_t index{0};
+  block::Envelopes envelopes([&](MDB_val &key, MDB_val &value) {
+    if (entries.size() <= index) {
+      return false;
+    }
+    key = MDB_val{entries.at(index).first.size(), entries.at(index).first.data()};
+    value = MDB_val{entries.at(index).second.size(), entries.at(index).second.data()};
+    index++;
+    return true;
+  }, nullptr);
+
+  std::vector<int64_t> timeStamps;
+  std::vector<int32_t> dataTypes;
+  int64_t timeStamp{0};
+  cluon::EnvelopeView e;
+  while (envelopes.next(timeStamp, e)) {
+    REQUIRE(timeStamp == e.sampleTimeStamp() * 1000);
+    timeStamps.push_back(e.sampleTimeStamp());
+    dataTypes.push_back(e.dataType());
+  }
+  REQUIRE(0 == envelopes.failed());
+  REQUIRE(std::vector<int64_t>{1000, 1010, 1020, 1025, 1030, 1040, 1050, 1060, 1070} == timeStamps);
+  REQUIRE(std::vector<int32_t>{19, 20, 19, 21, 20, 19, 20, 19, 20} == dataTypes);
+}
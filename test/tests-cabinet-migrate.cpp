@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifdef WIN32
+    #define UNLINK _unlink
+#else
+    #include <unistd.h>
+    #define UNLINK unlink
+#endif
+
+#include "catch.hpp"
+#include "cabinet-migrate.hpp"
+#include "cabinet-stream.hpp"
+#include "cabinet2rec.hpp"
+#include "clustered.hpp"
+#include "rec2cabinet2.hpp"
+#include "key.hpp"
+#include "morton.hpp"
+
+#include "lmdb++.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+TEST_CASE("Test migrating a cabinet between key layouts") {
+  const bool VERBOSE{false};
+  const std::string RECFILENAME{"tests-cabinet-migrate.rec"};
+  const std::vector<std::string> CABINETNAMES{"tests-cabinet-migrate-0.cab", "tests-cabinet-migrate-0to1.cab", "tests-cabinet-migrate-1.cab", "tests-cabinet-migrate-1to0.cab", "tests-cabinet-migrate-clustered-0.cab", "tests-cabinet-migrate-clustered-0to1.cab", "tests-cabinet-migrate-packed-0.cab", "tests-cabinet-migrate-unpacked-0.cab", "tests-cabinet-migrate-packed-clustered-1.cab"};
+  const std::vector<std::string> RECNAMES{"tests-cabinet-migrate-0.rec2", "tests-cabinet-migrate-0to1.rec2", "tests-cabinet-migrate-1.rec2", "tests-cabinet-migrate-1to0.rec2", "tests-cabinet-migrate-clustered-0.rec2", "tests-cabinet-migrate-clustered-0to1.rec2", "tests-cabinet-migrate-packed-0.rec2", "tests-cabinet-migrate-unpacked-0.rec2", "tests-cabinet-migrate-packed-clustered-1.rec2"};
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+
+  // Pairs of Envelopes from two streams share the same sampleTimeStamp; the
+  // pair of Envelopes 400 and 401 is at 1600000002s.
+  std::string original;
+  std::string fromStart;
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    for (uint32_t i{0}; i < 1000; i++) {
+      cluon::data::Envelope e;
+      e.dataType(19 + static_cast<int32_t>(i % 2)).senderStamp(0).serializedData(std::to_string(i)).sampleTimeStamp(cluon::time::fromMicroseconds(1600000000000000L + (i / 2) * 10000L));
+      const std::string s{cluon::serializeEnvelope(std::move(e))};
+      rec.write(s.data(), s.size());
+      original += s;
+      fromStart += (400 <= i) ? s : "";
+    }
+  }
+
+  const uint64_t MEM{1};
+  cluon::In_Ranges<int64_t> ranges;
+  REQUIRE(0 == rec2cabinet("tests-cabinet-migrate", MEM, RECFILENAME, CABINETNAMES.at(0), 0, ranges, VERBOSE, 1, codec::Selection(), KEY_LAYOUT_COMPARE_KEYS));
+  REQUIRE(0 == rec2cabinet("tests-cabinet-migrate", MEM, RECFILENAME, CABINETNAMES.at(2), 0, ranges, VERBOSE, 1, codec::Selection(), KEY_LAYOUT_MEMCMP));
+  // An existing cabinet keeps its layout and duplicates are still detected.
+  REQUIRE(0 == rec2cabinet("tests-cabinet-migrate", MEM, RECFILENAME, CABINETNAMES.at(2), 0, ranges, VERBOSE, 1, codec::Selection(), KEY_LAYOUT_COMPARE_KEYS));
+  REQUIRE(0 == rec2cabinet("tests-cabinet-migrate", MEM, RECFILENAME, CABINETNAMES.at(4), 0, ranges, VERBOSE, 1, codec::Selection(), KEY_LAYOUT_COMPARE_KEYS, 0, true));
+
+  REQUIRE(0 == cabinet_migrate("tests-cabinet-migrate", MEM, CABINETNAMES.at(0), CABINETNAMES.at(1), KEY_LAYOUT_MEMCMP, VERBOSE, 64));
+  REQUIRE(0 == cabinet_migrate("tests-cabinet-migrate", MEM, CABINETNAMES.at(2), CABINETNAMES.at(3), KEY_LAYOUT_COMPARE_KEYS, VERBOSE, 64));
+  REQUIRE(0 == cabinet_migrate("tests-cabinet-migrate", MEM, CABINETNAMES.at(4), CABINETNAMES.at(5), KEY_LAYOUT_MEMCMP, VERBOSE, 64));
+  // Blocks of up to 16 Envelopes per stream are packed and unpacked again.
+  REQUIRE(0 == cabinet_migrate("tests-cabinet-migrate", MEM, CABINETNAMES.at(0), CABINETNAMES.at(6), KEY_LAYOUT_COMPARE_KEYS, VERBOSE, 64, 16));
+  REQUIRE(0 == cabinet_migrate("tests-cabinet-migrate", MEM, CABINETNAMES.at(6), CABINETNAMES.at(7), KEY_LAYOUT_COMPARE_KEYS, VERBOSE, 64));
+  codec::Selection lz4;
+  REQUIRE(codec::parse("lz4", lz4));
+  REQUIRE(0 == cabinet_migrate("tests-cabinet-migrate", MEM, CABINETNAMES.at(4), CABINETNAMES.at(8), KEY_LAYOUT_MEMCMP, VERBOSE, 64, 16, 1000, lz4));
+  // The new cabinet must be empty.
+  REQUIRE(1 == cabinet_migrate("tests-cabinet-migrate", MEM, CABINETNAMES.at(2), CABINETNAMES.at(3), KEY_LAYOUT_COMPARE_KEYS, VERBOSE, 64));
+
+  // Collect the layout, the number of keys, and the distinct timeStamps per table; no comparator is set to check the memcmp order.
+  struct Table {
+    uint8_t layout{0};
+    uint64_t keys{0};
+    std::set<int64_t> timeStamps{};
+    bool memcmpOrdered{true};
+  };
+  auto readTable = [MEM](const std::string &CABINETNAME, const std::string &TABLE) {
+    Table t;
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    auto dbi = lmdb::dbi::open(rotxn, TABLE.c_str());
+    t.layout = keyLayoutOf(rotxn.handle(), dbi.handle());
+    auto cursor = lmdb::cursor::open(rotxn, dbi);
+    std::string lastKey;
+    MDB_val key;
+    while (cursor.get(&key, MDB_NEXT)) {
+      const std::string k(static_cast<char*>(key.mv_data), key.mv_size);
+      t.memcmpOrdered = t.memcmpOrdered && (lastKey < k);
+      lastKey = k;
+      t.keys++;
+      t.timeStamps.insert(getKey(static_cast<char*>(key.mv_data), key.mv_size).timeStamp());
+    }
+    cursor.close();
+    rotxn.abort();
+    return t;
+  };
+
+  // Envelopes with the same sampleTimeStamp coexist in both layouts.
+  Table t = readTable(CABINETNAMES.at(0), "all");
+  REQUIRE(KEY_LAYOUT_COMPARE_KEYS == t.layout);
+  REQUIRE(1000 == t.keys);
+  REQUIRE(500 == t.timeStamps.size());
+
+  // Migrated to layout 1, the keys are ordered by memcmp and keep their timeStamps.
+  t = readTable(CABINETNAMES.at(1), "all");
+  REQUIRE(KEY_LAYOUT_MEMCMP == t.layout);
+  REQUIRE(1000 == t.keys);
+  REQUIRE(500 == t.timeStamps.size());
+  REQUIRE(t.memcmpOrdered);
+  for (auto table : {"19/0", "20/0"}) {
+    Table s = readTable(CABINETNAMES.at(1), table);
+    REQUIRE(KEY_LAYOUT_MEMCMP == s.layout);
+    REQUIRE(500 == s.keys);
+    REQUIRE(s.memcmpOrdered);
+  }
+
+  t = readTable(CABINETNAMES.at(2), "all");
+  REQUIRE(KEY_LAYOUT_MEMCMP == t.layout);
+  REQUIRE(1000 == t.keys);
+  REQUIRE(500 == t.timeStamps.size());
+  REQUIRE(t.memcmpOrdered);
+
+  t = readTable(CABINETNAMES.at(3), "all");
+  REQUIRE(KEY_LAYOUT_COMPARE_KEYS == t.layout);
+  REQUIRE(1000 == t.keys);
+  REQUIRE(500 == t.timeStamps.size());
+
+  // A migrated clustered cabinet stays clustered.
+  for (auto table : {"19/0", "20/0"}) {
+    Table s = readTable(CABINETNAMES.at(5), table);
+    REQUIRE(KEY_LAYOUT_MEMCMP == s.layout);
+    REQUIRE(500 == s.keys);
+    REQUIRE(s.memcmpOrdered);
+  }
+  {
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAMES.at(5).c_str(), MDB_NOSUBDIR, 0600);
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    auto dbAll = lmdb::dbi::open(rotxn, "all");
+    REQUIRE(clustered::isClustered(rotxn.handle(), dbAll.handle()));
+    rotxn.abort();
+  }
+
+  // Each stream is packed into 32 blocks with 16 Envelopes except for the last one with 4.
+  t = readTable(CABINETNAMES.at(6), "all");
+  REQUIRE(64 == t.keys);
+  t = readTable(CABINETNAMES.at(7), "all");
+  REQUIRE(1000 == t.keys);
+  for (auto table : {"19/0", "20/0"}) {
+    Table s = readTable(CABINETNAMES.at(8), table);
+    REQUIRE(KEY_LAYOUT_MEMCMP == s.layout);
+    REQUIRE(32 == s.keys);
+  }
+
+  // Re-importing into packed cabinets is refused as the keys of blocks do not detect duplicates.
+  REQUIRE(1 == rec2cabinet("tests-cabinet-migrate", MEM, RECFILENAME, CABINETNAMES.at(6), 0, ranges, VERBOSE, 1, codec::Selection(), KEY_LAYOUT_COMPARE_KEYS));
+  REQUIRE(1 == rec2cabinet("tests-cabinet-migrate", MEM, RECFILENAME, CABINETNAMES.at(8), 0, ranges, VERBOSE, 1, codec::Selection(), KEY_LAYOUT_MEMCMP, 0, true));
+  UNLINK(RECFILENAME.c_str());
+  t = readTable(CABINETNAMES.at(6), "all");
+  REQUIRE(64 == t.keys);
+  for (auto table : {"19/0", "20/0"}) {
+    Table s = readTable(CABINETNAMES.at(8), table);
+    REQUIRE(32 == s.keys);
+  }
+
+  // All cabinets export the same Envelopes in the same order, also from a start time point.
+  for (auto START : {static_cast<int64_t>(0), static_cast<int64_t>(1600000002)}) {
+    std::vector<std::string> exported;
+    for (uint32_t i{0}; i < CABINETNAMES.size(); i++) {
+      REQUIRE(0 == cabinet2rec("tests-cabinet-migrate", MEM, CABINETNAMES.at(i), RECNAMES.at(i), START, std::numeric_limits<int64_t>::max(), VERBOSE));
+      std::fstream fin{RECNAMES.at(i).c_str(), std::ios::in|std::ios::binary};
+      exported.push_back(static_cast<std::stringstream const&>(std::stringstream() << fin.rdbuf()).str());
+      UNLINK(RECNAMES.at(i).c_str());
+    }
+    // The start time point is included, also within blocks that start before.
+    REQUIRE(((0 == START) ? original : fromStart) == exported.at(0));
+    for (auto e : exported) {
+      REQUIRE(exported.at(0) == e);
+    }
+  }
+
+  // cabinet-stream starts at the same Envelope from "all" and from the tables per stream.
+  for (uint32_t i{0}; i < CABINETNAMES.size(); i++) {
+    for (auto streams : std::vector<std::map<std::string, bool>>{{}, {{"19/0", true}, {"20/0", true}}}) {
+      std::stringstream sstr;
+      std::streambuf *coutBuffer{std::cout.rdbuf(sstr.rdbuf())};
+      const int retCode{cabinet_stream("tests-cabinet-migrate", MEM, CABINETNAMES.at(i), VERBOSE, streams, 1600000002, std::numeric_limits<int32_t>::max())};
+      std::cout.rdbuf(coutBuffer);
+      REQUIRE(0 == retCode);
+      REQUIRE(fromStart == sstr.str());
+    }
+  }
+
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+}
+
+TEST_CASE("Test migrating the Morton tables per time bucket") {
+  const bool VERBOSE{false};
+  const std::string RECFILENAME{"tests-cabinet-migrate-morton.rec"};
+  const std::vector<std::string> CABINETNAMES{"tests-cabinet-migrate-morton.cab", "tests-cabinet-migrate-morton-1.cab"};
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    for (uint32_t i{0}; i < 10; i++) {
+      cluon::data::Envelope e;
+      e.dataType(19).senderStamp(0).serializedData(std::to_string(i)).sampleTimeStamp(cluon::time::fromMicroseconds(1600000000000000L + i * 10000L));
+      const std::string s{cluon::serializeEnvelope(std::move(e))};
+      rec.write(s.data(), s.size());
+    }
+  }
+  const uint64_t MEM{1};
+  cluon::In_Ranges<int64_t> ranges;
+  REQUIRE(0 == rec2cabinet("tests-cabinet-migrate", MEM, RECFILENAME, CABINETNAMES.at(0), 0, ranges, VERBOSE, 1, codec::Selection(), KEY_LAYOUT_COMPARE_KEYS));
+  UNLINK(RECFILENAME.c_str());
+
+  // Several Morton codes per bucket, i.e., keys that share their first eight bytes.
+  auto readTable = [MEM](const std::string &CABINETNAME) {
+    std::vector<std::pair<std::string, int64_t>> entries;
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    auto dbi = lmdb::dbi::open(rotxn, "19/0-morton-time");
+    lmdb::dbi_set_dupsort(rotxn, dbi.handle(), &compareKeys);
+    auto cursor = lmdb::cursor::open(rotxn, dbi);
+    MDB_val key;
+    MDB_val value;
+    while (cursor.get(&key, &value, MDB_NEXT)) {
+      int64_t timeStamp{0};
+      std::memcpy(&timeStamp, value.mv_data, sizeof(timeStamp));
+      entries.emplace_back(std::string(static_cast<char*>(key.mv_data), key.mv_size), static_cast<int64_t>(be64toh(static_cast<uint64_t>(timeStamp))));
+    }
+    cursor.close();
+    rotxn.abort();
+    return entries;
+  };
+  {
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAMES.at(0).c_str(), MDB_NOSUBDIR, 0600);
+    auto txn = lmdb::txn::begin(env);
+    auto dbi = lmdb::dbi::open(txn, "19/0-morton-time", MDB_CREATE|MDB_DUPSORT|MDB_DUPFIXED);
+    lmdb::dbi_set_dupsort(txn, dbi.handle(), &compareKeys);
+    for (int64_t timeStamp{0}; timeStamp < 3 * MORTON_TIME_BUCKET; timeStamp += MORTON_TIME_BUCKET / 4) {
+      for (const auto &position : {std::make_pair(57.7f, 11.9f), std::make_pair(57.8f, 12.0f), std::make_pair(57.9f, 12.1f)}) {
+        const int64_t BUCKET{mortonBucketOf(timeStamp)};
+        uint64_t buffer[2];
+        MDB_val key{mortonKeyOf(&BUCKET, convertLatLonToMorton(position), buffer)};
+        int64_t v{static_cast<int64_t>(htobe64(static_cast<uint64_t>(timeStamp)))};
+        MDB_val value{sizeof(v), &v};
+        lmdb::dbi_put(txn, dbi, &key, &value, 0);
+      }
+    }
+    txn.commit();
+  }
+  const auto BEFORE{readTable(CABINETNAMES.at(0))};
+  REQUIRE(36 == BEFORE.size());
+
+  REQUIRE(0 == cabinet_migrate("tests-cabinet-migrate", MEM, CABINETNAMES.at(0), CABINETNAMES.at(1), KEY_LAYOUT_MEMCMP, VERBOSE, 64));
+  REQUIRE(BEFORE == readTable(CABINETNAMES.at(1)));
+
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+}
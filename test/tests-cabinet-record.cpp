@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifdef WIN32
+    #define UNLINK _unlink
+#else
+    #include <sys/wait.h>
+    #include <unistd.h>
+    #define UNLINK unlink
+#endif
+
+#include "catch.hpp"
+#include "cabinet-record.hpp"
+#include "clustered.hpp"
+#include "codec.hpp"
+#include "key.hpp"
+
+#include "lmdb++.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Test cabinet-record with a local OD4Session") {
+  const bool VERBOSE{false};
+  const std::string CABINETNAME{"tests-cabinet-record.cab"};
+  const std::string CABINETNAME_LOCK{"tests-cabinet-record.cab-lock"};
+  const uint16_t CID{211};
+  const uint64_t MEM{1};
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+
+  std::atomic<bool> running{true};
+  int32_t retCode{-1};
+  std::thread recorder([&]() {
+    retCode = cabinet_record("tests-cabinet-record", MEM, CID, CABINETNAME, 0, VERBOSE, running, 10, 20);
+  });
+  // Wait for the recorder to join the OD4Session.
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  const uint32_t ENVELOPES{100};
+  {
+    cluon::OD4Session od4{CID};
+    REQUIRE(od4.isRunning());
+    for (uint32_t i{0}; i < ENVELOPES; i++) {
+      cluon::data::TimeStamp ts;
+      ts.seconds(1600000000 + static_cast<int32_t>(i)).microseconds(static_cast<int32_t>(i));
+      od4.send(ts, ts, i % 2);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // Let the recorder commit the last batch while running.
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+  running.store(false);
+  recorder.join();
+  REQUIRE(0 == retCode);
+
+  bool failed{false};
+  try {
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+
+    std::map<std::string, uint64_t> entriesPerTable;
+    for (auto table : std::vector<std::string>{"all", "12/0", "12/1"}) {
+      auto dbi = lmdb::dbi::open(rotxn, table.c_str());
+      dbi.set_compare(rotxn, &compareKeys);
+      entriesPerTable[table] = dbi.size(rotxn);
+    }
+    REQUIRE(ENVELOPES == entriesPerTable["all"]);
+    REQUIRE(ENVELOPES / 2 == entriesPerTable["12/0"]);
+    REQUIRE(ENVELOPES / 2 == entriesPerTable["12/1"]);
+
+    // Values are the Envelopes as sent.
+    auto dbi = lmdb::dbi::open(rotxn, "all");
+    dbi.set_compare(rotxn, &compareKeys);
+    auto cursor = lmdb::cursor::open(rotxn, dbi);
+    MDB_val key;
+    MDB_val value;
+    uint32_t i{0};
+    std::vector<char> buffer;
+    while (cursor.get(&key, &value, MDB_NEXT)) {
+      cabinet::Key k = getKey(static_cast<char*>(key.mv_data), key.mv_size);
+      REQUIRE((1600000000L + i) * 1000L * 1000L * 1000L + i * 1000L == k.timeStamp());
+      auto decoded = codec::decode(k, static_cast<char*>(value.mv_data), value.mv_size, buffer);
+      REQUIRE(nullptr != decoded.first);
+      std::stringstream sstr{std::string(decoded.first, decoded.second)};
+      auto e = cluon::extractEnvelope(sstr);
+      REQUIRE(e.first);
+      REQUIRE(12 == e.second.dataType());
+      REQUIRE(i % 2 == e.second.senderStamp());
+      i++;
+    }
+    cursor.close();
+    rotxn.abort();
+  }
+  catch (...) {
+    failed = true;
+  }
+  REQUIRE(!failed);
+
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+}
+
+#ifndef WIN32
+TEST_CASE("Test cabinet-record with another process writing between two batches") {
+  const bool VERBOSE{false};
+  const std::string CABINETNAME{"tests-cabinet-record-concurrent.cab"};
+  const std::string CABINETNAME_LOCK{"tests-cabinet-record-concurrent.cab-lock"};
+  const uint16_t CID{212};
+  const uint64_t MEM{1};
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+
+  std::atomic<bool> running{true};
+  int32_t retCode{-1};
+  std::thread recorder([&]() {
+    retCode = cabinet_record("tests-cabinet-record", MEM, CID, CABINETNAME, 0, VERBOSE, running, 10, 20);
+  });
+  // Wait for the recorder to join the OD4Session.
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  const uint32_t ENVELOPES{100};
+  cluon::OD4Session od4{CID};
+  REQUIRE(od4.isRunning());
+  auto send = [&od4](const uint32_t &from, const uint32_t &to) {
+    for (uint32_t i{from}; i < to; i++) {
+      cluon::data::TimeStamp ts;
+      ts.seconds(1600000000 + static_cast<int32_t>(i)).microseconds(static_cast<int32_t>(i));
+      od4.send(ts, ts, i % 2);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // Let the recorder commit the last batch while running.
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  };
+  send(0, ENVELOPES / 2);
+
+  // Another process stores an Envelope later than the ones to be recorded next
+  // in "all" and "12/1"; LMDB environments must not be opened twice per process.
+  const pid_t PID{fork()};
+  REQUIRE(0 <= PID);
+  if (0 == PID) {
+    int32_t rc{1};
+    MDB_env *env{nullptr};
+    if ( (MDB_SUCCESS == mdb_env_create(&env))
+      && (MDB_SUCCESS == mdb_env_set_maxdbs(env, 100))
+      && (MDB_SUCCESS == mdb_env_set_mapsize(env, MEM * 1024UL * 1024UL * 1024UL))
+      && (MDB_SUCCESS == mdb_env_open(env, CABINETNAME.c_str(), MDB_NOSUBDIR, 0600)) ) {
+      cluon::data::TimeStamp ts;
+      ts.seconds(1600000075).microseconds(500000);
+      cluon::data::Envelope e;
+      e.dataType(12).senderStamp(1).serializedData("x").sent(ts).received(ts).sampleTimeStamp(ts);
+      std::string v{cluon::serializeEnvelope(std::move(e))};
+      cabinet::Key k;
+      k.dataType(12).senderStamp(1).timeStamp(cluon::time::toMicroseconds(ts) * 1000L).length(v.size()).version(codec::version(KEY_LAYOUT_COMPARE_KEYS, codec::NONE));
+      std::vector<char> _key(511);
+      MDB_val key{setKey(k, _key.data(), _key.size()), _key.data()};
+      MDB_val value{v.size(), &v[0]};
+      MDB_txn *txn{nullptr};
+      MDB_dbi dbAll{0};
+      MDB_dbi dbStream{0};
+      if ( (MDB_SUCCESS == mdb_txn_begin(env, nullptr, 0, &txn))
+        && (MDB_SUCCESS == mdb_dbi_open(txn, "all", 0, &dbAll))
+        && (MDB_SUCCESS == mdb_set_compare(txn, dbAll, &compareKeys))
+        && (MDB_SUCCESS == mdb_put(txn, dbAll, &key, &value, MDB_NOOVERWRITE))
+        && (MDB_SUCCESS == mdb_dbi_open(txn, "12/1", 0, &dbStream))
+        && (MDB_SUCCESS == mdb_set_compare(txn, dbStream, &compareKeys)) ) {
+        MDB_val keyInStream{fixedFieldsOf(key)};
+        MDB_val empty{0, nullptr};
+        rc = ( (MDB_SUCCESS == mdb_put(txn, dbStream, &keyInStream, &empty, MDB_NOOVERWRITE)) && (MDB_SUCCESS == mdb_txn_commit(txn)) ) ? 0 : 1;
+      }
+      mdb_env_close(env);
+    }
+    _exit(rc);
+  }
+  int status{-1};
+  REQUIRE(PID == waitpid(PID, &status, 0));
+  REQUIRE(WIFEXITED(status));
+  REQUIRE(0 == WEXITSTATUS(status));
+
+  send(ENVELOPES / 2, ENVELOPES);
+  running.store(false);
+  recorder.join();
+  REQUIRE(0 == retCode);
+
+  // No Envelope was dropped as duplicate or ended the recording.
+  bool failed{false};
+  try {
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    std::map<std::string, uint64_t> entriesPerTable;
+    for (auto table : std::vector<std::string>{"all", "12/0", "12/1"}) {
+      auto dbi = lmdb::dbi::open(rotxn, table.c_str());
+      dbi.set_compare(rotxn, &compareKeys);
+      entriesPerTable[table] = dbi.size(rotxn);
+    }
+    REQUIRE(ENVELOPES + 1 == entriesPerTable["all"]);
+    REQUIRE(ENVELOPES / 2 == entriesPerTable["12/0"]);
+    REQUIRE(ENVELOPES / 2 + 1 == entriesPerTable["12/1"]);
+    rotxn.abort();
+  }
+  catch (...) {
+    failed = true;
+  }
+  REQUIRE(!failed);
+
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+}
+#endif
+
+TEST_CASE("Test skipping the same Envelope from another source in both key layouts") {
+  const std::string CABINETNAME{"tests-cabinet-record-layouts.cab"};
+  const std::string CABINETNAME_LOCK{"tests-cabinet-record-layouts.cab-lock"};
+  const uint64_t MEM{1};
+
+  // Envelopes at 1600000000s + i with the last one being the latest.
+  std::vector<std::string> envelopes;
+  for (int32_t i{0}; i < 3; i++) {
+    cluon::data::TimeStamp ts;
+    ts.seconds(1600000000 + i);
+    cluon::data::Envelope e;
+    e.dataType(12).senderStamp(0).serializedData("x").sent(ts).received(ts).sampleTimeStamp(ts);
+    envelopes.push_back(cluon::serializeEnvelope(std::move(e)));
+  }
+
+  for (auto layout : {KEY_LAYOUT_COMPARE_KEYS, KEY_LAYOUT_MEMCMP}) {
+    UNLINK(CABINETNAME.c_str());
+    UNLINK(CABINETNAME_LOCK.c_str());
+
+    bool failed{false};
+    try {
+      auto env = lmdb::env::create();
+      env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+      env.set_max_dbs(100);
+      env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+      auto txn = lmdb::txn::begin(env);
+      clustered::Store store(blobs::fileOf(CABINETNAME), layout, false);
+      REQUIRE(MDB_SUCCESS == store.begin(txn.handle()));
+
+      // The keys of the same Envelope from two sources differ in hashOfRecFile.
+      auto put = [&](const std::string &v, const uint32_t &hashOfRecFile) {
+        cluon::EnvelopeView e(v.data(), v.size(), 0);
+        cabinet::Key k;
+        k.timeStamp(e.sampleTimeStamp() * 1000L)
+         .dataType(e.dataType())
+         .senderStamp(e.senderStamp())
+         .hash(XXH64(v.data(), v.size(), 0))
+         .hashOfRecFile(hashOfRecFile)
+         .length(static_cast<uint16_t>(v.size()))
+         .version(codec::version(layout, codec::NONE));
+        return store.put(txn.handle(), k, v.data(), v.size(), v.size());
+      };
+      for (auto &v : envelopes) {
+        REQUIRE(MDB_SUCCESS == put(v, 1));
+      }
+      for (auto &v : envelopes) {
+        REQUIRE(MDB_KEYEXIST == put(v, 2));
+      }
+      REQUIRE(MDB_SUCCESS == store.flush(txn.handle()));
+
+      MDB_stat stat;
+      REQUIRE(MDB_SUCCESS == mdb_stat(txn.handle(), store.all(), &stat));
+      REQUIRE(envelopes.size() == stat.ms_entries);
+      txn.commit();
+    }
+    catch (...) {
+      failed = true;
+    }
+    REQUIRE(!failed);
+  }
+
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+}
+
+TEST_CASE("Test cabinet-record refuses to record into a packed cabinet") {
+  const bool VERBOSE{false};
+  const std::string CABINETNAME{"tests-cabinet-record-packed.cab"};
+  const std::string CABINETNAME_LOCK{"tests-cabinet-record-packed.cab-lock"};
+  const uint16_t CID{214};
+  const uint64_t MEM{1};
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+
+  // A block key holds the last timeStamp in hash and the number of Envelopes in hashOfRecFile.
+  bool failed{false};
+  try {
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+    auto txn = lmdb::txn::begin(env);
+    clustered::Store store(blobs::fileOf(CABINETNAME), KEY_LAYOUT_COMPARE_KEYS, false);
+    REQUIRE(MDB_SUCCESS == store.begin(txn.handle()));
+    const std::string value{"block"};
+    cabinet::Key k;
+    k.timeStamp(1600000000000000000L)
+     .dataType(12)
+     .senderStamp(0)
+     .hash(1600000001000000000UL)
+     .hashOfRecFile(2)
+     .length(static_cast<uint16_t>(value.size()))
+     .version(codec::version(KEY_LAYOUT_COMPARE_KEYS, codec::NONE) | KEY_BLOCK);
+    REQUIRE(MDB_SUCCESS == store.put(txn.handle(), k, value.data(), value.size(), value.size()));
+    REQUIRE(MDB_SUCCESS == store.flush(txn.handle()));
+    txn.commit();
+  }
+  catch (...) {
+    failed = true;
+  }
+  REQUIRE(!failed);
+
+  std::atomic<bool> running{true};
+  REQUIRE(1 == cabinet_record("tests-cabinet-record", MEM, CID, CABINETNAME, 0, VERBOSE, running));
+
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifdef WIN32
+    #define UNLINK _unlink
+#else
+    #include <unistd.h>
+    #define UNLINK unlink
+#endif
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "cabinet-migrate.hpp"
+#include "catalog.hpp"
+#include "rec2cabinet2.hpp"
+
+#include "lmdb++.h"
+#include "xxhash.h"
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+static catalog::Catalog catalogOf(const std::string &CABINET) {
+  catalog::Catalog c;
+  auto env = lmdb::env::create();
+  env.set_mapsize(1UL * 1024UL * 1024UL * 1024UL);
+  env.set_max_dbs(100);
+  env.open(CABINET.c_str(), MDB_NOSUBDIR|MDB_RDONLY, 0600);
+  auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+  REQUIRE(c.load(rotxn.handle()));
+  rotxn.abort();
+  return c;
+}
+
+TEST_CASE("Test merging the changes per stream into the catalog") {
+  const std::string CABINETNAME{"tests-catalog-merge.cab"};
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+
+  catalog::Catalog changes;
+  changes.add(19, 0, 2000, 2000, 1, 100, 50, 0x1234, 7);
+  changes.add(19, 0, 1000, 3000, 4, 400, 100, 0x1234, 7);
+  changes.add(-1, 2, 5000, 5000, 1, 10, 10, 0x5678, 0);
+  {
+    auto env = lmdb::env::create();
+    env.set_mapsize(1UL * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+    auto txn = lmdb::txn::begin(env);
+    REQUIRE(MDB_SUCCESS == changes.store(txn.handle()));
+    REQUIRE(changes.entries().empty());
+    txn.commit();
+
+    // Later changes are merged into the stored entries.
+    changes.add(19, 0, 500, 600, 2, 20, 10, 0x9999, 8);
+    txn = lmdb::txn::begin(env);
+    REQUIRE(MDB_SUCCESS == changes.store(txn.handle()));
+    txn.commit();
+  }
+
+  catalog::Catalog c{catalogOf(CABINETNAME)};
+  REQUIRE(2 == c.entries().size());
+  const catalog::Entry &e = c.entries().at(std::make_pair(19, 0u));
+  REQUIRE(500 == e.first);
+  REQUIRE(3000 == e.last);
+  REQUIRE(7 == e.count);
+  REQUIRE(520 == e.rawBytes);
+  REQUIRE(160 == e.storedBytes);
+  REQUIRE((std::set<std::pair<uint32_t, uint64_t>>{{0x1234, 7}, {0x9999, 8}}) == e.sources);
+  REQUIRE(1 == c.entries().at(std::make_pair(-1, 2u)).count);
+
+  std::vector<char> bytes;
+  catalog::encode(e, bytes);
+  REQUIRE(catalog::HEADER_SIZE + 2 * catalog::SOURCE_SIZE == bytes.size());
+  catalog::Entry decoded;
+  REQUIRE(!catalog::decode(bytes.data(), bytes.size() - 1, decoded));
+
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+}
+
+TEST_CASE("Test maintaining the catalog while importing and migrating") {
+  const bool VERBOSE{false};
+  const uint64_t MEM{1};
+  const std::string RECFILENAME{"tests-catalog.rec"};
+  const std::vector<std::string> CABINETNAMES{"tests-catalog.cab", "tests-catalog-v1.cab", "tests-catalog-packed.cab"};
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+
+  // Two streams at 100Hz and 10Hz; the expected entries are computed from the .rec file.
+  std::map<std::pair<int32_t, uint32_t>, catalog::Entry> expected;
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    for (int64_t i{0}; i < 1000; i++) {
+      const int32_t dataType{(0 == (i % 10)) ? 1046 : 19};
+      const uint32_t senderStamp{(0 == (i % 10)) ? 1u : 0u};
+      cluon::data::Envelope e;
+      e.dataType(dataType).senderStamp(senderStamp).serializedData(std::string(static_cast<std::size_t>(10 + (i % 50)), 'x')).sampleTimeStamp(cluon::time::fromMicroseconds(1600000000000000L + i * 10000L));
+      const std::string s{cluon::serializeEnvelope(std::move(e))};
+      rec.write(s.data(), s.size());
+      catalog::Entry &entry = expected[std::make_pair(dataType, senderStamp)];
+      entry.first = std::min<int64_t>(entry.first, (1600000000000000L + i * 10000L) * 1000L);
+      entry.last = std::max<int64_t>(entry.last, (1600000000000000L + i * 10000L) * 1000L);
+      entry.count++;
+      entry.rawBytes += s.size();
+    }
+  }
+  auto sameAsExpected = [&expected](const catalog::Catalog &c) {
+    REQUIRE(expected.size() == c.entries().size());
+    for (const auto &e : expected) {
+      const catalog::Entry &stored = c.entries().at(e.first);
+      REQUIRE(e.second.first == stored.first);
+      REQUIRE(e.second.last == stored.last);
+      REQUIRE(e.second.count == stored.count);
+      REQUIRE(e.second.rawBytes == stored.rawBytes);
+      REQUIRE(0 < stored.storedBytes);
+    }
+  };
+
+  const uint32_t HASH_OF_RECFILE{XXH32(RECFILENAME.c_str(), RECFILENAME.size(), 0)};
+  cluon::In_Ranges<int64_t> ranges;
+  REQUIRE(0 == rec2cabinet("tests-catalog", MEM, RECFILENAME, CABINETNAMES.at(0), 0, ranges, VERBOSE, 2));
+  sameAsExpected(catalogOf(CABINETNAMES.at(0)));
+
+  // Duplicates do not change the catalog, also when imported with other userData.
+  REQUIRE(0 == rec2cabinet("tests-catalog", MEM, RECFILENAME, CABINETNAMES.at(0), 0, ranges, VERBOSE, 2));
+  sameAsExpected(catalogOf(CABINETNAMES.at(0)));
+  REQUIRE(0 == rec2cabinet("tests-catalog", MEM, RECFILENAME, CABINETNAMES.at(0), 42, ranges, VERBOSE, 2));
+  {
+    catalog::Catalog c{catalogOf(CABINETNAMES.at(0))};
+    sameAsExpected(c);
+    REQUIRE((std::set<std::pair<uint32_t, uint64_t>>{{HASH_OF_RECFILE, 0}}) == c.entries().at(std::make_pair(19, 0u)).sources);
+  }
+
+  // Migrating rebuilds the catalog, also for blocks.
+  REQUIRE(0 == cabinet_migrate("tests-catalog", MEM, CABINETNAMES.at(0), CABINETNAMES.at(1), KEY_LAYOUT_MEMCMP, VERBOSE, 100));
+  sameAsExpected(catalogOf(CABINETNAMES.at(1)));
+  REQUIRE(0 == cabinet_migrate("tests-catalog", MEM, CABINETNAMES.at(0), CABINETNAMES.at(2), KEY_LAYOUT_MEMCMP, VERBOSE, 100, 64, 1000));
+  sameAsExpected(catalogOf(CABINETNAMES.at(2)));
+
+  UNLINK(RECFILENAME.c_str());
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+}
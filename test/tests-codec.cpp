@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifdef WIN32
+    #define UNLINK _unlink
+#else
+    #include <unistd.h>
+    #define UNLINK unlink
+#endif
+
+#include "catch.hpp"
+
+#include "codec.hpp"
+
+#include "lz4.h"
+#include "lz4hc.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+TEST_CASE("Test parsing codecs") {
+  codec::Config c;
+  REQUIRE(codec::parse("none", c));
+  REQUIRE(codec::NONE == c.codec);
+  REQUIRE(codec::parse("lz4", c));
+  REQUIRE(codec::LZ4 == c.codec);
+  REQUIRE(1 == c.level);
+  REQUIRE(codec::parse("lz4:8", c));
+  REQUIRE(codec::LZ4 == c.codec);
+  REQUIRE(8 == c.level);
+  REQUIRE(codec::parse("lz4hc", c));
+  REQUIRE(codec::LZ4HC == c.codec);
+  REQUIRE(LZ4HC_CLEVEL_MAX == c.level);
+  REQUIRE(codec::parse("lz4hc:4", c));
+  REQUIRE(4 == c.level);
+  REQUIRE(codec::isAvailable(codec::ZSTD) == codec::parse("zstd:19", c));
+
+  REQUIRE(!codec::parse("lz5", c));
+  REQUIRE(!codec::parse("lz4:fast", c));
+  // Failed parsing leaves the codec untouched.
+  REQUIRE(codec::LZ4HC == c.codec);
+  REQUIRE(4 == c.level);
+}
+
+TEST_CASE("Test selecting codecs per dataType") {
+  codec::Selection s;
+  REQUIRE(codec::LZ4HC == s.select(19).codec);
+  REQUIRE(codec::parse("", s));
+  REQUIRE(codec::LZ4HC == s.select(19).codec);
+
+  REQUIRE(codec::parse("lz4,1055=none,19=lz4hc:3", s));
+  REQUIRE(codec::LZ4 == s.select(1).codec);
+  REQUIRE(codec::NONE == s.select(1055).codec);
+  REQUIRE(codec::LZ4HC == s.select(19).codec);
+  REQUIRE(3 == s.select(19).level);
+
+  REQUIRE(!codec::parse("lz4hc,abc=none", s));
+  REQUIRE(!codec::parse("lz4hc,49=abc", s));
+  // Failed parsing leaves the selection untouched.
+  REQUIRE(codec::LZ4 == s.select(1).codec);
+}
+
+TEST_CASE("Test codec in Key.version") {
+  cabinet::Key k;
+  REQUIRE(codec::LEGACY == codec::codecOf(k));
+  k.version(codec::version(1, codec::LZ4HC));
+  REQUIRE(codec::LZ4HC == codec::codecOf(k));
+  REQUIRE(1 == codec::layoutOf(k));
+}
+
+TEST_CASE("Test encoding and decoding values") {
+  // Larger than 2^16 to check that the length truncated by Key.length is recovered.
+  std::string original;
+  for (uint32_t i{0}; original.size() < 200000; i++) {
+    original += "Envelope " + std::to_string(i % 1000) + ";";
+  }
+
+  std::vector<std::string> specs{"none", "lz4", "lz4:16", "lz4hc:3", "lz4hc"};
+  if (codec::isAvailable(codec::ZSTD)) {
+    specs.push_back("zstd:1");
+    specs.push_back("zstd:19");
+  }
+  for (auto spec : specs) {
+    codec::Config c;
+    REQUIRE(codec::parse(spec, c));
+
+    std::vector<char> compressed;
+    const uint8_t applied{codec::encode(c, original.data(), original.size(), compressed)};
+    REQUIRE(c.codec == applied);
+    const char *ptr{(codec::NONE == applied) ? original.data() : compressed.data()};
+    const std::size_t len{(codec::NONE == applied) ? original.size() : compressed.size()};
+    if (codec::NONE != applied) {
+      REQUIRE(len < original.size());
+    }
+    if ( (codec::LZ4 == applied) || (codec::LZ4HC == applied) ) {
+      // The uncompressed length precedes the LZ4 block.
+      const char *src{ptr};
+      std::size_t remaining{len};
+      uint64_t length{0};
+      REQUIRE(codec::getVarint(src, remaining, length));
+      REQUIRE(original.size() == length);
+      REQUIRE(3 == len - remaining);
+    }
+
+    cabinet::Key k;
+    k.length(original.size()).version(codec::version(0, applied));
+    std::vector<char> buffer;
+    auto decoded = codec::decode(k, ptr, len, buffer);
+    REQUIRE(nullptr != decoded.first);
+    REQUIRE(original.size() == decoded.second);
+    REQUIRE(0 == std::memcmp(original.data(), decoded.first, decoded.second));
+  }
+}
+
+TEST_CASE("Test incompressible values are stored uncompressed") {
+  const std::string original{"\x0d\xa4\x03\x00\x00\x08\x01\x12"};
+  std::vector<char> compressed;
+  codec::Config c;
+  REQUIRE(codec::NONE == codec::encode(c, original.data(), original.size(), compressed));
+
+  cabinet::Key k;
+  k.length(original.size()).version(codec::version(0, codec::NONE));
+  std::vector<char> buffer;
+  auto decoded = codec::decode(k, original.data(), original.size(), buffer);
+  REQUIRE(original.data() == decoded.first);
+  REQUIRE(original.size() == decoded.second);
+}
+
+TEST_CASE("Test decoding legacy values") {
+  std::string original;
+  for (uint32_t i{0}; i < 100; i++) {
+    original += "legacy;";
+  }
+  std::vector<char> compressed(LZ4_compressBound(original.size()));
+  const int compressedSize{LZ4_compress_HC(original.data(), compressed.data(), original.size(), compressed.size(), LZ4HC_CLEVEL_MAX)};
+  REQUIRE(0 < compressedSize);
+
+  cabinet::Key k;
+  k.length(original.size()).version(0);
+  std::vector<char> buffer;
+  auto decoded = codec::decode(k, compressed.data(), compressedSize, buffer);
+  REQUIRE(nullptr != decoded.first);
+  REQUIRE(original == std::string(decoded.first, decoded.second));
+
+  // Uncompressed legacy value.
+  decoded = codec::decode(k, original.data(), original.size(), buffer);
+  REQUIRE(original.data() == decoded.first);
+
+  // The length of larger legacy values is only known modulo 2^16; it must
+  // remain larger than the stored value to mark it as compressed.
+  original.clear();
+  for (uint32_t i{0}; original.size() < 200000; i++) {
+    original += "legacy " + std::to_string(i % 1000) + ";";
+  }
+  original.resize(2 * 65536 + 60000);
+  compressed.resize(LZ4_compressBound(original.size()));
+  const int largeCompressedSize{LZ4_compress_HC(original.data(), compressed.data(), original.size(), compressed.size(), LZ4HC_CLEVEL_MAX)};
+  REQUIRE(0 < largeCompressedSize);
+  k.length(static_cast<uint16_t>(original.size()));
+  decoded = codec::decode(k, compressed.data(), largeCompressedSize, buffer);
+  REQUIRE(nullptr != decoded.first);
+  REQUIRE(original == std::string(decoded.first, decoded.second));
+}
+
+TEST_CASE("Test encoding and decoding values with a dictionary") {
+  codec::Dictionaries dictionaries;
+  codec::DictionaryTrainer trainer(dictionaries, 1024, 8);
+
+  auto value = [](uint32_t i) {
+    return "\x0d\xa4\x30\x00\x00\x08\x26\x12\x12 GeodeticWgs84Reading " + std::to_string(57700000 + i) + "," + std::to_string(11900000 + 3 * i);
+  };
+
+  codec::Config c;
+  REQUIRE(codec::parse("lz4hcdict", c));
+  std::shared_ptr<const codec::Dictionary> dictionary;
+  for (uint32_t i{0}; i < 8; i++) {
+    const std::string v{value(i)};
+    dictionary = trainer.sample(19, 0, v.data(), v.size());
+    REQUIRE((i < 7) == (nullptr == dictionary));
+  }
+  REQUIRE(1 == dictionaries.size());
+  REQUIRE(1 == dictionary->id());
+  REQUIRE(dictionary == dictionaries.latest(19, 0));
+  REQUIRE(nullptr == dictionaries.latest(19, 1));
+  REQUIRE(dictionary == trainer.sample(19, 0, "x", 1));
+
+  for (auto spec : std::vector<std::string>{"lz4dict", "lz4hcdict:9"}) {
+    REQUIRE(codec::parse(spec, c));
+    const std::string original{value(100)};
+    std::vector<char> compressed;
+    const uint8_t applied{codec::encode(c, original.data(), original.size(), compressed, dictionary.get())};
+    REQUIRE(c.codec == applied);
+
+    // Without dictionary, the same value does not shrink enough to be compressed.
+    std::vector<char> compressedWithoutDictionary;
+    REQUIRE(codec::NONE == codec::encode(c, original.data(), original.size(), compressedWithoutDictionary, nullptr));
+
+    cabinet::Key k;
+    k.length(original.size()).version(codec::version(0, applied));
+    std::vector<char> buffer;
+    REQUIRE(nullptr == codec::decode(k, compressed.data(), compressed.size(), buffer).first);
+    auto decoded = codec::decode(k, compressed.data(), compressed.size(), buffer, &dictionaries);
+    REQUIRE(nullptr != decoded.first);
+    REQUIRE(original == std::string(decoded.first, decoded.second));
+  }
+}
+
+TEST_CASE("Test allocating the ids of dictionaries when storing them") {
+  const std::string CABINETNAME{"tests-codec-dictionaries.cab"};
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+  MDB_env *env{nullptr};
+  REQUIRE(MDB_SUCCESS == mdb_env_create(&env));
+  REQUIRE(MDB_SUCCESS == mdb_env_set_maxdbs(env, 10));
+  REQUIRE(MDB_SUCCESS == mdb_env_open(env, CABINETNAME.c_str(), MDB_NOSUBDIR, 0600));
+
+  auto value = [](uint32_t senderStamp, uint32_t i) {
+    return "\x0d\xa4\x30\x00\x00\x08\x26\x12\x12 GeodeticWgs84Reading " + std::to_string(senderStamp) + ":" + std::to_string(57700000 + i) + "," + std::to_string(11900000 + 3 * i);
+  };
+  codec::Config c;
+  REQUIRE(codec::parse("lz4hcdict", c));
+
+  // Two writers loaded the same cabinet without dictionaries and train one each with the same preliminary id.
+  codec::Dictionaries dictionariesA;
+  codec::Dictionaries dictionariesB;
+  codec::DictionaryIds idsA(dictionariesA);
+  codec::DictionaryIds idsB(dictionariesB);
+  codec::DictionaryTrainer trainerA(dictionariesA, 1024, 8);
+  codec::DictionaryTrainer trainerB(dictionariesB, 1024, 8);
+  std::shared_ptr<const codec::Dictionary> dictionaryA;
+  std::shared_ptr<const codec::Dictionary> dictionaryB;
+  for (uint32_t i{0}; i < 8; i++) {
+    const std::string a{value(0, i)};
+    const std::string b{value(1, i)};
+    dictionaryA = trainerA.sample(19, 0, a.data(), a.size());
+    dictionaryB = trainerB.sample(19, 1, b.data(), b.size());
+  }
+  REQUIRE(nullptr != dictionaryA);
+  REQUIRE(nullptr != dictionaryB);
+  REQUIRE(1 == dictionaryA->id());
+  REQUIRE(1 == dictionaryB->id());
+
+  const std::string ORIGINAL_A{value(0, 100)};
+  const std::string ORIGINAL_B{value(1, 100)};
+  std::vector<char> compressedA;
+  std::vector<char> compressedB;
+  REQUIRE(c.codec == codec::encode(c, ORIGINAL_A.data(), ORIGINAL_A.size(), compressedA, dictionaryA.get()));
+  REQUIRE(c.codec == codec::encode(c, ORIGINAL_B.data(), ORIGINAL_B.size(), compressedB, dictionaryB.get()));
+
+  MDB_txn *txn{nullptr};
+  REQUIRE(MDB_SUCCESS == mdb_txn_begin(env, nullptr, 0, &txn));
+  REQUIRE(MDB_SUCCESS == idsA.store(txn, *dictionaryA, compressedA));
+  REQUIRE(MDB_SUCCESS == mdb_txn_commit(txn));
+  REQUIRE(MDB_SUCCESS == mdb_txn_begin(env, nullptr, 0, &txn));
+  REQUIRE(MDB_SUCCESS == idsB.store(txn, *dictionaryB, compressedB));
+  // Further values with the same dictionary get the same id.
+  std::vector<char> compressedB2;
+  REQUIRE(c.codec == codec::encode(c, ORIGINAL_B.data(), ORIGINAL_B.size(), compressedB2, dictionaryB.get()));
+  REQUIRE(MDB_SUCCESS == idsB.store(txn, *dictionaryB, compressedB2));
+  REQUIRE(compressedB == compressedB2);
+  REQUIRE(MDB_SUCCESS == mdb_txn_commit(txn));
+
+  codec::Dictionaries dictionaries;
+  REQUIRE(MDB_SUCCESS == mdb_txn_begin(env, nullptr, 0, &txn));
+  REQUIRE(dictionaries.load(txn));
+  REQUIRE(2 == dictionaries.size());
+  REQUIRE(0 == dictionaries.byId(1)->senderStamp());
+  REQUIRE(1 == dictionaries.byId(2)->senderStamp());
+  for (auto e : {std::make_pair(&ORIGINAL_A, &compressedA), std::make_pair(&ORIGINAL_B, &compressedB)}) {
+    cabinet::Key k;
+    k.length(e.first->size()).version(codec::version(0, c.codec));
+    std::vector<char> buffer;
+    auto decoded = codec::decode(k, e.second->data(), e.second->size(), buffer, &dictionaries);
+    REQUIRE(nullptr != decoded.first);
+    REQUIRE(*e.first == std::string(decoded.first, decoded.second));
+  }
+
+  // A dictionary with a given id is only accepted if the same one is stored already.
+  REQUIRE(MDB_SUCCESS == codec::Dictionaries::store(txn, *dictionaries.byId(1)));
+  REQUIRE(MDB_KEYEXIST == codec::Dictionaries::store(txn, *dictionaryB));
+  mdb_txn_abort(txn);
+  mdb_env_close(env);
+
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+}
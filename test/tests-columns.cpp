@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifdef WIN32
+    #define UNLINK _unlink
+#else
+    #include <unistd.h>
+    #define UNLINK unlink
+#endif
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "cabinet-columns.hpp"
+#include "columns.hpp"
+#include "rec2cabinet2.hpp"
+
+#include "lmdb++.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+static bool sameBits(const std::vector<double> &a, const std::vector<double> &b) {
+  return (a.size() == b.size()) && (0 == std::memcmp(a.data(), b.data(), a.size() * sizeof(double)));
+}
+
+TEST_CASE("Test encoding timeStamps and values into blocks") {
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<int64_t> jitter(-500, 500);
+  std::normal_distribution<double> noise(0.0, 0.01);
+
+  // 100Hz with jitter in microseconds, some gaps, and a slowly changing float value.
+  std::vector<int64_t> timeStamps;
+  std::vector<double> values;
+  int64_t t{1600000000000000000LL};
+  float speed{10.0f};
+  for (uint32_t i{0}; i < 1024; i++) {
+    t += 10000000LL + jitter(rng) * 1000LL + ((0 == (i % 300)) ? 3600LL * 1000000000LL : 0);
+    speed += static_cast<float>(noise(rng));
+    timeStamps.push_back(t);
+    values.push_back((0 == (i % 100)) ? speed : ((i % 7) ? static_cast<double>(speed) : values.back()));
+  }
+  values.at(10) = std::numeric_limits<double>::quiet_NaN();
+  values.at(11) = -std::numeric_limits<double>::infinity();
+  values.at(12) = -0.0;
+  values.at(13) = std::numeric_limits<double>::denorm_min();
+
+  std::vector<char> block;
+  columns::encode(timeStamps.data(), values.data(), static_cast<uint32_t>(timeStamps.size()), block);
+  // Smaller than 16 bytes per pair even for noisy values and jitter.
+  REQUIRE(block.size() < timeStamps.size() * 10);
+
+  columns::Header h;
+  REQUIRE(columns::headerOf(block.data(), block.size(), h));
+  REQUIRE(1024 == h.count);
+  REQUIRE(1000 == h.unit);
+  REQUIRE(timeStamps.front() == h.first);
+  REQUIRE(timeStamps.back() == h.last);
+  REQUIRE(std::isinf(h.min));
+
+  columns::Series s;
+  REQUIRE(columns::decode(block.data(), block.size(), s.timeStamps, s.values));
+  REQUIRE(timeStamps == s.timeStamps);
+  REQUIRE(sameBits(values, s.values));
+
+  // A regular signal with repeated values takes less than a byte per pair.
+  for (uint32_t i{0}; i < 1024; i++) {
+    timeStamps.at(i) = 1600000000000000000LL + static_cast<int64_t>(i) * 10000000LL;
+    values.at(i) = static_cast<double>(i / 64);
+  }
+  block.clear();
+  columns::encode(timeStamps.data(), values.data(), static_cast<uint32_t>(timeStamps.size()), block);
+  REQUIRE(block.size() < timeStamps.size());
+  s = columns::Series();
+  REQUIRE(columns::decode(block.data(), block.size(), s.timeStamps, s.values));
+  REQUIRE(timeStamps == s.timeStamps);
+  REQUIRE(sameBits(values, s.values));
+
+  // Nanosecond timeStamps, equal timeStamps, and random values.
+  timeStamps.clear();
+  values.clear();
+  for (uint32_t i{0}; i < 500; i++) {
+    timeStamps.push_back(static_cast<int64_t>(i / 2) * 1234567LL + ((i % 3) ? 0 : static_cast<int64_t>(rng() % 1000)));
+    uint64_t bits{rng()};
+    double d{0};
+    std::memcpy(&d, &bits, sizeof(d));
+    values.push_back(d);
+  }
+  std::sort(timeStamps.begin(), timeStamps.end());
+  block.clear();
+  columns::encode(timeStamps.data(), values.data(), static_cast<uint32_t>(timeStamps.size()), block);
+  REQUIRE(columns::headerOf(block.data(), block.size(), h));
+  REQUIRE(1 == h.unit);
+  s = columns::Series();
+  REQUIRE(columns::decode(block.data(), block.size(), s.timeStamps, s.values));
+  REQUIRE(timeStamps == s.timeStamps);
+  REQUIRE(sameBits(values, s.values));
+
+  // A single value and a truncated block.
+  block.clear();
+  columns::encode(timeStamps.data(), values.data(), 1, block);
+  s = columns::Series();
+  REQUIRE(columns::decode(block.data(), block.size(), s.timeStamps, s.values));
+  REQUIRE(1 == s.timeStamps.size());
+  block.clear();
+  columns::encode(timeStamps.data(), values.data(), 100, block);
+  s = columns::Series();
+  REQUIRE(!columns::decode(block.data(), block.size() - 8, s.timeStamps, s.values));
+  REQUIRE(s.timeStamps.empty());
+}
+
+TEST_CASE("Test parsing the fields to decode into columns") {
+  std::vector<columns::Field> fields;
+  REQUIRE(columns::parse("1046/0.groundSpeed,1030,19/2", fields));
+  REQUIRE(3 == fields.size());
+  REQUIRE(columns::selects(fields, 1046, 0, "groundSpeed"));
+  REQUIRE(!columns::selects(fields, 1046, 1));
+  REQUIRE(columns::selects(fields, 1030, 7, "accelerationZ"));
+  REQUIRE(columns::selects(fields, 19, 2, "latitude"));
+  REQUIRE(!columns::selects(fields, 19, 0, "latitude"));
+
+  std::vector<columns::Field> invalid;
+  REQUIRE(!columns::parse("speed", invalid));
+  REQUIRE(!columns::parse("1046x", invalid));
+  REQUIRE(!columns::parse("", invalid));
+}
+
+TEST_CASE("Test decoding numeric fields from a cabinet into columns") {
+  const bool VERBOSE{false};
+  const uint64_t MEM{1};
+  const std::string RECFILENAME{"tests-columns.rec"};
+  const std::string CABINETNAME{"tests-columns.cab"};
+  const std::string COLUMNCABINETNAME{"tests-columns.cab-columns"};
+  for (auto f : {CABINETNAME, COLUMNCABINETNAME}) {
+    UNLINK(f.c_str());
+    UNLINK((f + "-lock").c_str());
+  }
+
+  // GroundSpeedReading at 100Hz and AccelerationReading at 50Hz from two senders.
+  std::vector<int64_t> speedTimeStamps;
+  std::vector<double> speeds;
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    for (int64_t i{0}; i < 2000; i++) {
+      const int64_t T{1600000000000000L + i * 10000L};
+      opendlv::proxy::GroundSpeedReading gsr;
+      gsr.groundSpeed(static_cast<float>(i) * 0.01f);
+      cluon::data::Envelope e;
+      e.dataType(opendlv::proxy::GroundSpeedReading::ID()).senderStamp(0).sampleTimeStamp(cluon::time::fromMicroseconds(T));
+      {
+        cluon::ToProtoVisitor protoEncoder;
+        gsr.accept(protoEncoder);
+        e.serializedData(protoEncoder.encodedData());
+      }
+      const std::string s{cluon::serializeEnvelope(std::move(e))};
+      rec.write(s.data(), s.size());
+      speedTimeStamps.push_back(T * 1000);
+      speeds.push_back(static_cast<float>(i) * 0.01f);
+
+      if (0 == (i % 2)) {
+        for (uint32_t senderStamp{0}; senderStamp < 2; senderStamp++) {
+          opendlv::proxy::AccelerationReading ar;
+          ar.accelerationX(1.0f + static_cast<float>(senderStamp)).accelerationY(static_cast<float>(i)).accelerationZ(-9.81f);
+          cluon::ToProtoVisitor protoEncoder;
+          ar.accept(protoEncoder);
+          cluon::data::Envelope a;
+          a.dataType(opendlv::proxy::AccelerationReading::ID()).senderStamp(senderStamp).serializedData(protoEncoder.encodedData()).sampleTimeStamp(cluon::time::fromMicroseconds(T));
+          const std::string sa{cluon::serializeEnvelope(std::move(a))};
+          rec.write(sa.data(), sa.size());
+        }
+      }
+    }
+  }
+  cluon::In_Ranges<int64_t> ranges;
+  REQUIRE(0 == rec2cabinet("tests-columns", MEM, RECFILENAME, CABINETNAME, 0, ranges, VERBOSE, 1, codec::Selection(), KEY_LAYOUT_MEMCMP));
+  UNLINK(RECFILENAME.c_str());
+
+  std::vector<columns::Field> fields;
+  REQUIRE(columns::parse("1046,1030/1.accelerationX", fields));
+  REQUIRE(0 == cabinet_columns("tests-columns", MEM, CABINETNAME, COLUMNCABINETNAME, fields, 256, VERBOSE));
+  // Running again does not add values.
+  REQUIRE(0 == cabinet_columns("tests-columns", MEM, CABINETNAME, COLUMNCABINETNAME, fields, 256, VERBOSE));
+
+  auto env = lmdb::env::create();
+  env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+  env.set_max_dbs(100);
+  env.open(COLUMNCABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+  auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+  REQUIRE(std::vector<std::string>{"1030/1.accelerationX", "1046/0.groundSpeed"} == columns::columnsOf(rotxn.handle()));
+  {
+    auto dbi = lmdb::dbi::open(rotxn, "1046/0.groundSpeed");
+    REQUIRE(8 == dbi.size(rotxn));
+  }
+
+  columns::Series s;
+  REQUIRE(columns::read(rotxn.handle(), "1046/0.groundSpeed", 0, std::numeric_limits<int64_t>::max(), s));
+  REQUIRE(speedTimeStamps == s.timeStamps);
+  REQUIRE(speeds == s.values);
+
+  s = columns::Series();
+  REQUIRE(columns::read(rotxn.handle(), "1030/1.accelerationX", 0, std::numeric_limits<int64_t>::max(), s));
+  REQUIRE(1000 == s.values.size());
+  REQUIRE(2.0 == Approx(s.values.front()));
+
+  // A window within and across blocks.
+  const int64_t START{speedTimeStamps.at(300)};
+  const int64_t END{speedTimeStamps.at(1299)};
+  s = columns::Series();
+  REQUIRE(columns::read(rotxn.handle(), "1046/0.groundSpeed", START, END, s));
+  REQUIRE(1000 == s.values.size());
+  REQUIRE(START == s.timeStamps.front());
+  REQUIRE(END == s.timeStamps.back());
+
+  // Only the blocks at the boundaries of the window are decoded.
+  columns::Summary summary;
+  REQUIRE(columns::summarize(rotxn.handle(), "1046/0.groundSpeed", START, END, summary));
+  REQUIRE(1000 == summary.count);
+  REQUIRE(speeds.at(300) == Approx(summary.min));
+  REQUIRE(speeds.at(1299) == Approx(summary.max));
+  REQUIRE(2 == summary.blocksDecoded);
+
+  REQUIRE(!columns::read(rotxn.handle(), "1046/1.groundSpeed", 0, END, s));
+  rotxn.abort();
+
+  for (auto f : {CABINETNAME, COLUMNCABINETNAME}) {
+    UNLINK(f.c_str());
+    UNLINK((f + "-lock").c_str());
+  }
+}
@@ -9,11 +9,14 @@
 #include "catch.hpp"
 
 #include "cluon-complete.hpp"
+#include "codec.hpp"
 #include "key.hpp"
 
 #include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <string>
+#include <tuple>
 #include <vector>
 
 TEST_CASE("Test writing key") {
@@ -73,3 +76,176 @@ TEST_CASE("Test reading key") {
   REQUIRE(0x566F7961676572 == k.userData());
   REQUIRE(0 == k.version());
 }
+
+TEST_CASE("Test writing and reading key in memcmp layout") {
+  std::vector<char> tmp(511);
+
+  cabinet::Key k;
+  k.timeStamp(12345)
+   .dataType(4321)
+   .senderStamp(223344)
+   .hash(987654321)
+   .hashOfRecFile(1219289910)
+   .length(345)
+   .userData(0x566F7961676572ULL)  // Voyager
+   .version(KEY_LAYOUT_MEMCMP);
+
+  const size_t len = setKey(k, tmp.data(), tmp.size());
+  REQUIRE(39 == len);
+
+  // Only the sign bits of timeStamp and dataType are flipped.
+  const unsigned char output[] = { 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x39, 0x80, 0x00, 0x10, 0xe1, 0x00, 0x03, 0x68, 0x70, 0x00, 0x00, 0x00, 0x00, 0x3a, 0xde, 0x68, 0xb1, 0x48, 0xac, 0xe3, 0x36, 0x01, 0x59, 0x00, 0x56, 0x6f, 0x79, 0x61, 0x67, 0x65, 0x72, 0x01 };
+  REQUIRE(0 == std::memcmp(tmp.data(), output, len));
+
+  cabinet::Key k2 = getKey(tmp.data(), len);
+  REQUIRE(12345 == k2.timeStamp());
+  REQUIRE(4321 == k2.dataType());
+  REQUIRE(223344 == k2.senderStamp());
+  REQUIRE(987654321 == k2.hash());
+  REQUIRE(1219289910 == k2.hashOfRecFile());
+  REQUIRE(345 == k2.length());
+  REQUIRE(0x566F7961676572 == k2.userData());
+  REQUIRE(KEY_LAYOUT_MEMCMP == k2.version());
+
+  // The prefix to position a cursor matches the leading timeStamp.
+  std::vector<char> prefix(8);
+  REQUIRE(8 == setKeyPrefix(12345, KEY_LAYOUT_MEMCMP, prefix.data(), prefix.size()));
+  REQUIRE(0 == std::memcmp(prefix.data(), output, 8));
+  REQUIRE(8 == setKeyPrefix(12345, KEY_LAYOUT_COMPARE_KEYS, prefix.data(), prefix.size()));
+  REQUIRE(0x00 == static_cast<uint8_t>(prefix[0]));
+}
+
+TEST_CASE("Test memcmp layout orders keys by timeStamp, dataType, and senderStamp") {
+  std::vector<std::pair<int64_t, int32_t>> fields{{-5, 1}, {-1, -7}, {-1, 3}, {0, 0}, {0, 19}, {1, -1}, {1650000000000000000LL, 19}, {1650000000000000000LL, 1055}};
+
+  std::vector<std::string> serialized;
+  for (auto f : fields) {
+    cabinet::Key k;
+    k.timeStamp(f.first).dataType(f.second).version(KEY_LAYOUT_MEMCMP);
+    std::vector<char> tmp(511);
+    serialized.emplace_back(tmp.data(), setKey(k, tmp.data(), tmp.size()));
+  }
+  for (size_t i{1}; i < serialized.size(); i++) {
+    REQUIRE(0 > std::memcmp(serialized[i - 1].data(), serialized[i].data(), serialized[i].size()));
+  }
+}
+
+TEST_CASE("Test compareKeys orders keys with the same timeStamp by dataType, senderStamp, and hash") {
+  std::vector<std::tuple<int64_t, int32_t, uint32_t, uint64_t>> fields{{-1, 19, 0, 0}, {1000, -7, 3, 0}, {1000, 19, 0, 0xFFFF}, {1000, 19, 1, 0}, {1000, 19, 1, 0x8000000000000000ULL}, {1000, 1055, 0, 0}, {1001, -7, 0, 0}};
+
+  std::vector<std::string> serialized;
+  for (auto f : fields) {
+    cabinet::Key k;
+    k.timeStamp(std::get<0>(f)).dataType(std::get<1>(f)).senderStamp(std::get<2>(f)).hash(std::get<3>(f));
+    std::vector<char> tmp(511);
+    serialized.emplace_back(tmp.data(), setKey(k, tmp.data(), tmp.size()));
+  }
+  for (size_t i{1}; i < serialized.size(); i++) {
+    MDB_val a{serialized[i - 1].size(), const_cast<char*>(serialized[i - 1].data())};
+    MDB_val b{serialized[i].size(), const_cast<char*>(serialized[i].data())};
+    REQUIRE(-1 == compareKeys(&a, &b));
+    REQUIRE(1 == compareKeys(&b, &a));
+    REQUIRE(0 == compareKeys(&a, &a));
+  }
+
+  // A prefix with only the timeStamp is ordered before all keys with that timeStamp.
+  std::vector<char> prefix(8);
+  setKeyPrefix(1000, KEY_LAYOUT_COMPARE_KEYS, prefix.data(), prefix.size());
+  MDB_val p{prefix.size(), prefix.data()};
+  MDB_val before{serialized[0].size(), const_cast<char*>(serialized[0].data())};
+  MDB_val first{serialized[1].size(), const_cast<char*>(serialized[1].data())};
+  REQUIRE(1 == compareKeys(&p, &before));
+  REQUIRE(-1 == compareKeys(&p, &first));
+}
+
+// Serialized key from "Test writing key" in memcmp layout.
+constexpr char MEMCMP_KEY[KEY_SIZE]{'\x80', 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x39, '\x80', 0x00, 0x10, '\xe1', 0x00, 0x03, 0x68, 0x70, 0x00, 0x00, 0x00, 0x00, 0x3a, '\xde', 0x68, '\xb1', 0x48, '\xac', '\xe3', 0x36, 0x01, 0x59, 0x00, 0x56, 0x6f, 0x79, 0x61, 0x67, 0x65, 0x72, 0x01};
+static_assert(12345 == keyTimeStamp(MEMCMP_KEY), "timeStamp must be readable at compile time");
+static_assert(4321 == keyDataType(MEMCMP_KEY), "dataType must be readable at compile time");
+static_assert(KEY_LAYOUT_MEMCMP == keyLayout(MEMCMP_KEY), "layout must be readable at compile time");
+
+TEST_CASE("Test reading single fields from key") {
+  for (auto layout : {KEY_LAYOUT_COMPARE_KEYS, KEY_LAYOUT_MEMCMP}) {
+    cabinet::Key k;
+    k.timeStamp(-12345).dataType(-4321).senderStamp(223344).hash(0xFEDCBA9876543210ULL).hashOfRecFile(1219289910).length(345).userData(0x566F7961676572).version(codec::version(layout, codec::LZ4));
+
+    std::vector<char> tmp(511);
+    REQUIRE(KEY_SIZE == setKey(k, tmp.data(), tmp.size()));
+    REQUIRE(0 == setKey(k, tmp.data(), KEY_SIZE - 1));
+
+    const char *ptr{tmp.data()};
+    REQUIRE(-12345 == keyTimeStamp(ptr));
+    REQUIRE(-4321 == keyDataType(ptr));
+    REQUIRE(223344 == keySenderStamp(ptr));
+    REQUIRE(0xFEDCBA9876543210ULL == keyHash(ptr));
+    REQUIRE(1219289910 == keyHashOfRecFile(ptr));
+    REQUIRE(345 == keyLength(ptr));
+    REQUIRE(0x566F7961676572 == keyUserData(ptr));
+    REQUIRE(layout == keyLayout(ptr));
+    REQUIRE(codec::LZ4 == (keyVersion(ptr) >> 4));
+  }
+}
+
+TEST_CASE("Test reading columns from keys") {
+  std::vector<std::vector<char>> serialized;
+  std::vector<MDB_val> keys;
+  for (int32_t i{0}; i < 5; i++) {
+    cabinet::Key k;
+    k.timeStamp(1000 - i).dataType(19 + i).senderStamp(static_cast<uint32_t>(i)).hash(static_cast<uint64_t>(i) * 7).version(static_cast<uint8_t>(i % 2));
+    serialized.emplace_back(511);
+    serialized.back().resize(setKey(k, serialized.back().data(), serialized.back().size()));
+  }
+  for (auto &s : serialized) {
+    keys.push_back(MDB_val{s.size(), s.data()});
+  }
+  // A prefix to position a cursor is too short for the columns.
+  char prefix[sizeof(int64_t)];
+  keys.push_back(MDB_val{setKeyPrefix(1, KEY_LAYOUT_COMPARE_KEYS, prefix, sizeof(prefix)), prefix});
+
+  std::vector<int64_t> timeStamps(keys.size(), -1);
+  std::vector<int32_t> dataTypes(keys.size(), -1);
+  std::vector<uint64_t> hashes(keys.size(), 1);
+  REQUIRE(5 == getKeyColumns(keys.data(), keys.size(), timeStamps.data(), dataTypes.data(), nullptr, hashes.data()));
+  for (int32_t i{0}; i < 5; i++) {
+    REQUIRE(1000 - i == timeStamps[i]);
+    REQUIRE(19 + i == dataTypes[i]);
+    REQUIRE(static_cast<uint64_t>(i) * 7 == hashes[i]);
+  }
+  REQUIRE(0 == timeStamps[5]);
+  REQUIRE(0 == dataTypes[5]);
+  REQUIRE(0 == hashes[5]);
+}
+
+TEST_CASE("Test writing key with inline value") {
+  cabinet::Key k;
+  k.timeStamp(12345).dataType(19).senderStamp(2).hash(0xABCD).length(5).version(codec::version(KEY_LAYOUT_MEMCMP, codec::NONE));
+  const std::string VALUE{"Hello"};
+
+  std::vector<char> tmp(511);
+  REQUIRE(KEY_SIZE + VALUE.size() == setKey(k, VALUE.data(), VALUE.size(), tmp.data(), tmp.size()));
+  REQUIRE(0 == setKey(k, VALUE.data(), VALUE.size(), tmp.data(), KEY_SIZE + VALUE.size() - 1));
+  REQUIRE(KEY_LAYOUT_MEMCMP == keyLayout(tmp.data()));
+  REQUIRE(0 != (keyVersion(tmp.data()) & KEY_INLINE_VALUE));
+
+  cabinet::Key k2 = getKey(tmp.data(), KEY_SIZE + VALUE.size());
+  REQUIRE(12345 == k2.timeStamp());
+  REQUIRE(codec::NONE == codec::codecOf(k2));
+  REQUIRE(KEY_LAYOUT_MEMCMP == codec::layoutOf(k2));
+
+  // The inline value replaces the LMDB value.
+  MDB_val key{KEY_SIZE + VALUE.size(), tmp.data()};
+  MDB_val value{0, nullptr};
+  MDB_val v = storedValueOf(key, value);
+  REQUIRE(VALUE == std::string(static_cast<char*>(v.mv_data), v.mv_size));
+  REQUIRE(KEY_SIZE == fixedFieldsOf(key).mv_size);
+
+  // Keys without inline value refer to the LMDB value.
+  std::vector<char> tmp2(511);
+  MDB_val key2{setKey(k, tmp2.data(), tmp2.size()), tmp2.data()};
+  MDB_val value2{VALUE.size(), const_cast<char*>(VALUE.data())};
+  REQUIRE(value2.mv_data == storedValueOf(key2, value2).mv_data);
+
+  // compareKeys considers both keys equal; memcmp orders the key without value first.
+  REQUIRE(0 == compareKeys(&key, &key2));
+  REQUIRE(0 > std::memcmp(tmp2.data(), tmp.data(), KEY_SIZE));
+}
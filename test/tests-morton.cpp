@@ -19,11 +19,18 @@
 #include "opendlv-standard-message-set.hpp"
 #include "rec2cabinet.hpp"
 #include "cabinet-WGS84toMorton.hpp"
+#include "gps-traces.hpp"
+#include "hilbert.hpp"
 #include "morton.hpp"
 #include "lmdb.h"
 
+#include <algorithm>
+#include <array>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
 
 TEST_CASE("Test encode/decode") {
   std::pair<std::uint32_t,std::uint32_t> xy1(57772400, 12765000);
@@ -429,117 +436,7 @@ TEST_CASE("Test GeodeticWge84") {
 }
 
 TEST_CASE("Range querying Morton-indexed GPS traces") {
-  const char *gps = R"(
-57.77778901 12.77790337
-57.77734125 12.77817215
-57.77689127 12.77846196
-57.77645616 12.77873826
-57.77601406 12.77902484
-57.77556784 12.77930998
-57.7751248 12.77957598
-57.77467775 12.77975093
-57.77422499 12.77980395
-57.7737736 12.77971304
-57.77332939 12.77949689
-57.77289907 12.77913649
-57.77250135 12.77864161
-57.77216032 12.77803764
-57.77187986 12.77735772
-57.77166482 12.77660913
-57.77151726 12.77580491
-57.77143545 12.77494498
-57.77141137 12.7740273
-57.77140439 12.77307387
-57.77140376 12.77214181
-57.77143701 12.77125741
-57.77152257 12.77038774
-57.77165858 12.76955397
-57.77184604 12.76874014
-57.77209332 12.76794528
-57.77238912 12.76722763
-57.77271621 12.76659785
-57.77306859 12.76606175
-57.77346526 12.76559187
-57.77388869 12.7652073
-57.77434951 12.76490549
-57.77481957 12.76472222
-57.77528843 12.76462972
-57.77575132 12.76465133
-57.77621227 12.76477113
-57.7766734 12.76499178
-57.77711784 12.76531837
-57.77754423 12.7657113
-57.77796038 12.76611514
-57.77839225 12.76651221
-57.77884971 12.76681376
-57.77931949 12.76699075
-57.77979492 12.76706398
-57.78026842 12.76701259
-57.78074233 12.76683419
-57.78119314 12.76654933
-57.78161167 12.76617196
-57.78200969 12.76573402
-57.78240413 12.76527802
-57.78281179 12.76480606
-57.78322918 12.76433381
-57.78365049 12.76384777
-57.78403756 12.76339636
-57.7844396 12.76293542
-57.78485236 12.76245808
-57.78526512 12.76198531
-57.78567563 12.76151412
-57.78607437 12.76105485
-57.78646903 12.76059934
-57.78685972 12.76015645
-57.78729273 12.75972409
-57.78772906 12.7594104
-57.78820149 12.75920448
-57.78868953 12.75913302
-57.78917059 12.75919195
-57.78962594 12.75937305
-57.79006776 12.75967779
-57.79048793 12.76009748
-57.79085991 12.76061729
-57.7912018 12.76126108
-57.79147693 12.76200414
-57.79167706 12.76284685
-57.79178783 12.76368688
-57.79182191 12.7645425
-57.79177819 12.76539516
-57.79164308 12.76628887
-57.79142382 12.76711409
-57.79114957 12.76781077
-57.79081165 12.76841176
-57.79043384 12.76887687
-57.79000543 12.76924681
-57.78957781 12.7695419
-57.78914941 12.7698457
-57.78870819 12.77020802
-57.78828911 12.77061578
-57.78788781 12.77107466
-57.78749761 12.77156274
-57.78711964 12.77203214
-57.7867304 12.77251473
-57.78631662 12.7730335
-57.7859302 12.77351976
-57.78554044 12.77400062
-57.78514573 12.77446785
-57.7847399 12.77489121
-57.78432775 12.77527039
-57.78391069 12.77560755
-57.78348518 12.77590203
-57.78300759 12.7761827
-57.78254842 12.77639931
-57.78209549 12.77657095
-57.78162585 12.7766985
-57.78116643 12.77678231
-57.7807129 12.77686025
-57.78026355 12.77694265
-57.77977698 12.77705753
-57.7793023 12.77720993
-57.77884228 12.7773841
-57.77837325 12.77759546
-)";
+  const char *gps{GPS_TRACE_AZ};
 
   std::string RECFILE("az.rec");
   std::string DBFILE("az.cab");
@@ -547,6 +444,8 @@ TEST_CASE("Range querying Morton-indexed GPS traces") {
     UNLINK(RECFILE.c_str());
     UNLINK("az.cab");
     UNLINK("az.cab-lock");
+    UNLINK("az.cab.mc");
+    UNLINK("az.cab.mc-lock");
     std::fstream recordingFile(RECFILE.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
     REQUIRE(recordingFile.good());
    
@@ -696,14 +595,659 @@ TEST_CASE("Range querying Morton-indexed GPS traces") {
     mdb_cursor_close(cursor);
     mdb_txn_abort(txn);
   }
+  {
+    // The same entries are indexed per time bucket.
+    MDB_txn *txn{nullptr};
+    MDB_dbi dbi{0};
+    REQUIRE(MDB_SUCCESS == mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn));
+    REQUIRE(MDB_SUCCESS == mdb_dbi_open(txn, "19/0-morton-time", 0 , &dbi));
+    mdb_set_dupsort(txn, dbi, &compareKeys);
+
+    MDB_stat stat;
+    mdb_stat(txn, dbi, &stat);
+    REQUIRE(110 == stat.ms_entries);
+
+    MDB_cursor *cursor;
+    REQUIRE(MDB_SUCCESS == mdb_cursor_open(txn, dbi, &cursor));
+    const auto box{convertLatLonBoxToMorton(std::make_pair(57.771302f, 12.774653f), std::make_pair(57.771677f, 12.776144f))};
+    std::vector<int64_t> timeStamps;
+    std::vector<int64_t> found;
+    mortonForEachBucket(cursor, 0, 1000L * 1000L * 1000L * 1000L, [&](const int64_t &bucket) {
+      return mortonForEachInBox(cursor, box.first, box.second, [&](const uint64_t &, const MDB_val &values) {
+        mortonTimeStampsOf(values, timeStamps);
+        found.insert(found.end(), timeStamps.begin(), timeStamps.end());
+      }, &bucket);
+    });
+    REQUIRE((std::vector<int64_t>{283001183000, 273001173000}) == found);
+    mdb_cursor_close(cursor);
+    mdb_txn_abort(txn);
+  }
    
   if (env) {
     mdb_env_close(env);
   }
 
+  // The same entries are found along the Hilbert curve.
+  UNLINK("az.cab.hc");
+  UNLINK("az.cab.hc-lock");
+  REQUIRE(!cabinet_WGS84toMorton(MEM, DBFILE, "az.cab.hc", VERBOSE, CURVE_HILBERT));
+  REQUIRE(MDB_SUCCESS == mdb_env_create(&env));
+  REQUIRE(MDB_SUCCESS == mdb_env_set_maxdbs(env, numberOfDatabases));
+  REQUIRE(MDB_SUCCESS == mdb_env_set_mapsize(env, SIZE_DB));
+  REQUIRE(MDB_SUCCESS == mdb_env_open(env, "az.cab.hc", MDB_NOSUBDIR|MDB_RDONLY, 0600));
+  {
+    MDB_txn *txn{nullptr};
+    MDB_dbi dbi{0};
+    REQUIRE(MDB_SUCCESS == mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn));
+    REQUIRE(MDB_NOTFOUND == mdb_dbi_open(txn, "19/0-morton", 0 , &dbi));
+    const auto box{convertLatLonBoxToMorton(std::make_pair(57.771302f, 12.774653f), std::make_pair(57.771677f, 12.776144f))};
+    for (const std::string TABLE : {"19/0-hilbert", "19/0-hilbert-time"}) {
+      REQUIRE(MDB_SUCCESS == mdb_dbi_open(txn, TABLE.c_str(), 0 , &dbi));
+      REQUIRE(CURVE_HILBERT == curveOfTable(TABLE));
+      if (!isCurveTimeTable(TABLE)) {
+        mdb_set_compare(txn, dbi, &compareMortonKeys);
+      }
+      mdb_set_dupsort(txn, dbi, &compareKeys);
+
+      MDB_stat stat;
+      mdb_stat(txn, dbi, &stat);
+      REQUIRE(110 == stat.ms_entries);
+
+      MDB_cursor *cursor;
+      REQUIRE(MDB_SUCCESS == mdb_cursor_open(txn, dbi, &cursor));
+      std::vector<int64_t> timeStamps;
+      std::vector<int64_t> found;
+      auto collect = [&](const uint64_t &code, const MDB_val &values) {
+        const auto LATLON{convertHilbertToLatLon(code)};
+        REQUIRE(57.771302f <= LATLON.first);
+        REQUIRE(LATLON.first <= 57.771677f);
+        mortonTimeStampsOf(values, timeStamps);
+        found.insert(found.end(), timeStamps.begin(), timeStamps.end());
+      };
+      if (isCurveTimeTable(TABLE)) {
+        mortonForEachBucket(cursor, 0, 1000L * 1000L * 1000L * 1000L, [&](const int64_t &bucket) {
+          return hilbertForEachInBox(cursor, box.first, box.second, collect, &bucket);
+        });
+      }
+      else {
+        hilbertForEachInBox(cursor, box.first, box.second, collect);
+      }
+      std::sort(found.begin(), found.end());
+      REQUIRE((std::vector<int64_t>{273001173000, 283001183000}) == found);
+      mdb_cursor_close(cursor);
+    }
+    mdb_txn_abort(txn);
+  }
+  mdb_env_close(env);
+
   UNLINK(RECFILE.c_str());
   UNLINK("az.cab");
   UNLINK("az.cab-lock");
   UNLINK("az.cab.mc");
   UNLINK("az.cab.mc-lock");
+  UNLINK("az.cab.hc");
+  UNLINK("az.cab.hc-lock");
+}
+
+TEST_CASE("Test BIGMIN and LITMAX against all Morton codes of a grid") {
+  std::mt19937 rng(19);
+  std::uniform_int_distribution<uint32_t> coordinate(0, 31);
+  for (uint32_t i{0}; i < 200; i++) {
+    uint32_t x0{coordinate(rng)}, x1{coordinate(rng)}, y0{coordinate(rng)}, y1{coordinate(rng)};
+    const uint64_t zmin{mortonEncode(std::make_pair(std::min(x0, x1), std::min(y0, y1)))};
+    const uint64_t zmax{mortonEncode(std::make_pair(std::max(x0, x1), std::max(y0, y1)))};
+    std::vector<uint64_t> inBox;
+    for (uint64_t z{zmin}; z <= zmax; z++) {
+      if (mortonIsInBox(z, zmin, zmax)) {
+        inBox.push_back(z);
+      }
+    }
+    for (uint64_t z{zmin + 1}; z < zmax; z++) {
+      if (!mortonIsInBox(z, zmin, zmax)) {
+        REQUIRE(*std::upper_bound(inBox.begin(), inBox.end(), z) == mortonBigMin(z, zmin, zmax));
+        REQUIRE(*(std::lower_bound(inBox.begin(), inBox.end(), z) - 1) == mortonLitMax(z, zmin, zmax));
+      }
+    }
+  }
+
+  // The corners of a box may be given in any order.
+  const auto box{convertLatLonBoxToMorton(std::make_pair(57.7f, 12.8f), std::make_pair(57.6f, 12.7f))};
+  REQUIRE(box == convertLatLonBoxToMorton(std::make_pair(57.6f, 12.7f), std::make_pair(57.7f, 12.8f)));
+  REQUIRE(mortonIsInBox(convertLatLonToMorton(std::make_pair(57.65f, 12.75f)), box.first, box.second));
+  REQUIRE(!mortonIsInBox(convertLatLonToMorton(std::make_pair(57.65f, 12.85f)), box.first, box.second));
+}
+
+TEST_CASE("Test visiting only the entries within a geobox") {
+  const std::string CABINETNAME{"tests-morton-geobox.cab"};
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+
+  MDB_env *env{nullptr};
+  REQUIRE(MDB_SUCCESS == mdb_env_create(&env));
+  REQUIRE(MDB_SUCCESS == mdb_env_set_maxdbs(env, 100));
+  REQUIRE(MDB_SUCCESS == mdb_env_set_mapsize(env, 1UL * 1024UL * 1024UL * 1024UL));
+  REQUIRE(MDB_SUCCESS == mdb_env_open(env, CABINETNAME.c_str(), MDB_NOSUBDIR, 0600));
+
+  // Positions on a grid of 0.001 degrees around Gothenburg with mostly two timeStamps
+  // each and a hot spot with more timeStamps than fit on one page; the timeStamps are
+  // stored as fixed-size duplicates like by cabinet-WGS84toMorton and as variable ones.
+  const std::vector<std::pair<std::string, unsigned int>> TABLES{{"19/0-morton", MDB_DUPSORT|MDB_DUPFIXED}, {"19/1-morton", MDB_DUPSORT}};
+  const uint64_t HOTSPOT{convertLatLonToMorton(std::make_pair(57.7005f, 11.9505f))};
+  std::vector<std::pair<uint64_t, int64_t>> entries;
+  MDB_txn *txn{nullptr};
+  MDB_dbi dbi{0};
+  REQUIRE(MDB_SUCCESS == mdb_txn_begin(env, nullptr, 0, &txn));
+  for (const auto &table : TABLES) {
+    REQUIRE(MDB_SUCCESS == mdb_dbi_open(txn, table.first.c_str(), MDB_CREATE|table.second, &dbi));
+    mdb_set_compare(txn, dbi, &compareMortonKeys);
+    mdb_set_dupsort(txn, dbi, &compareKeys);
+    auto put = [&](const uint64_t &morton, const int64_t &timeStamp) {
+      if (table == TABLES.front()) {
+        entries.emplace_back(morton, timeStamp);
+      }
+      uint64_t k{htobe64(morton)};
+      int64_t v{static_cast<int64_t>(htobe64(static_cast<uint64_t>(timeStamp)))};
+      MDB_val key{sizeof(k), &k};
+      MDB_val value{sizeof(v), &v};
+      REQUIRE(MDB_SUCCESS == mdb_put(txn, dbi, &key, &value, 0));
+    };
+    for (int32_t lat{0}; lat < 200; lat++) {
+      for (int32_t lon{0}; lon < 200; lon++) {
+        const uint64_t morton{convertLatLonToMorton(std::make_pair(57.6f + static_cast<float>(lat) * 0.001f, 11.9f + static_cast<float>(lon) * 0.001f))};
+        put(morton, lat * 1000 + lon);
+        // Some positions have a single timeStamp between positions with duplicates.
+        if (0 != ((lat + lon) % 7)) {
+          put(morton, 1000000 + lat * 1000 + lon);
+        }
+      }
+    }
+    for (int64_t i{0}; i < 5000; i++) {
+      put(HOTSPOT, 2000000 + i);
+    }
+  }
+  REQUIRE(MDB_SUCCESS == mdb_txn_commit(txn));
+
+  REQUIRE(MDB_SUCCESS == mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn));
+  for (const auto &table : TABLES) {
+    REQUIRE(MDB_SUCCESS == mdb_dbi_open(txn, table.first.c_str(), 0, &dbi));
+    mdb_set_compare(txn, dbi, &compareMortonKeys);
+    mdb_set_dupsort(txn, dbi, &compareKeys);
+    MDB_cursor *cursor{nullptr};
+    REQUIRE(MDB_SUCCESS == mdb_cursor_open(txn, dbi, &cursor));
+    for (const auto &corners : {std::make_pair(std::make_pair(57.65f, 11.95f), std::make_pair(57.66f, 11.97f)),
+                                std::make_pair(std::make_pair(57.7f, 12.05f), std::make_pair(57.6f, 11.9f)),
+                                std::make_pair(std::make_pair(57.6505f, 11.9505f), std::make_pair(57.6508f, 11.9508f)),
+                                std::make_pair(std::make_pair(57.7f, 11.95f), std::make_pair(57.701f, 11.951f))}) {
+      const auto box{convertLatLonBoxToMorton(corners.first, corners.second)};
+      std::vector<std::pair<uint64_t, int64_t>> expected;
+      for (const auto &e : entries) {
+        if (mortonIsInBox(e.first, box.first, box.second)) {
+          expected.push_back(e);
+        }
+      }
+      std::sort(expected.begin(), expected.end());
+
+      std::vector<std::pair<uint64_t, int64_t>> visited;
+      uint64_t batches{0};
+      std::vector<int64_t> timeStamps;
+      const uint64_t SEEKS{mortonForEachInBox(cursor, box.first, box.second, [&](const uint64_t &morton, const MDB_val &values) {
+        mortonTimeStampsOf(values, timeStamps);
+        for (const auto &timeStamp : timeStamps) {
+          visited.emplace_back(morton, timeStamp);
+        }
+        batches++;
+      })};
+      REQUIRE(expected == visited);
+      REQUIRE(0 < SEEKS);
+      // Fixed-size duplicates are read a page at a time.
+      if (visited.empty()) {
+        REQUIRE(0 == batches);
+      }
+      else if (MDB_DUPFIXED == (table.second & MDB_DUPFIXED)) {
+        REQUIRE(batches < visited.size());
+      }
+      else {
+        REQUIRE(batches == visited.size());
+      }
+    }
+    mdb_cursor_close(cursor);
+  }
+  mdb_txn_abort(txn);
+  mdb_env_close(env);
+
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+}
+
+TEST_CASE("Test covering polygons and corridors with Morton cells") {
+  REQUIRE(geofence::intersects<double>({{0, 0}}, {{10, 10}}, {{4, 4}}, {{6, 6}}));
+  REQUIRE(geofence::intersects<double>({{5, 5}}, {{5, 5}}, {{4, 4}}, {{6, 6}}));
+  REQUIRE(geofence::intersects<double>({{0, 4}}, {{10, 4}}, {{4, 4}}, {{6, 6}}));
+  REQUIRE(!geofence::intersects<double>({{0, 0}}, {{10, 0}}, {{4, 1}}, {{6, 6}}));
+  REQUIRE(!geofence::intersects<double>({{0, 0}}, {{3, 9}}, {{4, 4}}, {{6, 6}}));
+  REQUIRE(5.0 == Approx(geofence::distanceToSegment<double>({{0, 0}}, {{10, 0}}, {{3, 5}})));
+  REQUIRE(5.0 == Approx(geofence::distanceToSegment<double>({{0, 0}}, {{0, 0}}, {{3, 4}})));
+  REQUIRE(5.0 == Approx(geofence::distanceToBox<double>({{0, 0}}, {{1, 1}}, {{4, 5}})));
+  REQUIRE(0.0 == Approx(geofence::distanceToBox<double>({{0, 0}}, {{1, 1}}, {{0.5, 0.5}})));
+
+  // Areas in the grid of the Morton codes: a concave polygon and a corridor around a polyline.
+  std::vector<std::array<double,2>> polygon{{{1000, 1000}}, {{1100, 1010}}, {{1090, 1110}}, {{1070, 1100}}, {{1070, 1030}}, {{1030, 1030}}, {{1030, 1100}}, {{1000, 1100}}};
+  const std::vector<std::array<double,2>> polyline{{{1000, 1000}}, {{1050, 1080}}, {{1120, 1040}}};
+  const double WIDTH{7.5};
+  auto planarOf = [](const uint64_t &morton) {
+    const auto XY = mortonDecode(morton);
+    return std::array<double,2>{{static_cast<double>(XY.first), static_cast<double>(XY.second)}};
+  };
+  const uint64_t ZMIN{mortonEncode(std::make_pair(990u, 990u))};
+  const uint64_t ZMAX{mortonEncode(std::make_pair(1130u, 1130u))};
+
+  for (const bool IS_POLYGON : {true, false}) {
+    auto overlapOf = [&](const uint64_t &bl, const uint64_t &tr) {
+      return IS_POLYGON ? geofence::overlapOfPolygon(polygon, planarOf(bl), planarOf(tr)) : geofence::overlapOfCorridor(polyline, WIDTH, planarOf(bl), planarOf(tr));
+    };
+    auto isIn = [&](const uint64_t &morton) {
+      std::array<double,2> p{planarOf(morton)};
+      return IS_POLYGON ? geofence::isIn(polygon, p) : geofence::isInCorridor(polyline, WIDTH, p);
+    };
+
+    uint64_t previousPartial{std::numeric_limits<uint64_t>::max()};
+    for (const std::size_t MAX_CELLS : {4, 16, 64, 1024}) {
+      const std::vector<MortonCell> cells{mortonCoverOf(ZMIN, ZMAX, overlapOf, MAX_CELLS)};
+      REQUIRE(!cells.empty());
+      for (std::size_t i{1}; i < cells.size(); i++) {
+        REQUIRE(cells.at(i - 1).last < cells.at(i).first);
+      }
+
+      // Every grid point in the area is covered and every grid point in a cell that is not partial is in the area.
+      uint64_t partial{0};
+      for (uint32_t x{980}; x < 1140; x++) {
+        for (uint32_t y{980}; y < 1140; y++) {
+          const uint64_t MORTON{mortonEncode(std::make_pair(x, y))};
+          auto it = std::upper_bound(cells.begin(), cells.end(), MORTON, [](const uint64_t &m, const MortonCell &c) { return m < c.first; });
+          const bool COVERED{(cells.begin() != it) && (MORTON <= (it - 1)->last)};
+          const bool IN{isIn(MORTON)};
+          if (IN) {
+            REQUIRE(COVERED);
+          }
+          if (COVERED && !(it - 1)->partial) {
+            REQUIRE(IN);
+          }
+          partial += (COVERED && (it - 1)->partial) ? 1 : 0;
+        }
+      }
+      // More cells at finer levels leave fewer entries to be checked individually.
+      REQUIRE(partial <= previousPartial);
+      previousPartial = partial;
+    }
+  }
+}
+
+TEST_CASE("Test visiting only the entries within a polygon or corridor") {
+  const std::string CABINETNAME{"tests-morton-polygon.cab"};
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+
+  MDB_env *env{nullptr};
+  REQUIRE(MDB_SUCCESS == mdb_env_create(&env));
+  REQUIRE(MDB_SUCCESS == mdb_env_set_maxdbs(env, 100));
+  REQUIRE(MDB_SUCCESS == mdb_env_set_mapsize(env, 1UL * 1024UL * 1024UL * 1024UL));
+  REQUIRE(MDB_SUCCESS == mdb_env_open(env, CABINETNAME.c_str(), MDB_NOSUBDIR, 0600));
+
+  // Positions on a grid of 0.001 degrees around Gothenburg with two timeStamps each.
+  std::vector<std::pair<uint64_t, int64_t>> entries;
+  MDB_txn *txn{nullptr};
+  MDB_dbi dbi{0};
+  REQUIRE(MDB_SUCCESS == mdb_txn_begin(env, nullptr, 0, &txn));
+  REQUIRE(MDB_SUCCESS == mdb_dbi_open(txn, "19/0-morton", MDB_CREATE|MDB_DUPSORT|MDB_DUPFIXED, &dbi));
+  mdb_set_compare(txn, dbi, &compareMortonKeys);
+  mdb_set_dupsort(txn, dbi, &compareKeys);
+  for (int32_t lat{0}; lat < 200; lat++) {
+    for (int32_t lon{0}; lon < 200; lon++) {
+      const uint64_t morton{convertLatLonToMorton(std::make_pair(57.6f + static_cast<float>(lat) * 0.001f, 11.9f + static_cast<float>(lon) * 0.001f))};
+      for (const int64_t timeStamp : {lat * 1000 + lon, 1000000 + lat * 1000 + lon}) {
+        entries.emplace_back(morton, timeStamp);
+        uint64_t k{htobe64(morton)};
+        int64_t v{static_cast<int64_t>(htobe64(static_cast<uint64_t>(timeStamp)))};
+        MDB_val key{sizeof(k), &k};
+        MDB_val value{sizeof(v), &v};
+        REQUIRE(MDB_SUCCESS == mdb_put(txn, dbi, &key, &value, 0));
+      }
+    }
+  }
+  REQUIRE(MDB_SUCCESS == mdb_txn_commit(txn));
+  std::sort(entries.begin(), entries.end());
+
+  std::vector<std::array<double,2>> polygon{{{57.62, 11.91}}, {{57.78, 11.95}}, {{57.70, 12.00}}, {{57.75, 12.08}}, {{57.61, 12.05}}};
+  const std::vector<std::array<double,2>> polyline{{{57.61, 11.92}}, {{57.70, 12.02}}, {{57.65, 12.09}}};
+  const double WIDTH{0.0025};
+  auto planarOf = [](const uint64_t &morton) {
+    const auto XY = mortonDecode(morton);
+    return std::array<double,2>{{XY.first / 100000.0 - 90.0, XY.second / 100000.0 - 180.0}};
+  };
+  const auto box{convertLatLonBoxToMorton(std::make_pair(57.6f, 11.9f), std::make_pair(57.8f, 12.1f))};
+
+  REQUIRE(MDB_SUCCESS == mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn));
+  REQUIRE(MDB_SUCCESS == mdb_dbi_open(txn, "19/0-morton", 0, &dbi));
+  mdb_set_compare(txn, dbi, &compareMortonKeys);
+  mdb_set_dupsort(txn, dbi, &compareKeys);
+  MDB_cursor *cursor{nullptr};
+  REQUIRE(MDB_SUCCESS == mdb_cursor_open(txn, dbi, &cursor));
+  for (const bool IS_POLYGON : {true, false}) {
+    auto isIn = [&](const uint64_t &morton) {
+      std::array<double,2> p{planarOf(morton)};
+      return IS_POLYGON ? geofence::isIn(polygon, p) : geofence::isInCorridor(polyline, WIDTH, p);
+    };
+    const std::vector<MortonCell> cells{mortonCoverOf(box.first, box.second, [&](const uint64_t &bl, const uint64_t &tr) {
+      return IS_POLYGON ? geofence::overlapOfPolygon(polygon, planarOf(bl), planarOf(tr)) : geofence::overlapOfCorridor(polyline, WIDTH, planarOf(bl), planarOf(tr));
+    }, 256)};
+
+    std::vector<std::pair<uint64_t, int64_t>> expected;
+    for (const auto &e : entries) {
+      if (isIn(e.first)) {
+        expected.push_back(e);
+      }
+    }
+    REQUIRE(!expected.empty());
+
+    std::vector<std::pair<uint64_t, int64_t>> visited;
+    std::vector<int64_t> timeStamps;
+    const uint64_t SEEKS{mortonForEachInCells(cursor, cells, isIn, [&](const uint64_t &morton, const MDB_val &values) {
+      mortonTimeStampsOf(values, timeStamps);
+      for (const auto &timeStamp : timeStamps) {
+        visited.emplace_back(morton, timeStamp);
+      }
+    })};
+    REQUIRE(expected == visited);
+    REQUIRE(0 < SEEKS);
+    REQUIRE(SEEKS <= cells.size());
+  }
+  mdb_cursor_close(cursor);
+  mdb_txn_abort(txn);
+  mdb_env_close(env);
+
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+}
+
+TEST_CASE("Test visiting only the entries within an area and a time range") {
+  const int64_t HOUR{MORTON_TIME_BUCKET};
+  REQUIRE(0 == mortonBucketOf(HOUR - 1));
+  REQUIRE(1 == mortonBucketOf(HOUR));
+  REQUIRE(-1 == mortonBucketOf(-1));
+
+  // The keys are ordered by time bucket and then by Morton code with memcmp.
+  uint64_t a[2];
+  uint64_t b[2];
+  const int64_t BUCKETS[]{-1, 0, 1};
+  REQUIRE(0 > std::memcmp(mortonKeyOf(&BUCKETS[0], 7, a).mv_data, mortonKeyOf(&BUCKETS[1], 0, b).mv_data, 16));
+  REQUIRE(0 > std::memcmp(mortonKeyOf(&BUCKETS[2], 0, a).mv_data, mortonKeyOf(&BUCKETS[2], 1, b).mv_data, 16));
+  uint64_t morton{0};
+  REQUIRE(mortonFromKey(mortonKeyOf(&BUCKETS[2], 42, a), &BUCKETS[2], morton));
+  REQUIRE(42 == morton);
+  REQUIRE(!mortonFromKey(mortonKeyOf(&BUCKETS[2], 42, a), &BUCKETS[1], morton));
+
+  const std::string CABINETNAME{"tests-morton-time.cab"};
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+
+  MDB_env *env{nullptr};
+  REQUIRE(MDB_SUCCESS == mdb_env_create(&env));
+  REQUIRE(MDB_SUCCESS == mdb_env_set_maxdbs(env, 100));
+  REQUIRE(MDB_SUCCESS == mdb_env_set_mapsize(env, 1UL * 1024UL * 1024UL * 1024UL));
+  REQUIRE(MDB_SUCCESS == mdb_env_open(env, CABINETNAME.c_str(), MDB_NOSUBDIR, 0600));
+
+  // A vehicle driving back and forth on a grid of 0.001 degrees for 1000 hours with a pause in hours 300 to 599.
+  std::vector<std::pair<uint64_t, int64_t>> entries;
+  MDB_txn *txn{nullptr};
+  MDB_dbi dbi{0};
+  REQUIRE(MDB_SUCCESS == mdb_txn_begin(env, nullptr, 0, &txn));
+  REQUIRE(MDB_SUCCESS == mdb_dbi_open(txn, "19/0-morton-time", MDB_CREATE|MDB_DUPSORT|MDB_DUPFIXED, &dbi));
+  mdb_set_dupsort(txn, dbi, &compareKeys);
+  std::mt19937 rng(24);
+  std::uniform_int_distribution<int32_t> position(0, 99);
+  for (int64_t i{0}; i < 100000; i++) {
+    const int64_t timeStamp{i * 36L * 1000L * 1000L * 1000L - 10 * HOUR};
+    if ((300 * HOUR <= timeStamp) && (timeStamp < 600 * HOUR)) {
+      continue;
+    }
+    const uint64_t m{convertLatLonToMorton(std::make_pair(57.6f + static_cast<float>(position(rng)) * 0.001f, 11.9f + static_cast<float>(position(rng)) * 0.001f))};
+    entries.emplace_back(m, timeStamp);
+    const int64_t bucket{mortonBucketOf(timeStamp)};
+    uint64_t k[2];
+    MDB_val key{mortonKeyOf(&bucket, m, k)};
+    int64_t v{static_cast<int64_t>(htobe64(static_cast<uint64_t>(timeStamp)))};
+    MDB_val value{sizeof(v), &v};
+    REQUIRE(MDB_SUCCESS == mdb_put(txn, dbi, &key, &value, 0));
+  }
+  REQUIRE(MDB_SUCCESS == mdb_txn_commit(txn));
+
+  REQUIRE(MDB_SUCCESS == mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn));
+  REQUIRE(MDB_SUCCESS == mdb_dbi_open(txn, "19/0-morton-time", 0, &dbi));
+  mdb_set_dupsort(txn, dbi, &compareKeys);
+  MDB_cursor *cursor{nullptr};
+  REQUIRE(MDB_SUCCESS == mdb_cursor_open(txn, dbi, &cursor));
+  const auto box{convertLatLonBoxToMorton(std::make_pair(57.62f, 11.93f), std::make_pair(57.66f, 11.96f))};
+  std::vector<std::array<double,2>> polygon{{{57.62, 11.91}}, {{57.69, 11.95}}, {{57.61, 11.99}}};
+  auto planarOf = [](const uint64_t &m) {
+    const auto XY = mortonDecode(m);
+    return std::array<double,2>{{XY.first / 100000.0 - 90.0, XY.second / 100000.0 - 180.0}};
+  };
+  auto isInPolygon = [&polygon, &planarOf](const uint64_t &m) {
+    std::array<double,2> p{planarOf(m)};
+    return geofence::isIn(polygon, p);
+  };
+  const auto bounds{convertLatLonBoxToMorton(std::make_pair(57.60f, 11.90f), std::make_pair(57.70f, 12.00f))};
+  const std::vector<MortonCell> cells{mortonCoverOf(bounds.first, bounds.second, [&polygon, &planarOf](const uint64_t &bl, const uint64_t &tr) {
+    return geofence::overlapOfPolygon(polygon, planarOf(bl), planarOf(tr));
+  }, 256)};
+
+  for (const auto &range : {std::make_pair(-10 * HOUR, 1000 * HOUR), std::make_pair(100 * HOUR + 17, 101 * HOUR + 5), std::make_pair(250 * HOUR, 650 * HOUR), std::make_pair(350 * HOUR, 450 * HOUR), std::make_pair(-5 * HOUR - 1, -5 * HOUR)}) {
+    for (const bool IS_POLYGON : {false, true}) {
+      std::vector<std::pair<uint64_t, int64_t>> expected;
+      for (const auto &e : entries) {
+        const bool IN_AREA{IS_POLYGON ? isInPolygon(e.first) : mortonIsInBox(e.first, box.first, box.second)};
+        if (IN_AREA && (range.first <= e.second) && (e.second <= range.second)) {
+          expected.push_back(e);
+        }
+      }
+      std::sort(expected.begin(), expected.end());
+
+      std::vector<std::pair<uint64_t, int64_t>> visited;
+      std::vector<int64_t> timeStamps;
+      auto delegate = [&](const uint64_t &m, const MDB_val &values) {
+        mortonTimeStampsOf(values, timeStamps);
+        for (const auto &timeStamp : timeStamps) {
+          if ((range.first <= timeStamp) && (timeStamp <= range.second)) {
+            visited.emplace_back(m, timeStamp);
+          }
+        }
+      };
+      uint64_t buckets{0};
+      const uint64_t SEEKS{mortonForEachBucket(cursor, range.first, range.second, [&](const int64_t &bucket) {
+        buckets++;
+        return IS_POLYGON ? mortonForEachInCells(cursor, cells, isInPolygon, delegate, &bucket) : mortonForEachInBox(cursor, box.first, box.second, delegate, &bucket);
+      })};
+      std::sort(visited.begin(), visited.end());
+      REQUIRE(expected == visited);
+      // Only the buckets with entries in the range are scanned.
+      REQUIRE(buckets <= static_cast<uint64_t>(mortonBucketOf(range.second) - mortonBucketOf(range.first) + 1));
+      if (range.first == 350 * HOUR) {
+        REQUIRE(0 == buckets);
+        REQUIRE(1 == SEEKS);
+      }
+    }
+  }
+  mdb_cursor_close(cursor);
+  mdb_txn_abort(txn);
+  mdb_env_close(env);
+
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+}
+
+TEST_CASE("Test encode/decode along the Hilbert curve") {
+  // Consecutive Hilbert codes are neighbouring grid points.
+  for (uint64_t code{0}; code < 4096; code++) {
+    const auto A{hilbertDecode(code)};
+    const auto B{hilbertDecode(code + 1)};
+    REQUIRE(code == hilbertEncode(A));
+    const uint32_t DX{(A.first > B.first) ? A.first - B.first : B.first - A.first};
+    const uint32_t DY{(A.second > B.second) ? A.second - B.second : B.second - A.second};
+    REQUIRE(1 == DX + DY);
+  }
+
+  // The tables give the same codes as rotating the quadrants bit by bit.
+  auto reference = [](uint32_t x, uint32_t y) {
+    uint64_t code{0};
+    for (uint32_t s{1u << 31}; 0 < s; s >>= 1) {
+      const uint32_t RX{(0 != (x & s)) ? 1u : 0u};
+      const uint32_t RY{(0 != (y & s)) ? 1u : 0u};
+      code += static_cast<uint64_t>(s) * static_cast<uint64_t>(s) * ((3u * RX) ^ RY);
+      if (0 == RY) {
+        if (1 == RX) {
+          x = ~x;
+          y = ~y;
+        }
+        std::swap(x, y);
+      }
+    }
+    return code;
+  };
+  std::mt19937_64 rng(19);
+  for (uint32_t i{0}; i < 100000; i++) {
+    const std::pair<uint32_t,uint32_t> XY{static_cast<uint32_t>(rng()), static_cast<uint32_t>(rng())};
+    REQUIRE(reference(XY.first, XY.second) == hilbertEncode(XY));
+    REQUIRE(XY == hilbertDecode(hilbertEncode(XY)));
+  }
+  REQUIRE(0 == hilbertEncode(std::make_pair(0u, 0u)));
+  REQUIRE(std::make_pair(std::numeric_limits<uint32_t>::max(), 0u) == hilbertDecode(std::numeric_limits<uint64_t>::max()));
+
+  const std::pair<float,float> GOTHENBURG{57.7089f, 11.9746f};
+  REQUIRE(convertMortonToLatLon(convertLatLonToMorton(GOTHENBURG)) == convertHilbertToLatLon(convertLatLonToHilbert(GOTHENBURG)));
+
+  // Every cell of the quadtree is a single range of Hilbert codes.
+  for (const uint32_t LEVEL : {1u, 2u, 4u}) {
+    const uint32_t SIZE{1u << LEVEL};
+    for (uint32_t i{0}; i < 20; i++) {
+      const uint32_t X{static_cast<uint32_t>(rng()) & ~(SIZE - 1)};
+      const uint32_t Y{static_cast<uint32_t>(rng()) & ~(SIZE - 1)};
+      const uint64_t SPAN{(1ULL << (2 * LEVEL)) - 1};
+      const uint64_t FIRST{hilbertEncode(std::make_pair(X, Y)) & ~SPAN};
+      for (uint32_t dx{0}; dx < SIZE; dx++) {
+        for (uint32_t dy{0}; dy < SIZE; dy++) {
+          REQUIRE(FIRST == (hilbertEncode(std::make_pair(X + dx, Y + dy)) & ~SPAN));
+        }
+      }
+    }
+  }
+
+  REQUIRE(CURVE_MORTON == curveOfTable("19/0-morton"));
+  REQUIRE(CURVE_HILBERT == curveOfTable("19/2-hilbert-time"));
+  REQUIRE(CURVE_NONE == curveOfTable("19/0"));
+  REQUIRE(isCurveTimeTable("19/0-morton-time"));
+  REQUIRE(!isCurveTimeTable("19/0-hilbert"));
+  REQUIRE(!isCurveTimeTable("timeline-time"));
+}
+
+TEST_CASE("Test visiting only the entries within a geobox or polygon along the Hilbert curve") {
+  const std::string CABINETNAME{"tests-morton-hilbert.cab"};
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+
+  MDB_env *env{nullptr};
+  REQUIRE(MDB_SUCCESS == mdb_env_create(&env));
+  REQUIRE(MDB_SUCCESS == mdb_env_set_maxdbs(env, 100));
+  REQUIRE(MDB_SUCCESS == mdb_env_set_mapsize(env, 1UL * 1024UL * 1024UL * 1024UL));
+  REQUIRE(MDB_SUCCESS == mdb_env_open(env, CABINETNAME.c_str(), MDB_NOSUBDIR, 0600));
+
+  // Positions on a grid of 0.001 degrees around Gothenburg with two timeStamps each.
+  std::vector<std::pair<uint64_t, int64_t>> entries;
+  MDB_txn *txn{nullptr};
+  MDB_dbi dbi{0};
+  REQUIRE(MDB_SUCCESS == mdb_txn_begin(env, nullptr, 0, &txn));
+  REQUIRE(MDB_SUCCESS == mdb_dbi_open(txn, "19/0-hilbert", MDB_CREATE|MDB_DUPSORT|MDB_DUPFIXED, &dbi));
+  mdb_set_compare(txn, dbi, &compareMortonKeys);
+  mdb_set_dupsort(txn, dbi, &compareKeys);
+  for (int32_t lat{0}; lat < 200; lat++) {
+    for (int32_t lon{0}; lon < 200; lon++) {
+      const uint64_t code{convertLatLonToHilbert(std::make_pair(57.6f + static_cast<float>(lat) * 0.001f, 11.9f + static_cast<float>(lon) * 0.001f))};
+      for (const int64_t timeStamp : {lat * 1000 + lon, 1000000 + lat * 1000 + lon}) {
+        entries.emplace_back(code, timeStamp);
+        uint64_t k{htobe64(code)};
+        int64_t v{static_cast<int64_t>(htobe64(static_cast<uint64_t>(timeStamp)))};
+        MDB_val key{sizeof(k), &k};
+        MDB_val value{sizeof(v), &v};
+        REQUIRE(MDB_SUCCESS == mdb_put(txn, dbi, &key, &value, 0));
+      }
+    }
+  }
+  REQUIRE(MDB_SUCCESS == mdb_txn_commit(txn));
+  std::sort(entries.begin(), entries.end());
+
+  REQUIRE(MDB_SUCCESS == mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn));
+  REQUIRE(MDB_SUCCESS == mdb_dbi_open(txn, "19/0-hilbert", 0, &dbi));
+  mdb_set_compare(txn, dbi, &compareMortonKeys);
+  mdb_set_dupsort(txn, dbi, &compareKeys);
+  MDB_cursor *cursor{nullptr};
+  REQUIRE(MDB_SUCCESS == mdb_cursor_open(txn, dbi, &cursor));
+  std::vector<int64_t> timeStamps;
+  std::vector<std::pair<uint64_t, int64_t>> visited;
+  auto collect = [&](const uint64_t &code, const MDB_val &values) {
+    mortonTimeStampsOf(values, timeStamps);
+    for (const auto &timeStamp : timeStamps) {
+      visited.emplace_back(code, timeStamp);
+    }
+  };
+
+  for (const auto &corners : {std::make_pair(std::make_pair(57.65f, 11.95f), std::make_pair(57.66f, 11.97f)),
+                              std::make_pair(std::make_pair(57.7f, 12.05f), std::make_pair(57.6f, 11.9f)),
+                              std::make_pair(std::make_pair(57.6505f, 11.9505f), std::make_pair(57.6508f, 11.9508f))}) {
+    const auto box{convertLatLonBoxToMorton(corners.first, corners.second)};
+    std::vector<std::pair<uint64_t, int64_t>> expected;
+    for (const auto &e : entries) {
+      if (mortonIsInBox(mortonEncode(hilbertDecode(e.first)), box.first, box.second)) {
+        expected.push_back(e);
+      }
+    }
+    for (const std::size_t MAX_CELLS : {4, 64, 1024}) {
+      visited.clear();
+      const uint64_t SEEKS{hilbertForEachInBox(cursor, box.first, box.second, collect, nullptr, MAX_CELLS)};
+      REQUIRE(expected == visited);
+      REQUIRE(0 < SEEKS);
+    }
+  }
+
+  std::vector<std::array<double,2>> polygon{{{57.62, 11.91}}, {{57.78, 11.95}}, {{57.70, 12.00}}, {{57.75, 12.08}}, {{57.61, 12.05}}};
+  auto planarOf = [](const std::pair<uint32_t,uint32_t> &XY) {
+    return std::array<double,2>{{XY.first / 100000.0 - 90.0, XY.second / 100000.0 - 180.0}};
+  };
+  auto isIn = [&](const uint64_t &code) {
+    std::array<double,2> p{planarOf(hilbertDecode(code))};
+    return geofence::isIn(polygon, p);
+  };
+  const auto box{convertLatLonBoxToMorton(std::make_pair(57.6f, 11.9f), std::make_pair(57.8f, 12.1f))};
+  const std::vector<MortonCell> cells{hilbertCoverOf(box.first, box.second, [&](const uint64_t &bl, const uint64_t &tr) {
+    return geofence::overlapOfPolygon(polygon, planarOf(mortonDecode(bl)), planarOf(mortonDecode(tr)));
+  }, 256)};
+  for (std::size_t i{1}; i < cells.size(); i++) {
+    REQUIRE(cells.at(i - 1).last < cells.at(i).first);
+  }
+  std::vector<std::pair<uint64_t, int64_t>> expected;
+  for (const auto &e : entries) {
+    if (isIn(e.first)) {
+      expected.push_back(e);
+    }
+  }
+  REQUIRE(!expected.empty());
+  visited.clear();
+  const uint64_t SEEKS{mortonForEachInCells(cursor, cells, isIn, collect)};
+  REQUIRE(expected == visited);
+  REQUIRE(SEEKS <= cells.size());
+
+  mdb_cursor_close(cursor);
+  mdb_txn_abort(txn);
+  mdb_env_close(env);
+
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
 }
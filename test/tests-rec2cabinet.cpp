@@ -16,11 +16,19 @@
 #include "catch.hpp"
 #include "rec2cabinet.hpp"
 #include "cabinet2rec.hpp"
+#include "checkpoint.hpp"
+#include "duplicate-filter.hpp"
 #include "key.hpp"
+#include "rec-file-view.hpp"
+#include "rec-file-envelopes.hpp"
 
 #include "lmdb++.h"
 
+#include <sys/stat.h>
+
 #include <fstream>
+#include <random>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -208,7 +216,7 @@ TEST_CASE("Test rec2cabinet with lmdb++") {
 			1553249169860727000,
 			1553249169870727000,
 			1553249169874897000,
-			1553249169874897001,
+			1553249169874897000, // Same sampleTimeStamp as the Envelope before.
 			1553249169880727000,
 			1553249169890727000,
 			1553249169899412000,
@@ -242,3 +250,634 @@ TEST_CASE("Test rec2cabinet with lmdb++") {
   UNLINK(CABINETNAME_LOCK.c_str());
   UNLINK(REC2FILENAME.c_str());
 }
+
+TEST_CASE("Test rec2cabinet with batched commits matches per-Envelope commits") {
+  const bool VERBOSE{false};
+  const std::string RECFILENAME{"tests-rec2cabinet-batch.rec"};
+  const std::vector<std::string> CABINETNAMES{"tests-rec2cabinet-batch-1.cab", "tests-rec2cabinet-batch-4.cab", "tests-rec2cabinet-batch-0.cab", "tests-rec2cabinet-batch-bytes.cab"};
+  UNLINK(RECFILENAME.c_str());
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    rec.write(reinterpret_cast<const char*>(recfile), recfile_len);
+    rec.flush();
+    rec.close();
+  }
+  const uint64_t MEM{1};
+  cluon::In_Ranges<int64_t> ranges;
+  // Per-Envelope commits.
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAMES.at(0), 0, ranges, VERBOSE, 1, 0, 0));
+  // Commit every 4 Envelopes.
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAMES.at(1), 0, ranges, VERBOSE, 4, 0, 0));
+  // Commit once at the end.
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAMES.at(2), 0, ranges, VERBOSE, 0, 0, 0));
+  // Commit every 200 bytes; importing twice must skip all duplicates.
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAMES.at(3), 0, ranges, VERBOSE, 0, 200, 0));
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAMES.at(3), 0, ranges, VERBOSE, 0, 200, 0));
+  UNLINK(RECFILENAME.c_str());
+
+  // Dump all key/value pairs from all tables of a cabinet.
+  auto dumpCabinet = [MEM](const std::string &CABINETNAME) {
+    std::map<std::string, std::vector<std::pair<std::string, std::string>>> tables;
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    std::vector<std::string> tableNames;
+    {
+      auto dbi = lmdb::dbi::open(rotxn, nullptr);
+      auto cursor = lmdb::cursor::open(rotxn, dbi);
+      MDB_val key;
+      while (cursor.get(&key, MDB_NEXT)) {
+        tableNames.push_back(std::string(static_cast<char*>(key.mv_data), key.mv_size));
+      }
+      cursor.close();
+    }
+    for (auto t : tableNames) {
+      auto dbi = lmdb::dbi::open(rotxn, t.c_str());
+      dbi.set_compare(rotxn, &compareKeys);
+      auto cursor = lmdb::cursor::open(rotxn, dbi);
+      MDB_val key;
+      MDB_val value;
+      while (cursor.get(&key, &value, MDB_NEXT)) {
+        tables[t].push_back(std::make_pair(std::string(static_cast<char*>(key.mv_data), key.mv_size), std::string(static_cast<char*>(value.mv_data), value.mv_size)));
+      }
+      cursor.close();
+    }
+    rotxn.abort();
+    return tables;
+  };
+
+  bool failed{false};
+  try {
+    auto reference = dumpCabinet(CABINETNAMES.at(0));
+    REQUIRE(reference.count("all") == 1);
+    REQUIRE(19 == reference["all"].size());
+    REQUIRE(1 < reference.size());
+    // The catalog does not depend on the batches either.
+    REQUIRE(reference.count("catalog") == 1);
+    for (uint32_t i{1}; i < CABINETNAMES.size(); i++) {
+      auto tables = dumpCabinet(CABINETNAMES.at(i));
+      REQUIRE(tables.size() == reference.size());
+      for (auto t : reference) {
+        REQUIRE(tables.count(t.first) == 1);
+        REQUIRE(tables[t.first] == t.second);
+      }
+    }
+  }
+  catch (...) {
+    failed = true;
+  }
+  REQUIRE(!failed);
+
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+}
+
+TEST_CASE("Test DuplicateFilter considers colliding timeStamps") {
+  const std::string CABINETNAME{"tests-rec2cabinet-filter.cab"};
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+  auto env = lmdb::env::create();
+  env.set_mapsize(64UL * 1024UL * 1024UL);
+  env.set_max_dbs(10);
+  env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+  auto txn = lmdb::txn::begin(env);
+  auto dbi = lmdb::dbi::open(txn, "all", MDB_CREATE);
+  setKeyCompare(txn.handle(), dbi.handle(), KEY_LAYOUT_COMPARE_KEYS);
+  auto put = [&](const int64_t &timeStamp, const uint64_t &hash) {
+    cabinet::Key k;
+    k.timeStamp(timeStamp).hash(hash);
+    std::vector<char> _key(KEY_SIZE + 64);
+    MDB_val key{setKey(k, _key.data(), _key.size()), _key.data()};
+    MDB_val value{0, nullptr};
+    lmdb::dbi_put(txn, dbi, &key, &value, 0);
+  };
+  put(1000, 0x1234);
+  // Stored in the next free slot after a collision by earlier versions.
+  put(1001, 0x5678);
+  put(5000, 0x9999);
+
+  DuplicateFilter f;
+  REQUIRE(!f.mightContain(0x1234));
+  REQUIRE(2 == f.seed(txn.handle(), dbi.handle(), 0, 1000, KEY_LAYOUT_COMPARE_KEYS, 10));
+  REQUIRE(2 == f.size());
+  REQUIRE(f.mightContain(0x1234));
+  REQUIRE(f.mightContain(0x5678));
+  REQUIRE(!f.mightContain(0x9999));
+  f.insert(0x9999);
+  REQUIRE(f.mightContain(0x9999));
+
+  // Hits are confirmed with the table.
+  REQUIRE(DuplicateFilter::isStored(txn.handle(), dbi.handle(), 1000, 0x1234));
+  REQUIRE(DuplicateFilter::isStored(txn.handle(), dbi.handle(), 1000, 0x5678));
+  REQUIRE(!DuplicateFilter::isStored(txn.handle(), dbi.handle(), 1001, 0x1234));
+  REQUIRE(!DuplicateFilter::isStored(txn.handle(), dbi.handle(), 1000 - DuplicateFilter::MAX_COLLISIONS, 0x1234));
+  REQUIRE(!DuplicateFilter::isStored(txn.handle(), dbi.handle(), 1000, 0x9abc));
+  txn.abort();
+
+  // The memory is bounded and about one in a thousand unknown xxhashes needs to be confirmed.
+  DuplicateFilter large(1000UL * 1000UL * 1000UL);
+  REQUIRE(static_cast<uint64_t>(DuplicateFilter::MAX_BYTES) == large.bytes());
+  DuplicateFilter g(100000);
+  REQUIRE(g.bytes() <= 2 * 100000 * DuplicateFilter::BITS_PER_ENTRY / 8);
+  for (uint64_t i{0}; i < 100000; i++) {
+    g.insert(XXH64(&i, sizeof(i), 0));
+  }
+  uint64_t falsePositives{0};
+  for (uint64_t i{100000}; i < 200000; i++) {
+    falsePositives += g.mightContain(XXH64(&i, sizeof(i), 0)) ? 1 : 0;
+  }
+  REQUIRE(falsePositives < 500);
+
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+}
+
+TEST_CASE("Test RecFileView matches cluon::extractEnvelope") {
+  const std::string RECFILENAME{"tests-rec2cabinet-view.rec"};
+  UNLINK(RECFILENAME.c_str());
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    rec.write(reinterpret_cast<const char*>(recfile), recfile_len);
+    // Incomplete trailing Envelope must be ignored.
+    rec.write(reinterpret_cast<const char*>(recfile), 10);
+    rec.flush();
+    rec.close();
+  }
+
+  std::fstream recFile(RECFILENAME.c_str(), std::ios::in|std::ios::binary);
+  cluon::RecFileView recFileView(RECFILENAME);
+  REQUIRE(recFileView.good());
+  REQUIRE(recfile_len + 10 == recFileView.size());
+
+  uint32_t entries{0};
+  cluon::EnvelopeView e;
+  while (recFileView.next(e)) {
+    auto retVal = cluon::extractEnvelope(recFile);
+    REQUIRE(retVal.first);
+    cluon::data::Envelope env{std::move(retVal.second)};
+    REQUIRE(env.dataType() == e.dataType());
+    REQUIRE(env.senderStamp() == e.senderStamp());
+    REQUIRE(cluon::time::toMicroseconds(env.sampleTimeStamp()) == e.sampleTimeStamp());
+    const std::string s{cluon::serializeEnvelope(std::move(env))};
+    REQUIRE(s.size() == e.size());
+    REQUIRE(0 == std::memcmp(s.data(), e.data(), s.size()));
+    entries++;
+  }
+  REQUIRE(19 == entries);
+  REQUIRE(recfile_len == recFileView.position());
+
+  UNLINK(RECFILENAME.c_str());
+}
+
+TEST_CASE("Test rec2cabinet with different codecs") {
+  const bool VERBOSE{false};
+  const std::string RECFILENAME{"tests-rec2cabinet-codecs.rec"};
+  const std::string CABINETNAME{"tests-rec2cabinet-codecs.cab"};
+  const std::string CABINETNAME_LOCK{"tests-rec2cabinet-codecs.cab-lock"};
+  const std::string REC2FILENAME{"tests-rec2cabinet-codecs.rec2"};
+  UNLINK(RECFILENAME.c_str());
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    rec.write(reinterpret_cast<const char*>(recfile), recfile_len);
+    rec.flush();
+    rec.close();
+  }
+
+  for (auto spec : std::vector<std::string>{"none", "lz4", "lz4hc:3", "lz4,19=none"}) {
+    UNLINK(CABINETNAME.c_str());
+    UNLINK(CABINETNAME_LOCK.c_str());
+    UNLINK(REC2FILENAME.c_str());
+
+    codec::Selection codecs;
+    REQUIRE(codec::parse(spec, codecs));
+    cluon::In_Ranges<int64_t> ranges;
+    const uint64_t MEM{1};
+    REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAME, 0, ranges, VERBOSE, 0, 0, 0, codecs));
+    REQUIRE(0 == cabinet2rec("tests-rec2cabinet", MEM, CABINETNAME, REC2FILENAME, 0, std::numeric_limits<int64_t>::max(), VERBOSE));
+
+    std::fstream fin{REC2FILENAME.c_str(), std::ios::in|std::ios::binary};
+    REQUIRE(fin.good());
+    const std::string s{static_cast<std::stringstream const&>(std::stringstream() << fin.rdbuf()).str()};
+    REQUIRE(s.size() == recfile_len);
+    fin.close();
+
+    // Envelopes with the same sampleTimeStamp, dataType, and senderStamp are exported in the order of their hash.
+    REQUIRE(19 == envelopes(REC2FILENAME).size());
+    REQUIRE(envelopes(RECFILENAME) == envelopes(REC2FILENAME));
+  }
+
+  UNLINK(RECFILENAME.c_str());
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+  UNLINK(REC2FILENAME.c_str());
+}
+
+TEST_CASE("Test rec2cabinet with dictionaries for small Envelopes") {
+  const bool VERBOSE{false};
+  const std::string RECFILENAME{"tests-rec2cabinet-dict.rec"};
+  const std::vector<std::string> CABINETNAMES{"tests-rec2cabinet-nodict.cab", "tests-rec2cabinet-dict.cab"};
+  const std::string REC2FILENAME{"tests-rec2cabinet-dict.rec2"};
+  UNLINK(RECFILENAME.c_str());
+  UNLINK(REC2FILENAME.c_str());
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+
+  // Small Envelopes resembling a GPS trace: two doubles as payload.
+  std::string original;
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    for (uint32_t i{0}; i < 1000; i++) {
+      const double latitude{57.7 + i * 1e-5};
+      const double longitude{11.9 + i * 2e-5};
+      std::string payload{"\x09"};
+      payload.append(reinterpret_cast<const char*>(&latitude), sizeof(double));
+      payload.append("\x11");
+      payload.append(reinterpret_cast<const char*>(&longitude), sizeof(double));
+
+      cluon::data::Envelope e;
+      e.dataType(19).senderStamp(0).serializedData(payload).sampleTimeStamp(cluon::time::fromMicroseconds(1600000000000000L + i * 100000L));
+      const std::string s{cluon::serializeEnvelope(std::move(e))};
+      original += s;
+      rec.write(s.data(), s.size());
+    }
+    rec.flush();
+    rec.close();
+  }
+
+  const uint64_t MEM{1};
+  cluon::In_Ranges<int64_t> ranges;
+  codec::Selection withoutDictionary;
+  REQUIRE(codec::parse("lz4hc", withoutDictionary));
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAMES.at(0), 0, ranges, VERBOSE, 0, 0, 0, withoutDictionary));
+  codec::Selection withDictionary;
+  REQUIRE(codec::parse("lz4hc,19=lz4hcdict", withDictionary));
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAMES.at(1), 0, ranges, VERBOSE, 0, 0, 0, withDictionary));
+  // Importing again reuses the stored dictionary.
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAMES.at(1), 0, ranges, VERBOSE, 0, 0, 0, withDictionary));
+  UNLINK(RECFILENAME.c_str());
+
+  // Sum of the sizes of all stored values.
+  auto storedBytes = [MEM](const std::string &CABINETNAME, uint64_t &numberOfDictionaries) {
+    uint64_t bytes{0};
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    auto dbAll = lmdb::dbi::open(rotxn, "all");
+    dbAll.set_compare(rotxn, &compareKeys);
+    auto cursor = lmdb::cursor::open(rotxn, dbAll);
+    MDB_val key;
+    MDB_val value;
+    while (cursor.get(&key, &value, MDB_NEXT)) {
+      bytes += value.mv_size;
+    }
+    cursor.close();
+    codec::Dictionaries dictionaries;
+    REQUIRE(dictionaries.load(rotxn.handle()));
+    numberOfDictionaries = dictionaries.size();
+    rotxn.abort();
+    return bytes;
+  };
+  uint64_t numberOfDictionaries{0};
+  const uint64_t BYTES_WITHOUT_DICTIONARY{storedBytes(CABINETNAMES.at(0), numberOfDictionaries)};
+  REQUIRE(0 == numberOfDictionaries);
+  const uint64_t BYTES_WITH_DICTIONARY{storedBytes(CABINETNAMES.at(1), numberOfDictionaries)};
+  REQUIRE(1 == numberOfDictionaries);
+  REQUIRE(BYTES_WITH_DICTIONARY < BYTES_WITHOUT_DICTIONARY);
+
+  REQUIRE(0 == cabinet2rec("tests-rec2cabinet", MEM, CABINETNAMES.at(1), REC2FILENAME, 0, std::numeric_limits<int64_t>::max(), VERBOSE));
+  {
+    std::fstream fin{REC2FILENAME.c_str(), std::ios::in|std::ios::binary};
+    REQUIRE(fin.good());
+    const std::string s{static_cast<std::stringstream const&>(std::stringstream() << fin.rdbuf()).str()};
+    REQUIRE(original == s);
+  }
+
+  UNLINK(REC2FILENAME.c_str());
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+}
+
+TEST_CASE("Test rec2cabinet resumes at the last checkpoint") {
+  const bool VERBOSE{false};
+  const std::string RECFILENAME{"tests-rec2cabinet-resume.rec"};
+  const std::vector<std::string> CABINETNAMES{"tests-rec2cabinet-resume-complete.cab", "tests-rec2cabinet-resume.cab", "tests-rec2cabinet-resume-replaced.cab"};
+  UNLINK(RECFILENAME.c_str());
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+
+  // Offset after the first 10 Envelopes.
+  uint64_t offset{0};
+  {
+    const std::string TMP{"tests-rec2cabinet-resume.tmp"};
+    std::fstream rec(TMP.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    rec.write(reinterpret_cast<const char*>(recfile), recfile_len);
+    rec.close();
+    cluon::RecFileView recFile(TMP);
+    cluon::EnvelopeView e;
+    for (uint32_t i{0}; (i < 10) && recFile.next(e); i++) {}
+    offset = recFile.position();
+    UNLINK(TMP.c_str());
+  }
+  REQUIRE(0 < offset);
+  REQUIRE(offset < recfile_len);
+
+  const uint64_t MEM{1};
+  cluon::In_Ranges<int64_t> ranges;
+  auto writeRecFile = [&RECFILENAME](const uint64_t &length) {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    rec.write(reinterpret_cast<const char*>(recfile), length);
+    rec.flush();
+    rec.close();
+  };
+  auto loadCheckpoint = [MEM, &RECFILENAME](const std::string &CABINETNAME) {
+    Checkpoint checkpoint;
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    REQUIRE(checkpoint.load(rotxn.handle(), XXH32(RECFILENAME.c_str(), RECFILENAME.size(), 0)));
+    rotxn.abort();
+    return checkpoint;
+  };
+
+  // Reference: Complete import.
+  writeRecFile(recfile_len);
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAMES.at(0), 0, ranges, VERBOSE, 4, 0, 0));
+  Checkpoint checkpoint{loadCheckpoint(CABINETNAMES.at(0))};
+  REQUIRE(checkpoint.isComplete());
+  REQUIRE(recfile_len == checkpoint.offset);
+  REQUIRE(19 == checkpoint.envelopes);
+
+  // Import that stopped after 10 Envelopes, then resumed on the complete file.
+  writeRecFile(offset);
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAMES.at(1), 0, ranges, VERBOSE, 4, 0, 0));
+  checkpoint = loadCheckpoint(CABINETNAMES.at(1));
+  REQUIRE(offset == checkpoint.offset);
+  REQUIRE(10 == checkpoint.envelopes);
+  writeRecFile(recfile_len);
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAMES.at(1), 0, ranges, VERBOSE, 4, 0, 0, codec::Selection(), true));
+  checkpoint = loadCheckpoint(CABINETNAMES.at(1));
+  REQUIRE(checkpoint.isComplete());
+  REQUIRE(19 == checkpoint.envelopes);
+  // Resuming a complete import does not read any Envelope.
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAMES.at(1), 0, ranges, VERBOSE, 4, 0, 0, codec::Selection(), true));
+  checkpoint = loadCheckpoint(CABINETNAMES.at(1));
+  REQUIRE(checkpoint.isComplete());
+  REQUIRE(19 == checkpoint.envelopes);
+  UNLINK(RECFILENAME.c_str());
+
+  // Both cabinets have the same content.
+  auto dumpAll = [MEM](const std::string &CABINETNAME) {
+    std::vector<std::pair<std::string, std::string>> entries;
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    auto dbi = lmdb::dbi::open(rotxn, "all");
+    dbi.set_compare(rotxn, &compareKeys);
+    auto cursor = lmdb::cursor::open(rotxn, dbi);
+    MDB_val key;
+    MDB_val value;
+    while (cursor.get(&key, &value, MDB_NEXT)) {
+      entries.push_back(std::make_pair(std::string(static_cast<char*>(key.mv_data), key.mv_size), std::string(static_cast<char*>(value.mv_data), value.mv_size)));
+    }
+    cursor.close();
+    rotxn.abort();
+    return entries;
+  };
+  const auto REFERENCE{dumpAll(CABINETNAMES.at(0))};
+  REQUIRE(19 == REFERENCE.size());
+  REQUIRE(REFERENCE == dumpAll(CABINETNAMES.at(1)));
+
+  // A .rec file that is smaller than at the last checkpoint was replaced and is imported from its beginning.
+  {
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAMES.at(2).c_str(), MDB_NOSUBDIR, 0600);
+    auto wtxn = lmdb::txn::begin(env);
+    Checkpoint c;
+    c.offset = offset;
+    c.envelopes = 10;
+    c.fileSize = recfile_len + 1;
+    REQUIRE(MDB_SUCCESS == c.store(wtxn.handle(), XXH32(RECFILENAME.c_str(), RECFILENAME.size(), 0)));
+    wtxn.commit();
+  }
+  writeRecFile(recfile_len);
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAMES.at(2), 0, ranges, VERBOSE, 4, 0, 0, codec::Selection(), true));
+  UNLINK(RECFILENAME.c_str());
+  checkpoint = loadCheckpoint(CABINETNAMES.at(2));
+  REQUIRE(checkpoint.isComplete());
+  REQUIRE(recfile_len == checkpoint.fileSize);
+  REQUIRE(19 == checkpoint.envelopes);
+  REQUIRE(REFERENCE == dumpAll(CABINETNAMES.at(2)));
+
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+}
+
+TEST_CASE("Test rec2cabinet with values inline in keys") {
+  const bool VERBOSE{false};
+  const std::string RECFILENAME{"tests-rec2cabinet-inline.rec"};
+  const std::string CABINETNAME{"tests-rec2cabinet-inline.cab"};
+  const std::string CABINETNAME_LOCK{"tests-rec2cabinet-inline.cab-lock"};
+  const std::string REC2FILENAME{"tests-rec2cabinet-inline.rec2"};
+  UNLINK(RECFILENAME.c_str());
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    rec.write(reinterpret_cast<const char*>(recfile), recfile_len);
+    rec.flush();
+    rec.close();
+  }
+
+  // Values of up to 57 bytes are inline, the larger ones are not.
+  for (auto layout : {KEY_LAYOUT_COMPARE_KEYS, KEY_LAYOUT_MEMCMP}) {
+    UNLINK(CABINETNAME.c_str());
+    UNLINK(CABINETNAME_LOCK.c_str());
+    UNLINK(REC2FILENAME.c_str());
+
+    cluon::In_Ranges<int64_t> ranges;
+    const uint64_t MEM{1};
+    REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAME, 0, ranges, VERBOSE, 0, 0, 0, codec::Selection(), false, layout, 57));
+    REQUIRE(0 == cabinet2rec("tests-rec2cabinet", MEM, CABINETNAME, REC2FILENAME, 0, std::numeric_limits<int64_t>::max(), VERBOSE));
+
+    uint32_t inlineValues{0};
+    uint32_t values{0};
+    {
+      auto env = lmdb::env::create();
+      env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+      env.set_max_dbs(100);
+      env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+      auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+      auto dbAll = lmdb::dbi::open(rotxn, "all");
+      auto cursor = lmdb::cursor::open(rotxn, dbAll);
+      MDB_val key;
+      MDB_val value;
+      while (cursor.get(&key, &value, MDB_NEXT)) {
+        const bool INLINE{0 != (keyVersion(static_cast<char*>(key.mv_data)) & KEY_INLINE_VALUE)};
+        REQUIRE(layout == keyLayout(static_cast<char*>(key.mv_data)));
+        REQUIRE((INLINE ? (KEY_SIZE < key.mv_size) : (KEY_SIZE == key.mv_size)));
+        REQUIRE(INLINE == (0 == value.mv_size));
+        REQUIRE(0 < storedValueOf(key, value).mv_size);
+        inlineValues += INLINE ? 1 : 0;
+        values += INLINE ? 0 : 1;
+      }
+      cursor.close();
+
+      // Tables per stream contain only the fixed fields.
+      auto dbStream = lmdb::dbi::open(rotxn, "19/0");
+      auto streamCursor = lmdb::cursor::open(rotxn, dbStream);
+      uint32_t streamEntries{0};
+      while (streamCursor.get(&key, &value, MDB_NEXT)) {
+        REQUIRE(KEY_SIZE == key.mv_size);
+        streamEntries++;
+      }
+      streamCursor.close();
+      REQUIRE(0 < streamEntries);
+      rotxn.abort();
+    }
+    REQUIRE(0 < inlineValues);
+    REQUIRE(0 < values);
+    REQUIRE(19 == inlineValues + values);
+
+    // The exported Envelopes are the same as without inline values.
+    REQUIRE(envelopes(RECFILENAME) == envelopes(REC2FILENAME));
+  }
+
+  UNLINK(RECFILENAME.c_str());
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+  UNLINK(REC2FILENAME.c_str());
+}
+
+TEST_CASE("Test rec2cabinet stores large values in the blob file") {
+  const bool VERBOSE{false};
+  const uint64_t MEM{1};
+  const std::string RECFILENAME{"tests-rec2cabinet-blobs.rec"};
+  const std::string CABINETNAME{"tests-rec2cabinet-blobs.cab"};
+  const std::string REC2FILENAME{"tests-rec2cabinet-blobs.rec2"};
+  const std::vector<std::string> FILES{CABINETNAME, CABINETNAME + "-lock", blobs::fileOf(CABINETNAME), REC2FILENAME};
+  auto sizeOf = [](const std::string &filename) {
+    struct stat s;
+    return (0 == ::stat(filename.c_str(), &s)) ? static_cast<uint64_t>(s.st_size) : 0;
+  };
+
+  // Incompressible frames of 8kB between small Envelopes.
+  const std::size_t FRAME_SIZE{8 * 1024};
+  std::mt19937 rng(7);
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    for (int64_t i{0}; i < 50; i++) {
+      cluon::data::Envelope e;
+      std::string payload{std::to_string(i)};
+      if (0 == (i % 5)) {
+        payload.resize(FRAME_SIZE);
+        for (auto &c : payload) {
+          c = static_cast<char>(rng());
+        }
+      }
+      e.dataType((0 == (i % 5)) ? 1055 : 19).senderStamp(0).serializedData(payload).sampleTimeStamp(cluon::time::fromMicroseconds(1600000000000000L + i * 10000L));
+      const std::string str{cluon::serializeEnvelope(std::move(e))};
+      rec.write(str.data(), str.size());
+    }
+  }
+
+  for (auto f : FILES) {
+    UNLINK(f.c_str());
+  }
+  // The values are synced to the blob file with each batch of 10 Envelopes.
+  cluon::In_Ranges<int64_t> ranges;
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAME, 0, ranges, VERBOSE, 10, 0, 0, codec::Selection(), false, KEY_LAYOUT_COMPARE_KEYS, 0, false, 4096));
+  const uint64_t BLOBS_SIZE{sizeOf(blobs::fileOf(CABINETNAME))};
+  REQUIRE(10 * FRAME_SIZE < BLOBS_SIZE);
+  REQUIRE(11 * FRAME_SIZE > BLOBS_SIZE);
+  // Importing again neither stores the duplicates nor their values.
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAME, 0, ranges, VERBOSE, 10, 0, 0, codec::Selection(), false, KEY_LAYOUT_COMPARE_KEYS, 0, false, 4096));
+  REQUIRE(BLOBS_SIZE == sizeOf(blobs::fileOf(CABINETNAME)));
+
+  REQUIRE(0 == cabinet2rec("tests-rec2cabinet", MEM, CABINETNAME, REC2FILENAME, 0, std::numeric_limits<int64_t>::max(), VERBOSE));
+  REQUIRE(envelopes(RECFILENAME) == envelopes(REC2FILENAME));
+
+  for (auto f : FILES) {
+    UNLINK(f.c_str());
+  }
+  UNLINK(RECFILENAME.c_str());
+}
+
+TEST_CASE("Test rec2cabinet refuses to import into a packed cabinet") {
+  const bool VERBOSE{false};
+  const std::string RECFILENAME{"tests-rec2cabinet-packed.rec"};
+  const std::string CABINETNAME{"tests-rec2cabinet-packed.cab"};
+  const std::string CABINETNAME_LOCK{"tests-rec2cabinet-packed.cab-lock"};
+  UNLINK(RECFILENAME.c_str());
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    rec.write(reinterpret_cast<const char*>(recfile), recfile_len);
+    rec.flush();
+    rec.close();
+  }
+  const uint64_t MEM{1};
+
+  // A block key holds the last timeStamp in hash and the number of Envelopes in hashOfRecFile.
+  {
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+    auto txn = lmdb::txn::begin(env);
+    clustered::Store store(blobs::fileOf(CABINETNAME), KEY_LAYOUT_COMPARE_KEYS, false);
+    REQUIRE(MDB_SUCCESS == store.begin(txn.handle()));
+    const std::string value{"block"};
+    cabinet::Key k;
+    k.timeStamp(1600000000000000000L)
+     .dataType(19)
+     .senderStamp(0)
+     .hash(1600000001000000000UL)
+     .hashOfRecFile(2)
+     .length(static_cast<uint16_t>(value.size()))
+     .version(codec::version(KEY_LAYOUT_COMPARE_KEYS, codec::NONE) | KEY_BLOCK);
+    REQUIRE(MDB_SUCCESS == store.put(txn.handle(), k, value.data(), value.size(), value.size()));
+    REQUIRE(MDB_SUCCESS == store.flush(txn.handle()));
+    txn.commit();
+  }
+
+  cluon::In_Ranges<int64_t> ranges;
+  REQUIRE(1 == rec2cabinet("tests-rec2cabinet", MEM, RECFILENAME, CABINETNAME, 0, ranges, VERBOSE));
+  {
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    auto dbAll = lmdb::dbi::open(rotxn, "all");
+    REQUIRE(1 == dbAll.size(rotxn));
+    rotxn.abort();
+  }
+
+  UNLINK(RECFILENAME.c_str());
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+}
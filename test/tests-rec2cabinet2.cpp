@@ -16,11 +16,18 @@
 #include "catch.hpp"
 #include "rec2cabinet2.hpp"
 #include "cabinet2rec.hpp"
+#include "clustered.hpp"
 #include "key.hpp"
+#include "rec-file-envelopes.hpp"
 
 #include "lmdb++.h"
+#include "xxhash.h"
+
+#include <sys/stat.h>
 
 #include <fstream>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -208,7 +215,7 @@ TEST_CASE("Test rec2cabinet with lmdb++") {
 			1553249169860727000,
 			1553249169870727000,
 			1553249169874897000,
-			1553249169874897001,
+			1553249169874897000, // Same sampleTimeStamp as the Envelope before.
 			1553249169880727000,
 			1553249169890727000,
 			1553249169899412000,
@@ -242,3 +249,343 @@ TEST_CASE("Test rec2cabinet with lmdb++") {
   UNLINK(CABINETNAME_LOCK.c_str());
   UNLINK(REC2FILENAME.c_str());
 }
+
+TEST_CASE("Test rec2cabinet with several worker threads matches one worker thread") {
+  const bool VERBOSE{false};
+  const std::string RECFILENAME{"tests-rec2cabinet2-threads.rec"};
+  const std::vector<std::string> CABINETNAMES{"tests-rec2cabinet2-threads-1.cab", "tests-rec2cabinet2-threads-3.cab", "tests-rec2cabinet2-threads-8.cab"};
+  const std::vector<uint32_t> THREADS{1, 3, 8};
+  UNLINK(RECFILENAME.c_str());
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+  {
+    // Repeat the recording to have more Envelopes than fit into the queues.
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    for (uint32_t i{0}; i < 60; i++) {
+      rec.write(reinterpret_cast<const char*>(recfile), recfile_len);
+    }
+    rec.flush();
+    rec.close();
+  }
+  const uint64_t MEM{1};
+  cluon::In_Ranges<int64_t> ranges;
+  for (uint32_t i{0}; i < CABINETNAMES.size(); i++) {
+    REQUIRE(0 == rec2cabinet("tests-rec2cabinet2", MEM, RECFILENAME, CABINETNAMES.at(i), 0, ranges, VERBOSE, THREADS.at(i)));
+  }
+  UNLINK(RECFILENAME.c_str());
+
+  // Dump all key/value pairs from all tables of a cabinet.
+  auto dumpCabinet = [MEM](const std::string &CABINETNAME) {
+    std::map<std::string, std::vector<std::pair<std::string, std::string>>> tables;
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    std::vector<std::string> tableNames;
+    {
+      auto dbi = lmdb::dbi::open(rotxn, nullptr);
+      auto cursor = lmdb::cursor::open(rotxn, dbi);
+      MDB_val key;
+      while (cursor.get(&key, MDB_NEXT)) {
+        tableNames.push_back(std::string(static_cast<char*>(key.mv_data), key.mv_size));
+      }
+      cursor.close();
+    }
+    for (auto t : tableNames) {
+      auto dbi = lmdb::dbi::open(rotxn, t.c_str());
+      dbi.set_compare(rotxn, &compareKeys);
+      auto cursor = lmdb::cursor::open(rotxn, dbi);
+      MDB_val key;
+      MDB_val value;
+      while (cursor.get(&key, &value, MDB_NEXT)) {
+        tables[t].push_back(std::make_pair(std::string(static_cast<char*>(key.mv_data), key.mv_size), std::string(static_cast<char*>(value.mv_data), value.mv_size)));
+      }
+      cursor.close();
+    }
+    rotxn.abort();
+    return tables;
+  };
+
+  bool failed{false};
+  try {
+    auto reference = dumpCabinet(CABINETNAMES.at(0));
+    REQUIRE(reference.count("all") == 1);
+    // The repetitions of the recording are skipped as duplicates.
+    REQUIRE(19 == reference["all"].size());
+    for (uint32_t i{1}; i < CABINETNAMES.size(); i++) {
+      auto tables = dumpCabinet(CABINETNAMES.at(i));
+      REQUIRE(tables.size() == reference.size());
+      for (auto t : reference) {
+        REQUIRE(tables.count(t.first) == 1);
+        REQUIRE(tables[t.first] == t.second);
+      }
+    }
+  }
+  catch (...) {
+    failed = true;
+  }
+  REQUIRE(!failed);
+
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+}
+
+TEST_CASE("Test rec2cabinet appends time-ordered Envelopes and falls back for out-of-order Envelopes") {
+  const bool VERBOSE{false};
+  const std::vector<std::string> RECFILENAMES{"tests-rec2cabinet2-append-1.rec", "tests-rec2cabinet2-append-2.rec"};
+  const std::string CABINETNAME{"tests-rec2cabinet2-append.cab"};
+  const std::string CABINETNAME_LOCK{"tests-rec2cabinet2-append.cab-lock"};
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+
+  // The second recording overlaps the first one in time.
+  const std::vector<int64_t> FIRST_TIMESTAMP{0, 500 * 100000L + 50000L};
+  for (uint32_t f{0}; f < RECFILENAMES.size(); f++) {
+    std::fstream rec(RECFILENAMES.at(f).c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    for (uint32_t i{0}; i < 1000; i++) {
+      cluon::data::Envelope e;
+      e.dataType(19).senderStamp(i % 2).serializedData(std::to_string(f) + "/" + std::to_string(i)).sampleTimeStamp(cluon::time::fromMicroseconds(1600000000000000L + FIRST_TIMESTAMP.at(f) + i * 100000L));
+      const std::string s{cluon::serializeEnvelope(std::move(e))};
+      rec.write(s.data(), s.size());
+    }
+    rec.flush();
+    rec.close();
+  }
+
+  const uint64_t MEM{1};
+  cluon::In_Ranges<int64_t> ranges;
+  for (auto r : RECFILENAMES) {
+    REQUIRE(0 == rec2cabinet("tests-rec2cabinet2", MEM, r, CABINETNAME, 0, ranges, VERBOSE, 2));
+  }
+  // Importing again does not add any Envelope.
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet2", MEM, RECFILENAMES.at(1), CABINETNAME, 0, ranges, VERBOSE, 2));
+  for (auto r : RECFILENAMES) {
+    UNLINK(r.c_str());
+  }
+
+  bool failed{false};
+  try {
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+
+    // Count keys per table and make sure that they are strictly ordered.
+    auto countOrderedKeys = [&rotxn](const std::string &table) {
+      auto dbi = lmdb::dbi::open(rotxn, table.c_str());
+      dbi.set_compare(rotxn, &compareKeys);
+      auto cursor = lmdb::cursor::open(rotxn, dbi);
+      uint64_t count{0};
+      int64_t lastTimeStamp{std::numeric_limits<int64_t>::min()};
+      MDB_val key;
+      while (cursor.get(&key, MDB_NEXT)) {
+        const int64_t TIMESTAMP{getKey(static_cast<char*>(key.mv_data), key.mv_size).timeStamp()};
+        REQUIRE(lastTimeStamp < TIMESTAMP);
+        lastTimeStamp = TIMESTAMP;
+        count++;
+      }
+      cursor.close();
+      return count;
+    };
+    REQUIRE(2000 == countOrderedKeys("all"));
+    REQUIRE(1000 == countOrderedKeys("19/0"));
+    REQUIRE(1000 == countOrderedKeys("19/1"));
+    rotxn.abort();
+  }
+  catch (...) {
+    failed = true;
+  }
+  REQUIRE(!failed);
+
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+}
+
+TEST_CASE("Test rec2cabinet imports several .rec files into one cabinet") {
+  const bool VERBOSE{false};
+  const std::string DIRECTORY{"tests-rec2cabinet2-multi"};
+  const std::vector<std::string> RECFILENAMES{DIRECTORY + "/c.rec", DIRECTORY + "/a.rec", DIRECTORY + "/b.rec"};
+  const std::string RECFILENAME{"tests-rec2cabinet2-multi.rec"};
+  const std::vector<std::string> CABINETNAMES{"tests-rec2cabinet2-multi-directory.cab", "tests-rec2cabinet2-multi-list.cab", "tests-rec2cabinet2-multi-single.cab"};
+  ::mkdir(DIRECTORY.c_str(), 0700);
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+
+  // Interleave the Envelopes over the .rec files; the single file contains all of them.
+  {
+    std::fstream single(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    std::vector<std::unique_ptr<std::fstream>> recs;
+    for (auto r : RECFILENAMES) {
+      recs.emplace_back(new std::fstream(r.c_str(), std::ios::out|std::ios::binary|std::ios::trunc));
+    }
+    for (uint32_t i{0}; i < 3000; i++) {
+      cluon::data::Envelope e;
+      e.dataType(19 + static_cast<int32_t>(i % 2)).senderStamp(0).serializedData(std::to_string(i)).sampleTimeStamp(cluon::time::fromMicroseconds(1600000000000000L + i * 1000L));
+      const std::string s{cluon::serializeEnvelope(std::move(e))};
+      recs[i % recs.size()]->write(s.data(), s.size());
+      single.write(s.data(), s.size());
+    }
+  }
+
+  const std::vector<std::string> RECS{listRecFiles(DIRECTORY)};
+  REQUIRE(3 == RECS.size());
+  REQUIRE(RECFILENAMES.at(1) == RECS.at(0));
+  REQUIRE(RECFILENAMES.at(2) == RECS.at(1));
+  REQUIRE(RECFILENAMES.at(0) == RECS.at(2));
+  REQUIRE(RECFILENAMES == listRecFiles(RECFILENAMES.at(0) + "," + RECFILENAMES.at(1) + "," + RECFILENAMES.at(2)));
+
+  const uint64_t MEM{1};
+  cluon::In_Ranges<int64_t> ranges;
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet2", MEM, RECS, CABINETNAMES.at(0), 0, ranges, VERBOSE, 4));
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet2", MEM, RECFILENAMES, CABINETNAMES.at(1), 0, ranges, VERBOSE, 2));
+  REQUIRE(0 == rec2cabinet("tests-rec2cabinet2", MEM, RECFILENAME, CABINETNAMES.at(2), 0, ranges, VERBOSE, 1));
+  // Missing files are reported but the others are imported.
+  REQUIRE(1 == rec2cabinet("tests-rec2cabinet2", MEM, std::vector<std::string>{"tests-rec2cabinet2-missing.rec", RECFILENAME}, CABINETNAMES.at(2), 0, ranges, VERBOSE, 1));
+  for (auto r : RECFILENAMES) {
+    UNLINK(r.c_str());
+  }
+  UNLINK(RECFILENAME.c_str());
+  ::rmdir(DIRECTORY.c_str());
+
+  // Collect timeStamp and value per key in "all" and the hashes of the .rec files.
+  auto dumpAll = [MEM](const std::string &CABINETNAME, std::set<uint32_t> &hashesOfRecFiles) {
+    std::map<int64_t, std::string> entries;
+    auto env = lmdb::env::create();
+    env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+    auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    auto dbi = lmdb::dbi::open(rotxn, "all");
+    dbi.set_compare(rotxn, &compareKeys);
+    auto cursor = lmdb::cursor::open(rotxn, dbi);
+    MDB_val key;
+    MDB_val value;
+    while (cursor.get(&key, &value, MDB_NEXT)) {
+      cabinet::Key k = getKey(static_cast<char*>(key.mv_data), key.mv_size);
+      entries[k.timeStamp()] = std::string(static_cast<char*>(value.mv_data), value.mv_size);
+      hashesOfRecFiles.insert(k.hashOfRecFile());
+    }
+    cursor.close();
+    rotxn.abort();
+    return entries;
+  };
+
+  bool failed{false};
+  try {
+    std::set<uint32_t> hashesOfRecFiles;
+    auto reference = dumpAll(CABINETNAMES.at(2), hashesOfRecFiles);
+    REQUIRE(3000 == reference.size());
+    REQUIRE(1 == hashesOfRecFiles.size());
+    for (uint32_t i{0}; i < 2; i++) {
+      hashesOfRecFiles.clear();
+      REQUIRE(reference == dumpAll(CABINETNAMES.at(i), hashesOfRecFiles));
+      REQUIRE(3 == hashesOfRecFiles.size());
+      for (auto r : RECFILENAMES) {
+        REQUIRE(1 == hashesOfRecFiles.count(XXH32(r.c_str(), r.size(), 0)));
+      }
+    }
+  }
+  catch (...) {
+    failed = true;
+  }
+  REQUIRE(!failed);
+
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+}
+
+TEST_CASE("Test rec2cabinet stores the values per stream in a clustered cabinet") {
+  const bool VERBOSE{false};
+  const std::string RECFILENAME{"tests-rec2cabinet2-clustered.rec"};
+  const std::string CABINETNAME{"tests-rec2cabinet2-clustered.cab"};
+  const std::string CABINETNAME_LOCK{"tests-rec2cabinet2-clustered.cab-lock"};
+  const std::string REC2FILENAME{"tests-rec2cabinet2-clustered.rec2"};
+  UNLINK(RECFILENAME.c_str());
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    rec.write(reinterpret_cast<const char*>(recfile), recfile_len);
+    rec.flush();
+    rec.close();
+  }
+
+  // Values of up to 57 bytes are inline in the keys of the stream tables.
+  for (auto layout : {KEY_LAYOUT_COMPARE_KEYS, KEY_LAYOUT_MEMCMP}) {
+    UNLINK(CABINETNAME.c_str());
+    UNLINK(CABINETNAME_LOCK.c_str());
+    UNLINK(REC2FILENAME.c_str());
+
+    cluon::In_Ranges<int64_t> ranges;
+    const uint64_t MEM{1};
+    REQUIRE(0 == rec2cabinet("tests-rec2cabinet2", MEM, RECFILENAME, CABINETNAME, 0, ranges, VERBOSE, 2, codec::Selection(), layout, 57, true));
+    // An existing clustered cabinet stays clustered and duplicates are still detected.
+    REQUIRE(0 == rec2cabinet("tests-rec2cabinet2", MEM, RECFILENAME, CABINETNAME, 0, ranges, VERBOSE, 2, codec::Selection(), layout, 57, false));
+    REQUIRE(0 == cabinet2rec("tests-rec2cabinet2", MEM, CABINETNAME, REC2FILENAME, 0, std::numeric_limits<int64_t>::max(), VERBOSE));
+    REQUIRE(envelopes(RECFILENAME) == envelopes(REC2FILENAME));
+
+    {
+      auto env = lmdb::env::create();
+      env.set_mapsize(MEM * 1024UL * 1024UL * 1024UL);
+      env.set_max_dbs(100);
+      env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+      auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+      auto dbAll = lmdb::dbi::open(rotxn, "all");
+      REQUIRE(clustered::isClustered(rotxn.handle(), dbAll.handle()));
+      REQUIRE(layout == useKeyLayoutOf(rotxn.handle(), dbAll.handle()));
+
+      // "all" contains only the fixed fields of the keys.
+      std::vector<std::string> keysInAll;
+      std::set<std::string> tables;
+      auto cursor = lmdb::cursor::open(rotxn, dbAll);
+      MDB_val key;
+      MDB_val value;
+      while (cursor.get(&key, &value, MDB_NEXT)) {
+        const char *ptr = static_cast<char*>(key.mv_data);
+        REQUIRE(KEY_SIZE == key.mv_size);
+        REQUIRE(0 == value.mv_size);
+        keysInAll.emplace_back(ptr, key.mv_size);
+        tables.insert(clustered::tableOf(keyDataType(ptr), keySenderStamp(ptr)));
+      }
+      cursor.close();
+      REQUIRE(19 == keysInAll.size());
+
+      // Merging the stream tables yields the keys in the same order as "all", with their values.
+      std::vector<std::string> mergedKeys;
+      {
+        clustered::Merge merge(rotxn.handle(), std::vector<std::string>(tables.begin(), tables.end()), layout, 0);
+        while (merge.next(key, value)) {
+          REQUIRE(KEY_SIZE <= key.mv_size);
+          REQUIRE(0 < storedValueOf(key, value).mv_size);
+          mergedKeys.emplace_back(static_cast<char*>(key.mv_data), KEY_SIZE);
+        }
+      }
+      REQUIRE(keysInAll == mergedKeys);
+
+      // Starting after the first timeStamp skips the first entries.
+      {
+        clustered::Merge merge(rotxn.handle(), std::vector<std::string>(tables.begin(), tables.end()), layout, keyTimeStamp(keysInAll.front().data()) + 1);
+        uint32_t merged{0};
+        while (merge.next(key, value)) {
+          merged++;
+        }
+        REQUIRE(18 == merged);
+      }
+      rotxn.abort();
+    }
+  }
+
+  UNLINK(RECFILENAME.c_str());
+  UNLINK(CABINETNAME.c_str());
+  UNLINK(CABINETNAME_LOCK.c_str());
+  UNLINK(REC2FILENAME.c_str());
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifdef WIN32
+    #define UNLINK _unlink
+#else
+    #include <unistd.h>
+    #define UNLINK unlink
+#endif
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "cabinet-migrate.hpp"
+#include "rec2cabinet2.hpp"
+#include "timeline.hpp"
+
+#include "lmdb++.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using Buckets = std::map<timeline::Timeline::Stream, std::vector<timeline::Bucket>>;
+
+static Buckets bucketsOf(const std::string &CABINET, const int64_t &from, const int64_t &to) {
+  Buckets buckets;
+  auto env = lmdb::env::create();
+  env.set_mapsize(1UL * 1024UL * 1024UL * 1024UL);
+  env.set_max_dbs(100);
+  env.open(CABINET.c_str(), MDB_NOSUBDIR|MDB_RDONLY, 0600);
+  auto rotxn = lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+  REQUIRE(timeline::query(rotxn.handle(), from, to, buckets));
+  rotxn.abort();
+  return buckets;
+}
+
+namespace timeline {
+static bool operator==(const Bucket &lhs, const Bucket &rhs) {
+  return (lhs.minute == rhs.minute) && (lhs.count == rhs.count) && (lhs.rawBytes == rhs.rawBytes);
+}
+}
+
+TEST_CASE("Test ordering and querying the buckets per stream and minute") {
+  const int64_t MINUTE{timeline::BUCKET};
+  REQUIRE(0 == timeline::minuteOf(0));
+  REQUIRE(0 == timeline::minuteOf(MINUTE - 1));
+  REQUIRE(1 == timeline::minuteOf(MINUTE));
+  REQUIRE(-1 == timeline::minuteOf(-1));
+  REQUIRE(-1 == timeline::minuteOf(-MINUTE));
+  REQUIRE(-2 == timeline::minuteOf(-MINUTE - 1));
+
+  // The keys are ordered by stream and then by minute with memcmp.
+  char a[timeline::KEY_SIZE];
+  char b[timeline::KEY_SIZE];
+  timeline::keyOf(-1, 7, 100, a);
+  timeline::keyOf(0, 0, -100, b);
+  REQUIRE(0 > std::memcmp(a, b, timeline::KEY_SIZE));
+  timeline::keyOf(0, 0, -1, a);
+  timeline::keyOf(0, 0, 1, b);
+  REQUIRE(0 > std::memcmp(a, b, timeline::KEY_SIZE));
+  REQUIRE(std::make_tuple(0, 0u, int64_t{1}) == timeline::fromKey(b));
+  timeline::keyOf(std::numeric_limits<int32_t>::min(), std::numeric_limits<uint32_t>::max(), std::numeric_limits<int64_t>::min(), a);
+  REQUIRE(std::make_tuple(std::numeric_limits<int32_t>::min(), std::numeric_limits<uint32_t>::max(), std::numeric_limits<int64_t>::min()) == timeline::fromKey(a));
+
+  const std::vector<timeline::Bucket> BUCKETS{{3, 1, 1}, {4, 1, 1}, {7, 1, 1}};
+  REQUIRE((std::vector<std::pair<int64_t, int64_t>>{{0, 2}, {5, 6}, {8, 9}}) == timeline::gapsOf(BUCKETS, 0, 9));
+  REQUIRE((std::vector<std::pair<int64_t, int64_t>>{{5, 6}}) == timeline::gapsOf(BUCKETS, 4, 7));
+  REQUIRE(timeline::gapsOf(BUCKETS, 3, 4).empty());
+
+  const std::string CABINETNAME{"tests-timeline-query.cab"};
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+  {
+    auto env = lmdb::env::create();
+    env.set_mapsize(1UL * 1024UL * 1024UL * 1024UL);
+    env.set_max_dbs(100);
+    env.open(CABINETNAME.c_str(), MDB_NOSUBDIR, 0600);
+
+    timeline::Timeline changes;
+    for (int64_t minute{0}; minute < 100; minute++) {
+      changes.add(19, 0, minute * MINUTE, 10);
+      if (0 == (minute % 10)) {
+        changes.add(1046, 1, minute * MINUTE + 1, 100);
+      }
+    }
+    changes.add(-5, 2, -1, 1);
+    auto txn = lmdb::txn::begin(env);
+    REQUIRE(MDB_SUCCESS == changes.store(txn.handle()));
+    txn.commit();
+
+    // Later changes are merged into the stored buckets.
+    changes.add(19, 0, 50 * MINUTE + 5, 20);
+    txn = lmdb::txn::begin(env);
+    REQUIRE(MDB_SUCCESS == changes.store(txn.handle()));
+    txn.commit();
+  }
+
+  Buckets all{bucketsOf(CABINETNAME, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max())};
+  REQUIRE(3 == all.size());
+  REQUIRE(100 == all[std::make_pair(19, 0u)].size());
+  REQUIRE(10 == all[std::make_pair(1046, 1u)].size());
+  REQUIRE((timeline::Bucket{-1, 1, 1}) == all[std::make_pair(-5, 2u)].at(0));
+
+  // Only the buckets in the range are read; the last minute is inclusive.
+  Buckets range{bucketsOf(CABINETNAME, 45 * MINUTE + 1, 50 * MINUTE)};
+  REQUIRE(2 == range.size());
+  REQUIRE(6 == range[std::make_pair(19, 0u)].size());
+  REQUIRE((timeline::Bucket{45, 1, 10}) == range[std::make_pair(19, 0u)].front());
+  REQUIRE((timeline::Bucket{50, 2, 30}) == range[std::make_pair(19, 0u)].back());
+  REQUIRE(1 == range[std::make_pair(1046, 1u)].size());
+  REQUIRE((timeline::Bucket{50, 1, 100}) == range[std::make_pair(1046, 1u)].front());
+  REQUIRE(bucketsOf(CABINETNAME, 200 * MINUTE, 300 * MINUTE).empty());
+
+  UNLINK(CABINETNAME.c_str());
+  UNLINK((CABINETNAME + "-lock").c_str());
+}
+
+TEST_CASE("Test maintaining the timeline while importing and migrating") {
+  const bool VERBOSE{false};
+  const uint64_t MEM{1};
+  const std::string RECFILENAME{"tests-timeline.rec"};
+  const std::vector<std::string> CABINETNAMES{"tests-timeline.cab", "tests-timeline-v1.cab", "tests-timeline-packed.cab"};
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+
+  // A stream at 10Hz over 10 minutes that pauses in minutes 4 and 5, and a stream at 1Hz; the expected buckets are computed from the .rec file.
+  const int64_t START{1600000000L - (1600000000L % 60)};
+  Buckets expected;
+  {
+    std::fstream rec(RECFILENAME.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+    for (int64_t i{0}; i < 6000; i++) {
+      const bool PAUSED{(2400 <= i) && (i < 3600)};
+      if (PAUSED && (0 != (i % 10))) {
+        continue;
+      }
+      const int32_t dataType{(0 == (i % 10)) ? 1046 : 19};
+      cluon::data::Envelope e;
+      e.dataType(dataType).serializedData(std::string(static_cast<std::size_t>(10 + (i % 50)), 'x')).sampleTimeStamp(cluon::time::fromMicroseconds((START * 10L + i) * 100000L));
+      const std::string s{cluon::serializeEnvelope(std::move(e))};
+      rec.write(s.data(), s.size());
+      std::vector<timeline::Bucket> &buckets = expected[std::make_pair(dataType, 0u)];
+      const int64_t MINUTE{(START + i / 10) / 60};
+      if (buckets.empty() || (buckets.back().minute != MINUTE)) {
+        buckets.push_back(timeline::Bucket{MINUTE, 0, 0});
+      }
+      buckets.back().count++;
+      buckets.back().rawBytes += s.size();
+    }
+  }
+  REQUIRE(8 == expected[std::make_pair(19, 0u)].size());
+  REQUIRE(10 == expected[std::make_pair(1046, 0u)].size());
+  auto sameAsExpected = [&expected](const Buckets &buckets) {
+    REQUIRE(expected.size() == buckets.size());
+    for (const auto &e : expected) {
+      REQUIRE(1 == buckets.count(e.first));
+      REQUIRE(e.second == buckets.at(e.first));
+    }
+  };
+  const int64_t NS{1000L * 1000L * 1000L};
+  const int64_t FROM{START * NS};
+  const int64_t TO{(START + 600) * NS - 1};
+
+  cluon::In_Ranges<int64_t> ranges;
+  REQUIRE(0 == rec2cabinet("tests-timeline", MEM, RECFILENAME, CABINETNAMES.at(0), 0, ranges, VERBOSE, 2));
+  sameAsExpected(bucketsOf(CABINETNAMES.at(0), FROM, TO));
+  REQUIRE((std::vector<std::pair<int64_t, int64_t>>{{START / 60 + 4, START / 60 + 5}}) == timeline::gapsOf(bucketsOf(CABINETNAMES.at(0), FROM, TO).at(std::make_pair(19, 0u)), START / 60, START / 60 + 9));
+
+  // Duplicates do not change the timeline.
+  REQUIRE(0 == rec2cabinet("tests-timeline", MEM, RECFILENAME, CABINETNAMES.at(0), 0, ranges, VERBOSE, 2));
+  sameAsExpected(bucketsOf(CABINETNAMES.at(0), FROM, TO));
+
+  // Migrating rebuilds the timeline, also for blocks.
+  REQUIRE(0 == cabinet_migrate("tests-timeline", MEM, CABINETNAMES.at(0), CABINETNAMES.at(1), KEY_LAYOUT_MEMCMP, VERBOSE, 100));
+  sameAsExpected(bucketsOf(CABINETNAMES.at(1), FROM, TO));
+  REQUIRE(0 == cabinet_migrate("tests-timeline", MEM, CABINETNAMES.at(0), CABINETNAMES.at(2), KEY_LAYOUT_MEMCMP, VERBOSE, 100, 64, 1000));
+  sameAsExpected(bucketsOf(CABINETNAMES.at(2), FROM, TO));
+
+  UNLINK(RECFILENAME.c_str());
+  for (auto c : CABINETNAMES) {
+    UNLINK(c.c_str());
+    UNLINK((c + "-lock").c_str());
+  }
+}